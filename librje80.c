@@ -0,0 +1,3550 @@
+//  librje80 - the IBM 2780/3780 RJE station engine behind rje80.
+//
+//  This is the bisync line handling that used to live in rje80.c, with its
+//  state moved into a struct rje_session so several lines can be run by one
+//  program.  Sending is driven by rje_poll as a small state machine (bid,
+//  text, ack) rather than a loop that waits on the line, so the caller is
+//  never stuck behind a slow host.  As before, this works with the BSC
+//  protocol as implemented by the Hercules/370 2703 device, not with
+//  "real" bisync hardware.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+
+#if defined (_WIN32)	// Windows
+#include <winsock2.h>
+#include <io.h>
+#include <windows.h>
+#else					// Linux
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#endif
+#include <ctype.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/stat.h>
+
+#include "librje80.h"
+
+// Internal prototypes
+
+static int xmit_dispatch(struct rje_session *s);
+static int job_start(struct rje_session *s);
+static int job_best(struct rje_session *s);
+static int xmit_chain(struct rje_session *s);
+static int xmit_start(struct rje_session *s);
+static int xmit_bid(struct rje_session *s);
+static int xmit_next(struct rje_session *s);
+static int xmit_reply(struct rje_session *s);
+static int xmit_timeout(struct rje_session *s);
+static int xmit_wack(struct rje_session *s);
+static int xmit_hold(struct rje_session *s);
+static int xmit_done(struct rje_session *s, int rc);
+static int xmit_idle(struct rje_session *s, int rc, int done);
+static int send_eot(struct rje_session *s);
+static int line_lost(struct rje_session *s);
+static int idle_frame(struct rje_session *s);
+static int recv_char(struct rje_session *s, unsigned char ch);
+static int end_of_output(struct rje_session *s);
+static int job_card(struct rje_session *s, unsigned char *card, int len,
+	int id, char *file);
+static int job_message(struct rje_session *s, char *text);
+static int job_record(struct rje_session *s, int dev, unsigned char *rec,
+	int len);
+static int job_output_end(struct rje_session *s, int dev, int n);
+static char *job_label(struct rje_jobrec *j, char *buf);
+static int ml_begin(struct rje_session *s);
+static int ml_signon(struct rje_session *s);
+static int ml_char(struct rje_session *s, unsigned char ch);
+static int ml_block(struct rje_session *s);
+static int ml_heard(struct rje_session *s, int block);
+static int ml_resend(struct rje_session *s);
+static int ml_service(struct rje_session *s);
+static int ml_pending(struct rje_session *s);
+static int ml_fcs(struct rje_session *s, int byte);
+static int ml_send(struct rje_session *s);
+static int ml_frame(struct rje_session *s, unsigned char *blk, int len);
+static int ml_cards(struct rje_session *s, struct rje_mlstream *m, int n,
+	unsigned char *blk, int *len);
+static int ml_deck_done(struct rje_session *s, struct rje_mlstream *m, int n);
+static int ml_readers(struct rje_session *s);
+static int ml_job(struct rje_session *s, int kind);
+static int ml_control(struct rje_session *s, int rcb, int srcb);
+static struct rje_mlstream *ml_stream(struct rje_session *s, int rcb);
+static int ml_request(struct rje_session *s, int srcb);
+static int ml_start_output(struct rje_session *s, struct rje_mlstream *m,
+	int rcb);
+static int ml_record(struct rje_session *s, int rcb, int srcb,
+	unsigned char *rec, int len);
+static int ml_end_output(struct rje_session *s, struct rje_mlstream *m,
+	int rcb);
+static int ml_swap(struct rje_session *s, struct rje_mlstream *m, int dev);
+static int ml_stop(struct rje_session *s);
+static int ml_event(struct rje_session *s, int type, int kind, int id,
+	int rc, int device);
+static int ckpt_open(struct rje_session *s);
+static int ckpt_write(struct rje_session *s);
+static int ckpt_close(struct rje_session *s, int done);
+static int push_event(struct rje_session *s, int type, int rc);
+static int lat_start(struct rje_session *s, int kind);
+static int lat_end(struct rje_session *s, int kind);
+static int read_poll(struct rje_session *s, int sec, int usec);
+static int read_frame(struct rje_session *s);
+static int get_buffer(struct rje_session *s);
+static int clear_input_buffer(struct rje_session *s);
+static int clear_input_record(struct rje_session *s);
+static int write_record(struct rje_session *s);
+static int print_record(struct rje_session *s, const struct rje_fcact *fc,
+	unsigned char *line, int len);
+static int print_flush(struct rje_session *s);
+static int put_record(struct rje_session *s, int dev, int vb, int cc,
+	unsigned char *data, int len, int recl, unsigned char fill);
+static int out_open(struct rje_session *s, int dev);
+static int out_write(struct rje_session *s, int dev, const void *data,
+	int len);
+static int out_end(struct rje_session *s, int dev, int close);
+static int sink_service(struct rje_session *s);
+static int pages_open(struct rje_session *s);
+static int page_mark(struct rje_session *s, int flags, const char *text,
+	int len);
+static int sink_done(struct rje_session *s, struct rje_sink *k);
+static int write_buffer(struct rje_session *s);
+static int send_ack(struct rje_session *s, unsigned char ack);
+static int block_ack(struct rje_session *s);
+static int recv_enq(struct rje_session *s);
+static int sink_busy(struct rje_session *s);
+static int send_ctl(struct rje_session *s, const unsigned char *ctl, int len);
+static int trace_line(struct rje_session *s, char *tag,
+	unsigned char *buf, int len);
+
+// Timing (milliseconds) and retry limits: the defaults for a new
+// session's s->tm
+
+#define BID_WAIT 10000		/* reply to our ENQ */
+#define SIGNON_WAIT 3000	/* ... when signing on */
+#define TEXT_WAIT 10000		/* reply to a block */
+#define POLL_TIME 500		/* between polls of an idle line */
+#define BID_TRIES 10		/* ENQs before giving up */
+#define SIGNON_TRIES 3
+#define NAK_TRIES 10		/* NAKs of one block before giving up */
+#define WACK_WAIT 250		/* before the ENQ after a WACK, doubling */
+#define WACK_MAX 4000		/* ... up to this */
+#define WACK_TRIES 100		/* WACKs in a row before giving up */
+#define TTD_TIME 2000		/* next card late this long: send TTD */
+
+#define PAGE_STARTS 0x100	/* in pages.next, or'ed with RJE_PAGE_xxx */
+
+// BSC control characters
+
+static const unsigned char SOH = 0x01;
+static const unsigned char STX = 0x02;
+static const unsigned char ETX = 0x03;
+static const unsigned char DLE = 0x10;
+static const unsigned char DC1 = 0x11;
+static const unsigned char DC2 = 0x12;
+static const unsigned char NL  = 0x15;
+static const unsigned char EM  = 0x19;
+static const unsigned char IGS = 0x1d;
+static const unsigned char IRS = 0x1e;
+static const unsigned char ITB = 0x1f;
+static const unsigned char ETB = 0x26;
+static const unsigned char ESC = 0x27;
+static const unsigned char ENQ = 0x2d;
+static const unsigned char SYN = 0x32;
+static const unsigned char EOT = 0x37;
+static const unsigned char NAK = 0x3d;
+static const unsigned char DC3 = 0x5d;
+static const unsigned char ACK1 = 0x61;
+static const unsigned char WABT = 0x6b;
+static const unsigned char ACK0 = 0x70;
+static const unsigned char EPAD = 0xff;
+static const unsigned char SPAD = 0xaa;
+static const unsigned char RVI = 0x7c;
+
+// Can an interrupted deck be resumed from the last ACKed record, or does
+// the host discard (or run) a partial deck?  Indexed by opt_os.
+
+static const int os_resume[7] = {1, 0, 0, 0, 0, 0, 0};
+
+// Will the host take several decks in one transmission and split them
+// into jobs itself?  RSCS would make them one spool file, and we don't
+// know about a generic host.
+
+static const int os_batch[7] = {0, 0, 1, 1, 1, 1, 1};
+
+// "ID       " in EBCDIC, the start of a VM/370 RSCS ID card
+
+static const unsigned char vm_id[9] = {
+	0xc9, 0xc4, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40
+};
+
+// Translation tables (from Hercules)
+
+static unsigned char
+ascii_to_ebcdic[] = {
+    "\x00\x01\x02\x03\x37\x2D\x2E\x2F\x16\x05\x25\x0B\x0C\x0D\x0E\x0F"
+    "\x10\x11\x12\x13\x3C\x3D\x32\x26\x18\x19\x1A\x27\x22\x1D\x35\x1F"
+    "\x40\x5A\x7F\x7B\x5B\x6C\x50\x7D\x4D\x5D\x5C\x4E\x6B\x60\x4B\x61"
+    "\xF0\xF1\xF2\xF3\xF4\xF5\xF6\xF7\xF8\xF9\x7A\x5E\x4C\x7E\x6E\x6F"
+    "\x7C\xC1\xC2\xC3\xC4\xC5\xC6\xC7\xC8\xC9\xD1\xD2\xD3\xD4\xD5\xD6"
+    "\xD7\xD8\xD9\xE2\xE3\xE4\xE5\xE6\xE7\xE8\xE9\xAD\xE0\xBD\x5F\x6D"
+    "\x79\x81\x82\x83\x84\x85\x86\x87\x88\x89\x91\x92\x93\x94\x95\x96"
+    "\x97\x98\x99\xA2\xA3\xA4\xA5\xA6\xA7\xA8\xA9\xC0\x6A\xD0\xA1\x07"
+    "\x68\xDC\x51\x42\x43\x44\x47\x48\x52\x53\x54\x57\x56\x58\x63\x67"
+    "\x71\x9C\x9E\xCB\xCC\xCD\xDB\xDD\xDF\xEC\xFC\xB0\xB1\xB2\xB3\xB4"
+    "\x45\x55\xCE\xDE\x49\x69\x04\x06\xAB\x08\xBA\xB8\xB7\xAA\x8A\x8B"
+    "\x09\x0A\x14\xBB\x15\xB5\xB6\x17\x1B\xB9\x1C\x1E\xBC\x20\xBE\xBF"
+    "\x21\x23\x24\x28\x29\x2A\x2B\x2C\x30\x31\xCA\x33\x34\x36\x38\xCF"
+    "\x39\x3A\x3B\x3E\x41\x46\x4A\x4F\x59\x62\xDA\x64\x65\x66\x70\x72"
+    "\x73\xE1\x74\x75\x76\x77\x78\x80\x8C\x8D\x8E\xEB\x8F\xED\xEE\xEF"
+    "\x90\x9A\x9B\x9D\x9F\xA0\xAC\xAE\xAF\xFD\xFE\xFB\x3F\xEA\xFA\xFF"
+};
+
+static unsigned char
+ebcdic_to_ascii[] = {
+    "\x00\x01\x02\x03\xA6\x09\xA7\x7F\xA9\xB0\xB1\x0B\x0C\x0D\x0E\x0F"
+    "\x10\x11\x12\x13\xB2\x0A\x08\xB7\x18\x19\x1A\xB8\xBA\x1D\xBB\x1F"
+    "\xBD\xC0\x1C\xC1\xC2\x0A\x17\x1B\xC3\xC4\xC5\xC6\xC7\x05\x06\x07"
+    "\xC8\xC9\x16\xCB\xCC\x1E\xCD\x04\xCE\xD0\xD1\xD2\x14\x15\xD3\xFC"
+    "\x20\xD4\x83\x84\x85\xA0\xD5\x86\x87\xA4\xD6\x2E\x3C\x28\x2B\xD7"
+    "\x26\x82\x88\x89\x8A\xA1\x8C\x8B\x8D\xD8\x21\x24\x2A\x29\x3B\x5E"
+    "\x2D\x2F\xD9\x8E\xDB\xDC\xDD\x8F\x80\xA5\x7C\x2C\x25\x5F\x3E\x3F"
+    "\xDE\x90\xDF\xE0\xE2\xE3\xE4\xE5\xE6\x60\x3A\x23\x40\x27\x3D\x22"
+    "\xE7\x61\x62\x63\x64\x65\x66\x67\x68\x69\xAE\xAF\xE8\xE9\xEA\xEC"
+    "\xF0\x6A\x6B\x6C\x6D\x6E\x6F\x70\x71\x72\xF1\xF2\x91\xF3\x92\xF4"
+    "\xF5\x7E\x73\x74\x75\x76\x77\x78\x79\x7A\xAD\xA8\xF6\x5B\xF7\xF8"
+    "\x9B\x9C\x9D\x9E\x9F\xB5\xB6\xAC\xAB\xB9\xAA\xB3\xBC\x5D\xBE\xBF"
+    "\x7B\x41\x42\x43\x44\x45\x46\x47\x48\x49\xCA\x93\x94\x95\xA2\xCF"
+    "\x7D\x4A\x4B\x4C\x4D\x4E\x4F\x50\x51\x52\xDA\x96\x81\x97\xA3\x98"
+    "\x5C\xE1\x53\x54\x55\x56\x57\x58\x59\x5A\xFD\xEB\x99\xED\xEE\xEF"
+    "\x30\x31\x32\x33\x34\x35\x36\x37\x38\x39\xFE\xFB\x9A\xF9\xFA\xFF"
+};
+
+// ---------------------------------------------------------------------------------
+// Session life cycle
+// ---------------------------------------------------------------------------------
+
+// Socket initialization (Windows only), once per program
+
+int rje_init()
+{
+#if defined (_WIN32)
+	int err;
+	WORD wVersionRequested;
+	WSADATA wsaData;
+
+	wVersionRequested = MAKEWORD (1, 1);
+	err = WSAStartup(wVersionRequested, &wsaData);
+	if (err != 0) {
+		printf("\r\nRJE000T Winsock: Startup error number %d\n", err);
+		return (-1);
+	}
+#endif
+	return (0);
+}
+
+// Shutdown Sockets (Windows Only)
+
+int rje_term()
+{
+	return (0);
+}
+
+// Make a new session with the same defaults rje80 always had
+
+struct rje_session *rje_new()
+{
+	struct rje_session *s;
+
+	s = (struct rje_session *) calloc(1, sizeof(struct rje_session));
+	if (s == NULL)
+		return (NULL);
+	s->status = NOLINK;
+	s->sockfd = -1;
+	s->pollflag = 2;
+	s->reader_recl = 80;
+	s->print_recl = 132;
+	rje_forms_init(&s->forms);
+	strcpy(s->punch, "punch.txt");
+	s->punch_recl = 80;
+	s->opt_poll = 1;
+	s->opt_trn = 1;
+	s->opt_copy = 1;
+	s->opt_os = 2;
+	s->opt_ckpt = 1;
+	s->opt_batch = 8;
+	s->opt_wack = 1;
+	s->opt_mlrdrs = 1;
+	s->tm.bid_wait = BID_WAIT;
+	s->tm.signon_wait = SIGNON_WAIT;
+	s->tm.text_wait = TEXT_WAIT;
+	s->tm.poll_time = POLL_TIME;
+	s->tm.bid_tries = BID_TRIES;
+	s->tm.signon_tries = SIGNON_TRIES;
+	s->tm.nak_tries = NAK_TRIES;
+	s->tm.wack_wait = WACK_WAIT;
+	s->tm.wack_max = WACK_MAX;
+	s->tm.wack_tries = WACK_TRIES;
+	s->tm.ttd_time = TTD_TIME;
+	return (s);
+}
+
+// Throw a session away, closing anything it has open
+
+int rje_free(struct rje_session *s)
+{
+	int i;
+
+	rje_close(s);
+	rje_output_close(s, 0);
+	rje_output_close(s, 1);
+	for (i = 0; i < RJE_SINKS; i++)
+		rje_sink_finish(&s->sinks[i]);
+	rje_index_close(s->index);
+	if (strlen(s->tracefile) > 0)
+		fclose(s->tracefd);
+	free(s);
+	return (0);
+}
+
+// Pass a message to whoever is running the session
+
+int rje_msg(struct rje_session *s, char *msg)
+{
+	if (s->msgfn != NULL)
+		s->msgfn(s, msg);
+	return (0);
+}
+
+// Put another clock (microseconds) in place of the real one, for running
+// sessions in simulated time (see rjesim).  NULL goes back to real time.
+
+static long long (*clockfn)() = NULL;
+
+int rje_set_clock(long long (*fn)())
+{
+	clockfn = fn;
+	return (0);
+}
+
+// A clock in milliseconds, for timeouts and polling
+
+long rje_clock()
+{
+	if (clockfn != NULL)
+		return ((long) (clockfn() / 1000));
+#if defined (_WIN32)
+	return ((long) GetTickCount());
+#else
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return (tv.tv_sec * 1000L + tv.tv_usec / 1000);
+#endif
+}
+
+// The same in microseconds, for timing the host's answers
+
+long long rje_uclock()
+{
+	if (clockfn != NULL)
+		return (clockfn());
+#if defined (_WIN32)
+	LARGE_INTEGER t, f;
+
+	QueryPerformanceCounter(&t);
+	QueryPerformanceFrequency(&f);
+	return ((long long) (t.QuadPart * 1000000.0 / f.QuadPart));
+#else
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return (tv.tv_sec * 1000000LL + tv.tv_usec);
+#endif
+}
+
+// Change one of the session's timings (milliseconds) or retry limits,
+// by the name of its field in struct rje_timing
+
+int rje_set_timing(struct rje_session *s, char *name, long value)
+{
+	static const struct {
+		char *name;
+		int off;
+	} tm[] = {
+		{"bid_wait", offsetof(struct rje_timing, bid_wait)},
+		{"signon_wait", offsetof(struct rje_timing, signon_wait)},
+		{"text_wait", offsetof(struct rje_timing, text_wait)},
+		{"poll_time", offsetof(struct rje_timing, poll_time)},
+		{"bid_tries", offsetof(struct rje_timing, bid_tries)},
+		{"signon_tries", offsetof(struct rje_timing, signon_tries)},
+		{"nak_tries", offsetof(struct rje_timing, nak_tries)},
+		{"wack_wait", offsetof(struct rje_timing, wack_wait)},
+		{"wack_max", offsetof(struct rje_timing, wack_max)},
+		{"wack_tries", offsetof(struct rje_timing, wack_tries)},
+		{"ttd_time", offsetof(struct rje_timing, ttd_time)}
+	};
+	int i;
+
+	if (value < 0)
+		return (-1);
+	for (i = 0; i < sizeof(tm) / sizeof(tm[0]); i++) {
+		if (strcmp(name, tm[i].name) == 0) {
+			*(long *) ((char *) &s->tm + tm[i].off) = value;
+			return (0);
+		}
+	}
+	return (-1);
+}
+
+// Start (or stop, with an empty file name) recording a trace of the line
+
+int rje_trace(struct rje_session *s, char *file)
+{
+	if (strlen(s->tracefile) > 0)
+		fclose(s->tracefd);
+	strcpy(s->tracefile, "");
+	if (strlen(file) > 0) {
+		s->tracefd = fopen(file, "w");
+		if (s->tracefd == NULL)
+			return (-1);
+		strcpy(s->tracefile, file);
+	}
+	return (0);
+}
+
+// Keep a full text index of print output in file, or (file empty) stop.
+// Output part way through when it's changed isn't indexed.
+
+int rje_set_index(struct rje_session *s, char *file)
+{
+	rje_index_close(s->index);
+	s->index = NULL;
+	strcpy(s->indexfile, "");
+	if (strlen(file) > 0) {
+		s->index = rje_index_open(file, ebcdic_to_ascii);
+		if (s->index == NULL)
+			return (-1);
+		strcpy(s->indexfile, file);
+	}
+	return (0);
+}
+
+// Write the line's response time histograms to fd
+
+int rje_latency_dump(struct rje_session *s, FILE *fd)
+{
+	static char *name[RJE_LAT_KINDS] = {
+		"bid response", "block ack", "poll response", "turnaround"
+	};
+	int i;
+
+	fprintf(fd, "# %s %d\n", s->inethost, s->inetport);
+	for (i = 0; i < RJE_LAT_KINDS; i++)
+		rje_hist_dump(&s->lat[i], name[i], fd);
+	return (0);
+}
+
+// Start the histograms again
+
+int rje_latency_reset(struct rje_session *s)
+{
+	int i;
+
+	for (i = 0; i < RJE_LAT_KINDS; i++) {
+		rje_hist_clear(&s->lat[i]);
+		s->lat_start[i] = 0;
+	}
+	return (0);
+}
+
+// The write just made wants an answer: time it
+
+static int lat_start(struct rje_session *s, int kind)
+{
+	s->lat_start[kind] = s->lat_wrote;
+	return (0);
+}
+
+// The answer is here (it came in with the last read).  A frame that was
+// already in hand when we wrote isn't the answer to it.
+
+static int lat_end(struct rje_session *s, int kind)
+{
+	if (s->lat_start[kind] == 0)
+		return (0);
+	if (s->lat_read >= s->lat_start[kind])
+		rje_hist_add(&s->lat[kind], (long) (s->lat_read - s->lat_start[kind]));
+	s->lat_start[kind] = 0;
+	return (0);
+}
+
+// Hand the caller the oldest event we have.  Returns 1 if there was one.
+
+int rje_event(struct rje_session *s, struct rje_event *ev)
+{
+	if (s->ev_head == s->ev_tail)
+		return (0);
+	*ev = s->ev[s->ev_tail];
+	s->ev_tail = (s->ev_tail + 1) % RJE_MAXEV;
+	return (1);
+}
+
+// Queue an event.  If the caller isn't reading them, the oldest goes.
+
+static int push_event(struct rje_session *s, int type, int rc)
+{
+	struct rje_event *ev;
+
+	ev = &s->ev[s->ev_head];
+	ev->type = type;
+	ev->status = s->status;
+	ev->kind = s->xmit;
+	ev->id = s->xmit_id;
+	ev->rc = rc;
+	ev->device = s->device_select;
+	s->ev_head = (s->ev_head + 1) % RJE_MAXEV;
+	if (s->ev_head == s->ev_tail)
+		s->ev_tail = (s->ev_tail + 1) % RJE_MAXEV;
+	return (0);
+}
+
+// ---------------------------------------------------------------------------------
+// Line operations
+// ---------------------------------------------------------------------------------
+
+// Function to connect to the host
+
+int rje_open(struct rje_session *s, char *host, int port)
+{
+	struct hostent *he;
+	struct sockaddr_in sin;
+	struct in_addr intmp;
+	char thing[128];
+	int rc;
+#if defined (_WIN32)
+	int wsaerrno;
+	long int non_block = 1;
+#endif
+
+	strncpy(s->inethost, host, sizeof(s->inethost) - 1);
+	s->inethost[sizeof(s->inethost) - 1] = 0;
+	s->inetport = port;
+	he = gethostbyname(s->inethost);
+	strcpy(s->hname, s->inethost);	/* the same size */
+	if (he == NULL) {
+		rje_msg(s, "\r\nRJE201A Can't locate hostname: ");
+		rje_msg(s, s->inethost);
+		rje_msg(s, "\r\n");
+		return(-1);
+	}
+	memcpy(&s->host_ip, he->h_addr_list[0], 4);
+	sin.sin_family = AF_INET;
+	sin.sin_addr.s_addr = s->host_ip;
+	sin.sin_port = htons(s->inetport);
+	s->sockfd = socket(AF_INET, SOCK_STREAM, 0);
+#if defined (_WIN32)
+	ioctlsocket (s->sockfd, FIONBIO, &non_block);
+	rc = connect(s->sockfd, (struct sockaddr *)&sin, sizeof(sin));
+	if ((rc == SOCKET_ERROR) &&
+		(wsaerrno = WSAGetLastError() != WSAEWOULDBLOCK)) {
+		rje_msg(s, "\r\nRJE202S Failed to connect\r\n");
+		rje_msg(s, "\r\nRJE202I The winsock error number is ");
+		sprintf(thing, "%d", wsaerrno);
+		rje_msg(s, thing);
+		close(s->sockfd);
+		s->status = NOLINK;
+		return (-1);
+	}
+#else
+	rc = fcntl(s->sockfd, F_GETFL);
+	rc |= O_NONBLOCK;
+	fcntl(s->sockfd, F_SETFL, rc);
+	fcntl(s->sockfd, F_SETFD, FD_CLOEXEC);	/* not for sinks */
+	rc = connect(s->sockfd, (struct sockaddr *)&sin, sizeof(sin));
+	if (rc < 0 && errno!= EINPROGRESS) {
+		rje_msg(s, "\r\nRJE202S Failed to connect\r\n");
+		rje_msg(s, "RJE202I The reason was: ");
+		rje_msg(s, strerror(errno));
+		rje_msg(s, "\r\n");
+		close(s->sockfd);
+		s->status = NOLINK;
+		return (-1);
+	}
+#endif
+	rje_msg(s, "\r\nRJE203I Link established to ");
+	rje_msg(s, s->hname);
+	rje_msg(s, " (");
+	intmp.s_addr = s->host_ip;
+	strcpy(thing, (char *)inet_ntoa(intmp));
+	rje_msg(s, thing);
+	rje_msg(s, ") ");
+	rje_msg(s, " port ");
+	sprintf(thing, "%d", s->inetport);
+	rje_msg(s, thing);
+	rje_msg(s, ".");
+	s->status = INITIAL_WAIT;
+	s->phy_ctr = 0;
+	clear_input_buffer(s);
+	push_event(s, RJE_EV_STATUS, 0);
+	return (1);
+}
+
+// Bring up a line that isn't a socket: s->waitfn, readfn and writefn
+// carry it (a simulated host, say).  name is only for messages.
+
+int rje_attach(struct rje_session *s, char *name)
+{
+	if (s->waitfn == NULL || s->readfn == NULL || s->writefn == NULL)
+		return (-1);
+	strncpy(s->inethost, name, sizeof(s->inethost) - 1);
+	s->inethost[sizeof(s->inethost) - 1] = 0;
+	strcpy(s->hname, s->inethost);
+	s->inetport = 0;
+	rje_msg(s, "\r\nRJE200I Link established to ");
+	rje_msg(s, s->hname);
+	rje_msg(s, ".");
+	s->status = INITIAL_WAIT;
+	s->phy_ctr = 0;
+	clear_input_buffer(s);
+	push_event(s, RJE_EV_STATUS, 0);
+	return (1);
+}
+
+// Drop the connection.  Anything being sent fails.
+
+int rje_close(struct rje_session *s)
+{
+	int i;
+
+	if (s->status <= NOLINK)
+		return (0);
+	if (s->status == MULTILEAVE)
+		ml_stop(s);
+	if (s->sockfd >= 0)
+		close(s->sockfd);
+	s->sockfd = -1;
+	s->status = NOLINK;
+	print_flush(s);
+	out_end(s, 0, 0);		/* output cut off */
+	out_end(s, 1, 0);
+	for (i = 0; i < RJE_ML_STREAMS; i++) {
+		if (s->index != NULL && s->job_out[0][i].active)
+			rje_index_end(s->index, i, NULL, 0,
+				i ? s->ml_prt[i].file : s->print);
+	}
+	memset(s->job_out, 0, sizeof(s->job_out));
+	if (s->xmit != XMIT_NONE)
+		xmit_done(s, -1);
+	push_event(s, RJE_EV_STATUS, 0);
+	return (0);
+}
+
+// Sign on to the host OS.  The signon card goes out as a one card
+// transmission; RJE_EV_DONE says how it went.  A user id of * skips
+// the signon, for lines that don't need one.
+
+int rje_signon(struct rje_session *s, char *user, char *password)
+{
+	char signon[128];
+
+	if (s->status < INITIAL_WAIT || s->xmit != XMIT_NONE)
+		return (-1);
+	if (strcmp(user, "*") == 0) {
+		rje_msg(s, "\r\nRJE300I Signon bypassed.");
+		s->status = IDLE;
+		s->pollflag = 2;
+		s->polltime = rje_clock();
+		push_event(s, RJE_EV_STATUS, 0);
+		return (0);
+	}
+
+	// Build the SIGNON card
+
+	switch (s->opt_os) {
+		case 1:		// VM/370
+			strcpy(signon, "SIGNON ");
+			break;
+		case 2:		// JES2
+		case 3:		// JES3
+			strcpy(signon, "/*SIGNON       ");
+			break;
+		case 4:		// DOS/VS
+			strcpy(signon, "* .. SIGNON ");
+			break;
+		case 6:		// OS/360
+			strcpy(signon, ".. RJSTART ");
+			break;
+		default:	// All others
+			strcpy(signon, "SIGNON ");
+			break;
+	}
+	strncat(signon, user, 32);
+	switch (s->opt_os) {
+		case 1:		// VM/370
+			strcat(signon, " ");
+			strcat(signon, "3780 B512 P120 TRSY PCHY");
+			if (strlen(password) > 0) {
+				strcat(signon, " PWD=");
+				strncat(signon, password, 32);
+			}
+			break;
+		case 2:		// JES2 - password in column 25
+		case 3:		// JES3
+			while (strlen(signon) < 24)
+				strcat(signon, " ");
+			strncat(signon, password, 8);
+			break;
+		case 4:		// DOS/VS
+			strcat(signon, " ");
+			strncat(signon, password, 32);
+			break;
+		case 6:		// OS/360
+			strcat(signon, ",BRDCST=YES");
+			break;
+		default:	// All others
+			strcat(signon, " ");
+			strncat(signon, password, 32);
+			break;
+	}
+	strcpy(s->xmit_text, signon);
+
+	// Flush out anything that might be in the pipe
+
+	while (read_poll(s, 0, 5000) == 1) {
+		if (get_buffer(s) < 0)
+			break;
+		s->phy_ctr = 0;
+	}
+	s->phy_ctr = 0;
+	clear_input_buffer(s);
+
+	s->xmit = XMIT_SIGNON;
+	s->xmit_id = ++s->next_id;
+	s->ml = s->opt_ml;
+	xmit_start(s);
+	return (s->xmit_id);
+}
+
+// Queue a deck (or, for *, cards from the cardfn) or an operator command
+// for the host.  It is sent as soon as the line is ours and nothing of a
+// higher priority is waiting; the line need not even be up yet.  Returns
+// the submission id reported with RJE_EV_DONE, or -1.
+
+int rje_queue(struct rje_session *s, int kind, char *text, int prio)
+{
+	struct rje_job *j;
+	FILE *fd;
+
+	if (s->nqueue >= RJE_MAXQ) {
+		rje_msg(s, "\r\nRJE195S Too much work queued for the line already.\r\n");
+		return (-1);
+	}
+	if (kind == XMIT_FILE && rje_reader_stream(text)) {
+		// Not opened here: a FIFO would wait for something to write it
+
+		if (s->reader_fmt == RDR_AWS) {
+			rje_msg(s, "\r\nRJE240S An AWS tape image can't be read from a pipe.\r\n");
+			return (-1);
+		}
+	} else if (kind == XMIT_FILE && strcmp(text, "*") != 0) {
+		if ((fd = fopen(text, "r")) == NULL) {
+			rje_msg(s, "\r\nRJE172S Can't open that file, it doesn't exist?\r\n");
+			return (-1);
+		}
+		fclose(fd);
+	}
+	j = &s->queue[s->nqueue++];
+	memset(j, 0, sizeof(struct rje_job));
+	j->id = ++s->next_id;
+	j->kind = kind;
+	j->prio = (prio < 0) ? 0 : (prio > 9) ? 9 : prio;
+	j->fmt = s->reader_fmt;
+	j->recl = s->reader_recl;
+	if (kind == XMIT_FILE) {
+		strncpy(j->file, text, sizeof(j->file) - 1);
+	} else {
+		switch (s->opt_os) {
+		case 4:
+			strcpy(j->text, "* .. ");
+			break;
+		case 6:
+			strcpy(j->text, ".. ");
+			break;
+		}
+		strncat(j->text, text, sizeof(j->text) - 6);
+	}
+	xmit_dispatch(s);
+	return (j->id);
+}
+
+int rje_submit(struct rje_session *s, char *file)
+{
+	return (rje_queue(s, XMIT_FILE, file, RJE_PRIO_FILE));
+}
+
+// The first n cards of a deck as text, the first 80 columns with the
+// blanks after them gone, to see what's in it before it's queued.
+// Returns how many there were, or -1 if it can't be read (a stream
+// can't be read twice, so isn't).
+
+int rje_deck_peek(char *file, int fmt, int recl, char text[][81], int n)
+{
+	struct rje_reader r;
+	unsigned char card[RDR_MAXRECL];
+	int i, k, len;
+
+	if (rje_reader_stream(file) ||
+		rje_reader_open(&r, file, fmt, recl, ascii_to_ebcdic) != 0)
+		return (-1);
+	for (i = 0; i < n; i++) {
+		if ((len = rje_reader_get(&r, card)) <= 0)
+			break;
+		if (len > 80)
+			len = 80;
+		for (k = 0; k < len; k++)
+			text[i][k] = ebcdic_to_ascii[card[k]];
+		while (k > 0 && text[i][k - 1] == ' ')
+			k--;
+		text[i][k] = 0;
+	}
+	rje_reader_close(&r);
+	return (i);
+}
+
+// Operator commands get the prefix the host OS wants in front of them
+
+int rje_command(struct rje_session *s, char *cmd)
+{
+	return (rje_queue(s, XMIT_CMD, cmd, RJE_PRIO_CMD));
+}
+
+// Take a submission off the queue before it's sent.  Returns 0, or -1
+// if it isn't waiting (it may be going out already).
+
+int rje_cancel(struct rje_session *s, int id)
+{
+	int i;
+
+	for (i = 0; i < s->nqueue; i++) {
+		if (s->queue[i].id == id) {
+			s->nqueue--;
+			memmove(&s->queue[i], &s->queue[i + 1],
+				(s->nqueue - i) * sizeof(struct rje_job));
+			return (0);
+		}
+	}
+	return (-1);
+}
+
+// Which submission goes next
+
+static int job_best(struct rje_session *s)
+{
+	int i, best = 0;
+
+	for (i = 1; i < s->nqueue; i++) {
+		if (s->queue[i].prio > s->queue[best].prio)
+			best = i;
+	}
+	return (best);
+}
+
+// The line is ours: carry on with a transmission the host interrupted,
+// or take the next one off the queue.
+
+static int xmit_dispatch(struct rje_session *s)
+{
+	while (s->status == IDLE && s->xmit == XMIT_NONE && s->nqueue > 0) {
+		if (job_start(s) == 0)
+			break;
+	}
+	if (s->status == IDLE && s->xmit != XMIT_NONE &&
+		s->xmit_state == XS_WAIT)
+		xmit_start(s);
+	return (0);
+}
+
+// Make the first of the highest priority submissions the current one.
+// Returns -1 if its deck can't be opened any more.
+
+static int job_start(struct rje_session *s)
+{
+	struct rje_job j;
+
+	j = s->queue[job_best(s)];
+	rje_cancel(s, j.id);
+
+	s->xmit = j.kind;
+	s->xmit_id = j.id;
+	s->xmit_recl = j.recl;
+	s->xmit_prio = j.prio;
+	s->xmit_state = XS_WAIT;
+	s->xmit_wack = s->xmit_held = s->xmit_ttd = 0;
+	s->xmit_count = 0;
+	s->xmit_show = 0;
+	s->xmit_endpos = 0;
+	s->savelen = 0;
+	if (j.kind == XMIT_CMD) {
+		strcpy(s->xmit_text, j.text);
+		return (0);
+	}
+	strcpy(s->reader, j.file);
+	if (strcmp(s->reader, "*") == 0) {
+		rje_msg(s, "\r\nRJE174A Enter lines to send, CTRL-D for EOF\r\n");
+		return (0);
+	}
+	if (rje_decks_reader(s->decks, &s->rdr, s->reader, j.fmt, j.recl,
+		ascii_to_ebcdic) != 0) {
+		rje_msg(s, "\r\nRJE172S Can't open ");
+		rje_msg(s, s->reader);
+		rje_msg(s, " any more, it's been removed?\r\n");
+		push_event(s, RJE_EV_DONE, -1);
+		s->xmit = XMIT_NONE;
+		return (-1);
+	}
+	rje_msg(s, "\r\nRJE173I Sending file '");
+	rje_msg(s, s->reader);
+	rje_msg(s, "' to the host.\r\n");
+	ckpt_open(s);
+	return (0);
+}
+
+// Service the line for up to msec milliseconds: take in whatever the host
+// sent, answer it, move any transmission along, and poll when idle.
+// Returns the number of events waiting for rje_event.
+
+int rje_poll(struct rje_session *s, int msec)
+{
+	long now, wait;
+	int i, data = 0, piped;
+#if !defined (_WIN32)
+	struct timeval tv;
+#endif
+
+	piped = sink_service(s);
+	if (s->status <= NOLINK || s->status == SHUTDOWN) {
+		if (s->waitfn != NULL) {
+			s->waitfn(s, msec);	/* let simulated time pass */
+		} else {
+#if defined (_WIN32)
+			Sleep(msec);
+#else
+			tv.tv_sec = msec / 1000;
+			tv.tv_usec = (msec % 1000) * 1000;
+			select(0, NULL, NULL, NULL, &tv);
+#endif
+		}
+		return ((s->ev_head - s->ev_tail + RJE_MAXEV) % RJE_MAXEV);
+	}
+	xmit_dispatch(s);
+
+	// Don't wait past the time a reply is due
+
+	wait = msec;
+	if (s->status == SENDING || s->status == MULTILEAVE) {
+		now = rje_clock();
+		if (s->status == SENDING && s->xmit_timer - now < wait)
+			wait = s->xmit_timer - now;
+		if (s->status == MULTILEAVE && s->ml_timer - now < wait)
+			wait = s->ml_timer - now;
+		if (wait < 0)
+			wait = 0;
+	}
+	if (s->phy_ctr > 0)
+		wait = 0;
+	if (piped > 0 && wait > 10)
+		wait = 10;		/* back soon to fill the pipes */
+	if (read_poll(s, wait / 1000, (wait % 1000) * 1000) == 1) {
+		if (get_buffer(s) < 0) {
+			line_lost(s);
+			return ((s->ev_head - s->ev_tail + RJE_MAXEV) % RJE_MAXEV);
+		}
+		data = 1;
+	}
+	while (s->status > NOLINK && read_frame(s)) {
+		trace_line(s, "RECV: ", s->line_in, s->line_in_ctr);
+		switch (s->status) {
+		case SENDING:
+			xmit_reply(s);
+			break;
+		case RECEIVING:
+			for (i = 0; i < s->line_in_ctr; i++)
+				recv_char(s, s->line_in[i]);
+			break;
+		case IDLE:
+			idle_frame(s);
+			break;
+		case MULTILEAVE:
+			for (i = 0; i < s->line_in_ctr; i++)
+				ml_char(s, s->line_in[i]);
+			break;
+		default:		/* not signed on - ignore it */
+			break;
+		}
+		clear_input_buffer(s);
+		data = 1;
+	}
+	if (s->status == MULTILEAVE)
+		ml_service(s);
+	if (s->status == SENDING && s->xmit_state == XS_HOLD && !s->xmit_ttd)
+		xmit_next(s);		/* is the card there yet? */
+	if (s->status == SENDING && s->xmit_state != XS_WAIT &&
+		rje_clock() - s->xmit_timer >= 0)
+		xmit_timeout(s);
+
+	// no data .. so, we consider polling
+
+	if (s->status == IDLE && !data && s->pollflag == 2 &&
+		rje_clock() - s->polltime > s->tm.poll_time) {
+		if (s->opt_poll) {
+			s->line_out[0] = s->line_out[1] = s->line_out[2] = DLE;
+			s->line_out[3] = ACK0;
+			s->line_out_size = 4;
+			write_buffer(s);
+			lat_start(s, RJE_LAT_POLL);
+		}
+		s->polltime = rje_clock();
+	}
+	return ((s->ev_head - s->ev_tail + RJE_MAXEV) % RJE_MAXEV);
+}
+
+// ---------------------------------------------------------------------------------
+// Sending to the host
+// ---------------------------------------------------------------------------------
+
+// The line is ours to bid for
+
+static int xmit_start(struct rje_session *s)
+{
+	s->status = SENDING;
+	s->xmit_state = XS_BID;
+	s->xmit_retry = 0;
+	s->xmit_wack = s->xmit_held = s->xmit_ttd = 0;
+	s->xmit_decks = 0;
+	push_event(s, RJE_EV_STATUS, 0);
+	xmit_bid(s);
+	return (0);
+}
+
+// Send the ENQ and see if the host gives us an ACK0
+
+static int xmit_bid(struct rje_session *s)
+{
+	s->line_out_size = 0;
+	if (s->xmit == XMIT_SIGNON)
+		s->line_out[s->line_out_size++] = SYN;
+	s->line_out[s->line_out_size++] = SYN;
+	s->line_out[s->line_out_size++] = SYN;
+	s->line_out[s->line_out_size++] = ENQ;
+	write_buffer(s);
+	lat_start(s, RJE_LAT_BID);
+	if (s->xmit == XMIT_SIGNON)
+		s->xmit_timer = rje_clock() + s->tm.signon_wait;
+	else
+		s->xmit_timer = rje_clock() + s->tm.bid_wait;
+	return (0);
+}
+
+// The host answered our ENQ or our last block
+
+static int xmit_reply(struct rje_session *s)
+{
+	unsigned char *r = s->line_in;
+	char wstr[64];
+
+	while (r < s->line_in + s->line_in_ctr - 1 &&
+		(*r == SYN || *r == EPAD || *r == SPAD))
+		r++;			/* left in for a multileaving signon */
+	if (s->xmit_state == XS_BID)
+		lat_end(s, RJE_LAT_BID);
+	if (s->xmit_state == XS_TEXT)
+		lat_end(s, RJE_LAT_BLOCK);
+	if (r[0] == DLE && r[1] == WABT)
+		return (xmit_wack(s));
+	s->xmit_wack = 0;
+	s->xmit_held = 0;
+	if (s->xmit_state == XS_HOLD) {
+		if (r[0] != NAK)
+			return (xmit_done(s, -1));
+		s->xmit_ttd = 0;	/* the NAK to our TTD: line still ours */
+		s->xmit_timer = rje_clock() + s->tm.ttd_time;
+		return (0);
+	}
+
+	if (s->xmit_state == XS_BID) {
+		if (r[0] == ENQ && s->xmit != XMIT_SIGNON) {
+
+			// We both bid.  The host wins, we try again
+			// once it's done.
+
+			s->xmit_state = XS_WAIT;
+			s->status = RECEIVING;
+			s->rvi_sent = s->wack_sent = 0;
+			clear_input_record(s);
+			s->lastack = ACK0;
+			send_ack(s, ACK0);
+			lat_start(s, RJE_LAT_TURN);
+			push_event(s, RJE_EV_STATUS, 0);
+			return (0);
+		}
+		if (r[0] == NAK || (r[0] == DLE && r[1] == NAK)) {
+			if (s->xmit == XMIT_SIGNON)
+				rje_msg(s, "\r\nRJE129S The host says (with a NAK) it's not ready.\r\n");
+			else
+				rje_msg(s, "\r\nRJE178S The host says (with a NAK) it's not ready.\r\n");
+			return (xmit_done(s, -1));
+		}
+		if (r[0] != DLE || r[1] != ACK0)
+			return (xmit_done(s, -1));
+		lat_end(s, RJE_LAT_TURN);
+
+		// HOST appears to want our file
+
+		s->xmit_state = XS_TEXT;
+		return (xmit_next(s));
+	}
+
+	if (s->xmit == XMIT_SIGNON) {
+		if (s->ml && (r[0] == STX || (r[0] == DLE &&
+			(r[1] == ACK0 || r[1] == ACK1 || r[1] == STX))))
+			return (ml_begin(s));	/* the host's first block, or ACK0 */
+		if (r[0] == NAK || (r[0] == DLE && r[1] == NAK)) {
+			rje_msg(s, "\r\nRJE132S The host says (with a NAK) it didn't like the signon.\r\n");
+			return (xmit_done(s, -1));
+		}
+		if (r[0] != DLE || r[1] != ACK1) {
+			rje_msg(s, "\r\nRJE133S The host said something odd.  Use TRACE.\r\n");
+			return (xmit_done(s, -1));
+		}
+
+		// Cool. The host said it got our signon.
+		// Let's send it an EOT so it'll know we're done
+
+		send_eot(s);
+		return (xmit_done(s, 0));
+	}
+
+	if ((r[0] == DLE && r[1] == ACK0) ||
+		(r[0] == DLE && r[1] == ACK1) ||
+		r[0] == EOT) {
+		if (s->xmit == XMIT_CMD) {
+			send_eot(s);
+			return (xmit_done(s, 0));
+		}
+		s->xmit_count++;
+		s->xmit_show++;
+		if (strcmp(s->reader, "*") != 0)
+			ckpt_write(s);
+		return (xmit_next(s));
+	}
+	if (r[0] != NAK)
+		return (xmit_done(s, -1));
+
+	// it was a NAK -- try the transmit again
+
+	s->xmit_retry++;
+	s->stat_retries++;
+	if (s->xmit_retry > s->tm.nak_tries) {
+		sprintf(wstr, "\r\nRJE186S %d consecutive NAKs, giving up on send.\r\n",
+			s->xmit_retry - 1);
+		rje_msg(s, wstr);
+		return (xmit_done(s, -1));
+	}
+	write_buffer(s);
+	lat_start(s, RJE_LAT_BLOCK);
+	s->xmit_timer = rje_clock() + s->tm.text_wait;
+	return (0);
+}
+
+// Nothing came back in time
+
+static int xmit_timeout(struct rje_session *s)
+{
+	unsigned char enq[3] = {SYN, SYN, ENQ};
+	unsigned char ttd[4] = {SYN, SYN, STX, ENQ};
+
+	if (s->xmit_held) {		/* waited out a WACK, ask again */
+		s->xmit_held = 0;
+		if (s->xmit_state == XS_BID)
+			return (xmit_bid(s));
+		send_ctl(s, enq, sizeof(enq));
+		s->xmit_timer = rje_clock() + s->tm.text_wait;
+		return (0);
+	}
+	if (s->xmit_state == XS_HOLD && !s->xmit_ttd) {
+		send_ctl(s, ttd, sizeof(ttd));
+		s->xmit_ttd = 1;
+		s->xmit_timer = rje_clock() + s->tm.text_wait;
+		return (0);
+	}
+	if (s->xmit_state == XS_BID) {
+		s->xmit_retry++;
+		s->stat_retries++;
+		if (s->xmit == XMIT_SIGNON && s->xmit_retry < s->tm.signon_tries)
+			return (xmit_bid(s));
+		if (s->xmit != XMIT_SIGNON && s->xmit_retry < s->tm.bid_tries)
+			return (xmit_bid(s));
+		if (s->xmit == XMIT_SIGNON)
+			rje_msg(s, "\r\nRJE128S The host did not respond to our initial greeting.\r\n");
+		else
+			rje_msg(s, "\r\nRJE177S The host did not respond to our initial greeting.\r\n");
+		return (xmit_done(s, -1));
+	}
+	if (s->xmit == XMIT_SIGNON)
+		rje_msg(s, "\r\nRJE131S The host did not respond to the signon record.\r\n");
+	else
+		rje_msg(s, "\r\nRJE184S The send timed out, host probably down.\r\n");
+	return (xmit_done(s, -1));
+}
+
+// The host answered with WACK: it has our bid or our block, but is busy
+// and wants us to wait.  After a while we ENQ, and it says WACK again or
+// gives us the ACK we were waiting for.  The wait doubles each time.
+
+static int xmit_wack(struct rje_session *s)
+{
+	int wait;
+
+	if (s->xmit_state == XS_HOLD) {
+		s->xmit_ttd = 0;	/* take it as the NAK to our TTD */
+		s->xmit_timer = rje_clock() + s->tm.ttd_time;
+		return (0);
+	}
+	s->xmit_wack++;
+	s->stat_wacks++;
+	if (s->xmit_wack > s->tm.wack_tries) {
+		rje_msg(s, "\r\nRJE212S The host has been busy (WACK) too long, giving up.\r\n");
+		return (xmit_done(s, -1));
+	}
+	if (s->xmit_wack == 1 && s->xmit_state == XS_BID)
+		rje_msg(s, "\r\nRJE213I The host is busy (WACK), waiting for it.\r\n");
+	wait = s->tm.wack_wait << (s->xmit_wack < 6 ? s->xmit_wack - 1 : 5);
+	if (wait > s->tm.wack_max)
+		wait = s->tm.wack_max;
+	s->xmit_held = 1;
+	s->xmit_timer = rje_clock() + wait;
+	return (0);
+}
+
+// The next card isn't ready yet (cards being typed, or a slow program on
+// the other end of a pipe).  Keep trying it from rje_poll; if it's more
+// than tm.ttd_time coming, send TTD so the host knows we still have the line.
+
+static int xmit_hold(struct rje_session *s)
+{
+	if (s->xmit_state != XS_HOLD) {
+		s->xmit_state = XS_HOLD;
+		s->xmit_ttd = 0;
+		s->xmit_timer = rje_clock() + s->tm.ttd_time;
+	}
+	return (0);
+}
+
+// Build and send the next block: the signon card, the command, or the
+// next card from the reader.  At the end of the deck, send the EOT.
+
+static int xmit_next(struct rje_session *s)
+{
+	int n;
+	char wstr[32];
+	char line[RDR_MAXRECL + 2];
+	unsigned char output_data[512];
+	unsigned char *card = &s->line_out[1];	/* cards go straight in */
+
+	s->xmit_retry = 0;
+	if (s->xmit == XMIT_SIGNON && s->ml)
+		return (ml_signon(s));
+	if (s->xmit == XMIT_SIGNON) {
+		s->line_out[0] = SYN;
+		s->line_out[1] = SYN;
+		s->line_out[2] = STX;
+		s->line_out_size = 3;
+		strcpy(output_data, s->xmit_text);
+		translate_to_ebcdic(output_data);
+		memcpy(&s->line_out[3], output_data, strlen(output_data));
+		s->line_out_size += strlen(output_data);
+		s->line_out[s->line_out_size] = ETX;
+		s->line_out_size++;
+		write_buffer(s);
+		lat_start(s, RJE_LAT_BLOCK);
+		s->xmit_timer = rje_clock() + s->tm.text_wait;
+		return (0);
+	}
+	if (s->xmit == XMIT_CMD) {
+		rje_card_text(card, s->xmit_text, s->xmit_recl, ascii_to_ebcdic);
+		s->line_out[0] = STX;
+		s->line_out[1 + s->xmit_recl] = ETX;
+		s->line_out_size = s->xmit_recl + 2;
+		write_buffer(s);
+		lat_start(s, RJE_LAT_BLOCK);
+		s->xmit_timer = rje_clock() + s->tm.text_wait;
+		return (0);
+	}
+	if (s->xmit_show > 9) {
+		s->xmit_show = 0;
+		rje_msg(s, "RJE180I ");
+		sprintf(wstr, "%d Records sent.\r", s->xmit_count);
+		rje_msg(s, wstr);
+	}
+	if (s->savelen > 0) {
+		memcpy(card, s->savebuf, s->savelen);
+		s->savelen = 0;
+		s->xmit_ackpos = s->xmit_endpos;
+	} else if (strcmp(s->reader, "*") != 0) {
+		n = rje_reader_get(&s->rdr, card);
+		if (n == RDR_WAIT)
+			return (xmit_hold(s));	/* stream: not in yet */
+		if (n < 0) {
+			rje_msg(s, "\r\nRJE187S The file isn't in the format given on SEND, ");
+			sprintf(wstr, "%d", s->xmit_count);
+			rje_msg(s, wstr);
+			rje_msg(s, " records sent.\r\n");
+			send_eot(s);
+			return (xmit_done(s, -1));
+		}
+		if (n == 0) {
+			rje_msg(s, "\r\nRJE181I ");
+			sprintf(wstr, "%d Total records sent.", s->xmit_count);
+			rje_msg(s, wstr);
+			rje_reader_close(&s->rdr);
+			ckpt_close(s, 1);
+			if (xmit_chain(s) == 0)
+				return (0);
+			send_eot(s);
+			return (xmit_done(s, 0));
+		}
+		s->xmit_pos = s->rdr.pos;
+		s->xmit_endpos = s->xmit_ackpos = s->rdr.next;
+	} else {
+		memset(line, 0, sizeof(line));
+		n = (s->cardfn == NULL) ? -1 : s->cardfn(s, line);
+		if (n > 0)
+			return (xmit_hold(s));
+		if (n < 0 || line[0] == '\004') {
+			send_eot(s);
+			return (xmit_done(s, 0));
+		}
+		rje_card_text(card, line, s->xmit_recl, ascii_to_ebcdic);
+	}
+
+	// Handle special VM ID card
+
+	if (s->opt_os == 1 && s->xmit_count == 0 && strlen(s->opt_user) > 0 &&
+		memcmp(card, vm_id, sizeof(vm_id)) != 0) {
+		memcpy(s->savebuf, card, s->xmit_recl);
+		s->savelen = s->xmit_recl;
+		strcpy(line, "ID       ");
+		strcat(line, s->opt_user);
+		rje_card_text(card, line, s->xmit_recl, ascii_to_ebcdic);
+		s->xmit_ackpos = s->xmit_pos;	/* card read isn't sent yet */
+	}
+
+	// The card is in place, frame it and send it
+
+	job_card(s, card, s->xmit_recl, s->xmit_id, s->reader);
+	s->xmit_state = XS_TEXT;
+	s->line_out[0] = STX;
+	s->line_out[1 + s->xmit_recl] = ETX;
+	s->line_out_size = s->xmit_recl + 2;
+	write_buffer(s);
+	lat_start(s, RJE_LAT_BLOCK);
+	s->xmit_timer = rje_clock() + s->tm.text_wait;
+	return (0);
+}
+
+// A deck is finished.  If the next submission is another deck and the
+// host splits jobs itself, carry straight on with it rather than giving
+// up the line and bidding again.  Returns 0 if the deck just sent has
+// been reported done here: there's a new deck going, or none of those
+// queued could be opened and the line has been given up.
+
+static int xmit_chain(struct rje_session *s)
+{
+	struct rje_job *j;
+
+	if (++s->xmit_decks >= s->opt_batch || !rje_can_batch(s) ||
+		s->nqueue == 0)
+		return (-1);
+	j = &s->queue[job_best(s)];
+	if (j->kind != XMIT_FILE || strcmp(j->file, "*") == 0)
+		return (-1);
+	push_event(s, RJE_EV_DONE, 0);	/* for the one just sent */
+	s->xmit = XMIT_NONE;
+	while (s->nqueue > 0) {
+		j = &s->queue[job_best(s)];
+		if (j->kind != XMIT_FILE || strcmp(j->file, "*") == 0)
+			break;
+		if (job_start(s) == 0) {
+			s->xmit_state = XS_TEXT;
+			xmit_next(s);
+			return (0);
+		}
+	}
+
+	// job_start has said DONE -1 for each that failed, and there's no
+	// deck going to say DONE for
+
+	send_eot(s);
+	xmit_idle(s, 0, 0);
+	return (0);
+}
+
+// This transmission is over, one way or the other
+
+static int xmit_done(struct rje_session *s, int rc)
+{
+	if (s->xmit == XMIT_FILE)
+		rje_reader_close(&s->rdr);
+	if (rc != 0)
+		ckpt_close(s, 0);	/* leave it for the next try */
+	return (xmit_idle(s, rc, 1));
+}
+
+// The line is ours to give up: say DONE rc for what was going if done,
+// and start on what's next
+
+static int xmit_idle(struct rje_session *s, int rc, int done)
+{
+	if (s->status > NOLINK) {
+		if (s->xmit == XMIT_SIGNON && rc != 0)
+			s->status = INITIAL_WAIT;
+		else
+			s->status = IDLE;
+		s->pollflag = 2;
+		s->polltime = rje_clock();
+	}
+	if (done)
+		push_event(s, RJE_EV_DONE, rc);
+	s->xmit = XMIT_NONE;
+	push_event(s, RJE_EV_STATUS, 0);
+	xmit_dispatch(s);
+	return (rc);
+}
+
+// End our transmission.  EOT does not expect a reply.
+
+static int send_eot(struct rje_session *s)
+{
+	s->line_out[0] = s->line_out[1] = SYN;
+	s->line_out[2] = EOT;
+	s->line_out_size = 3;
+	write_buffer(s);
+	return (0);
+}
+
+// The host hung up on us
+
+static int line_lost(struct rje_session *s)
+{
+	if (s->status == SENDING && s->xmit != XMIT_SIGNON) {
+		if (s->xmit_state >= XS_TEXT) {
+			rje_msg(s, "\r\nRJE182S The line has disconnected during the send.\r\n");
+			rje_msg(s, "\r\nRJE183W The connection is now closed.\r\n");
+		} else {
+			rje_msg(s, "\r\nRJE175S The line has disconnected.\r\n");
+			rje_msg(s, "\r\nRJE176W The connection is now closed.\r\n");
+		}
+	} else {
+		rje_msg(s, "\r\nRJE127S The line has disconnected.\r\n");
+	}
+	rje_close(s);
+	return (-1);
+}
+
+// ---------------------------------------------------------------------------------
+// Send checkpoints
+// ---------------------------------------------------------------------------------
+
+// Look for a checkpoint left by an interrupted send of the reader file.
+// If there is one, and it still matches the file, either position the
+// reader after the last record the host ACKed, or start over from card
+// one, depending on what the host OS does with a partial deck.
+
+static int ckpt_open(struct rje_session *s)
+{
+	struct stat st;
+	long cpos, csize, cmtime;
+	int ccount, resume;
+	char wstr[32];
+	FILE *fd;
+
+	s->ckptfd = NULL;
+	strcpy(s->ckptfile, "");
+	if (s->opt_ckpt == 0 || s->rdr.stream ||
+		strncmp(s->reader, RDR_FD, strlen(RDR_FD)) == 0 ||
+		strlen(s->reader) + 5 > sizeof(s->ckptfile))
+		return (0);		/* streams can't be gone back over, */
+				/* nor an fd someone else will reuse */
+	strcpy(s->ckptfile, s->reader);
+	strcat(s->ckptfile, ".ckp");
+	if ((fd = fopen(s->ckptfile, "r")) == NULL)
+		return (0);
+	if (fscanf(fd, "RJE80CKP %ld %d %ld %ld", &cpos, &ccount,
+		&csize, &cmtime) != 4) {
+		fclose(fd);
+		return (0);
+	}
+	fclose(fd);
+	if (stat(s->reader, &st) != 0 || st.st_size != csize ||
+		(long) st.st_mtime != cmtime || cpos > csize) {
+		rje_msg(s, "RJE193W The file has changed since the last send was ");
+		rje_msg(s, "interrupted, sending it all.\r\n");
+		return (0);
+	}
+	resume = rje_can_resume(s);
+	sprintf(wstr, "%d", ccount);
+	if (resume == 0) {
+		rje_msg(s, "RJE191I The last send was interrupted after record ");
+		rje_msg(s, wstr);
+		rje_msg(s, ", restarting from the first record.\r\n");
+		return (0);
+	}
+	if (rje_reader_seek(&s->rdr, cpos) != 0) {
+		rje_reader_seek(&s->rdr, 0);	/* it may have moved on */
+		rje_msg(s, "RJE277W The last send was interrupted after record ");
+		rje_msg(s, wstr);
+		rje_msg(s, ", which can't be found again, restarting from the first record.\r\n");
+		return (0);
+	}
+	rje_msg(s, "RJE190I Resuming the interrupted send after record ");
+	rje_msg(s, wstr);
+	rje_msg(s, ".\r\n");
+	s->xmit_endpos = cpos;
+	s->xmit_count = ccount;
+	return (1);
+}
+
+// Record the position after the last record the host ACKed.  The
+// checkpoint is rewritten in place with fixed width fields.
+
+static int ckpt_write(struct rje_session *s)
+{
+	struct stat st;
+
+	if (strlen(s->ckptfile) == 0)
+		return (0);
+	if (s->ckptfd == NULL) {
+		if (stat(s->reader, &st) != 0 ||
+			(s->ckptfd = fopen(s->ckptfile, "w")) == NULL) {
+			rje_msg(s, "\r\nRJE192W Can't write the checkpoint file ");
+			rje_msg(s, s->ckptfile);
+			rje_msg(s, "\r\n");
+			strcpy(s->ckptfile, "");
+			return (-1);
+		}
+		s->ckpt_size = st.st_size;
+		s->ckpt_mtime = (long) st.st_mtime;
+	}
+	rewind(s->ckptfd);
+	fprintf(s->ckptfd, "RJE80CKP %12ld %10d %12ld %12ld\n",
+		s->xmit_ackpos, s->xmit_count, s->ckpt_size, s->ckpt_mtime);
+	fflush(s->ckptfd);
+	return (0);
+}
+
+// Would an interrupted send be picked up where it stopped?
+
+int rje_can_resume(struct rje_session *s)
+{
+	if (s->opt_ckpt == 0 || s->opt_ckpt == 3)
+		return (0);
+	if (s->opt_ckpt == 2)
+		return (1);
+	return (os_resume[s->opt_os]);
+}
+
+// Would queued decks go out together?
+
+int rje_can_batch(struct rje_session *s)
+{
+	return (s->opt_batch > 1 && os_batch[s->opt_os]);
+}
+
+// Done with the checkpoint.  A completed send removes it.
+
+static int ckpt_close(struct rje_session *s, int done)
+{
+	if (s->ckptfd != NULL)
+		fclose(s->ckptfd);
+	s->ckptfd = NULL;
+	if (done && strlen(s->ckptfile) > 0)
+		remove(s->ckptfile);
+	strcpy(s->ckptfile, "");
+	return (0);
+}
+
+// ---------------------------------------------------------------------------------
+// Receiving from the host
+// ---------------------------------------------------------------------------------
+
+// Something arrived while the line was idle
+
+static int idle_frame(struct rje_session *s)
+{
+	int i;
+	unsigned char ch;
+	char sho[16];
+
+	for (i = 0; i < s->line_in_ctr; i++) {	/* Process data */
+		ch = s->line_in[i];
+		if (ch == ENQ) {	/* he wants to send us something */
+			s->pollflag = 0;
+			s->status = RECEIVING;
+			s->rvi_sent = s->wack_sent = 0;
+			clear_input_record(s);
+			s->lastack = ACK0;
+			send_ack(s, ACK0);
+			lat_start(s, RJE_LAT_TURN);
+			push_event(s, RJE_EV_STATUS, 0);
+			continue;
+		}
+		if (ch == EPAD || ch == SYN) {	/* fillers - ignore */
+			continue;
+		}
+		if (ch == DLE) {	/* Probably poll response */
+			lat_end(s, RJE_LAT_POLL);
+			s->pollflag = 1;
+			continue;
+		}
+		if (ch == ACK0 || ch == ACK1) {	/* it is a poll response */
+			s->pollflag = 2;	/* set up to poll again */
+			continue;
+		}
+		// WE don't know what it is ...
+		// Ignore it for now ...
+		if (s->debugit == 1) {
+			rje_msg(s, "\r\nOdd data found: ");
+			sprintf(sho, "%2x", ch);
+			rje_msg(s, sho);
+			rje_msg(s, "\r\n");
+		}
+	}
+	return (0);
+}
+
+// One character of a host transmission
+
+static int recv_char(struct rje_session *s, unsigned char ch)
+{
+	if (s->transparent) {	// Handle chars in transparent mode */
+		if (s->gotdle == 1 && ch == EOT) {	/* End of file */
+			return (end_of_output(s));
+		}
+		if (s->gotdle == 1 && ch == STX) {	/* Start of text */
+			if (s->gotdle)
+				s->transparent = 1;
+			s->gotstx = 1;
+			s->gotdle = 0;
+			return (0);
+		}
+		if (s->gotdle == 0 && ch == DLE) {	/* DLE what follows is special */
+			s->gotdle = 1;
+			s->gotstx = 0;
+			return (0);
+		}
+		if (s->gotdle == 1 && ch == DC1) {	/* DC1: Select printer if after an STX */
+			if (s->gotstx == 1) {
+				s->device_select = 0;
+				if (strlen(s->print) != 0) {
+					rje_msg(s, "\r\nRJE001I Receiving print data...");
+				} else {
+					rje_msg(s, "\r\n");
+				}
+				push_event(s, RJE_EV_OUTPUT, 0);
+			}
+			s->gotdle = s->gotstx = 0;
+			return (0);
+		}
+		if (s->gotdle == 1 && ch == DC2) {	/* DC2: Select punch if after an STX */
+			if (s->gotstx == 1) {
+				s->device_select = 1;
+				rje_msg(s, "\r\nRJE001I Receiving punch data...");
+				push_event(s, RJE_EV_OUTPUT, 0);
+			}
+			return (0);
+		}
+		if (s->gotdle == 1 && ch == ETB && s->record_ctr > 0) {	// DOS bug, some recs have only ETB
+			write_record(s);
+		}
+		if (s->gotdle == 1 && ch == ETX) {	/* End of block -- */
+			block_ack(s);		/* Acknowledge */
+			s->gotdle = s->gotstx = 0;
+			s->transparent = 0;	/* transparent off */
+			return (0);
+		}
+		if (s->gotdle == 1 && ch == ETB) {	/* End of block -- */
+			block_ack(s);		/* Acknowledge */
+			s->gotdle = s->gotstx = 0;
+			return (0);
+		}
+		if (s->gotdle == 1 && (ch == IRS ||
+		    ch == NL)) {			/* End of record - write */
+			write_record(s);
+			s->gotdle = s->gotstx = 0;
+			return (0);
+		}
+		if (s->gotdle == 1 && ch == ENQ) {
+			send_ack(s, 0);		/* Acknowledge */
+			s->gotdle = s->gotstx = 0;
+			return (0);
+		}
+
+		s->record_in[s->record_ctr] = ch;	/* data - save it */
+		if (s->record_ctr < sizeof(s->record_in) - 1)
+			s->record_ctr++;
+		s->gotdle = s->gotstx = 0;
+		return (0);
+	}
+
+	if (ch == EOT) {	/* End of file */
+		return (end_of_output(s));
+	}
+	if (ch == STX) {	/* Start of text */
+		lat_end(s, RJE_LAT_TURN);	/* the first block since our ACK0 */
+		if (s->gotdle)
+			s->transparent = 1;
+		s->gotstx = 1;
+		s->gotdle = 0;
+		return (0);
+	}
+	if (ch == DLE) {	/* DLE what follows is special */
+		s->gotdle = 1;
+		s->gotstx = 0;
+		return (0);
+	}
+	if (ch == DC1) {	/* DC1: Select printer if after an STX */
+		if (s->gotstx == 1) {
+			s->device_select = 0;
+			if (strlen(s->print) != 0) {
+				rje_msg(s, "\r\nRJE001I Receiving print data...");
+			} else {
+				rje_msg(s, "\r\n");
+			}
+			push_event(s, RJE_EV_OUTPUT, 0);
+		}
+		s->gotdle = s->gotstx = 0;
+		return (0);
+	}
+	if (ch == DC2) {	/* DC2: Select punch if after an STX */
+		if (s->gotstx == 1) {
+			s->device_select = 1;
+			rje_msg(s, "\r\nRJE001I Receiving punch data...");
+			push_event(s, RJE_EV_OUTPUT, 0);
+		}
+		return (0);
+	}
+	if (ch == ETB && s->record_ctr > 0) {	// DOS bug, some recs have only ETB
+		write_record(s);
+	}
+	if (ch == ETX ||		/* End of block -- */
+	    ch == ETB) {
+		block_ack(s);		/* Acknowledge */
+		s->gotdle = s->gotstx = 0;
+		return (0);
+	}
+	if (ch == IRS ||
+	    ch == NL) {			/* End of record - write */
+		write_record(s);
+		s->gotdle = s->gotstx = 0;
+		return (0);
+	}
+	if (ch == ENQ) {
+		recv_enq(s);
+		s->gotdle = s->gotstx = 0;
+		return (0);
+	}
+
+	// WHAT DO TO WITH ALL THE OTHER CONTROL CHARS?
+	// store'em, thats what ... until we know better ...
+	// NOTE: thats what we want to do with ESC sequences
+	// ...we handle them when we output the record
+
+	s->record_in[s->record_ctr] = ch;	/* data - save it */
+	if (s->record_ctr < sizeof(s->record_in) - 1)
+		s->record_ctr++;
+	s->gotdle = s->gotstx = 0;
+	return (0);
+}
+
+// The host sent EOT, the line is ours again
+
+static int end_of_output(struct rje_session *s)
+{
+	if (s->device_select == 0 && strlen(s->print) != 0) {
+		rje_msg(s, "EOT\r\n");
+	}
+	if (s->device_select == 1 && strlen(s->punch) != 0) {
+		rje_msg(s, "EOT\r\n");
+	}
+	print_flush(s);
+	out_end(s, 0, 0);
+	out_end(s, 1, 0);
+	send_ack(s, 0);
+	job_output_end(s, 0, 0);
+	job_output_end(s, 1, 0);
+	s->status = IDLE;
+	s->pollflag = 2;
+	s->polltime = rje_clock();
+	s->gotdle = s->gotstx = 0;
+	push_event(s, RJE_EV_EOT, 0);
+	push_event(s, RJE_EV_STATUS, 0);
+	s->lat_start[RJE_LAT_TURN] = 0;
+	xmit_dispatch(s);	/* the line's ours, use it */
+	if (s->status == SENDING)
+		s->lat_start[RJE_LAT_TURN] = s->lat_read;	/* until our bid's ACKed */
+	return (0);
+}
+
+// ---------------------------------------------------------------------------------
+// Job tracking
+// ---------------------------------------------------------------------------------
+
+// A card has gone to the host.  If it's a JOB card, start following the
+// job it begins.
+
+static int job_card(struct rje_session *s, unsigned char *card, int len,
+	int id, char *file)
+{
+	struct rje_jobrec *j;
+	char name[9], cls;
+	int i, dev;
+
+	if (!(card[0] == 0x61 && card[1] == 0x61) && card[0] != 0x5c)
+		return (0);		/* neither // nor *, don't bother */
+	if (!rje_job_card(card, len, ebcdic_to_ascii, name, &cls))
+		return (0);
+	j = rje_jobs_add(&s->jobs, id, file, name, cls, rje_clock());
+	for (dev = 0; dev < 2; dev++) {
+		for (i = 0; i < RJE_ML_STREAMS; i++) {
+			if (s->job_out[dev][i].job == j)
+				s->job_out[dev][i].job = NULL;	/* an old job's */
+		}
+	}
+	return (0);
+}
+
+// A message from the host, on the console or the printer.  If it's about
+// one of our jobs, note its number and how it's getting on.  Returns 1 if
+// it's a job message, ours or not.
+
+static int job_message(struct rje_session *s, char *text)
+{
+	struct rje_jobrec *j;
+	char name[9];
+	int kind, number;
+
+	if (s->jobs.n == 0)
+		return (0);
+	kind = rje_job_msg(text, name, &number);
+	if (kind == JOBMSG_NONE)
+		return (0);
+	if ((j = rje_jobs_named(&s->jobs, name, number)) == NULL)
+		return (1);
+	if (number > 0 && j->number == 0)
+		j->number = number;
+	if (kind == JOBMSG_READ && j->state < JOB_READ)
+		j->state = JOB_READ;
+	if (kind == JOBMSG_ENDED && j->state < JOB_ENDED)
+		j->state = JOB_ENDED;
+	return (1);
+}
+
+// A print or punch record has come in, still EBCDIC (a print line with
+// its ESC in front).  Until we know whose output it is, look for a job
+// in its first lines: JES2 puts the job name and number on the separator
+// and the job log.
+
+static int job_record(struct rje_session *s, int dev, unsigned char *rec,
+	int len)
+{
+	struct rje_jobout *o = &s->job_out[dev][s->out_stream];
+	struct rje_jobrec *j;
+	char text[RJE_FORMS_MAX + 1];
+	char wstr[100], label[32];
+	int i;
+
+	if (!o->active) {
+		o->active = 1;
+		o->lines = 0;
+		o->start = rje_clock();
+		o->job = NULL;
+	}
+	o->lines++;
+	if (o->job != NULL) {
+		o->job->records++;
+		return (0);
+	}
+	if (s->jobs.n == 0)
+		return (0);
+	if (dev == 0 && len >= 2 && rec[0] == ESC) {
+		rec += 2;
+		len -= 2;
+	}
+	if (len > RJE_FORMS_MAX)
+		len = RJE_FORMS_MAX;
+	for (i = 0; i < len; i++)
+		text[i] = ebcdic_to_ascii[rec[i]];
+	text[len] = 0;
+	if (job_message(s, text) || o->lines > JOB_SCAN)
+		return (0);
+	if ((j = rje_jobs_match(&s->jobs, text)) == NULL)
+		return (0);
+	o->job = j;
+	j->records += o->lines;
+	if (j->state < JOB_OUTPUT)
+		j->state = JOB_OUTPUT;
+	if (j->start == 0)
+		j->start = o->start;
+	sprintf(wstr, "\r\nRJE224I Output for %s on the %s.\r\n",
+		job_label(j, label), dev ? "punch" : "printer");
+	rje_msg(s, wstr);
+	return (0);
+}
+
+// Output on a printer or punch has ended
+
+static int job_output_end(struct rje_session *s, int dev, int n)
+{
+	struct rje_jobout *o = &s->job_out[dev][n];
+	struct rje_jobrec *j = o->job;
+	char wstr[100], label[32];
+
+	if (!o->active)
+		return (0);
+	o->active = 0;
+	o->job = NULL;
+	if (!dev && s->index != NULL)
+		rje_index_end(s->index, n, j ? j->name : NULL, j ? j->number : 0,
+			n ? s->ml_prt[n].file : s->print);
+	if (j == NULL)
+		return (0);
+	j->end = rje_clock();
+	j->state = JOB_DONE;
+	sprintf(wstr, "\r\nRJE225I Output for %s is in, %.1f seconds after it was sent.\r\n",
+		job_label(j, label), (j->end - j->submit) / 1000.0);
+	rje_msg(s, wstr);
+	ml_event(s, RJE_EV_JOB, XMIT_FILE, j->id, 0, dev);
+	return (0);
+}
+
+// A job's name and, once we know it, its number
+
+static char *job_label(struct rje_jobrec *j, char *buf)
+{
+	if (j->number > 0)
+		sprintf(buf, "%s JOB%05d", j->name, j->number);
+	else
+		strcpy(buf, j->name);
+	return (buf);
+}
+
+// ---------------------------------------------------------------------------------
+// Multileaving workstation
+// ---------------------------------------------------------------------------------
+
+// Once signed on, the line never turns around.  We and the host take
+// turns sending a block, each one answering the last; a side with
+// nothing to say answers DLE ACK0.  The records in a block belong to
+// any number of streams: our readers and console commands going up,
+// the host's printers, punches and console messages coming down.
+// Printer and punch 1 write to PRINT and PUNCH; the others to the same
+// names with .2, .3 and so on after them.
+
+// The host answered the signon block.  From here on everything the host
+// sends goes to ml_char, starting with that answer.
+
+static int ml_begin(struct rje_session *s)
+{
+	int i;
+
+	s->status = MULTILEAVE;
+	s->ml_bcbin = -1;		/* take whatever count comes first */
+	s->ml_fcs[0] = ML_FCS | 0x0f;	/* until the host says otherwise */
+	s->ml_fcs[1] = ML_FCS | ML_FCS_CONSOLE | 0x0f;
+	s->ml_fcsout = 0;
+	s->ml_nctl = 0;
+	s->ml_inblk = s->ml_dle = s->ml_inlen = 0;
+	s->ml_retry = 0;
+	memset(s->ml_rdr, 0, sizeof(s->ml_rdr));
+	memset(s->ml_prt, 0, sizeof(s->ml_prt));
+	memset(s->ml_pun, 0, sizeof(s->ml_pun));
+	rje_msg(s, "\r\nRJE214I Signed on as a multileaving workstation.\r\n");
+	push_event(s, RJE_EV_DONE, 0);	/* for the signon */
+	s->xmit = XMIT_NONE;
+	push_event(s, RJE_EV_STATUS, 0);
+	for (i = 0; i < s->line_in_ctr; i++)
+		ml_char(s, s->line_in[i]);
+	return (0);
+}
+
+// The signon card goes in a block of its own, as it is
+
+static int ml_signon(struct rje_session *s)
+{
+	unsigned char blk[90];
+
+	s->ml_bcbout = 0;
+	blk[0] = ML_BCB | s->ml_bcbout;
+	blk[1] = ML_FCS | 0x0f;
+	blk[2] = ML_FCS | ML_FCS_CONSOLE | 0x0f;
+	blk[3] = ML_RCB_SIGNON;
+	blk[4] = ML_SRCB_SIGNON;
+	rje_card_text(blk + 5, s->xmit_text, 80, ascii_to_ebcdic);
+	blk[85] = ML_RCB_EOB;
+	ml_frame(s, blk, 86);
+	s->ml_bcbout = 1;
+	s->xmit_timer = rje_clock() + s->tm.signon_wait;
+	return (0);
+}
+
+// One character from the host.  Blocks are gathered up in ml_in (DLEs
+// taken out of transparent ones) and taken apart by ml_block.
+
+static int ml_char(struct rje_session *s, unsigned char ch)
+{
+	unsigned char nak[3] = {SYN, SYN, NAK};
+
+	if (s->ml_inblk == 0) {
+		if (ch == DLE) {
+			s->ml_dle = 1;
+			return (0);
+		}
+		if (ch == STX) {
+			s->ml_inblk = s->ml_dle ? 2 : 1;
+			s->ml_dle = 0;
+			s->ml_inlen = 0;
+			return (0);
+		}
+		if (s->ml_dle && ch == ACK0) {	/* nothing to send */
+			s->ml_dle = 0;
+			return (ml_heard(s, 0));
+		}
+		s->ml_dle = 0;
+		if (ch == NAK || ch == ENQ)	/* send that again */
+			return (ml_resend(s));
+		if (ch == EOT) {
+			rje_msg(s, "\r\nRJE221S The host has ended the multileaving session.\r\n");
+			ml_stop(s);
+			s->status = INITIAL_WAIT;
+			push_event(s, RJE_EV_STATUS, 0);
+		}
+		return (0);		/* SYNs, pads and the like */
+	}
+	if (s->ml_inblk == 2 && !s->ml_dle && ch == DLE) {
+		s->ml_dle = 1;
+		return (0);
+	}
+	if ((s->ml_inblk == 1 || s->ml_dle) && (ch == ETB || ch == ETX)) {
+		s->ml_inblk = s->ml_dle = 0;
+		return (ml_block(s));
+	}
+	if (s->ml_inblk == 2 && s->ml_dle && ch == ENQ) {	/* block abandoned */
+		s->ml_inblk = s->ml_dle = 0;
+		memcpy(s->line_out, nak, sizeof(nak));
+		s->line_out_size = sizeof(nak);
+		write_buffer(s);
+		s->ml_turn = 0;
+		s->ml_timer = rje_clock() + s->tm.text_wait;
+		return (0);
+	}
+	if ((s->ml_inblk == 2 && s->ml_dle && ch == SYN) ||
+		(s->ml_inblk == 1 && ch == SYN)) {
+		s->ml_dle = 0;
+		return (0);		/* time fill */
+	}
+	s->ml_dle = 0;
+	if (s->ml_inlen < sizeof(s->ml_in))
+		s->ml_in[s->ml_inlen++] = ch;
+	return (0);
+}
+
+// Take apart a block from the host
+
+static int ml_block(struct rje_session *s)
+{
+	unsigned char *b = s->ml_in;
+	unsigned char rec[1024];
+	unsigned char nak[3] = {SYN, SYN, NAK};
+	char wstr[80];
+	int i, n, rcb, srcb, seq, used;
+
+	if (s->ml_inlen < 3) {
+		memcpy(s->line_out, nak, sizeof(nak));
+		s->line_out_size = sizeof(nak);
+		write_buffer(s);
+		s->ml_turn = 0;
+		s->ml_timer = rje_clock() + s->tm.text_wait;
+		return (0);
+	}
+	seq = b[0] & 0x0f;
+	switch (b[0] & 0xf0) {
+	case ML_BCB:
+		if (s->ml_bcbin >= 0 && seq == ((s->ml_bcbin + 15) & 0x0f)) {
+			write_buffer(s);	/* had it, our answer was lost */
+			s->ml_timer = rje_clock() + s->tm.text_wait;
+			return (0);
+		}
+		if (s->ml_bcbin >= 0 && seq != s->ml_bcbin) {
+			sprintf(wstr, "\r\nRJE219W Block %d from the host, expected %d.\r\n",
+				seq, s->ml_bcbin);
+			rje_msg(s, wstr);
+		}
+		s->ml_bcbin = (seq + 1) & 0x0f;
+		break;
+	case ML_BCB_RESET:
+		s->ml_bcbin = (seq + 1) & 0x0f;
+		break;
+	}
+	s->ml_fcs[0] = b[1];
+	s->ml_fcs[1] = b[2];
+
+	for (i = 3; i + 1 < s->ml_inlen; ) {
+		rcb = b[i++];
+		if (rcb == ML_RCB_EOB)
+			break;
+		srcb = b[i++];
+		if (rcb == ML_RCB_REQUEST) {
+			ml_request(s, srcb);
+			continue;
+		}
+		if (rcb == ML_RCB_GRANT) {
+			if (ML_RCB_TYPE(srcb) == ML_READER &&
+				ml_stream(s, srcb) != NULL &&
+				ml_stream(s, srcb)->state == ML_ASKED)
+				ml_stream(s, srcb)->state = ML_ACTIVE;
+			continue;
+		}
+		if (rcb == ML_RCB_BADBCB) {
+			s->ml_bcbout = srcb & 0x0f;
+			continue;
+		}
+		if (ML_RCB_TYPE(rcb) < ML_MSG || ML_RCB_TYPE(rcb) > ML_PUNCH ||
+			ML_RCB_STREAM(rcb) == 0) {
+			sprintf(wstr, "\r\nRJE222W Record type %02x from the host not understood, rest of block lost.\r\n", rcb);
+			rje_msg(s, wstr);
+			break;
+		}
+		n = rje_ml_unpack(b + i, s->ml_inlen - i, rec, sizeof(rec), &used);
+		if (n < 0) {
+			rje_msg(s, "\r\nRJE222W Bad record from the host, rest of block lost.\r\n");
+			break;
+		}
+		i += used;
+		ml_record(s, rcb, srcb, rec, n);
+	}
+	return (ml_heard(s, 1));
+}
+
+// The host has answered, it's our turn.  After a block we answer right
+// away; if it had nothing either, there's no hurry unless we have.
+
+static int ml_heard(struct rje_session *s, int block)
+{
+	lat_end(s, RJE_LAT_BLOCK);
+	lat_end(s, RJE_LAT_POLL);
+	s->ml_retry = 0;
+	s->ml_turn = 1;
+	s->ml_timer = rje_clock() + (block ? 0 : s->tm.poll_time);
+	return (0);
+}
+
+// The host didn't get our last block (or ACK0), or hasn't answered it
+
+static int ml_resend(struct rje_session *s)
+{
+	if (s->ml_turn)
+		return (0);		/* nothing out there to send again */
+	s->stat_retries++;
+	if (++s->ml_retry > s->tm.nak_tries) {
+		rje_msg(s, "\r\nRJE220S The host has stopped answering the multileaving line.\r\n");
+		return (rje_close(s));
+	}
+	write_buffer(s);
+	s->ml_timer = rje_clock() + s->tm.text_wait;
+	return (0);
+}
+
+// Called from rje_poll: answer the host when it's time, or try again if
+// it's gone quiet
+
+static int ml_service(struct rje_session *s)
+{
+	if (s->ml_turn) {
+		if (ml_pending(s) || rje_clock() - s->ml_timer >= 0)
+			ml_send(s);
+		return (0);
+	}
+	if (rje_clock() - s->ml_timer >= 0)
+		ml_resend(s);
+	return (0);
+}
+
+// Is there anything for the next block?
+
+static int ml_pending(struct rje_session *s)
+{
+	struct rje_mlstream *m;
+	int i;
+
+	if (s->ml_nctl > 0 || ml_fcs(s, 0) != s->ml_fcsout)
+		return (1);
+	if (ml_job(s, XMIT_CMD) >= 0 && (s->ml_fcs[1] & ML_FCS_CONSOLE))
+		return (1);
+	if (ml_job(s, XMIT_FILE) >= 0) {
+		for (i = 0; i < s->opt_mlrdrs && i < RJE_ML_STREAMS; i++) {
+			if (s->ml_rdr[i].state == ML_IDLE)
+				return (1);
+		}
+	}
+	if (s->ml_fcs[0] & ML_FCS_WAIT)
+		return (0);
+	for (i = 0; i < RJE_ML_STREAMS; i++) {
+		m = &s->ml_rdr[i];
+		if (m->state == ML_ACTIVE && (s->ml_fcs[0] & ML_FCS_STREAM(i + 1)))
+			return (1);
+	}
+	return (0);
+}
+
+// Our FCS: everything may come, unless we're behind with the output
+
+static int ml_fcs(struct rje_session *s, int byte)
+{
+	if (s->opt_wack && sink_busy(s))
+		return (byte == 0 ? ML_FCS | ML_FCS_WAIT : ML_FCS);
+	return (byte == 0 ? ML_FCS | 0x0f : ML_FCS | ML_FCS_CONSOLE | 0x0f);
+}
+
+// Our turn: put together a block of whatever we have, or DLE ACK0
+
+static int ml_send(struct rje_session *s)
+{
+	unsigned char blk[ML_BLKSIZE];
+	unsigned char ack[4] = {SYN, SYN, DLE, ACK0};
+	unsigned char card[RDR_MAXRECL];
+	int i, k, n, len = 3;
+
+	ml_readers(s);
+	blk[0] = ML_BCB | s->ml_bcbout;
+	blk[1] = ml_fcs(s, 0);
+	blk[2] = ml_fcs(s, 1);
+
+	// Control records first, then commands, then cards
+
+	for (i = 0; i < s->ml_nctl && len + 2 < ML_BLKSIZE; i++) {
+		blk[len++] = s->ml_ctl[i][0];
+		blk[len++] = s->ml_ctl[i][1];
+	}
+	memmove(s->ml_ctl, s->ml_ctl[i], (s->ml_nctl - i) * 2);
+	s->ml_nctl -= i;
+	while ((s->ml_fcs[1] & ML_FCS_CONSOLE) &&
+		(k = ml_job(s, XMIT_CMD)) >= 0) {
+		rje_card_text(card, s->queue[k].text, 80, ascii_to_ebcdic);
+		n = rje_ml_pack(blk + len + 2, ML_BLKSIZE - 1 - len - 2, card, 80);
+		if (n < 0)
+			break;
+		blk[len++] = ML_RCB(ML_CMD, 1);
+		blk[len++] = ML_SRCB;
+		len += n;
+		ml_event(s, RJE_EV_DONE, XMIT_CMD, s->queue[k].id, 0, 0);
+		rje_cancel(s, s->queue[k].id);
+	}
+	if (!(s->ml_fcs[0] & ML_FCS_WAIT)) {
+		for (i = 0; i < RJE_ML_STREAMS; i++) {
+			k = (s->ml_bcbout + i) % RJE_ML_STREAMS;	/* take turns */
+			if (s->ml_rdr[k].state == ML_ACTIVE &&
+				(s->ml_fcs[0] & ML_FCS_STREAM(k + 1)))
+				ml_cards(s, &s->ml_rdr[k], k + 1, blk, &len);
+		}
+	}
+
+	s->ml_turn = 0;
+	s->ml_timer = rje_clock() + s->tm.text_wait;
+	if (len == 3 && blk[1] == s->ml_fcsout) {
+		memcpy(s->line_out, ack, sizeof(ack));
+		s->line_out_size = sizeof(ack);
+		write_buffer(s);
+		lat_start(s, RJE_LAT_POLL);
+		return (0);
+	}
+	s->ml_fcsout = blk[1];
+	blk[len++] = ML_RCB_EOB;
+	ml_frame(s, blk, len);
+	lat_start(s, RJE_LAT_BLOCK);
+	s->ml_bcbout = (s->ml_bcbout + 1) & 0x0f;
+	return (0);
+}
+
+// Send a block, transparent, DLEs in it doubled
+
+static int ml_frame(struct rje_session *s, unsigned char *blk, int len)
+{
+	int i, n = 0;
+
+	s->line_out[n++] = SYN;
+	s->line_out[n++] = SYN;
+	s->line_out[n++] = DLE;
+	s->line_out[n++] = STX;
+	for (i = 0; i < len; i++) {
+		if (blk[i] == DLE)
+			s->line_out[n++] = DLE;
+		s->line_out[n++] = blk[i];
+	}
+	s->line_out[n++] = DLE;
+	s->line_out[n++] = ETB;
+	s->line_out_size = n;
+	write_buffer(s);
+	return (0);
+}
+
+// Put as many of a reader's cards in the block as fit.  At the end of
+// the deck an empty record tells the host so.
+
+static int ml_cards(struct rje_session *s, struct rje_mlstream *m, int n,
+	unsigned char *blk, int *len)
+{
+	char line[RDR_MAXRECL + 2];
+	int rc, used;
+
+	for (;;) {
+		if (m->cardlen == 0 && !m->eof) {
+			if (strcmp(m->file, "*") == 0) {
+				memset(line, 0, sizeof(line));
+				rc = (s->cardfn == NULL) ? -1 : s->cardfn(s, line);
+				if (rc > 0)
+					return (0);	/* not typed yet */
+				if (rc < 0 || line[0] == '\004')
+					m->eof = 1;
+				else
+					m->cardlen = rje_card_text(m->card, line,
+						m->recl, ascii_to_ebcdic);
+			} else {
+				rc = rje_reader_get(&m->rdr, m->card);
+				if (rc == RDR_WAIT)
+					return (0);	/* not in yet */
+				if (rc < 0) {
+					rje_msg(s, "\r\nRJE187S The file isn't in the format given on SEND, ");
+					rje_msg(s, m->file);
+					rje_msg(s, " cut short.\r\n");
+					m->eof = -1;
+				} else if (rc == 0) {
+					m->eof = 1;
+				} else {
+					m->cardlen = rc;
+				}
+			}
+		}
+		if (*len + 3 > ML_BLKSIZE - 1)
+			return (0);
+		if (m->eof) {
+			blk[(*len)++] = ML_RCB(ML_READER, n);
+			blk[(*len)++] = ML_SRCB;
+			blk[(*len)++] = 0;
+			return (ml_deck_done(s, m, n));
+		}
+		used = rje_ml_pack(blk + *len + 2, ML_BLKSIZE - 1 - *len - 2,
+			m->card, m->cardlen);
+		if (used < 0)
+			return (0);	/* it goes in the next block */
+		blk[(*len)++] = ML_RCB(ML_READER, n);
+		blk[(*len)++] = ML_SRCB;
+		*len += used;
+		job_card(s, m->card, m->cardlen, m->id, m->file);
+		m->cardlen = 0;
+		m->count++;
+	}
+}
+
+// A deck has gone, the reader is free
+
+static int ml_deck_done(struct rje_session *s, struct rje_mlstream *m, int n)
+{
+	char wstr[80];
+
+	if (strcmp(m->file, "*") != 0)
+		rje_reader_close(&m->rdr);
+	sprintf(wstr, "\r\nRJE216I Reader %d: %d cards sent from ", n, m->count);
+	rje_msg(s, wstr);
+	rje_msg(s, m->file);
+	rje_msg(s, "\r\n");
+	ml_event(s, RJE_EV_DONE, XMIT_FILE, m->id, m->eof < 0 ? -1 : 0, 0);
+	m->state = ML_IDLE;
+	return (0);
+}
+
+// Put queued decks on free readers and ask the host for the go ahead
+
+static int ml_readers(struct rje_session *s)
+{
+	struct rje_mlstream *m;
+	struct rje_job j;
+	char wstr[80];
+	int i, k;
+
+	for (i = 0; i < s->opt_mlrdrs && i < RJE_ML_STREAMS &&
+		s->ml_nctl < RJE_ML_CTL; i++) {
+		m = &s->ml_rdr[i];
+		if (m->state != ML_IDLE)
+			continue;
+		if ((k = ml_job(s, XMIT_FILE)) < 0)
+			return (0);
+		j = s->queue[k];
+		rje_cancel(s, j.id);
+		memset(m, 0, sizeof(struct rje_mlstream));
+		strcpy(m->file, j.file);
+		m->id = j.id;
+		m->recl = j.recl;
+		if (strcmp(j.file, "*") == 0) {
+			rje_msg(s, "\r\nRJE174A Enter lines to send, CTRL-D for EOF\r\n");
+		} else if (rje_decks_reader(s->decks, &m->rdr, j.file, j.fmt,
+			j.recl, ascii_to_ebcdic) != 0) {
+			rje_msg(s, "\r\nRJE172S Can't open ");
+			rje_msg(s, j.file);
+			rje_msg(s, " any more, it's been removed?\r\n");
+			ml_event(s, RJE_EV_DONE, XMIT_FILE, j.id, -1, 0);
+			i--;		/* try the next one */
+			continue;
+		}
+		sprintf(wstr, "\r\nRJE215I Reader %d: sending ", i + 1);
+		rje_msg(s, wstr);
+		rje_msg(s, j.file);
+		rje_msg(s, "\r\n");
+		m->state = ML_ASKED;
+		ml_control(s, ML_RCB_REQUEST, ML_RCB(ML_READER, i + 1));
+	}
+	return (0);
+}
+
+// The best queued submission of a kind, or -1.  Only one deck at a time
+// can come from the keyboard.
+
+static int ml_job(struct rje_session *s, int kind)
+{
+	int i, k, best = -1;
+
+	for (i = 0; i < s->nqueue; i++) {
+		if (s->queue[i].kind != kind)
+			continue;
+		if (kind == XMIT_FILE && strcmp(s->queue[i].file, "*") == 0) {
+			for (k = 0; k < RJE_ML_STREAMS; k++) {
+				if (s->ml_rdr[k].state != ML_IDLE &&
+					strcmp(s->ml_rdr[k].file, "*") == 0)
+					break;
+			}
+			if (k < RJE_ML_STREAMS)
+				continue;
+		}
+		if (best < 0 || s->queue[i].prio > s->queue[best].prio)
+			best = i;
+	}
+	return (best);
+}
+
+static int ml_control(struct rje_session *s, int rcb, int srcb)
+{
+	if (s->ml_nctl >= RJE_ML_CTL)
+		return (-1);
+	s->ml_ctl[s->ml_nctl][0] = rcb;
+	s->ml_ctl[s->ml_nctl][1] = srcb;
+	s->ml_nctl++;
+	return (0);
+}
+
+// The stream an RCB names, or NULL if it's not one we have
+
+static struct rje_mlstream *ml_stream(struct rje_session *s, int rcb)
+{
+	int n = ML_RCB_STREAM(rcb);
+
+	if (n < 1 || n > RJE_ML_STREAMS)
+		return (NULL);
+	switch (ML_RCB_TYPE(rcb)) {
+	case ML_READER:
+		return (&s->ml_rdr[n - 1]);
+	case ML_PRINTER:
+		return (&s->ml_prt[n - 1]);
+	case ML_PUNCH:
+		return (&s->ml_pun[n - 1]);
+	}
+	return (NULL);
+}
+
+// The host wants to start a printer or punch.  Say yes.
+
+static int ml_request(struct rje_session *s, int srcb)
+{
+	struct rje_mlstream *m = ml_stream(s, srcb);
+
+	if (m == NULL || ML_RCB_TYPE(srcb) == ML_READER)
+		return (-1);
+	if (m->state != ML_ACTIVE)
+		ml_start_output(s, m, srcb);
+	return (ml_control(s, ML_RCB_GRANT, srcb));
+}
+
+static int ml_start_output(struct rje_session *s, struct rje_mlstream *m,
+	int rcb)
+{
+	int n = ML_RCB_STREAM(rcb), dev = (ML_RCB_TYPE(rcb) == ML_PUNCH);
+	char *base = dev ? s->punch : s->print;
+	char wstr[80];
+
+	m->state = ML_ACTIVE;
+	m->count = 0;
+	m->action = 0x61;		/* single space */
+	if (n > 1 && base[0] == '|')
+		strcpy(m->file, base);	/* RJE_STREAM tells them apart */
+	else if (n > 1 && strlen(base) > 0 && strlen(base) < sizeof(m->file) - 4)
+		sprintf(m->file, "%s.%d", base, n);
+	else if (n > 1)
+		strcpy(m->file, "");
+	sprintf(wstr, "\r\nRJE217I %s %d: receiving", dev ? "Punch" : "Printer", n);
+	rje_msg(s, wstr);
+	if (n > 1 && strlen(m->file) > 0) {
+		rje_msg(s, " into ");
+		rje_msg(s, m->file);
+	}
+	rje_msg(s, "\r\n");
+	ml_event(s, RJE_EV_OUTPUT, XMIT_NONE, 0, 0, dev);
+	return (0);
+}
+
+// A record for one of our streams
+
+static int ml_record(struct rje_session *s, int rcb, int srcb,
+	unsigned char *rec, int len)
+{
+	struct rje_mlstream *m;
+	int i, n = ML_RCB_STREAM(rcb), dev;
+	char text[256];
+
+	if (ML_RCB_TYPE(rcb) == ML_MSG) {	/* the host's console */
+		for (i = 0; i < len && i < sizeof(text) - 1; i++)
+			text[i] = ebcdic_to_ascii[rec[i]];
+		text[i] = 0;
+		rje_msg(s, "\r\n");
+		rje_msg(s, text);
+		job_message(s, text);
+		return (0);
+	}
+	if ((m = ml_stream(s, rcb)) == NULL || ML_RCB_TYPE(rcb) == ML_READER)
+		return (-1);
+	dev = (ML_RCB_TYPE(rcb) == ML_PUNCH);
+	if (m->state != ML_ACTIVE)
+		ml_start_output(s, m, rcb);	/* it didn't ask first */
+	if (len == 0)
+		return (ml_end_output(s, m, rcb));
+
+	// Into record_in as though it came as a 3780 record, the
+	// printer's carriage control as an ESC action in front
+
+	clear_input_record(s);
+	if (!dev) {
+		s->record_in[s->record_ctr++] = ESC;
+		s->record_in[s->record_ctr++] = m->action;
+		m->action = rje_ml_action(srcb);
+	}
+	if (len > sizeof(s->record_in) - 2)
+		len = sizeof(s->record_in) - 2;
+	memcpy(s->record_in + s->record_ctr, rec, len);
+	s->record_ctr += len;
+	s->device_select = dev;
+	s->out_stream = n - 1;
+	if (n > 1)
+		ml_swap(s, m, dev);
+	write_record(s);
+	if (n > 1)
+		ml_swap(s, m, dev);
+	s->out_stream = 0;
+	m->count++;
+	return (0);
+}
+
+// End of file on a printer or punch
+
+static int ml_end_output(struct rje_session *s, struct rje_mlstream *m,
+	int rcb)
+{
+	int n = ML_RCB_STREAM(rcb), dev = (ML_RCB_TYPE(rcb) == ML_PUNCH);
+	char wstr[80];
+
+	if (n > 1)
+		ml_swap(s, m, dev);
+	if (!dev)
+		print_flush(s);
+	out_end(s, dev, n > 1);
+	if (n > 1)
+		ml_swap(s, m, dev);
+	sprintf(wstr, "\r\nRJE218I %s %d: done, %d records.\r\n",
+		dev ? "Punch" : "Printer", n, m->count);
+	rje_msg(s, wstr);
+	m->state = ML_IDLE;
+	ml_event(s, RJE_EV_EOT, XMIT_NONE, 0, 0, dev);
+	job_output_end(s, dev, n - 1);
+	return (0);
+}
+
+// Printers and punches after the first have output of their own.  Trade
+// it with the session's PRINT or PUNCH around the write_record, which
+// then works for them just as it does for the first.
+
+static int ml_swap(struct rje_session *s, struct rje_mlstream *m, int dev)
+{
+	unsigned char hold[RJE_FORMS_MAX + 1];
+	char name[80];
+	struct rje_sink *k;
+	struct rje_pages pages;
+	FILE *fd;
+	int open, held;
+
+	if (dev) {
+		strcpy(name, s->punch);
+		strcpy(s->punch, m->file);
+		fd = s->punchfd;
+		s->punchfd = m->fd;
+		open = s->punch_open;
+		s->punch_open = m->open;
+		k = s->punch_sink;
+		s->punch_sink = m->sink;
+	} else {
+		strcpy(name, s->print);
+		strcpy(s->print, m->file);
+		fd = s->printfd;
+		s->printfd = m->fd;
+		open = s->print_open;
+		s->print_open = m->open;
+		k = s->print_sink;
+		s->print_sink = m->sink;
+		held = s->print_held;
+		s->print_held = m->held;
+		m->held = held;
+		memcpy(hold, s->print_hold, sizeof(hold));
+		memcpy(s->print_hold, m->hold, sizeof(hold));
+		memcpy(m->hold, hold, sizeof(hold));
+		pages = s->pages;
+		s->pages = m->pages;
+		m->pages = pages;
+	}
+	strcpy(m->file, name);
+	m->fd = fd;
+	m->open = open;
+	m->sink = k;
+	return (0);
+}
+
+// The line's gone: decks being sent have failed, output is closed off
+
+static int ml_stop(struct rje_session *s)
+{
+	struct rje_mlstream *m;
+	int i;
+
+	for (i = 0; i < RJE_ML_STREAMS; i++) {
+		m = &s->ml_rdr[i];
+		if (m->state != ML_IDLE) {
+			if (strcmp(m->file, "*") != 0)
+				rje_reader_close(&m->rdr);
+			ml_event(s, RJE_EV_DONE, XMIT_FILE, m->id, -1, 0);
+			m->state = ML_IDLE;
+		}
+		if (s->ml_prt[i].state != ML_IDLE)
+			ml_end_output(s, &s->ml_prt[i], ML_RCB(ML_PRINTER, i + 1));
+		if (s->ml_pun[i].state != ML_IDLE)
+			ml_end_output(s, &s->ml_pun[i], ML_RCB(ML_PUNCH, i + 1));
+	}
+	s->ml_nctl = 0;
+	return (0);
+}
+
+// An event for a stream, which isn't the session's current transmission
+
+static int ml_event(struct rje_session *s, int type, int kind, int id,
+	int rc, int device)
+{
+	struct rje_event *ev;
+
+	push_event(s, type, rc);
+	ev = &s->ev[(s->ev_head + RJE_MAXEV - 1) % RJE_MAXEV];
+	ev->kind = kind;
+	ev->id = id;
+	ev->device = device;
+	return (0);
+}
+
+// ---------------------------------------------------------------------------------
+// This is code supporting the I/O to and from the line
+// ---------------------------------------------------------------------------------
+
+// This function polls for data, and if there is some waiting,
+// it returns 1, otherwise it returns 0.
+// the parameters are the timeout values
+
+static int read_poll(struct rje_session *s, int sec, int usec)
+{
+	struct timeval tv;
+	fd_set readfdset;
+	int maxfd;
+
+	if (s->waitfn != NULL)
+		return (s->waitfn(s, sec * 1000L + usec / 1000));
+	tv.tv_sec = sec;			/* Set timeout value */
+	tv.tv_usec = usec;
+	FD_ZERO(&readfdset);
+	FD_SET(s->sockfd, &readfdset);
+	maxfd = s->sockfd;
+#if !defined (_WIN32)
+
+	// A deck coming down a pipe, held for its next card, wakes us too
+
+	if (s->status == SENDING && s->xmit_state == XS_HOLD &&
+		!s->xmit_ttd && s->rdr.stream && s->rdr.sfd >= 0) {
+		FD_SET(s->rdr.sfd, &readfdset);
+		if (s->rdr.sfd > maxfd)
+			maxfd = s->rdr.sfd;
+	}
+#endif
+	select(maxfd+1, &readfdset, NULL, NULL, &tv);
+	if (FD_ISSET(s->sockfd, &readfdset)) 	/* Data ready? */
+		return (1);
+	return (0);
+}
+
+// This gathers a frame from the physical buffer into line_in.  It stops
+// when it's got a bisync unpend character.  Those are:
+// ENQ, EOT, ETB, ETX.
+// Unless we are receiving text, NAK, ACK0, ACK1 and WACK
+// are also unpend characters.  (That's when text is not being sent
+// to us but controls are.)
+// Returns 1 when line_in holds a whole frame, 0 if more is needed.
+// Anything after the unpend character stays in the physical buffer.
+
+static int read_frame(struct rje_session *s)
+{
+	int i, unpend = 0;
+	unsigned char c;
+
+	for (i = 0; i < s->phy_ctr; i++) {
+		c = s->phybuffer[i];
+		s->line_in[s->line_in_ctr] = c;
+		s->line_in_ctr++;
+		if (c == ENQ || c == EOT || c == ETX || c == ETB) {
+			unpend = 1;
+			break;
+		}
+		if (s->status != RECEIVING &&
+			(c == NAK || c == ACK0 || c == ACK1 || c == WABT)) {
+			unpend = 1;
+			break;
+		}
+		if (s->line_in_ctr == sizeof(s->line_in)) {
+			unpend = 1;	/* no room - take what we have */
+			break;
+		}
+	}
+	if (i < s->phy_ctr) {
+		i++;
+		memmove(s->phybuffer, &s->phybuffer[i], s->phy_ctr - i);
+		s->phy_ctr -= i;
+	} else {
+		s->phy_ctr = 0;
+	}
+	return (unpend);
+}
+
+// This function tries to read something from the line.  Whatever
+// it reads, it adds to the physical buffer (phybuffer).  It returns
+// the number of characters added to the buffer, or -1 if an error.
+
+static int get_buffer(struct rje_session *s)
+{
+	int i, rc, count;
+#if defined (_WIN32)
+	int err;
+#endif
+	char wstr[64];
+	unsigned char inbuffer[256];
+
+	if (s->status == NOLINK || s->status == SHUTDOWN)
+		return (-1);
+
+	if (s->readfn != NULL)
+		rc = s->readfn(s, inbuffer, sizeof(inbuffer));
+	else
+		rc = recv(s->sockfd, inbuffer, 256, 0);
+	if (rc == 0) return (-1);	/* disconnect */
+
+#if defined (_WIN32)			// Windows
+
+	if (rc == SOCKET_ERROR) {
+		err = WSAGetLastError();
+		if (err == WSAEWOULDBLOCK)
+			return (0);			/* no data */
+		printf("\nWindows socket error: %d\n", err);
+		return (-1);
+	}
+
+#else					// Linux
+
+	if (rc < 0 && errno == EAGAIN)
+		rc = 0;			/* No data */
+#endif
+
+	count = 0;
+	if (rc > 0) {
+		s->lat_read = rje_uclock();
+		if (s->debugit)
+			rje_msg(s, "\r\nData received: ");
+		for (i = 0; i < rc; i++) {	/* Consider each character */
+			if (!s->ml && (inbuffer[i] == SYN ||
+				inbuffer[i] == EPAD || inbuffer[i] == SPAD))
+				continue;	/* multileaving data may hold these */
+			if (s->debugit) {
+				sprintf(wstr,"%2x",inbuffer[i]);
+				rje_msg(s, wstr);
+			}
+			if (s->phy_ctr == sizeof(s->phybuffer))
+				break;
+			s->phybuffer[s->phy_ctr] = inbuffer[i];
+			s->phy_ctr++;
+			count++;
+		}
+	}
+
+	if (rc < 0)
+		return (-1);
+	return (count);
+}
+
+// Clear the input buffer
+
+static int clear_input_buffer(struct rje_session *s)
+{
+	memset(s->line_in, 0, sizeof(s->line_in));
+	s->line_in_ctr = 0;
+	return (0);
+}
+
+// Clear the input record
+
+static int clear_input_record(struct rje_session *s)
+{
+	memset(s->record_in, 0, sizeof(s->record_in));
+	s->record_ctr = 0;
+	return (0);
+}
+
+// Write the data record to the output file, or pass it to the recfn
+
+static int write_record(struct rje_session *s)
+{
+	char output_data[512];
+	char print_line[512];
+	const struct rje_fcact *fc;
+	int action, ebc;
+	int i, j;
+
+	job_record(s, s->device_select, s->record_in, s->record_ctr);
+	if (s->recfn != NULL &&
+		s->recfn(s, s->device_select, s->record_in, s->record_ctr) != 0) {
+		clear_input_record(s);	/* the caller took it */
+		return (0);
+	}
+	for (i = 0; i < 512; i++) {output_data[i] = 0;}
+	if (s->device_select == 0) {
+		if (strlen(s->print) > 0 && s->print_open == 0) {
+			out_open(s, 0);
+			s->print_held = 0;
+		}
+
+		// Is this is horizontal tabs record?  If so store it, and
+		// print whatever follows it.
+
+		i = rje_forms_tabs(&s->forms, s->record_in, s->record_ctr);
+		if (i > 0 && i >= s->record_ctr) {
+			clear_input_record(s);
+			return (0);	/* DO NOT print it */
+		}
+
+		// Expand tabs, pick up the vertical forms control and
+		// translate, all in one go.  The EBCDIC formats skip the
+		// translation.
+
+		ebc = (strlen(s->print) > 0 && s->print_fmt >= 3);
+		j = rje_forms_expand(&s->forms, s->record_in + i,
+			s->record_ctr - i, (unsigned char *) output_data,
+			RJE_FORMS_MAX, ebc ? NULL : ebcdic_to_ascii, &action);
+		fc = rje_forms_action(action);
+		if (s->pages.fd != NULL && fc->channel == 1)
+			s->pages.next |= PAGE_STARTS;
+		if (s->index != NULL)
+			rje_index_line(s->index, s->out_stream,
+				(unsigned char *) output_data, j, fc->channel == 1, ebc);
+		if (strlen(s->print) > 0 && s->print_fmt != 0) {
+			print_record(s, fc, (unsigned char *) output_data, j);
+			clear_input_record(s);
+			return (0);
+		}
+		while (j > 0 && output_data[j - 1] == ' ')
+			j--;
+		memcpy(print_line, fc->text, fc->textlen);
+		memcpy(print_line + fc->textlen, output_data, j);
+		print_line[fc->textlen + j] = 0;
+		if (strlen(s->print) == 0) {
+			rje_msg(s, print_line);
+		} else {
+			if (s->pages.next)
+				page_mark(s, s->pages.next, fc->text, fc->textlen);
+			s->pages.next = 0;
+			out_write(s, 0, print_line, fc->textlen + j);
+		}
+	} else {
+		if (strlen(s->punch) == 0) {
+			clear_input_record(s);
+			return (0);	/* into the bit bucket */
+		}
+		if (s->punch_open == 0)
+			out_open(s, 1);
+
+		// EBCDIC goes out just as it came in
+
+		if (s->punch_fmt != 0) {
+			put_record(s, 1, s->punch_fmt == 2, -1, s->record_in,
+				s->record_ctr, s->punch_recl, 0x40);
+			clear_input_record(s);
+			return (0);
+		}
+		for (i = 0; i < s->punch_recl; i++) {
+			if (i < s->record_ctr)
+				output_data[i] = s->record_in[i];
+			else
+				output_data[i] = 0x40;
+		}
+		translate_to_ascii(output_data);
+		j = strlen(output_data);
+		while (output_data[j] == ' ' && j > 1) {
+			output_data[j] = 0;
+			j--;
+		}
+		strcat(output_data, "\n");
+		out_write(s, 1, output_data, strlen(output_data));
+	}
+	clear_input_record(s);
+	return (0);
+}
+
+// Write one record: FB is padded out to recl with fill, VB gets a record
+// descriptor word (length including itself, big endian, then two zero
+// bytes) and is not padded.  cc, if not -1, is a carriage control byte
+// put in front of the data; recl is the data length without it.
+
+static int put_record(struct rje_session *s, int dev, int vb, int cc,
+	unsigned char *data, int len, int recl, unsigned char fill)
+{
+	unsigned char rec[1100];
+	int n = 0;
+
+	if (len > recl)
+		len = recl;
+	if (vb) {
+		n = 4 + len + (cc >= 0);
+		rec[0] = n >> 8;
+		rec[1] = n & 0xff;
+		rec[2] = rec[3] = 0;
+		n = 4;
+	}
+	if (cc >= 0)
+		rec[n++] = cc;
+	memcpy(rec + n, data, len);
+	n += len;
+	if (!vb) {
+		memset(rec + n, fill, recl - len);
+		n += recl - len;
+	}
+	return (out_write(s, dev, rec, n));
+}
+
+// Write a printer line as a record with its carriage control in front,
+// ASA or machine.  Nothing is trimmed and no line ends are added.  The
+// host's controls move the paper before the line, which is how ASA works,
+// but a machine code moves it after; so in machine format each line is
+// held until the next one says what comes after it.  FBA and VBA are ASA
+// in EBCDIC, the line having been left untranslated.
+
+static int print_record(struct rje_session *s, const struct rje_fcact *fc,
+	unsigned char *line, int len)
+{
+	unsigned char rec[RJE_FORMS_MAX + 1];
+	int recl = s->print_recl;
+
+	if (s->pages.next && s->print_fmt != 2) {
+		page_mark(s, s->pages.next, NULL, 0);
+		s->pages.next = 0;
+	}
+	switch (s->print_fmt) {
+	case 1:
+		return (put_record(s, 0, 0, fc->asa, line, len, recl, ' '));
+	case 3:
+	case 4:
+		return (put_record(s, 0, s->print_fmt == 4,
+			ascii_to_ebcdic[(unsigned char) fc->asa], line, len, recl, 0x40));
+	}
+	if (len > recl)
+		len = recl;
+	if (s->print_held) {
+		s->print_hold[0] = fc->mach;
+		if (s->pages.held)
+			page_mark(s, s->pages.held, NULL, 0);
+		out_write(s, 0, s->print_hold, recl + 1);
+	} else if (fc->mach != 0x01) {
+		rec[0] = fc->mach | RJE_MACH_IMMED;	/* first line: move now */
+		memset(rec + 1, ' ', recl);
+		out_write(s, 0, rec, recl + 1);
+	}
+	s->pages.held = s->pages.next;	/* its page starts when it goes */
+	s->pages.next = 0;
+	memcpy(s->print_hold + 1, line, len);
+	memset(s->print_hold + 1 + len, ' ', recl - len);
+	s->print_held = 1;
+	return (0);
+}
+
+// End of the host's output: write the held machine format line
+
+static int print_flush(struct rje_session *s)
+{
+	if (s->print_held && s->print_open == 1) {
+		s->print_hold[0] = 0x09;	/* write, space 1 */
+		if (s->pages.held)
+			page_mark(s, s->pages.held, NULL, 0);
+		out_write(s, 0, s->print_hold, s->print_recl + 1);
+		if (s->print_sink == NULL && s->printfd != NULL)
+			fflush(s->printfd);
+	}
+	s->print_held = 0;
+	s->pages.held = 0;
+	return (0);
+}
+
+// Open the printer's (dev 0) or punch's file, or start its command if
+// the name is a |command
+
+static int out_open(struct rje_session *s, int dev)
+{
+	char *name = dev ? s->punch : s->print;
+	int fmt = dev ? s->punch_fmt : s->print_fmt;
+	struct rje_sink *k = NULL;
+	FILE *fd = NULL;
+	int i;
+
+	if (name[0] != '|') {
+		fd = fopen(name, fmt ? "ab" : "a");
+	} else {
+		for (i = 0; i < RJE_SINKS; i++) {
+			if (s->sinks[i].state == SINK_FREE)
+				break;
+		}
+		if (i == RJE_SINKS) {	/* wait for the oldest to go */
+			for (i = 0; s->sinks[i].state != SINK_CLOSING &&
+				i < RJE_SINKS - 1; i++)
+				;
+			rje_sink_finish(&s->sinks[i]);
+			sink_done(s, &s->sinks[i]);
+		}
+		k = &s->sinks[i];
+		if (rje_sink_open(k, name + 1, dev ? "punch" : "print",
+			s->out_stream + 1) < 0) {
+			rje_msg(s, "\r\nRJE230W Can't start ");
+			rje_msg(s, name + 1);
+			rje_msg(s, ", the output is lost.\r\n");
+			k = NULL;
+		}
+	}
+	if (dev) {
+		s->punchfd = fd;
+		s->punch_sink = k;
+		s->punch_open = 1;
+	} else {
+		s->printfd = fd;
+		s->print_sink = k;
+		s->print_open = 1;
+		if (fd != NULL && s->opt_pages)
+			pages_open(s);
+	}
+	return (0);
+}
+
+// Write to the printer's or punch's file, or down its command's pipe
+
+static int out_write(struct rje_session *s, int dev, const void *data,
+	int len)
+{
+	struct rje_sink *k = dev ? s->punch_sink : s->print_sink;
+	FILE *fd = dev ? s->punchfd : s->printfd;
+	const char *p;
+
+	if (k != NULL) {
+		if (rje_sink_write(k, data, len) < 0 && k->broken == 1) {
+			k->broken = 2;	/* say so once */
+			rje_msg(s, "\r\nRJE231W ");
+			rje_msg(s, k->cmd);
+			rje_msg(s, " has stopped taking output, the rest is lost.\r\n");
+		}
+		return (0);
+	}
+	if (fd == NULL)
+		return (0);
+	fwrite(data, len, 1, fd);
+	if (!dev && s->pages.fd != NULL) {
+		s->pages.bytes += len;
+		if (s->print_fmt != 0)
+			s->pages.lines++;	/* a record */
+		else
+			for (p = (const char *) data; (p = memchr(p, '\n',
+				len - (p - (const char *) data))) != NULL; p++)
+				s->pages.lines++;
+	}
+	return (0);
+}
+
+// The printer's or punch's output has ended.  A command gets its end of
+// file (once it's had the rest); a file is flushed, or closed.
+
+static int out_end(struct rje_session *s, int dev, int close)
+{
+	struct rje_sink **k = dev ? &s->punch_sink : &s->print_sink;
+	FILE **fd = dev ? &s->punchfd : &s->printfd;
+	int *open = dev ? &s->punch_open : &s->print_open;
+
+	if (*open != 1)
+		return (0);
+	if (*k != NULL) {
+		if (rje_sink_close(*k))
+			sink_done(s, *k);
+		*k = NULL;
+		*open = 0;
+		return (0);
+	}
+	if (*fd != NULL && close) {
+		fclose(*fd);
+		*fd = NULL;
+	} else if (*fd != NULL) {
+		fflush(*fd);
+	}
+	if (!dev && s->pages.fd != NULL && *fd == NULL) {
+		fclose(s->pages.fd);
+		memset(&s->pages, 0, sizeof(s->pages));
+	} else if (!dev && s->pages.fd != NULL) {
+		fflush(s->pages.fd);
+		s->pages.next = PAGE_STARTS | RJE_PAGE_OUTPUT;	/* the next */
+	}
+	if (close || *fd == NULL)
+		*open = 0;
+	return (0);
+}
+
+// Close the printer's (dev 0) or punch's file, or end its command's
+// output, before PRINT or PUNCH changes where it goes
+
+int rje_output_close(struct rje_session *s, int dev)
+{
+	if (!dev)
+		print_flush(s);
+	return (out_end(s, dev, 1));
+}
+
+// Start (or go on with) the print file's page index.  Appending, what's
+// in the print file after the last page indexed is counted, so offsets
+// and line numbers carry on from the end of it.
+
+static int pages_open(struct rje_session *s)
+{
+	struct rje_pages *p = &s->pages;
+	struct rje_page pg;
+	unsigned char buf[4096];
+	char name[96];
+	long long size, at = 0;
+	FILE *fd;
+	int i, n;
+
+	memset(p, 0, sizeof(*p));
+	if (strlen(s->print) > sizeof(name) - 7)
+		return (-1);
+	sprintf(name, "%s.pages", s->print);
+	if ((p->fd = fopen(name, "a+b")) == NULL)
+		return (-1);
+	fseek(p->fd, 0, SEEK_END);
+	size = ftell(p->fd);
+	if (size % sizeof(pg) != 0) {	/* cut short: pad, line 0 = none */
+		memset(&pg, 0, sizeof(pg));
+		fwrite(&pg, sizeof(pg) - size % sizeof(pg), 1, p->fd);
+		size -= size % sizeof(pg);
+	}
+	if (size >= (long long) sizeof(pg)) {
+		fseek(p->fd, size - sizeof(pg), SEEK_SET);
+		if (fread(&pg, sizeof(pg), 1, p->fd) == 1 && pg.line > 0) {
+			at = pg.offset;
+			p->lines = pg.line - 1;
+		}
+	}
+	fseek(p->fd, 0, SEEK_END);
+	p->next = PAGE_STARTS | RJE_PAGE_OUTPUT;
+	if ((fd = fopen(s->print, "rb")) == NULL)
+		return (0);
+	fseek(fd, 0, SEEK_END);
+	p->bytes = ftell(fd);
+	if (s->print_fmt == 0 || s->print_fmt == 4) {
+		fseek(fd, at, SEEK_SET);
+		while (at < p->bytes && (n = fread(buf, 1,
+			s->print_fmt ? 4 : sizeof(buf), fd)) > 0) {
+			if (s->print_fmt) {	/* VBA: RDW to RDW */
+				if (n < 4)
+					break;	/* a record cut short */
+				n = (buf[0] << 8) | buf[1];
+				if (n < 4 || fseek(fd, at + n, SEEK_SET) != 0) {
+					rje_msg(s, "\r\nRJE276W The PRINT file isn't VBA, its pages won't be indexed.\r\n");
+					fclose(fd);
+					fclose(p->fd);
+					memset(p, 0, sizeof(*p));
+					return (-1);
+				}
+				at += n;
+				p->lines++;
+				continue;
+			}
+			for (i = 0; i < n; i++) {
+				if (buf[i] == '\n')
+					p->lines++;
+			}
+			at += n;
+		}
+	} else {
+		p->lines += (p->bytes - at) / (s->print_recl + 1);
+	}
+	fclose(fd);
+	return (0);
+}
+
+// A page starts with the line about to be written.  text is what comes
+// ahead of the line in a text file; the page starts at its form feed.
+
+static int page_mark(struct rje_session *s, int flags, const char *text,
+	int len)
+{
+	struct rje_pages *p = &s->pages;
+	struct rje_page pg;
+	int i, skip = len, nl = 0;
+
+	for (i = 0; i < len; i++) {
+		if (text[i] == '\014') {
+			skip = i;
+			break;
+		}
+		if (text[i] == '\n')
+			nl++;
+	}
+	pg.offset = p->bytes + skip;
+	pg.line = p->lines + nl + 1;
+	pg.flags = flags & ~PAGE_STARTS;
+	fwrite(&pg, sizeof(pg), 1, p->fd);
+	return (0);
+}
+
+// Keep output moving down the pipes, and see to commands that are done
+
+static int sink_service(struct rje_session *s)
+{
+	int i, pending = 0;
+
+	for (i = 0; i < RJE_SINKS; i++) {
+		if (s->sinks[i].state == SINK_FREE)
+			continue;
+		if (rje_sink_service(&s->sinks[i]))
+			sink_done(s, &s->sinks[i]);
+		pending += s->sinks[i].len;
+	}
+	return (pending);
+}
+
+// A command has finished.  Say so if it didn't go well.
+
+static int sink_done(struct rje_session *s, struct rje_sink *k)
+{
+	char wstr[160];
+
+	if (k->status != 0) {
+		sprintf(wstr, "\r\nRJE232W %.80s ended with code %d.\r\n",
+			k->cmd, k->status);
+		rje_msg(s, wstr);
+	}
+	return (0);
+}
+
+
+// Write the output buffer to the line.  line_out is left as it is, so
+// it can be sent again after a NAK.
+
+static int write_buffer(struct rje_session *s)
+{
+	int i, j, rc;
+	char diswrite[4200];
+	char hexch[32];
+	unsigned char trndata[2048];
+	unsigned char *out = s->line_out;
+	int out_size = s->line_out_size;
+	int xlate = 0;
+
+	if (s->opt_trn == 1 && !s->ml) {	// transparent?
+		j = 0;		// yes -- insert DLEs
+		for (i = 0; i < s->line_out_size; i++) {
+			if (s->line_out[i] == STX)
+				xlate = 1;
+			if (s->line_out[i] < 0x40 &&
+				xlate == 1) {
+				trndata[j] = DLE;
+				j++;
+			}
+			if (s->line_out[i] == ETX)
+				xlate = 0;
+			trndata[j] = s->line_out[i];
+			j++;
+		}
+		out = trndata;
+		out_size = j;
+	}
+	if (s->writefn != NULL)
+		rc = s->writefn(s, out, out_size);
+	else
+		rc = send(s->sockfd, out, out_size, 0);
+	s->lat_wrote = rje_uclock();
+	if (s->debugit) {
+		strcpy(diswrite, "");
+		for (i = 0; i < rc; i++) {
+			sprintf(hexch, "%02x", out[i]);
+			strcat(diswrite, hexch);
+		}
+		rje_msg(s, "\r\nWrote (");
+		sprintf(hexch, "%d bytes):", rc);
+		rje_msg(s, hexch);
+		rje_msg(s, diswrite);
+		if (rc != out_size) {
+			rje_msg(s, " INCOMPLETE WRITE, ");
+			sprintf(hexch, "%d", (out_size - rc));
+			rje_msg(s, hexch);
+			rje_msg(s, " short!");
+		}
+	}
+	trace_line(s, "SEND: ", out, out_size);
+	return (0);
+}
+
+// Record a frame in the trace file:  the ascii translation, then the
+// EBCDIC hex in two lines below it.
+
+static int trace_line(struct rje_session *s, char *tag,
+	unsigned char *buf, int len)
+{
+	int i, j;
+	char wstr[32];
+	char traceline[2100];
+	unsigned char transline[2100];
+
+	if (strlen(s->tracefile) == 0)
+		return (0);
+	if (len > 2048)
+		len = 2048;
+	memset(transline, 0, sizeof(transline));
+	memset(traceline, 0, sizeof(traceline));
+	for (i = 0; i < len; i++) {
+		transline[i] = buf[i];
+	}
+	translate_to_ascii(transline);
+	strcpy(traceline, tag);
+	j = 6;
+	for (i = 0; i < len; i++) {
+		if (isprint(transline[i]) && transline[i] > 0x1f) {
+			traceline[j] = transline[i];
+			j++;
+		} else {
+			traceline[j] = ' ';
+			j++;
+		}
+	}
+	strcat(traceline, "\n");
+	fputs(traceline, s->tracefd);
+	strcpy(traceline, "      ");
+	j = 6;
+	for (i = 0; i < len; i++) {
+		sprintf(wstr, "%02x", buf[i]);
+		traceline[j] = wstr[0];
+		j++;
+	}
+	//strcat(traceline, "\n");
+	fputs(traceline, s->tracefd);
+	strcpy(traceline, "      ");
+	j = 6;
+	for (i = 0; i < len; i++) {
+		sprintf(wstr, "%02x", buf[i]);
+		traceline[j] = wstr[1];
+		j++;
+	}
+	strcat(traceline, "\n");
+	fputs(traceline, s->tracefd);
+	return (0);
+}
+
+// Send an ACK after a record is received
+
+static int send_ack(struct rje_session *s, unsigned char ack)
+{
+	s->line_out[0] = s->line_out[1] = SYN;	/* Tell remote we're OK */
+	s->line_out[2] = DLE;
+	if (ack == 0) {
+		if (s->lastack == ACK0)	/* Be sure and send correct ACK */
+			s->lastack = ACK1;
+			else
+			s->lastack = ACK0;
+	} else {
+		s->lastack = ack;
+	}
+	s->line_out[3] = s->lastack;
+	s->line_out_size = 4;
+	write_buffer(s);
+	return (0);
+}
+
+// Acknowledge a block of host output.  If we're behind with the output
+// (busyfn says so) answer WACK: the block is taken, but the host has to
+// wait and ENQ until we say ACK.  If work at or above the SET RVI
+// priority is waiting for the line, answer with RVI instead: it ACKs the
+// block just the same, but asks the host to stop and give us the line.
+// The host may well send another block or two first; RVI goes only once.
+
+static int block_ack(struct rje_session *s)
+{
+	unsigned char wack[4] = {SYN, SYN, DLE, WABT};
+	int i, prio = -1;
+
+	if (s->opt_wack && sink_busy(s)) {
+		s->lastack = (s->lastack == ACK0) ? ACK1 : ACK0;	/* as if ACKed */
+		send_ctl(s, wack, sizeof(wack));
+		s->wack_sent = 1;
+		return (0);
+	}
+	if (s->opt_rvi == 0 || s->rvi_sent)
+		return (send_ack(s, 0));
+	if (s->xmit != XMIT_NONE)
+		prio = s->xmit_prio;	/* lost a bid, still waiting */
+	for (i = 0; i < s->nqueue; i++) {
+		if (s->queue[i].prio > prio)
+			prio = s->queue[i].prio;
+	}
+	if (prio < s->opt_rvi)
+		return (send_ack(s, 0));
+	s->lastack = (s->lastack == ACK0) ? ACK1 : ACK0;	/* as if ACKed */
+	s->line_out[0] = s->line_out[1] = SYN;
+	s->line_out[2] = DLE;
+	s->line_out[3] = RVI;
+	s->line_out_size = 4;
+	write_buffer(s);
+	s->rvi_sent = 1;
+	rje_msg(s, "\r\nRJE210I Asking the host (RVI) for the line, there's work waiting.\r\n");
+	return (0);
+}
+
+// The host sent ENQ in the middle of its transmission.  STX ENQ is TTD,
+// the host holding the line with nothing to send yet: NAK it.  A bare ENQ
+// wants our last reply again, either because it was lost or because it
+// was a WACK; keep WACKing until we've caught up, then give the ACK.
+
+static int recv_enq(struct rje_session *s)
+{
+	unsigned char nak[3] = {SYN, SYN, NAK};
+	unsigned char wack[4] = {SYN, SYN, DLE, WABT};
+
+	if (s->gotstx)
+		return (send_ctl(s, nak, sizeof(nak)));
+	if (s->wack_sent && sink_busy(s))
+		return (send_ctl(s, wack, sizeof(wack)));
+	s->wack_sent = 0;
+	return (send_ack(s, s->lastack));
+}
+
+// Has whatever takes the host's output fallen behind?
+
+static int sink_busy(struct rje_session *s)
+{
+	int i;
+
+	for (i = 0; i < RJE_SINKS; i++) {
+		if (s->sinks[i].state != SINK_FREE && s->sinks[i].len > SINK_HIGH)
+			return (1);
+	}
+	if (s->busyfn == NULL)
+		return (0);
+	return (s->busyfn(s));
+}
+
+// Send a short control sequence (never transparent) without disturbing
+// line_out, which may still hold a block the host hasn't ACKed.
+
+static int send_ctl(struct rje_session *s, const unsigned char *ctl, int len)
+{
+	unsigned char save[8];
+	int size = s->line_out_size, trn = s->opt_trn;
+
+	memcpy(save, s->line_out, len);
+	memcpy(s->line_out, ctl, len);
+	s->line_out_size = len;
+	s->opt_trn = 0;
+	write_buffer(s);
+	s->opt_trn = trn;
+	memcpy(s->line_out, save, len);
+	s->line_out_size = size;
+	return (0);
+}
+
+// ------------------------------------------------------------------------------
+// Code translation services
+// ------------------------------------------------------------------------------
+
+/*-------------------------------------------------------------------*/
+/* SUBROUTINE TO TRANSLATE A NULL-TERMINATED STRING TO EBCDIC        */
+/*-------------------------------------------------------------------*/
+char *translate_to_ebcdic (unsigned char *str)
+{
+int     i;                              /* Array subscript           */
+unsigned char c;                        /* Character work area       */
+
+    for (i = 0; str[i] != '\0'; i++)
+    {
+        c = str[i];
+        str[i] = ascii_to_ebcdic[c];
+    }
+
+    return str;
+}
+
+/*-------------------------------------------------------------------*/
+/* SUBROUTINE TO TRANSLATE A NULL-TERMINATED STRING TO ASCII         */
+/*-------------------------------------------------------------------*/
+char *translate_to_ascii (unsigned char *str)
+{
+int     i;                              /* Array subscript           */
+unsigned char c;                        /* Character work area       */
+
+    for (i = 0; str[i] != '\0'; i++)
+    {
+        c = str[i];
+        str[i] = ebcdic_to_ascii[c];
+    }
+
+    return str;
+}
@@ -0,0 +1,416 @@
+//  librje80 - the IBM 2780/3780 RJE station engine behind rje80.
+//
+//  All of the state for one bisync line lives in a struct rje_session, so a
+//  program can run as many lines as it likes.  Nothing here blocks: the
+//  caller starts things (rje_open, rje_signon) or queues work (rje_submit,
+//  rje_command, rje_queue) and then calls rje_poll regularly, which
+//  services the line for at most the time it's given, sends queued work
+//  whenever the line is ours, and reports what happened through rje_event.
+//
+//  Messages meant for the operator (and printer output that isn't going
+//  to a file) are passed to the session's msgfn, received records to its
+//  recfn.  Both are optional.  So are cardfn, which supplies the cards
+//  for SEND * (returning 1 while the next one isn't ready), and busyfn,
+//  which says when whatever takes the host's output has fallen behind so
+//  the host can be held off with WACK.
+//
+//  Every JOB card sent is followed through to its output (see rjejobs),
+//  RJE_EV_JOB saying when the output is in.
+//
+//  The line is normally a TCP connection to a Hercules 2703, but it can be
+//  anything the caller gives waitfn, readfn and writefn for, and the clock
+//  can be replaced with rje_set_clock: rjesim uses both to run sessions
+//  against a simulated host in simulated time.
+//
+//  Each line keeps histograms of how long the host takes to answer (see
+//  RJE_LAT_xxx), for telling a slow host from a slow line or a slow us.
+
+#ifndef LIBRJE80_H
+#define LIBRJE80_H
+
+#include <stdio.h>
+
+#include "rjeforms.h"
+#include "rjereader.h"
+#include "rjehasp.h"
+#include "rjehist.h"
+#include "rjejobs.h"
+#include "rjesink.h"
+#include "rjeindex.h"
+#include "rjedeck.h"
+
+// Status values for overall status flag
+
+#define NOLINK -1		/*  not connected, not yet trying */
+#define INITIAL_WAIT 0		/*  Connected waiting for signon command */
+#define IDLE 1			/*  Connected, signed on, idle */
+#define SENDING 5		/*  Data being sent to host */
+#define RECEIVING 6		/*  data being received from host */
+#define MULTILEAVE 7		/*  signed on as a multileaving workstation */
+#define SHUTDOWN 9		/*  emulator shutdown */
+
+// What a transmission to the host is carrying
+
+#define XMIT_NONE 0		/* nothing to send */
+#define XMIT_SIGNON 1		/* the signon card */
+#define XMIT_CMD 2		/* an operator command */
+#define XMIT_FILE 3		/* a deck from the reader */
+
+// Where a transmission is in the bid / text / ack cycle
+
+#define XS_WAIT 0		/* waiting for the line to be idle */
+#define XS_BID 1		/* ENQ sent, waiting for ACK0 */
+#define XS_TEXT 2		/* block sent, waiting for ACK */
+#define XS_HOLD 3		/* next card isn't ready, TTD to keep the line */
+
+// Events reported by rje_event
+
+#define RJE_EV_STATUS 1		/* status changed, see ev.status */
+#define RJE_EV_DONE 2		/* a transmission ended, ev.rc is 0 or -1 */
+#define RJE_EV_OUTPUT 3		/* host output started for ev.device */
+#define RJE_EV_EOT 4		/* host finished its transmission */
+#define RJE_EV_JOB 5		/* a job's output is in, ev.id its submission */
+
+#define RJE_MAXEV 64		/* events kept until the caller reads them */
+
+// Response times kept for each line, from the write that wants an answer
+// to the read that brings it
+
+#define RJE_LAT_BID 0		/* our ENQ to the host's answer */
+#define RJE_LAT_BLOCK 1		/* our block to its ACK (or WACK, NAK) */
+#define RJE_LAT_POLL 2		/* idle poll to the host's answer */
+#define RJE_LAT_TURN 3		/* line changes hands to the first block */
+				/* the other way (or ACK0 to our bid) */
+#define RJE_LAT_KINDS 4
+
+// Work waiting for the line.  The highest priority goes first, and
+// equal priorities in the order they were queued.
+
+#define RJE_MAXQ 64		/* submissions waiting */
+#define RJE_PRIO_FILE 4		/* default priority of a deck */
+#define RJE_PRIO_CMD 8		/* ... and of an operator command */
+
+struct rje_job {
+	int id;			/* submission id */
+	int kind;		/* XMIT_CMD or XMIT_FILE */
+	int prio;		/* 0 (lowest) to 9 */
+	char file[80];		/* deck, * = cardfn */
+	int fmt;		/* RDR_xxx */
+	int recl;		/* card length */
+	char text[128];		/* command, with its prefix */
+};
+
+// One device stream of a multileaving workstation
+
+#define RJE_ML_STREAMS 4	/* readers, printers and punches, each */
+#define RJE_ML_CTL 16		/* control records waiting to go */
+
+#define ML_IDLE 0		/* not in use */
+#define ML_ASKED 1		/* reader: waiting for the host's go ahead */
+#define ML_ACTIVE 2		/* sending or receiving */
+
+// A print file's page index (SET PAGES): a file of its own beside it,
+// name.pages, of one rje_page for each page, so page n is record n - 1
+
+#define RJE_PAGE_OUTPUT 1	/* the first page of an output (a job) */
+
+struct rje_page {
+	long long offset;	/* where it starts in the print file */
+	unsigned int line;	/* its first line (record), from 1; 0 = none */
+	unsigned int flags;	/* RJE_PAGE_xxx */
+};
+
+struct rje_pages {
+	FILE *fd;		/* NULL = no index being kept */
+	long long bytes;	/* in the print file so far */
+	unsigned int lines;	/* ... and lines (records) */
+	int next;		/* a page starts with the next line */
+	int held;		/* ... with the held machine format line */
+};
+
+struct rje_mlstream {
+	int state;		/* ML_xxx */
+	int count;		/* records so far */
+	char file[80];		/* the deck, or where output goes */
+
+	// Readers
+
+	int id;			/* submission id */
+	int recl;		/* card length */
+	struct rje_reader rdr;	/* the deck, unless it's * (cardfn) */
+	unsigned char card[RDR_MAXRECL];	/* card that missed the last block */
+	int cardlen;
+	int eof;		/* deck read, the end record is to go */
+
+	// Printers and punches after the first (the first uses the
+	// session's PRINT and PUNCH)
+
+	int action;		/* ESC action before the next line */
+	FILE *fd;
+	struct rje_sink *sink;	/* when the name is a |command */
+	struct rje_pages pages;
+	int open;
+	unsigned char hold[RJE_FORMS_MAX + 1];
+	int held;
+};
+
+// How long the session waits for the host (milliseconds), and how often
+// it tries, before giving up.  rje_new fills in the defaults; change them
+// directly or with rje_set_timing.
+
+struct rje_timing {
+	long bid_wait;		/* reply to our ENQ */
+	long signon_wait;	/* ... when signing on */
+	long text_wait;		/* reply to a block */
+	long poll_time;		/* between polls of an idle line */
+	long bid_tries;		/* ENQs before giving up */
+	long signon_tries;	/* ... when signing on */
+	long nak_tries;		/* NAKs of one block before giving up */
+	long wack_wait;		/* before the ENQ after a WACK, doubling */
+	long wack_max;		/* ... up to this */
+	long wack_tries;	/* WACKs in a row before giving up */
+	long ttd_time;		/* next card late this long: send TTD */
+};
+
+// Output arriving on one printer or punch, and the job it's for
+
+struct rje_jobout {
+	int active;		/* receiving */
+	int lines;		/* records so far */
+	long start;		/* when the first came */
+	struct rje_jobrec *job;	/* NULL = not known (yet) */
+};
+
+struct rje_event {
+	int type;		/* RJE_EV_xxx */
+	int status;		/* session status when it happened */
+	int kind;		/* XMIT_xxx for RJE_EV_DONE */
+	int id;			/* submission id for RJE_EV_DONE */
+	int rc;			/* 0 = ok, -1 = failed */
+	int device;		/* 0 = printer 1 = punch */
+};
+
+struct rje_session {
+	int status;		/* Emulator overall status */
+	int transparent;	/* 1 when in transparent mode */
+	int debugit;		/* show line data on the console */
+	char inethost[128];	/* Internet host */
+	int inetport;		/* Internet port */
+	char hname[128];	/* given host name, as long as inethost */
+	int host_ip;
+	int sockfd;		/* The socket itself */
+
+	int pollflag;		/* Polling control */
+	long polltime;		/* when we last polled */
+	unsigned char lastack;	/* To flip between ACK0 and ACK1 */
+	int gotdle;		/* receive: last char was DLE */
+	int gotstx;		/* receive: last char was STX */
+	int rvi_sent;		/* receive: we've asked for the line */
+	int wack_sent;		/* receive: we WACKed, the host will ENQ */
+
+	// Reader, printer and punch
+
+	char reader[80];	/* Reader filename being sent, * = cardfn */
+	int reader_recl;	/* record length for new submissions */
+	int reader_fmt;		/* RDR_xxx for new submissions */
+	char print[80];		/* Print filename, empty = msgfn */
+	int print_recl;		/* max printer width */
+	int print_fmt;		/* 0=text 1=ASA 2=machine 3=FBA 4=VBA */
+	unsigned char print_hold[RJE_FORMS_MAX + 1];	/* machine: line waiting */
+	int print_held;		/* ... for the next line's control */
+	struct rje_forms forms;	/* Tab stops from the host */
+	char punch[80];		/* Punch filename */
+	int punch_recl;		/* Punch recl (used for ebcdic only) */
+	int punch_fmt;		/* 0=ascii 1=ebcdic (FB) 2=VB */
+	int device_select;	/* 0 = printer 1 = punch */
+	int print_open;		/* need to open = 1 */
+	int punch_open;
+	FILE *printfd;		/* FDs for files */
+	FILE *punchfd;
+	struct rje_sink *print_sink;	/* ... or pipes, for a |command */
+	struct rje_sink *punch_sink;
+	struct rje_sink sinks[RJE_SINKS];
+	struct rje_pages pages;	/* the print file's page index */
+	struct rje_reader rdr;	/* the deck being sent */
+	FILE *tracefd;
+	char tracefile[80];
+	struct rje_index *index;	/* print output's words, NULL = not kept */
+	char indexfile[80];
+	struct rje_decks *decks;	/* decks made into cards, NULL = none;
+				   the caller's, and can be shared */
+
+	// Options
+
+	char opt_user[32];	/* Username */
+	int opt_poll;		/* Poll when idle */
+	int opt_trn;		/* Transparency on all writes */
+	int opt_pause;		/* -1 = every FF, 0 = none, > 0 = pause */
+	int opt_copy;		/* 1 = display printer output, 0 = no disp */
+	int opt_os;		/* 0 = generic */
+				/* 1 = VM/370 RSCS */
+				/* 2 = JES2 */
+				/* 3 = JES3 */
+				/* 4 = DOS/VS */
+				/* 5 = RES (VS1) */
+				/* 6 = OS/360 */
+	int opt_ckpt;		/* 0 = no send checkpoints */
+				/* 1 = resume if host OS allows */
+				/* 2 = always resume */
+				/* 3 = always restart */
+	int opt_rvi;		/* RVI the host for queued work of this */
+				/* priority or more, 0 = never */
+	int opt_batch;		/* most decks sent in one transmission, */
+				/* if the host OS takes them; 0 = one */
+	int opt_wack;		/* WACK host output while busyfn says */
+				/* we're behind */
+	int opt_ml;		/* sign on as a multileaving workstation */
+	int opt_mlrdrs;		/* ... with this many readers */
+	int opt_pages;		/* keep a page index beside print files */
+	struct rje_timing tm;	/* timeouts and retry limits */
+
+	// Send checkpoint
+
+	FILE *ckptfd;		/* Send checkpoint file */
+	char ckptfile[96];	/* Checkpoint filename (reader + .ckp) */
+	long ckpt_size;		/* Reader size and mtime when checkpointed */
+	long ckpt_mtime;
+
+	// The transmission in progress
+
+	int xmit;		/* XMIT_xxx */
+	int xmit_state;		/* XS_xxx */
+	int xmit_id;		/* submission id */
+	int xmit_recl;		/* card length */
+	int xmit_prio;		/* its priority */
+	int xmit_decks;		/* decks sent in this transmission */
+	int xmit_retry;		/* ENQs or NAKs so far */
+	int xmit_wack;		/* WACKs in a row from the host */
+	int xmit_held;		/* ... waiting to ENQ again after one */
+	int xmit_ttd;		/* TTD sent, waiting for the NAK */
+	long xmit_timer;	/* when the reply is due */
+	int xmit_count;		/* records ACKed */
+	int xmit_show;		/* records since the last progress message */
+	long xmit_pos;		/* reader offset of the card being read */
+	long xmit_endpos;	/* ... and after it */
+	long xmit_ackpos;	/* ... of the card in line_out */
+	unsigned char savebuf[RDR_MAXRECL];	/* card held back for a VM ID card */
+	int savelen;
+	char xmit_text[128];	/* command or signon card */
+	int next_id;		/* last submission id handed out */
+
+	// Submissions waiting for the line
+
+	struct rje_job queue[RJE_MAXQ];
+	int nqueue;
+
+	// Multileaving
+
+	int ml;			/* this signon is multileaving */
+	int ml_bcbout;		/* count in our next block */
+	int ml_bcbin;		/* ... and the one due from the host */
+	unsigned char ml_fcs[2];	/* host's FCS: what we may send */
+	int ml_fcsout;		/* ... and the first byte of our last one */
+	unsigned char ml_ctl[RJE_ML_CTL][2];	/* control records to send */
+	int ml_nctl;
+	int ml_turn;		/* the host is waiting for us */
+	long ml_timer;		/* when we answer, or hear back */
+	int ml_retry;		/* sends of our last block */
+	int ml_inblk;		/* receive: in a block, 2 = transparent */
+	int ml_dle;		/* ... last char was DLE */
+	unsigned char ml_in[1024];	/* ... the block */
+	int ml_inlen;
+	struct rje_mlstream ml_rdr[RJE_ML_STREAMS];
+	struct rje_mlstream ml_prt[RJE_ML_STREAMS];
+	struct rje_mlstream ml_pun[RJE_ML_STREAMS];
+
+	// Response times
+
+	long long lat_wrote;	/* when write_buffer last sent */
+	long long lat_read;	/* ... and get_buffer last read, us */
+	long long lat_start[RJE_LAT_KINDS];	/* waiting since, 0 = not */
+	struct rje_hist lat[RJE_LAT_KINDS];
+	long stat_retries;	/* blocks and bids sent again, all told */
+	long stat_wacks;	/* ... and WACKs from the host */
+
+	// Jobs sent, and where their output is
+
+	struct rje_jobs jobs;
+	struct rje_jobout job_out[2][RJE_ML_STREAMS];	/* printers, punches */
+	int out_stream;		/* the one write_record is writing for, 0 = 1 */
+
+	// Communications buffers
+
+	unsigned char phybuffer[8192];	/* Raw socket data */
+	int phy_ctr;		/* Size in physical buffer */
+	unsigned char line_in[1024];	/* Input data from line */
+	int line_in_ctr;	/* How many are stacked up */
+	unsigned char record_in[1024];	/* Record data */
+	int record_ctr;		/* How many bytes in record */
+	unsigned char line_out[1024];	/* Output data to be sent */
+	int line_out_size;	/* How many to actually send */
+
+	// Events not yet read by the caller
+
+	struct rje_event ev[RJE_MAXEV];
+	int ev_head;
+	int ev_tail;
+
+	// Hooks for the program using the session
+
+	int (*msgfn)(struct rje_session *s, char *msg);
+	int (*recfn)(struct rje_session *s, int device,
+		unsigned char *rec, int len);
+	int (*cardfn)(struct rje_session *s, char *card);
+	int (*busyfn)(struct rje_session *s);
+	void *user;		/* for the caller's own use */
+
+	// The line, when it isn't a socket (see rje_attach).  waitfn
+	// waits up to msec for something to read, returning 1 if there
+	// is; readfn returns what it read, 0 if the line's gone; writefn
+	// returns what it wrote.
+
+	int (*waitfn)(struct rje_session *s, long msec);
+	int (*readfn)(struct rje_session *s, unsigned char *buf, int len);
+	int (*writefn)(struct rje_session *s, unsigned char *buf, int len);
+	void *lineio;		/* for their use */
+};
+
+// Session life cycle
+
+int rje_init();
+int rje_term();
+struct rje_session *rje_new();
+int rje_free(struct rje_session *s);
+
+// Line operations - these start things, rje_poll finishes them
+
+int rje_open(struct rje_session *s, char *host, int port);
+int rje_attach(struct rje_session *s, char *name);
+int rje_close(struct rje_session *s);
+int rje_signon(struct rje_session *s, char *user, char *password);
+int rje_queue(struct rje_session *s, int kind, char *text, int prio);
+int rje_submit(struct rje_session *s, char *file);
+int rje_command(struct rje_session *s, char *cmd);
+int rje_cancel(struct rje_session *s, int id);
+int rje_poll(struct rje_session *s, int msec);
+int rje_event(struct rje_session *s, struct rje_event *ev);
+int rje_trace(struct rje_session *s, char *file);
+int rje_output_close(struct rje_session *s, int dev);
+int rje_set_index(struct rje_session *s, char *file);
+int rje_can_resume(struct rje_session *s);
+int rje_can_batch(struct rje_session *s);
+int rje_latency_dump(struct rje_session *s, FILE *fd);
+int rje_latency_reset(struct rje_session *s);
+int rje_set_timing(struct rje_session *s, char *name, long value);
+
+// Utilities
+
+long rje_clock();
+long long rje_uclock();
+int rje_set_clock(long long (*fn)());
+int rje_msg(struct rje_session *s, char *msg);
+int rje_deck_peek(char *file, int fmt, int recl, char text[][81], int n);
+char *translate_to_ebcdic (unsigned char *str);
+char *translate_to_ascii (unsigned char *str);
+
+#endif
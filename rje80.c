@@ -1,6 +1,19 @@
 //  A program to emulate an IBM 2780/3780 RJE station over a simulated
 //  bisync line using the BSC protocol as implemented by the Hercules/370 2703
 //  device.  This program will not work with "real" bisync hardware.
+//
+//  This is the interactive front end.  The line itself is run by the
+//  librje80 engine (librje80.c, rjeforms.c, rjereader.c, rjehasp.c,
+//  rjehist.c, rjejobs.c, rjesink.c, rjeindex.c, rjeroute.c, rjectl.c,
+//  rjedeck.c),
+//  build with:
+//
+//      cc -o rje80 rje80.c librje80.c rjeforms.c rjereader.c rjehasp.c rjehist.c rjejobs.c rjesink.c rjeindex.c rjeroute.c rjectl.c rjedeck.c -lpthread
+//
+//  It can have lines to several hosts at once (HOST), each a session of
+//  its own with its own options; commands go to the current one, and
+//  SEND can pick the host for each deck by its routes (ROUTE).  Other
+//  programs can use the lines too, through a control socket (CONTROL).
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -12,40 +25,63 @@
 #include <signal.h>
 #include <windows.h>
 #else					// Linux
-#include <sys/socket.h>
-#include <netinet/in.h>
-#include <arpa/inet.h>
 #include <termios.h>
-#include <netdb.h>
 #include <time.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <ctype.h>
 #include <string.h>
+#include <glob.h>
+#include <sys/select.h>
 #endif
 #include <errno.h>
 
+#include "librje80.h"
+#include "rjeroute.h"
+#include "rjectl.h"
+
+#define CLI_HOSTS 8		/* hosts we can have lines to */
+#define CLI_DECKS 128		/* decks passed on the control socket, not gone */
+
 // Prototypes 
 
 int do_char(unsigned char c);
-int do_input(int count);
 int execute();
 int nexttoken();
 int gettoken(int upper);
-int InitSockets();
-int CloseSockets();
-int connecthost();
-int send_file(char *command);
-int get_buffer();
-unsigned char read_byte();
-int read_poll(int sec, int usec);
-int read_data(int sec, int usec, int mode);
-int clear_input_buffer();
-int clear_input_record();
-int write_record();
-int printer_function(unsigned char func);
-int write_buffer();
-int send_ack(char ack);
+int getpipe(char *cmd);
+int cli_fmt(char *name);
+int cli_msg(struct rje_session *s, char *msg);
+int cli_card(struct rje_session *s, char *card);
+int cli_busy(struct rje_session *s);
+int cli_events();
+int cli_wait(int id);
+int show_print();
+int show_queue();
+int show_streams();
+int show_times();
+int show_jobs(int all);
+int show_classes();
+int show_found(char *words);
+int cli_found(struct rje_idxhit *h, void *arg);
+int cli_queued(struct rje_session *s, int id);
+int cli_poll(int msec);
+int cli_newhost(char *name);
+int cli_hostnum(char *name);
+int cli_hostof(struct rje_session *s);
+struct rje_session *cli_route(char *file, int fmt, int recl, char *tag,
+	char *host, char *why);
+int cli_send(struct rje_session *s, char *file, int fmt, int recl, int prio);
+int show_hosts();
+int show_routes();
+int show_cache();
+int cli_cache(long size, char *dir);
+int cli_request(struct rje_ctl *c, int n, char *req);
+int cli_tell(int h, struct rje_event *ev);
+int cli_deckdone(struct rje_session *s, int id);
+char *cli_state(int status);
+char *cli_word(char *p, char *word, int max);
+int cli_files(char *pattern, char list[][80], int n, int max);
 int ttyinit();
 int ttyclose();
 int ttygets(char *str);
@@ -53,28 +89,28 @@ int ttyread(unsigned char *buf);
 int ttychar(char c);
 int ttystr(char *msg);
 int rjesleep(int t);
-char *translate_to_ebcdic (unsigned char *str);
-char *translate_to_ascii (unsigned char *str);
 
 // Global control items
 
-// Status values for overall status flag
-
-#define NOLINK -1		/*  not connected, not yet trying */
-#define INITIAL_WAIT 0		/*  Connected waiting for signon command */
-#define IDLE 1			/*  Connected, signed on, idle */
-#define SENDING 5		/*  Data being sent to host */
-#define RECEIVING 6		/*  data being received from host */
-#define SHUTDOWN 9		/*  emulator shutdown */
-
-int status = NOLINK;		/* Emulator overall status */
-
-int transparent = 0;		/* 1 when in transparent mode */
+struct rje_session *rs;		/* The line we're running */
+
+struct cli_host {
+	char name[9];
+	struct rje_session *s;
+} hosts[CLI_HOSTS];		/* ... one of these */
+int nhosts = 0;
+struct rje_routes routes;	/* where SEND sends each deck */
+struct rje_session *said = NULL;	/* cli_msg: the line last heard from */
+
+struct rje_ctl ctl;		/* the control socket */
+struct cli_deck {
+	struct rje_session *s;	/* NULL = free */
+	int id;
+	int fd;
+} decks[CLI_DECKS];		/* ... decks passed on it, open till they've gone */
+struct rje_decks *deckcache = NULL;	/* CACHE: decks made into cards, for
+					   every host */
 
-int debugit = 0;		/* debug flag, set by -d on command */
-		
-char inethost[128];		/* Internet host (from command line) */
-int inetport;			/* Internet port (ditto) */				
 char macro[8192];		/* The macro buffer */
 int macro_size = 0;		/* Size of macro in biffer */
 int macro_ctr = 0;		/* chars in macro buffer */
@@ -83,186 +119,116 @@ char token[64];			/* A token from the command */
 int comctr;			/* used by the parser */
 int comlen = 0;			/* Length of command */
 int prompt = 0;			/* Prompt flag */
-int pollflag = 2;		/* Polling control */
-int pollctr = 0;
-unsigned char lastack = 0;	/* To flip between ACK0 and ACK1 */
-char reader[80];		/* Reader filename */
-int reader_recl = 80;		/* record length */
-int reader_fmt = 0;		/* 0=ascii 1=ebcdic */
-char print[80];			/* Print filename */
-int print_recl = 132;		/* max printer width */
-char htabs[256];		/* Horizontal tabs storage */
-char punch[80];			/* Punch filename */
-int punch_recl = 80;		/* Punch recl (used for ebcdic only) */
-int punch_fmt = 0;		/* 0=ascii 1=ebcdic */
-int punchform = 0;		/* Punch format 0=ascii 1=ebcdic */
-int readform = 0;		/* Reader format 0=ascii 1=ebcdic */
-int device_select = 0;		/* 0 = printer 1 = punch */
-
-int print_open = 0;		/* need to open = 1 */
-int punch_open = 0;
-
-FILE *printfd;			/* FDs for files */
-FILE *punchfd;
-FILE *readerfd;
-FILE *tracefd;
+int waitid = 0;			/* cli_wait: submission waited for */
+
 FILE *rcfd;
 
-char tracefile[80];
-
-char opt_user[32];		/* Username */
-int opt_poll = 1;		/* Poll when idle  TODO: was 0*/
-int opt_trn = 1;		/* Transparency on all writes TODO: was 0*/
-int opt_pause = 0;		/* -1 = every FF, 0 = none, > 0 = pause */
-int opt_copy = 1;		/* 1 = display printer output, 0 = no disp */
-int opt_os = 2;			/* 0 = generic  TODO: was 0*/
-				/* 1 = VM/370 RSCS */
-				/* 2 = JES2 */
-				/* 3 = JES3 */
-				/* 4 = DOS/VS */
-				/* 5 = RES (VS1) */
-				/* 6 = OS/360 */
 // TTY-related data
 
 unsigned char ttybuf[1];
+int ttyfd = 0;			/* the keyboard, -1 = none */
 #if defined (_WIN32)
 #else
 struct termios cmdtty, runtty;
 #endif
 
-// Socket-related stuff
-
-int sockfd;			/* The socket itself */
-char hname[80];			/* given host name */
-int host_ip;
-int inport;			/* our input port */
-int outport;			/* the hosts port */
-
-// Communications buffers
-
-unsigned char phybuffer[8192];	/* Raw socket data */
-int phy_ctr = 0;		/* Size in physical buffer */
-unsigned char line_in[1024];	/* Input data from line */
-int line_in_ctr = 0;		/* How many are stacked up */
-unsigned char record_in[1024];	/* Record data */
-int record_ctr = 0;		/* How many bytes in record */
-unsigned char line_out[1024];	/* Output data to be sent */
-int line_out_size = 0;		/* How many to actually send */
-char signon[80];		/* we build this */
-
-// BSC control characters
-
-unsigned char SOH = 0x01;
-unsigned char STX = 0x02;
-unsigned char ETX = 0x03;
-unsigned char DLE = 0x10;
-unsigned char DC1 = 0x11;
-unsigned char DC2 = 0x12;
-unsigned char NL  = 0x15;
-unsigned char EM  = 0x19;
-unsigned char IGS = 0x1d;
-unsigned char IRS = 0x1e;
-unsigned char ITB = 0x1f;
-unsigned char ETB = 0x26;
-unsigned char ESC = 0x27;
-unsigned char ENQ = 0x2d;
-unsigned char SYN = 0x32;
-unsigned char EOT = 0x37;
-unsigned char NAK = 0x3d;
-unsigned char DC3 = 0x5d;
-unsigned char ACK1 = 0x61;
-unsigned char WABT = 0x6b;
-unsigned char ACK0 = 0x70;
-unsigned char EPAD = 0xff;
-unsigned char SPAD = 0xaa;
-unsigned char RVI = 0x7c;
-
-// Translation tables (from Hercules)
-
-static unsigned char
-ascii_to_ebcdic[] = {
-    "\x00\x01\x02\x03\x37\x2D\x2E\x2F\x16\x05\x25\x0B\x0C\x0D\x0E\x0F"
-    "\x10\x11\x12\x13\x3C\x3D\x32\x26\x18\x19\x1A\x27\x22\x1D\x35\x1F"
-    "\x40\x5A\x7F\x7B\x5B\x6C\x50\x7D\x4D\x5D\x5C\x4E\x6B\x60\x4B\x61"
-    "\xF0\xF1\xF2\xF3\xF4\xF5\xF6\xF7\xF8\xF9\x7A\x5E\x4C\x7E\x6E\x6F"
-    "\x7C\xC1\xC2\xC3\xC4\xC5\xC6\xC7\xC8\xC9\xD1\xD2\xD3\xD4\xD5\xD6"
-    "\xD7\xD8\xD9\xE2\xE3\xE4\xE5\xE6\xE7\xE8\xE9\xAD\xE0\xBD\x5F\x6D"
-    "\x79\x81\x82\x83\x84\x85\x86\x87\x88\x89\x91\x92\x93\x94\x95\x96"
-    "\x97\x98\x99\xA2\xA3\xA4\xA5\xA6\xA7\xA8\xA9\xC0\x6A\xD0\xA1\x07"
-    "\x68\xDC\x51\x42\x43\x44\x47\x48\x52\x53\x54\x57\x56\x58\x63\x67"
-    "\x71\x9C\x9E\xCB\xCC\xCD\xDB\xDD\xDF\xEC\xFC\xB0\xB1\xB2\xB3\xB4"
-    "\x45\x55\xCE\xDE\x49\x69\x04\x06\xAB\x08\xBA\xB8\xB7\xAA\x8A\x8B"
-    "\x09\x0A\x14\xBB\x15\xB5\xB6\x17\x1B\xB9\x1C\x1E\xBC\x20\xBE\xBF"
-    "\x21\x23\x24\x28\x29\x2A\x2B\x2C\x30\x31\xCA\x33\x34\x36\x38\xCF"
-    "\x39\x3A\x3B\x3E\x41\x46\x4A\x4F\x59\x62\xDA\x64\x65\x66\x70\x72"
-    "\x73\xE1\x74\x75\x76\x77\x78\x80\x8C\x8D\x8E\xEB\x8F\xED\xEE\xEF"
-    "\x90\x9A\x9B\x9D\x9F\xA0\xAC\xAE\xAF\xFD\xFE\xFB\x3F\xEA\xFA\xFF"
-};
-
-static unsigned char
-ebcdic_to_ascii[] = {
-    "\x00\x01\x02\x03\xA6\x09\xA7\x7F\xA9\xB0\xB1\x0B\x0C\x0D\x0E\x0F"
-    "\x10\x11\x12\x13\xB2\x0A\x08\xB7\x18\x19\x1A\xB8\xBA\x1D\xBB\x1F"
-    "\xBD\xC0\x1C\xC1\xC2\x0A\x17\x1B\xC3\xC4\xC5\xC6\xC7\x05\x06\x07"
-    "\xC8\xC9\x16\xCB\xCC\x1E\xCD\x04\xCE\xD0\xD1\xD2\x14\x15\xD3\xFC"
-    "\x20\xD4\x83\x84\x85\xA0\xD5\x86\x87\xA4\xD6\x2E\x3C\x28\x2B\xD7"
-    "\x26\x82\x88\x89\x8A\xA1\x8C\x8B\x8D\xD8\x21\x24\x2A\x29\x3B\x5E"
-    "\x2D\x2F\xD9\x8E\xDB\xDC\xDD\x8F\x80\xA5\x7C\x2C\x25\x5F\x3E\x3F"
-    "\xDE\x90\xDF\xE0\xE2\xE3\xE4\xE5\xE6\x60\x3A\x23\x40\x27\x3D\x22"
-    "\xE7\x61\x62\x63\x64\x65\x66\x67\x68\x69\xAE\xAF\xE8\xE9\xEA\xEC"
-    "\xF0\x6A\x6B\x6C\x6D\x6E\x6F\x70\x71\x72\xF1\xF2\x91\xF3\x92\xF4"
-    "\xF5\x7E\x73\x74\x75\x76\x77\x78\x79\x7A\xAD\xA8\xF6\x5B\xF7\xF8"
-    "\x9B\x9C\x9D\x9E\x9F\xB5\xB6\xAC\xAB\xB9\xAA\xB3\xBC\x5D\xBE\xBF"
-    "\x7B\x41\x42\x43\x44\x45\x46\x47\x48\x49\xCA\x93\x94\x95\xA2\xCF"
-    "\x7D\x4A\x4B\x4C\x4D\x4E\x4F\x50\x51\x52\xDA\x96\x81\x97\xA3\x98"
-    "\x5C\xE1\x53\x54\x55\x56\x57\x58\x59\x5A\xFD\xEB\x99\xED\xEE\xEF"
-    "\x30\x31\x32\x33\x34\x35\x36\x37\x38\x39\xFE\xFB\x9A\xF9\xFA\xFF"
-};
-
 // Mainline code - - start here.
 
-main(int argc, char *argv[])
+int main(int argc, char *argv[])
 {
-	int stat, i, rstat;
-	int tries = 0;
+	int stat, i, rc;
 	int startar = 1;
-	int gotdle = 0;
-	int gotstx = 0;
-	unsigned char buf[1], ch, sho[16];
+	int debugit = 0;
+	int inetport = 0;
+	char inethost[128];
+	unsigned char buf[1];
+	char sends[RJE_MAXQ][80];	/* --send decks, and their formats */
+	char control[108];
+	char cache[80];
+	int sendfmt[RJE_MAXQ];
+	int nsends = 0;
 
 	strcpy(inethost, "");
-	strcpy(opt_user, "");
-	strcpy(tracefile, "");
+	strcpy(control, "");
+	strcpy(cache, "");
+	ctl.fd = -1;
+	ctl.reqfn = cli_request;
 
-	if (argc > 1) {
-		if (strcmp(argv[1], "-d") == 0) {
+	while (argc > startar && argv[startar][0] == '-') {
+		if (strcmp(argv[startar], "-d") == 0) {
 			printf("We are in debug mode.\n");
 			debugit = 1;
-			startar = 2;
+		} else if (strcmp(argv[startar], "--send") == 0 &&
+			argc > startar + 1 && nsends < RJE_MAXQ) {
+			startar++;
+			strncpy(sends[nsends], argv[startar], 79);
+			sends[nsends][79] = 0;
+			sendfmt[nsends] = RDR_ASCII;
+			if (argc > startar + 1 && cli_fmt(argv[startar + 1]) >= 0)
+				sendfmt[nsends] = cli_fmt(argv[++startar]);
+			if (strcmp(sends[nsends], "-") == 0 && isatty(0)) {
+				printf("RJE241A --send - sends what's piped into rje80, "
+					"and nothing is.\n");
+				return (1);
+			}
+			nsends++;
+		} else if (strcmp(argv[startar], "--control") == 0 &&
+			argc > startar + 1) {
+			startar++;
+			strncpy(control, argv[startar], sizeof(control) - 1);
+		} else if (strcmp(argv[startar], "--cache") == 0 &&
+			argc > startar + 1) {
+			startar++;
+			strncpy(cache, argv[startar], sizeof(cache) - 1);
+		} else {
+			printf("Usage: rje80 [-d] [--send file|- [format]] ... "
+				"[--control socket] [--cache dir] [host [port]]\n");
+			return (1);
 		}
-		if (argc >= startar) {
+		startar++;
+	}
+#if !defined (_WIN32)
+	for (i = 0; i < nsends; i++) {
+		if (strcmp(sends[i], "-") == 0 && ttyfd == 0)
+			ttyfd = open("/dev/tty", O_RDWR);	/* stdin is the deck */
+	}
+#endif
+	if (argc > 1) {
+		if (argc > startar) {
 			strcpy(inethost, argv[startar]);
 			startar++;
 		}
-		if (argc >= startar) {	
+		if (argc > startar) {	
 			inetport=atoi(argv[startar]);
-			outport = inetport;
 		}	
 	}		
 
 	ttyinit();
 	ttystr("\r\nRJE80 IBM 3780 Emulator Version 0.29");
-	strcpy(print, "");	/* default output files to display */
-	strcpy(punch, "punch.txt");
 
-	if (InitSockets() == -1) {
-		status = SHUTDOWN;
+	if (strlen(cache) > 0)
+		cli_cache(0, cache);
+	cli_newhost("MAIN");
+	rs = hosts[0].s;
+	rs->debugit = debugit;
+
+	if (rje_init() == -1) {
+		rs->status = SHUTDOWN;
 	}
 
 	if (strlen(inethost) > 0 &&
-		status != SHUTDOWN) {	/* host given in command line ? */
-		connecthost();		/* YEAH */
+		rs->status != SHUTDOWN) {	/* host given in command line ? */
+		rje_open(rs, inethost, inetport);	/* YEAH */
 	}	
+	if (strlen(control) > 0 && rje_ctl_open(&ctl, control) != 0)
+		printf("RJE260S Can't listen on %s, is another rje80 using it?\n",
+			control);
+	for (i = 0; i < nsends; i++) {		/* they go once signed on */
+		rs->reader_fmt = sendfmt[i];
+		rc = rje_queue(rs, XMIT_FILE, sends[i], RJE_PRIO_FILE);
+		if (rc > 0)
+			cli_queued(rs, rc);
+	}
 
 	// See if there's an rje80.rc file, if so, read it and stuff the
 	// characters in it into the macro buffer
@@ -282,13 +248,15 @@ main(int argc, char *argv[])
 	// This is the main loop.  It cycles continuously, looking for 
 	// events to process.  Events such as a character from the local
 	// keyboard, data arriving on the communications socket, or 
-	// a timer expiring.
+	// a timer expiring.  The line itself is looked after by rje_poll.
 	
-	while (status != SHUTDOWN) {
+	while (rs->status != SHUTDOWN) {
 		if (!prompt) {			/* Need a new prompt? */
 			for (i=0; i < 128; i++) command[i] = 0;
 			ttychar('\n');
 			ttychar('\r');
+			if (nhosts > 1)
+				ttystr(hosts[cli_hostof(rs)].name);
 			ttychar(')');
 			ttychar(' ');
 			prompt = 1;
@@ -298,232 +266,956 @@ main(int argc, char *argv[])
 		if (stat) {
 			do_char(buf[0]);
 		}
-		if (status == IDLE) {
-			if (read_poll(0, 10000) == 1) { /* Have data? */
-				read_data(3, 0, 0);		/* Yes -- go get it */
-				while (ch = read_byte()) {	/* Process data */
-					if (ch == ENQ) {	/* he wants to send us something */
-						prompt = 1;		
-						pollflag = 0;
-						status = RECEIVING;
-						clear_input_record();
-						lastack = ACK0;
-						send_ack(ACK0);
-						continue;
-					}
-					if (ch == EPAD || ch == SYN) {	/* fillers - ignore */
-						continue;
-					}	
-					if (ch == DLE) {	/* Probably poll response */
-						pollflag = 1;
-						continue;
-					}
-					if (ch == ACK0 || ch == ACK1) {	/* it is a poll response */
-						pollflag = 2;	/* set up to poll again */
-						continue;
-					}
-					// WE don't know what it is ...
-					// Ignore it for now ...
-					if (debugit == 1) {
-						ttystr("\r\nOdd data found: ");
-						sprintf(sho, "%2x", ch);
-						ttystr(sho);
-						ttystr("\r\n");
-					}
-				}
-			} else {	// no data .. so, we consider polling
-				if (pollflag == 2 && pollctr > 50) {
-					if (opt_poll) {
-						line_out[0] = line_out[1] = line_out[2] = DLE;
-						line_out[3] = ACK0;
-						line_out_size = 4;
-						write_buffer();
-					}
-					pollctr = 0;
-				} else {
-					pollctr++;
-				}
+		if (rs->status == SHUTDOWN)
+			break;
+		cli_poll(10);
+		cli_events();
+	}
+
+	rje_ctl_close(&ctl);
+	for (i = 0; i < CLI_DECKS; i++) {
+		if (decks[i].s != NULL)
+			close(decks[i].fd);
+	}
+	for (i = 0; i < nhosts; i++)
+		rje_free(hosts[i].s);
+	rje_decks_close(deckcache);
+	rje_term();
+	ttyclose();
+	printf("Goodbye...\n");
+	return (0);
+}
+
+// Messages from the line, and printer output bound for the screen
+
+int cli_msg(struct rje_session *s, char *msg)
+{
+	char wstr[32];
+
+	if (nhosts > 1 && s != said) {		/* say who it's from */
+		sprintf(wstr, "\r\n[%s]", hosts[cli_hostof(s)].name);
+		ttystr(wstr);
+	}
+	said = s;
+	ttystr(msg);
+	return (0);
+}
+
+// A format name as typed, in any case, to RDR_xxx or -1
+
+int cli_fmt(char *name)
+{
+	char upper[16];
+	int i;
+
+	for (i = 0; name[i] != 0 && i < sizeof(upper) - 1; i++)
+		upper[i] = toupper((unsigned char) name[i]);
+	upper[i] = 0;
+	return (rje_reader_fmt(upper));
+}
+
+// Cards for SEND * come from the keyboard.  The line is put together a
+// key at a time, so the link keeps running while it's typed; until the
+// end of it is in, say it isn't ready (1).
+
+int cli_card(struct rje_session *s, char *card)
+{
+	static char line[RDR_MAXRECL + 2];
+	static int n = 0;
+	unsigned char buf[1];
+
+	while (ttyread(buf)) {
+		if (buf[0] == '\b' || buf[0] == 0x7f) {
+			if (n > 0) {
+				ttystr("\b \b");
+				n--;
 			}
+			continue;
 		}
-		if (status == RECEIVING) {
-			if (line_in_ctr < 1)
-				rstat = read_data(3, 0, 1);
-			if (rstat == -1) {
-				ttystr("\r\nRJE127S The line has disconnected.\r\n");
-				status = IDLE;
+		ttychar(buf[0]);
+		if (buf[0] == '\n' || buf[0] == '\r' || buf[0] == '\004') {
+			ttystr("\r\n");
+			line[n++] = buf[0];
+			line[n] = 0;
+			strcpy(card, line);
+			n = 0;
+			return (0);
+		}
+		if (n < RDR_MAXRECL)
+			line[n++] = buf[0];
+	}
+	return (1);
+}
+
+// Is the terminal behind with what we've given it?  Then the host is held
+// off (WACK) until it catches up.
+
+int cli_busy(struct rje_session *s)
+{
+#if defined (_WIN32)
+	return (0);
+#else
+	struct timeval tv;
+	fd_set writefdset;
+
+	tv.tv_sec = 0;
+	tv.tv_usec = 0;
+	FD_ZERO(&writefdset);
+	FD_SET(fileno(stdout), &writefdset);
+	fflush(stdout);
+	if (select(fileno(stdout) + 1, NULL, &writefdset, NULL, &tv) == 0)
+		return (1);
+	return (0);
+#endif
+}
+
+// Look at what happened on the lines.  While a host is sending we hold
+// the prompt back, and give a fresh one when it's done.  Returns the
+// result of the last transmission that ended on the current line.
+
+int cli_events()
+{
+	struct rje_event ev;
+	int i, rc = 0;
+
+	for (i = 0; i < nhosts; i++) {
+		while (rje_event(hosts[i].s, &ev)) {
+			if (ctl.fd >= 0)
+				cli_tell(i, &ev);
+			if (ev.type == RJE_EV_DONE)
+				cli_deckdone(hosts[i].s, ev.id);
+			if (ev.type == RJE_EV_STATUS && ev.status == RECEIVING)
+				prompt = 1;
+			if (ev.type == RJE_EV_EOT)
+				prompt = 0;
+			if (hosts[i].s != rs)
 				continue;
+			if (ev.type == RJE_EV_DONE)
+				rc = ev.rc;
+			if (ev.type == RJE_EV_DONE && ev.id == waitid)
+				waitid = 0;
+		}
+	}
+	return (rc);
+}
+
+// Keep the lines going until transmission id on the current one is over
+
+int cli_wait(int id)
+{
+	int rc = 0;
+
+	waitid = id;
+	while (waitid != 0 && rs->status > NOLINK) {
+		cli_poll(10);
+		rc = cli_events();
+	}
+	waitid = 0;
+	rc |= cli_events();
+	return (rc);
+}
+
+// Run every line for up to msec: wait for whichever has something first,
+// then give each its turn.
+
+int cli_poll(int msec)
+{
+	struct timeval tv;
+	fd_set fds;
+	int i, max = -1;
+
+	FD_ZERO(&fds);
+	for (i = 0; i < nhosts && (nhosts > 1 || ctl.fd >= 0); i++) {
+		if (hosts[i].s->sockfd < 0)
+			continue;
+		FD_SET(hosts[i].s->sockfd, &fds);
+		if (hosts[i].s->sockfd > max)
+			max = hosts[i].s->sockfd;
+	}
+	max = rje_ctl_fds(&ctl, &fds, max);
+	if (max < 0)
+		return (rje_poll(rs, msec));	/* one line, or none open */
+	tv.tv_sec = msec / 1000;
+	tv.tv_usec = (msec % 1000) * 1000;
+	select(max + 1, &fds, NULL, NULL, &tv);
+	for (i = 0; i < nhosts; i++)
+		rje_poll(hosts[i].s, 0);
+	rje_ctl_poll(&ctl);
+	return (0);
+}
+
+// Tell the operator a submission is waiting, if it is
+
+int cli_queued(struct rje_session *s, int id)
+{
+	char wstr[80];
+
+	if (s->xmit != XMIT_NONE && s->xmit_id == id)
+		return (0);		/* it's going now */
+	if (nhosts > 1)
+		sprintf(wstr, "\r\nRJE196I Queued for %s as number %d, %d in the queue",
+			hosts[cli_hostof(s)].name, id, s->nqueue);
+	else
+		sprintf(wstr, "\r\nRJE196I Queued as number %d, %d in the queue", id,
+			s->nqueue);
+	ttystr(wstr);
+	if (s->status < IDLE)
+		ttystr(", to go once you SIGNON");
+	ttystr(".");
+	return (0);
+}
+
+// Add a host, a line of its own with the options a new one has.  Returns
+// its number, or -1 if there are too many.
+
+int cli_newhost(char *name)
+{
+	struct rje_session *s;
+	int i;
+
+	if (nhosts >= CLI_HOSTS || (s = rje_new()) == NULL)
+		return (-1);
+	s->msgfn = cli_msg;
+	s->cardfn = cli_card;
+	s->busyfn = cli_busy;
+	s->decks = deckcache;
+	strcpy(s->print, "");	/* default output files to display */
+	strcpy(s->punch, "punch.txt");
+	if (nhosts > 0) {	/* ... but not the same punch file */
+		s->debugit = rs->debugit;
+		sprintf(s->punch, "punch-%s.txt", name);
+		for (i = 0; s->punch[i] != 0; i++)
+			s->punch[i] = tolower((unsigned char) s->punch[i]);
+	}
+	memset(&hosts[nhosts], 0, sizeof(struct cli_host));
+	strncpy(hosts[nhosts].name, name, sizeof(hosts[nhosts].name) - 1);
+	hosts[nhosts].s = s;
+	return (nhosts++);
+}
+
+// The number of the host with this name (upper case, as they're kept),
+// or -1
+
+int cli_hostnum(char *name)
+{
+	int i;
+
+	for (i = 0; i < nhosts; i++) {
+		if (strcmp(hosts[i].name, name) == 0)
+			return (i);
+	}
+	return (-1);
+}
+
+// ... and of the one with this line
+
+int cli_hostof(struct rje_session *s)
+{
+	int i;
+
+	for (i = 0; i < nhosts; i++) {
+		if (hosts[i].s == s)
+			return (i);
+	}
+	return (0);
+}
+
+// The line a deck goes on: the host given with SEND ... HOST, else the
+// one its route names, else the current one.  NULL, and in why the
+// reason, if there's no such host.
+
+struct rje_session *cli_route(char *file, int fmt, int recl, char *tag,
+	char *host, char *why)
+{
+	int n, r = -1;
+
+	if (strlen(host) == 0) {
+		r = rje_route_find(&routes, file, fmt, recl, tag);
+		if (r < 0)
+			return (rs);
+		host = routes.route[r].host;
+	}
+	if ((n = cli_hostnum(host)) >= 0)
+		return (hosts[n].s);
+	if (r >= 0)
+		sprintf(why, "RJE253S Route %d sends %.60s to %s, and there's no host %s.",
+			r + 1, file, host, host);
+	else
+		sprintf(why, "RJE246W There's no host %.8s.", host);
+	return (NULL);
+}
+
+// Queue a deck for host s, in this format.  Returns its number, or -1.
+
+int cli_send(struct rje_session *s, char *file, int fmt, int recl, int prio)
+{
+	int savef, saver, rc;
+
+	savef = s->reader_fmt;
+	saver = s->reader_recl;
+	s->reader_fmt = fmt;
+	s->reader_recl = recl;
+	rc = rje_queue(s, XMIT_FILE, file, prio);
+	s->reader_fmt = savef;	/* SEND sets the current host's itself */
+	s->reader_recl = saver;
+	return (rc);
+}
+
+// A request on the control socket, see HELP CONTROL.  Each gets its
+// data lines, if any, then OK or ERR.
+
+int cli_request(struct rje_ctl *c, int n, char *req)
+{
+	static char *jstate[] = {"sent", "read", "ended", "output", "done"};
+	struct rje_session *s;
+	struct rje_jobrec *j;
+	char verb[16], word[RJE_CTL_LINE], host[16], tag[64], file[80];
+	char reply[RJE_CTL_LINE + 80], *p, *q;
+	int i, k, fd = -1, fmt, recl, prio, id;
+
+	for (i = strlen(req); i > 0 && (req[i - 1] == ' ' || req[i - 1] == '\t'); i--)
+		req[i - 1] = 0;
+	p = cli_word(req, verb, sizeof(verb));
+	strcpy(host, "");
+	strcpy(tag, "");
+	fmt = rs->reader_fmt;
+	recl = rs->reader_recl;
+	prio = -1;
+
+	// Options first, KEY=value
+
+	for (;;) {
+		q = cli_word(p, word, sizeof(word));
+		if (strncmp(word, "HOST=", 5) == 0) {
+			strncpy(host, word + 5, 8);
+			host[8] = 0;
+		} else if (strncmp(word, "TAG=", 4) == 0) {
+			strncpy(tag, word + 4, sizeof(tag) - 1);
+			tag[sizeof(tag) - 1] = 0;
+		} else if (strncmp(word, "PRIORITY=", 9) == 0) {
+			prio = atoi(word + 9);
+		} else if (strncmp(word, "FORMAT=", 7) == 0) {
+			if ((fmt = cli_fmt(word + 7)) < 0) {
+				rje_ctl_reply(c, n, "ERR RJE263A FORMAT= is ascii, ebcdic, fb, vb or aws.");
+				return (0);
 			}
-			ch = read_byte();
-			if (ch != 0) {
-				if (transparent) {	// Handle chars in transparent mode */
-					if (gotdle == 1 && ch == EOT) {	/* End of file */
-						if (device_select == 0 && strlen(print) != 0) {
-							ttystr("EOT\r\n");
-							prompt = 0;
-						}	
-						if (device_select == 1 && strlen(punch) != 0) {
-							ttystr("EOT\r\n");
-							prompt = 0;
-						}	
-						send_ack(0);
-						status = IDLE;
-						pollflag = 2;
-						pollctr = 0;
-						prompt = 0;
-						gotdle = gotstx = 0;
-						continue;
-					}
-					if (gotdle == 1 && ch == STX) {	/* Start of text */
-						if (gotdle)
-							transparent = 1;
-						gotstx = 1;
-						gotdle = 0;
-						continue;
-					}
-					if (gotdle == 0 && ch == DLE) {	/* DLE what follows is special */
-						gotdle = 1;
-						gotstx = 0;
-						continue;
-					}
-					if (gotdle == 1 && ch == DC1) {	/* DC1: Select printer if after an STX */
-						if (gotstx == 1) {
-							device_select = 0;
-							if (strlen(print) != 0) {
-								ttystr("\r\nRJE001I Receiving print data...");
-							} else {
-								ttystr("\r\n");
-							}
-						}
-						gotdle = gotstx = 0;
-						continue;
-					}	
-					if (gotdle == 1 && ch == DC2) {	/* DC2: Select punch if after an STX */
-						if (gotstx == 1) {
-							device_select = 1;
-							ttystr("\r\nRJE001I Receiving punch data...");
-						}
-						continue;
-					}
-					if (gotdle == 1 && ch == ETB && record_ctr > 0) {	// DOS bug, some recs have only ETB
-						write_record();
-					}
-					if (gotdle == 1 && ch == ETX) {	/* End of block -- */
-						send_ack(0);		/* Acknowledge */
-						gotdle = gotstx = 0;
-						transparent = 0;	/* transparent off */
-						continue;
-					}	
-					if (gotdle == 1 && ch == ETB) {	/* End of block -- */
-						send_ack(0);		/* Acknowledge */
-						gotdle = gotstx = 0;
-						continue;
-					}	
-					if (gotdle == 1 && (ch == IRS ||
-					    ch == NL)) {			/* End of record - write */
-						write_record();		
-						gotdle = gotstx = 0;
-						continue;	
-					}
-					if (gotdle == 1 && ch == ENQ) {
-						send_ack(0);		/* Acknowledge */
-						gotdle = gotstx = 0;
-						continue;		
-					}
-					
-					record_in[record_ctr] = ch;	/* data - save it */
-					record_ctr++;
-					gotdle = gotstx = 0;
+		} else if (strncmp(word, "RECL=", 5) == 0) {
+			recl = atoi(word + 5);
+			if (recl < 80 || recl > RDR_MAXRECL) {
+				rje_ctl_reply(c, n, "ERR RJE263A RECL= is 80 to 512.");
+				return (0);
+			}
+		} else {
+			break;
+		}
+		p = q;
+	}
+	for (i = 0; host[i] != 0; i++)
+		host[i] = toupper((unsigned char) host[i]);
+	if (strlen(host) > 0 && cli_hostnum(host) < 0 &&
+		strcmp(verb, "SUBMIT") != 0) {
+		sprintf(reply, "ERR RJE246W There's no host %s.", host);
+		rje_ctl_reply(c, n, reply);
+		return (0);
+	}
+	s = rs;			/* SUBMIT's is cli_route's to say */
+	if (strlen(host) > 0 && cli_hostnum(host) >= 0)
+		s = hosts[cli_hostnum(host)].s;
 
-				} else {
-					if (ch == EOT) {	/* End of file */
-						if (device_select == 0 && strlen(print) != 0) {
-							ttystr("EOT\r\n");
-							prompt = 0;
-						}	
-						if (device_select == 1 && strlen(punch) != 0) {
-							ttystr("EOT\r\n");
-							prompt = 0;
-						}	
-						send_ack(0);
-						status = IDLE;
-						pollflag = 2;
-						pollctr = 0;
-						prompt = 0;
-						gotdle = gotstx = 0;
-						continue;
-					}
-					if (ch == STX) {	/* Start of text */
-						if (gotdle)
-							transparent = 1;
-						gotstx = 1;
-						gotdle = 0;
-						continue;
-					}
-					if (ch == DLE) {	/* DLE what follows is special */
-						gotdle = 1;
-						gotstx = 0;
-						continue;
-					}
-					if (ch == DC1) {	/* DC1: Select printer if after an STX */
-						if (gotstx == 1) {
-							device_select = 0;
-							if (strlen(print) != 0) {
-								ttystr("\r\nRJE001I Receiving print data...");
-							} else {
-								ttystr("\r\n");
-							}
-						}
-						gotdle = gotstx = 0;
-						continue;
-					}	
-					if (ch == DC2) {	/* DC2: Select punch if after an STX */
-						if (gotstx == 1) {
-							device_select = 1;
-							ttystr("\r\nRJE001I Receiving punch data...");
-						}
-						continue;
-					}
-					if (ch == ETB && record_ctr > 0) {	// DOS bug, some recs have only ETB
-						write_record();
-					}
-					if (ch == ETX ||		/* End of block -- */
-					    ch == ETB) {
-						send_ack(0);		/* Acknowledge */
-						gotdle = gotstx = 0;
-						continue;
-					}	
-					if (ch == IRS ||
-					    ch == NL) {			/* End of record - write */
-						write_record();		
-						gotdle = gotstx = 0;
-						continue;	
-					}
-					if (ch == ENQ) {
-						send_ack(0);		/* Acknowledge */
-						gotdle = gotstx = 0;
-						continue;		
-					}
-					
-					// WHAT DO TO WITH ALL THE OTHER CONTROL CHARS?
-					// store'em, thats what ... until we know better ...
-					// NOTE: thats what we want to do with ESC sequences
-					// ...we handle them when we output the record
-
-					record_in[record_ctr] = ch;	/* data - save it */
-					record_ctr++;
-					gotdle = gotstx = 0;
-				}
+	// SUBMIT [options] [file]: a file passed with it, or by name
+
+	if (strcmp(verb, "SUBMIT") == 0) {
+		if (*p == 0) {
+			if ((fd = rje_ctl_takefd(c, n)) < 0) {
+				rje_ctl_reply(c, n, "ERR RJE264A Give the deck's file name, or pass it.");
+				return (0);
 			}
-		}	
-		rjesleep(10);			/* Allow local CPU some cycles */
+			sprintf(file, "%s%d", RDR_FD, fd);
+		} else {
+			strncpy(file, p, sizeof(file) - 1);
+			file[sizeof(file) - 1] = 0;
+		}
+		for (k = 0; k < CLI_DECKS && decks[k].s != NULL; k++)
+			;
+		if (fd >= 0 && k == CLI_DECKS) {
+			close(fd);
+			rje_ctl_reply(c, n, "ERR RJE265S Too many passed decks haven't gone yet.");
+			return (0);
+		}
+		if ((s = cli_route(file, fmt, recl, tag, host, word)) == NULL) {
+			if (fd >= 0)
+				close(fd);
+			sprintf(reply, "ERR %s", word);
+			rje_ctl_reply(c, n, reply);
+			return (0);
+		}
+		id = cli_send(s, file, fmt, recl, prio < 0 ? RJE_PRIO_FILE : prio);
+		if (id < 0) {
+			if (fd >= 0)
+				close(fd);
+			sprintf(reply, "ERR RJE266S %s won't take %.80s, see its console.",
+				hosts[cli_hostof(s)].name, file);
+			rje_ctl_reply(c, n, reply);
+			return (0);
+		}
+		if (fd >= 0) {		/* kept open till it's gone */
+			decks[k].s = s;
+			decks[k].id = id;
+			decks[k].fd = fd;
+		}
+		sprintf(reply, "OK %s %d", hosts[cli_hostof(s)].name, id);
+		return (rje_ctl_reply(c, n, reply));
 	}
 
-	if (strlen(tracefile) > 0)
+	// CMD [HOST=name] text
 
-		fclose(tracefd);
-	CloseSockets();
-	ttyclose();
-	printf("Goodbye...\n");
+	if (strcmp(verb, "CMD") == 0) {
+		if (*p == 0) {
+			rje_ctl_reply(c, n, "ERR RJE163A Give a command after CMD to send.");
+			return (0);
+		}
+		id = rje_queue(s, XMIT_CMD, p, prio < 0 ? RJE_PRIO_CMD : prio);
+		if (id < 0) {
+			sprintf(reply, "ERR RJE266S %s won't take the command, see its console.",
+				hosts[cli_hostof(s)].name);
+			return (rje_ctl_reply(c, n, reply));
+		}
+		sprintf(reply, "OK %s %d", hosts[cli_hostof(s)].name, id);
+		return (rje_ctl_reply(c, n, reply));
+	}
+
+	// STATUS: a line for each host
+
+	if (strcmp(verb, "STATUS") == 0) {
+		for (i = 0; i < nhosts; i++) {
+			s = hosts[i].s;
+			sprintf(reply, "HOST %s %s %d %.40s %d %d %d%s", hosts[i].name,
+				cli_state(s->status), s->opt_os,
+				s->status > NOLINK ? s->inethost : "-",
+				s->status > NOLINK ? s->inetport : 0, s->nqueue,
+				s->xmit != XMIT_NONE ? s->xmit_id : 0,
+				s == rs ? " current" : "");
+			rje_ctl_reply(c, n, reply);
+		}
+		sprintf(reply, "OK %d", nhosts);
+		return (rje_ctl_reply(c, n, reply));
+	}
+
+	// JOBS [HOST=name]: a line for each job the host's table has
+
+	if (strcmp(verb, "JOBS") == 0) {
+		for (i = 0; (j = rje_jobs_get(&s->jobs, i)) != NULL; i++) {
+			sprintf(reply, "JOB %s %d %s %d %s %.79s",
+				hosts[cli_hostof(s)].name, j->id, j->name, j->number,
+				jstate[j->state], j->file);
+			rje_ctl_reply(c, n, reply);
+		}
+		sprintf(reply, "OK %d", i);
+		return (rje_ctl_reply(c, n, reply));
+	}
+
+	// EVENTS [OFF]: what happens on the lines, as it happens
+
+	if (strcmp(verb, "EVENTS") == 0) {
+		cli_word(p, word, sizeof(word));
+		rje_ctl_watch(c, n, strcmp(word, "OFF") != 0);
+		return (rje_ctl_reply(c, n, "OK"));
+	}
+	sprintf(reply, "ERR RJE261A %s isn't a request; SUBMIT, CMD, STATUS, JOBS or EVENTS.",
+		verb);
+	return (rje_ctl_reply(c, n, reply));
+}
+
+// Tell the control socket's watchers what happened on host h's line
+
+int cli_tell(int h, struct rje_event *ev)
+{
+	struct rje_session *s = hosts[h].s;
+	struct rje_jobrec *j, *last = NULL;
+	char line[160];
+	int i;
+
+	switch (ev->type) {
+	case RJE_EV_STATUS:
+		sprintf(line, "EVENT %s STATUS %s", hosts[h].name,
+			cli_state(ev->status));
+		break;
+	case RJE_EV_DONE:
+		sprintf(line, "EVENT %s DONE %d %d", hosts[h].name, ev->id,
+			ev->rc);
+		break;
+	case RJE_EV_OUTPUT:
+		sprintf(line, "EVENT %s OUTPUT %s", hosts[h].name,
+			ev->device ? "PUNCH" : "PRINT");
+		break;
+	case RJE_EV_EOT:
+		sprintf(line, "EVENT %s EOT", hosts[h].name);
+		break;
+	case RJE_EV_JOB:		/* the job in it whose output just ended */
+		for (i = 0; (j = rje_jobs_get(&s->jobs, i)) != NULL; i++) {
+			if (j->id == ev->id && j->state == JOB_DONE &&
+				(last == NULL || j->end - last->end >= 0))
+				last = j;
+		}
+		sprintf(line, "EVENT %s JOB %d %s %d", hosts[h].name, ev->id,
+			last != NULL ? last->name : "-",
+			last != NULL ? last->number : 0);
+		break;
+	default:
+		return (0);
+	}
+	return (rje_ctl_event(&ctl, line));
+}
+
+// A deck passed on the control socket has gone (or won't): close it
+
+int cli_deckdone(struct rje_session *s, int id)
+{
+	int i;
+
+	for (i = 0; i < CLI_DECKS; i++) {
+		if (decks[i].s == s && decks[i].id == id) {
+			close(decks[i].fd);
+			decks[i].s = NULL;
+		}
+	}
+	return (0);
+}
+
+// A line's status, as HOST and the control socket show it
+
+char *cli_state(int status)
+{
+	switch (status) {
+	case NOLINK:
+		return ("closed");
+	case INITIAL_WAIT:
+		return ("connected");
+	case SENDING:
+		return ("sending");
+	case RECEIVING:
+		return ("receiving");
+	case MULTILEAVE:
+		return ("multileaving");
+	}
+	return ("signed-on");
+}
+
+// The next word at p, in upper case up to any =, into word.  Returns where
+// the one after it starts.
+
+char *cli_word(char *p, char *word, int max)
+{
+	int i, eq = 0;
+
+	while (*p == ' ')
+		p++;
+	for (i = 0; *p != 0 && *p != ' '; p++) {
+		if (i < max - 1)
+			word[i++] = eq ? *p : toupper((unsigned char) *p);
+		if (*p == '=')
+			eq = 1;
+	}
+	word[i] = 0;
+	while (*p == ' ')
+		p++;
+	return (p);
+}
+
+// Add the files matching a SEND file name, which may have wildcards, to
+// list.  Returns the new number in the list.
+
+int cli_files(char *pattern, char list[][80], int n, int max)
+{
+#if defined (_WIN32)
+	struct _finddata_t fd;
+	intptr_t h;
+	char *p;
+	int dirlen;
+
+	p = strrchr(pattern, '\\');
+	if (p == NULL)
+		p = strrchr(pattern, '/');
+	dirlen = (p == NULL) ? 0 : p - pattern + 1;
+	if ((h = _findfirst(pattern, &fd)) == -1)
+		return (n);
+	do {
+		if ((fd.attrib & _A_SUBDIR) == 0 && n < max &&
+			dirlen + strlen(fd.name) < 80) {
+			memcpy(list[n], pattern, dirlen);
+			strcpy(list[n] + dirlen, fd.name);
+			n++;
+		}
+	} while (_findnext(h, &fd) == 0);
+	_findclose(h);
+#else
+	glob_t g;
+	int i;
+
+	if (glob(pattern, 0, NULL, &g) != 0)
+		return (n);
+	for (i = 0; i < g.gl_pathc && n < max; i++) {
+		if (strlen(g.gl_pathv[i]) < 80)
+			strcpy(list[n++], g.gl_pathv[i]);
+	}
+	globfree(&g);
+#endif
+	return (n);
+}
+
+// List what's going to the host and what's waiting, for QUEUE
+
+int show_queue()
+{
+	struct rje_job *j;
+	struct rje_mlstream *m;
+	char wstr[200];
+	int i, busy = 0;
+
+	for (i = 0; i < RJE_ML_STREAMS; i++) {
+		m = &rs->ml_rdr[i];
+		if (rs->status != MULTILEAVE || m->state == ML_IDLE)
+			continue;
+		sprintf(wstr, "\r\nRJE197I Sending  %4d  FILE %s on reader %d, %d records so far",
+			m->id, m->file, i + 1, m->count);
+		ttystr(wstr);
+		busy = 1;
+	}
+	if (rs->xmit == XMIT_NONE && rs->nqueue == 0 && !busy) {
+		ttystr("\r\nRJE199I Nothing is queued for the host.");
+		return (0);
+	}
+	if (rs->xmit == XMIT_FILE || rs->xmit == XMIT_CMD) {
+		sprintf(wstr, "\r\nRJE197I Sending  %4d  ", rs->xmit_id);
+		ttystr(wstr);
+		if (rs->xmit == XMIT_FILE) {
+			sprintf(wstr, "FILE %s, %d records so far", rs->reader,
+				rs->xmit_count);
+		} else {
+			sprintf(wstr, "CMD  %s", rs->xmit_text);
+		}
+		ttystr(wstr);
+	}
+	for (i = 0; i < rs->nqueue; i++) {
+		j = &rs->queue[i];
+		sprintf(wstr, "\r\nRJE198I Waiting  %4d  priority %d  %s %s", j->id,
+			j->prio, j->kind == XMIT_FILE ? "FILE" : "CMD ",
+			j->kind == XMIT_FILE ? j->file : j->text);
+		ttystr(wstr);
+	}
+	return (0);
+}
+
+// The hosts we have lines to, for HOST; * is the one commands go to
+
+int show_hosts()
+{
+	static char *os[] = {"generic", "VM/370", "JES2", "JES3", "POWER",
+		"RES", "OS/360"};
+	struct rje_session *s;
+	char wstr[200], line[64], *state;
+	int i;
+
+	for (i = 0; i < nhosts; i++) {
+		s = hosts[i].s;
+		state = cli_state(s->status);
+		strcpy(line, "-");
+		if (s->status > NOLINK)
+			sprintf(line, "%.40s %d", s->inethost, s->inetport);
+		sprintf(wstr, "\r\nRJE258I %c %-8s %-24s %-12s %-7s %d queued",
+			s == rs ? '*' : ' ', hosts[i].name, line, state,
+			os[s->opt_os], s->nqueue + (s->xmit != XMIT_NONE));
+		ttystr(wstr);
+	}
+	return (0);
+}
+
+// Where SEND sends decks, for ROUTE
+
+int show_routes()
+{
+	char wstr[200];
+	int i;
+
+	if (routes.n == 0) {
+		ttystr("\r\nRJE259I There are no routes, decks go to the current host.");
+		return (0);
+	}
+	for (i = 0; i < routes.n; i++) {
+		sprintf(wstr, "\r\nRJE249I Route %d: %s %s goes to %s%s", i + 1,
+			rje_route_name(routes.route[i].kind),
+			routes.route[i].pattern, routes.route[i].host,
+			cli_hostnum(routes.route[i].host) < 0 ? ", which isn't there." : ".");
+		ttystr(wstr);
+	}
+	return (0);
+}
+
+// The deck cache, for CACHE
+
+int show_cache()
+{
+	char wstr[200];
+
+	if (deckcache == NULL) {
+		ttystr("\r\nRJE271I Decks aren't cached.  CACHE [<KB>] [<directory>] starts it.");
+		return (0);
+	}
+	sprintf(wstr, "\r\nRJE270I Deck cache: %d decks, %ldK of %ldK; %ld found, %ld read from disk, %ld made.",
+		deckcache->n, (deckcache->used + 1023) / 1024,
+		deckcache->size / 1024, deckcache->hits, deckcache->loads,
+		deckcache->made);
+	ttystr(wstr);
+	if (strlen(deckcache->dir) > 0) {
+		ttystr("\r\nRJE270I Decks are kept in ");
+		ttystr(deckcache->dir);
+	}
+	return (0);
+}
+
+// Cache decks in size bytes (0 for the default), kept in dir as well if
+// it isn't "", or (size -1) stop.  Every host uses the one cache; decks
+// being sent keep their cards till they've gone.
+
+int cli_cache(long size, char *dir)
+{
+	int i;
+
+	rje_decks_close(deckcache);
+	deckcache = NULL;
+	if (size >= 0 && (deckcache = rje_decks_open(size, dir)) == NULL)
+		return (-1);
+	for (i = 0; i < nhosts; i++)
+		hosts[i].s->decks = deckcache;
+	return (0);
+}
+
+// What each multileaving printer and punch is doing, for STATUS
+
+int show_streams()
+{
+	struct rje_mlstream *m;
+	char wstr[200];
+	int i, dev;
+
+	for (dev = 0; dev < 2; dev++) {
+		for (i = 0; i < RJE_ML_STREAMS; i++) {
+			m = dev ? &rs->ml_pun[i] : &rs->ml_prt[i];
+			if (m->state == ML_IDLE)
+				continue;
+			sprintf(wstr, "\r\nRJE152I %s %d receiving, %d records so far",
+				dev ? "Punch" : "Printer", i + 1, m->count);
+			ttystr(wstr);
+		}
+	}
+	return (0);
+}
+
+// Jobs sent and how far they've got, for JOBS: the last JOBS_SHOWN, or
+// all of them
+
+#define JOBS_SHOWN 20
+
+int show_jobs(int all)
+{
+	static char *state[] = {"sent", "read in", "ended", "output", "done"};
+	struct rje_jobrec *j;
+	char wstr[200], number[16], when[16], turn[16];
+	int i;
+
+	if (rs->jobs.n == 0) {
+		ttystr("\r\nRJE228I No jobs have been sent yet.");
+		return (0);
+	}
+	ttystr("\r\nRJE226I  Sub  Job       Number   Class  Sent      State    Turnaround");
+	for (i = all ? 0 : rs->jobs.n - JOBS_SHOWN; i < rs->jobs.n; i++) {
+		if ((j = rje_jobs_get(&rs->jobs, i)) == NULL)
+			continue;
+		strcpy(number, "");
+		if (j->number > 0)
+			sprintf(number, "JOB%05d", j->number);
+		strftime(when, sizeof(when), "%H:%M:%S", localtime(&j->when));
+		strcpy(turn, "");
+		if (j->state == JOB_DONE)
+			sprintf(turn, "%9.1fs", (j->end - j->submit) / 1000.0);
+		sprintf(wstr, "\r\nRJE226I %4d  %-8s  %-8s   %c    %s  %-7s %s",
+			j->id, j->name, number, j->cls, when, state[j->state], turn);
+		ttystr(wstr);
+	}
+	return (0);
+}
+
+// JOBS CLASS: turnaround, from sending the deck to having all its output,
+// for each class
+
+int show_classes()
+{
+	struct rje_jobstat st;
+	char wstr[200], seen[64] = "";
+	struct rje_jobrec *j;
+	int i, n = 0;
+
+	if (rje_jobs_class(&rs->jobs, 0, &st) == 0) {
+		ttystr("\r\nRJE228I No jobs have their output back yet.");
+		return (0);
+	}
+	ttystr("\r\nRJE227I Class  Jobs      Mean       p50       p90       Max (seconds)");
+	for (i = 0; i < rs->jobs.n; i++) {
+		j = rje_jobs_get(&rs->jobs, i);
+		if (j->state != JOB_DONE || strchr(seen, j->cls) != NULL ||
+			n == sizeof(seen) - 1)
+			continue;
+		seen[n++] = j->cls;
+		seen[n] = 0;
+		rje_jobs_class(&rs->jobs, j->cls, &st);
+		sprintf(wstr, "\r\nRJE227I   %c   %5d %9.1f %9.1f %9.1f %9.1f",
+			j->cls, st.count, st.mean / 1000.0, st.p50 / 1000.0,
+			st.p90 / 1000.0, st.max / 1000.0);
+		ttystr(wstr);
+	}
+	rje_jobs_class(&rs->jobs, 0, &st);
+	sprintf(wstr, "\r\nRJE227I  All  %5d %9.1f %9.1f %9.1f %9.1f",
+		st.count, st.mean / 1000.0, st.p50 / 1000.0, st.p90 / 1000.0,
+		st.max / 1000.0);
+	ttystr(wstr);
+	return (0);
+}
+
+// FIND: the jobs whose print output has all of words in it, from the
+// INDEX file, the first FIND_SHOWN of them
+
+#define FIND_SHOWN 50
+
+int show_found(char *words)
+{
+	char wstr[100];
+	long long start;
+	int n, shown = 0;
+
+	if (strlen(rs->indexfile) == 0) {
+		ttystr("\r\nRJE236A Print output isn't being indexed.  Use INDEX first.");
+		return (0);
+	}
+	start = rje_uclock();
+	ttystr("\r\nRJE238I Job       Number    Ended          Page  Line  Lines  File");
+	n = rje_index_find(rs->indexfile, words, cli_found, &shown);
+	if (n < 0) {
+		ttystr("\r\nRJE235A Can't read the index ");
+		ttystr(rs->indexfile);
+		return (0);
+	}
+	sprintf(wstr, "\r\nRJE239I %d found%s, in %.1f ms.", n,
+		n > FIND_SHOWN ? " (the first shown)" : "",
+		(rje_uclock() - start) / 1000.0);
+	ttystr(wstr);
+	return (0);
+}
+
+int cli_found(struct rje_idxhit *h, void *arg)
+{
+	char wstr[200], number[16], when[16];
+	int *shown = (int *) arg;
+	time_t t = (time_t) h->when;
+
+	if (++*shown > FIND_SHOWN)
+		return (0);
+	strcpy(number, "");
+	if (h->number > 0)
+		sprintf(number, "JOB%05d", h->number);
+	strftime(when, sizeof(when), "%m-%d %H:%M:%S", localtime(&t));
+	sprintf(wstr, "\r\nRJE238I %-8s  %-8s  %s %5u %5u %6ld  %.60s",
+		h->job[0] ? h->job : "?", number, when, h->page, h->line,
+		h->count, h->file[0] ? h->file : "(screen)");
+	ttystr(wstr);
+	return (0);
+}
+
+// STATUS TIMES: how long the host takes to answer, or with a file name
+// the whole histograms written to it, or with RESET start them again
+
+int show_times()
+{
+	static char *name[RJE_LAT_KINDS] = {
+		"Bid response", "Block ACK", "Poll response", "Turnaround"
+	};
+	struct rje_hist *h;
+	FILE *fd;
+	char wstr[200];
+	int i;
+
+	if (nexttoken() != 1) {
+		gettoken(0);
+		if (strcmp(token, "RESET") == 0 || strcmp(token, "reset") == 0) {
+			rje_latency_reset(rs);
+			ttystr("\r\nRJE156I Response times reset.");
+			return (0);
+		}
+		fd = fopen(token, "w");
+		if (fd == NULL) {
+			sprintf(wstr, "\r\nRJE155A Can't write %s: %s", token,
+				strerror(errno));
+			ttystr(wstr);
+			return (0);
+		}
+		rje_latency_dump(rs, fd);
+		fclose(fd);
+		ttystr("\r\nRJE154I Response time histograms written to ");
+		ttystr(token);
+		return (0);
+	}
+	ttystr("\r\nRJE157I                  count     p50     p90     p99   p99.9     max (ms)");
+	for (i = 0; i < RJE_LAT_KINDS; i++) {
+		h = &rs->lat[i];
+		sprintf(wstr, "\r\nRJE157I %-14s %7lu %7.2f %7.2f %7.2f %7.2f %7.2f",
+			name[i], h->count, rje_hist_pct(h, 50.0) / 1000.0,
+			rje_hist_pct(h, 90.0) / 1000.0,
+			rje_hist_pct(h, 99.0) / 1000.0,
+			rje_hist_pct(h, 99.9) / 1000.0, h->max / 1000.0);
+		ttystr(wstr);
+	}
+	return (0);
+}
+
+// Where received print data is going, for PRINT and STATUS
+
+int show_print()
+{
+	char reclen[32];
+
+	if (strlen(rs->print) > 0) {
+		if (rs->print[0] == '|') {
+			ttystr("piped to ");
+			ttystr(rs->print + 1);
+		} else {
+			ttystr("stored in ");
+			ttystr(rs->print);
+		}
+		switch (rs->print_fmt) {
+		case 1:
+			ttystr(" with ASA carriage control, recl=");
+			break;
+		case 2:
+			ttystr(" with machine carriage control, recl=");
+			break;
+		case 3:
+			ttystr(" in EBCDIC, RECFM=FBA, LRECL=");
+			break;
+		case 4:
+			ttystr(" in EBCDIC, RECFM=VBA, LRECL=");
+			break;
+		default:
+			return (0);
+		}
+		sprintf(reclen, "%d", rs->print_recl + (rs->print_fmt == 4 ? 5 : 1));
+		ttystr(reclen);
+	} else {
+		if (rs->opt_copy == 1) {
+			ttystr("displayed onscreen only");
+		} else {
+			ttystr("discarded.");
+		}
+	}
+	return (0);
 }
 
 // A character typed - store it, or execute the command
@@ -541,6 +1233,8 @@ int do_char(unsigned char c)
 	}	
 	if (c == '\n' || c == '\r') {			/* Line terminator */
 		execute();
+		memset(command, 0, sizeof(command));	/* used up */
+		comlen = 0;
 		return (0);
 	}
 	if (comlen > 128) {
@@ -558,11 +1252,16 @@ int do_char(unsigned char c)
 int execute() 
 {
 	char passw[32];
+	char user[64];
+	char host[128];
 	char reclen[32];
-	char shell[128];
 	char cmd[128];
-	char cmdline[128];
-	int i, rc, retry, savep;
+	char file[80];
+	char pipecmd[80];
+	char files[RJE_MAXQ][80];
+	char tag[64];
+	struct rje_session *s;
+	int i, n, rc, port, savep, prio, nfiles;
 	
 	
 	prompt = 0;
@@ -584,22 +1283,22 @@ int execute()
 			ttystr("\r\nRJE121A The hostname is missing, try again\r\n");
 			return (0);
 		}
-		if (status > INITIAL_WAIT) {
+		if (rs->status > INITIAL_WAIT) {
 			ttystr("\n\rRJE122A Connection is already open. CLOSE will close it.\r\n");
 			return (0);
 		}	
 		gettoken(0);
-		strcpy(inethost, token);
+		strcpy(host, token);
 		if (nexttoken() == 1) {
 			ttystr("\r\nRJE123A Remote host port is missing, try again.\r\n");
 			return (0);
 		}
 		gettoken(0);
-		inetport=atoi(token);
+		port = atoi(token);
 		if (nexttoken() == 0) {
 			ttystr("\r\nRJE124W Extra data after the port number is ignored\r\n");
 		}
-		connecthost();
+		rje_open(rs, host, port);
 		return (0);
 	}	
 	if (strcmp(token, "SHELL") == 0 || strcmp(token, "SH") == 0 ||
@@ -609,9 +1308,9 @@ int execute()
 #if defined (_WIN32)
 		system ("command.com");
 #else
-		tcsetattr (0, TCSAFLUSH, &cmdtty);
-		system ("bash");
-		tcsetattr (0, TCSAFLUSH, &runtty);
+		tcsetattr (ttyfd, TCSAFLUSH, &cmdtty);
+		system (ttyfd == 0 ? "bash" : "bash </dev/tty");
+		tcsetattr (ttyfd, TCSAFLUSH, &runtty);
 #endif
 		return (0);
 	}	
@@ -620,7 +1319,7 @@ int execute()
 		strcmp(token, "SIGN") == 0 ||
 		strcmp(token, "SIG") == 0 ||
 		strcmp(token, "SI") == 0) {
-		if (status < INITIAL_WAIT) {
+		if (rs->status < INITIAL_WAIT) {
 			ttystr("\r\nRJE125A You need a connection first.  Use OPEN.\r\n");
 			return (0);
 		}
@@ -629,178 +1328,68 @@ int execute()
 			return (0);
 		}
 		gettoken(0);
-		if (strcmp(token, "*") == 0) {
-			ttystr("\r\nRJE300I Signon bypassed.");
-			status = IDLE;
-			pollflag = 2;
-			pollctr = 0;
-			return (0);
-		}	
-		ttystr("\r\n");
-
-
-		// Flush out anything that might be in the pipe
-
-		while (1) {
-			rc = read_poll(0, 5000);
-			if (rc == 0) break;
-			rc = read_data(3, 0, 0);
-		}
-
-		// Send the initial ENQ and see if the host gives us an ACK0
-		
-		retry = 0;
-		while (retry < 3) {
-			line_out[0] = line_out[1] = line_out[2] = SYN;
-			line_out[3] = ENQ;
-			line_out_size = 4;
-			write_buffer();
-			rc = read_data(3, 0, 0);
-			if (rc != 0)
-				break;
-			retry++;	
-		}	
-		if (rc == -1) {
-			ttystr("\r\nRJE127S The line has disconnected.\r\n");
-			return (0);
-		}
-		if (rc == 0) {
-			ttystr("\r\nRJE128S The host did not respond to our initial greeting.\r\n");
-			return (0);
-		}
-		if (line_in[0] == NAK || (line_in[0] == DLE && line_in[1] == NAK)) {
-			ttystr("\r\nRJE129S The host says (with a NAK) it's not ready.\r\n");
-			return (0);
-		}
-		if (line_in[0] != DLE || line_in[1] != ACK0) {
-			return (0);
-		}
-		
-		// Ok, great, it's talking to us.
-		// Build the SIGNON card 
-		
-		line_out[0] = SYN;
-		line_out[1] = SYN;
-		line_out[2] = STX;
-		line_out[3] = 0;
-		line_out_size = 3;
-		switch (opt_os) {
-			case 1:		// VM/370
-				strcpy(signon, "SIGNON ");
-				break;
-			case 4:		// DOS/VS
-				strcpy(signon, "* .. SIGNON ");
-				break;
-			case 6:		// OS/360
-				strcpy(signon, ".. RJSTART ");
-				break;
-			default:	// All others
-				strcpy(signon, "SIGNON ");
-				break;
-		}
-		strcat(signon, token);
+		strcpy(user, token);
 		if (nexttoken() != 1) {
 			gettoken(0);
 			strcpy(passw, token);
 		} else {
 			strcpy(passw, "");
 		}
-		switch (opt_os) {
-			case 1:		// VM/370
-				strcat(signon, " ");
-				strcat(signon, "3780 B512 P120 TRSY PCHY");
-				if (strlen(passw) > 0) {
-					strcat(signon, " PWD=");
-					strcat(signon, passw);
-				}
-				break;
-			case 4:		// DOS/VS
-				strcat(signon, " ");
-				strcat(signon, passw);
-				break;
-			case 6:		// OS/360
-				strcat(signon, ",BRDCST=YES");
-				break;
-			default:	// All others
-				strcat(signon, " ");
-				strcat(signon, passw);
-				break;
-		}
-		//TODO: remove
-		strcpy(signon, "/*SIGNON       REMOTE001");
-		translate_to_ebcdic(signon);
-		strcat(line_out, signon);
-		line_out_size += strlen(signon);
-		line_out[line_out_size] = ETX;
-		line_out_size++;
-		write_buffer();
-		rc = read_data(10, 0, 0);
-		if (rc == 0) {
-			ttystr("\r\nRJE131S The host did not respond to the signon record.\r\n");
-			return (0);
-		}
-		if (line_in[0] == NAK || (line_in[0] == DLE && line_in[1] == NAK)) {
-			ttystr("\r\nRJE132S The host says (with a NAK) it didn't like the signon.\r\n");
-			return (0);
-		}
-		if (line_in[0] != DLE || line_in[1] != ACK1) {
-			ttystr("\r\nRJE133S The host said something odd.  Use TRACE.\r\n");
-			return (0);
-		}
-		
-		// Cool. The host said it got our signon.
-		// Let's send it an EOT so it'll know we're done
-		
-		line_out[0] = line_out[1] = SYN;
-		line_out[2] = EOT;
-		line_out_size = 3;
-		write_buffer();
-		// Note:  EOT does not expect a reply
-		status = IDLE;
-		pollflag = 2;
-		pollctr = 0;
-		return (0);	
-		
+		if (strcmp(user, "*") != 0)
+			ttystr("\r\n");
+		rc = rje_signon(rs, user, passw);
+		if (rc > 0)
+			cli_wait(rc);
+		return (0);
 	}
 	if (strcmp(token, "STATUS") == 0 ||
 		strcmp(token, "STATU") == 0 ||
 		strcmp(token, "STAT") == 0 ||
 		strcmp(token, "STA") == 0 ||
 		strcmp(token, "ST") == 0) {
-		if (status == NOLINK) {
+		if (nexttoken() != 1) {
+			gettoken(1);
+			if (strcmp(token, "TIMES") == 0 ||
+				strcmp(token, "TIME") == 0 ||
+				strcmp(token, "TIM") == 0 ||
+				strcmp(token, "TI") == 0)
+				return (show_times());
+			ttystr("\r\nRJE153A STATUS takes only TIMES after it.");
+			return (0);
+		}
+		if (rs->status == NOLINK) {
 			ttystr("\r\nRJE134I You have not connected to the host.  Use OPEN.");
 		}	
-		if (status == INITIAL_WAIT) {
+		if (rs->status == INITIAL_WAIT) {
 			ttystr("\r\nRJE135I Connected but not signed on.  Use SIGNON.");
 		}	
-		if (status == IDLE) {
+		if (rs->status == IDLE) {
 			ttystr("\r\nRJE136I Link is signed on but currently idle.");
 		}
-		if (status == SENDING) {
+		if (rs->status == SENDING) {
 			ttystr("\r\nRJE137I Sending a file to the host.");
 		}
-		if (status == RECEIVING) {
+		if (rs->status == RECEIVING) {
 			ttystr("\r\nRJE138I Receiving data from the host.");
 		}
-		ttystr("\r\nRJE139I Received print data will be ");
-		if (strlen(print) > 0) {
-			ttystr("stored in ");
-			ttystr(print);
-		} else {
-			if (opt_copy == 1) {
-				ttystr("displayed onscreen only");
-			} else {
-				ttystr("discarded.");
-			}
+		if (rs->status == MULTILEAVE) {
+			ttystr("\r\nRJE151I Signed on as a multileaving workstation.");
+			show_streams();
 		}
+		ttystr("\r\nRJE139I Received print data will be ");
+		show_print();
 		ttystr("\r\nRJE140I Received punch data will be ");
-		if (strlen(punch) > 0) {
+		if (strlen(rs->punch) > 0) {
 			ttystr("stored in ");
-			ttystr(punch);
+			ttystr(rs->punch);
 			ttystr(" in ");
-			if (punch_fmt) {
+			if (rs->punch_fmt == 2) {
+				ttystr("EBCDIC, RECFM=VB, LRECL=");
+				sprintf(reclen,"%d",rs->punch_recl + 4);
+				ttystr(reclen);
+			} else if (rs->punch_fmt) {
 				ttystr("EBCDIC, recl=");
-				sprintf(reclen,"%d",punch_recl);
+				sprintf(reclen,"%d",rs->punch_recl);
 				ttystr(reclen);
 			} else {
 				ttystr("ASCII");
@@ -824,90 +1413,165 @@ int execute()
 			ttystr(token);
 		} else {
 			ttystr("\r\nRJE036I Data trace will no longer be recorded");
-			if (strlen(tracefile) > 0)
-				fclose(tracefd);
 		}
-		strcpy(tracefile, token);
-		if (strlen(tracefile) > 0)
-			tracefd = fopen(tracefile, "w");
+		rje_trace(rs, token);
+		return (0);
+	}
+	if (strcmp(token, "INDEX") == 0 ||
+		strcmp(token, "INDE") == 0 ||
+		strcmp(token, "IND") == 0 ||
+		strcmp(token, "IN") == 0) {
+		if (nexttoken() == 1) {
+			strcpy(token, "");
+		} else {
+			gettoken(0);
+		}
+		if (rje_set_index(rs, token) != 0) {
+			ttystr("\r\nRJE235A Can't open the index ");
+			ttystr(token);
+		} else if (strlen(token) > 0) {
+			ttystr("\r\nRJE233I Print output will be indexed in ");
+			ttystr(token);
+		} else {
+			ttystr("\r\nRJE234I Print output will no longer be indexed");
+		}
 		return (0);
 	}
+	if (strcmp(token, "FIND") == 0 ||
+		strcmp(token, "FIN") == 0 ||
+		strcmp(token, "FI") == 0) {
+		if (nexttoken() == 1) {
+			ttystr("\r\nRJE237A Find what?  Use FIND <word> ...");
+			return (0);
+		}
+		memcpy(cmd, command + comctr, comlen - comctr);
+		cmd[comlen - comctr] = 0;
+		return (show_found(cmd));
+	}
 	if (strcmp(token, "PRINT") == 0 ||
 		strcmp(token, "PRIN") == 0 ||
 		strcmp(token, "PRI") == 0 ||
 		strcmp(token, "PR") == 0) {
-		if (nexttoken() == 1) {
+		if (getpipe(pipecmd) != 0) {
+			ttystr("\r\nRJE158A Print command is too long");
+			return (0);
+		}
+		if (pipecmd[0] == '|') {
+			strcpy(token, pipecmd);
+		} else if (nexttoken() == 1) {
 			strcpy(token, "");
 		} else {
 			gettoken(0);
 		}
-		strcpy(print, token);
-		ttystr("\r\nRJE141I Received print data will be ");
-		if (strlen(print) > 0) {
-			ttystr("stored in ");
-			ttystr(print);
-
-			if (print_open == 1)
-
-				fclose(printfd);
-
-			print_open = 0;
-		} else {
-			if (opt_copy == 1) {
-				ttystr("displayed onscreen only");
-			} else {
-				ttystr("discarded.");
+		rje_output_close(rs, 0);
+		strcpy(rs->print, token);
+		if (nexttoken() != 1) {
+			gettoken(1);
+			savep = rs->print_fmt;
+			rs->print_fmt = -1;
+			if (strcmp(token, "TEXT") == 0 ||
+				strcmp(token, "ASCII") == 0) {
+				rs->print_fmt = 0;
+			}
+			if (strcmp(token, "ASA") == 0) {
+				rs->print_fmt = 1;
+			}
+			if (strcmp(token, "MACHINE") == 0 ||
+				strcmp(token, "MACH") == 0) {
+				rs->print_fmt = 2;
+			}
+			if (strcmp(token, "FB") == 0 ||
+				strcmp(token, "FBA") == 0) {
+				rs->print_fmt = 3;
+			}
+			if (strcmp(token, "VB") == 0 ||
+				strcmp(token, "VBA") == 0) {
+				rs->print_fmt = 4;
+			}
+			if (rs->print_fmt == -1) {
+				ttystr("\r\nRJE149A Invalid option following print filename");
+				rs->print_fmt = savep;
+				return (0);
+			}
+			if (nexttoken() != 1) {
+				gettoken(0);
+				savep = rs->print_recl;
+				rs->print_recl = atoi(token);
+				if (rs->print_recl < 80 || rs->print_recl > 255) {
+					ttystr("\r\nRJE150A Invalid print record length");
+					rs->print_recl = savep;
+					return (0);
+				}
 			}
 		}
+		ttystr("\r\nRJE141I Received print data will be ");
+		show_print();
 		return (0);
 	}	
 	if (strcmp(token, "PUNCH") == 0 ||
 		strcmp(token, "PUNC") == 0 ||
 		strcmp(token, "PUN") == 0 ||
 		strcmp(token, "PU") == 0) {
-		if (nexttoken() == 1) {
+		if (getpipe(pipecmd) != 0) {
+			ttystr("\r\nRJE159A Punch command is too long");
+			return (0);
+		}
+		if (pipecmd[0] == '|') {
+			strcpy(token, pipecmd);
+		} else if (nexttoken() == 1) {
 			strcpy(token, "");
 		} else {
 			gettoken(0);
 		}
-		strcpy(punch, token);
+		rje_output_close(rs, 1);
+		strcpy(rs->punch, token);
 		if (nexttoken() != 1) {
 			gettoken(1);
-			savep = punch_fmt;
-			punch_fmt = -1;
+			savep = rs->punch_fmt;
+			rs->punch_fmt = -1;
 			if (strcmp(token, "ASCII") == 0) {
-				punch_fmt = 0;
+				rs->punch_fmt = 0;
+			}
+			if (strcmp(token, "EBCDIC") == 0 ||
+				strcmp(token, "FB") == 0) {
+				rs->punch_fmt = 1;
 			}
-			if (strcmp(token, "EBCDIC") == 0) {
-				punch_fmt = 1;
+			if (strcmp(token, "VB") == 0) {
+				rs->punch_fmt = 2;
 			}
-			if (punch_fmt == -1) {
+			if (rs->punch_fmt == -1) {
 				ttystr("\r\nRJE142A Invalid option following punch filename");
-				punch_fmt = savep;
+				rs->punch_fmt = savep;
 				return (0);
 			}
 			if (nexttoken() != 1) {
 				gettoken(0);
-				savep = punch_recl;
-				punch_recl=atoi(token);
-				if (punch_recl < 80 || punch_recl > 512) {
+				savep = rs->punch_recl;
+				rs->punch_recl=atoi(token);
+				if (rs->punch_recl < 80 || rs->punch_recl > 512) {
 					ttystr("\r\nRJE143A Invalid punch record length");
-					punch_recl = savep;
+					rs->punch_recl = savep;
 					return (0);
 				}
 			}
 		}
 		ttystr("\r\nRJE144I Received punch data will be ");
-		if (strlen(punch) > 0) {
-			ttystr("stored in ");
-			ttystr(punch);
-			if (punch_open == 1)
-				fclose(punchfd);
-			punch_open = 0;
+		if (strlen(rs->punch) > 0) {
+			if (rs->punch[0] == '|') {
+				ttystr("piped to ");
+				ttystr(rs->punch + 1);
+			} else {
+				ttystr("stored in ");
+				ttystr(rs->punch);
+			}
 			ttystr(" in ");
-			if (punch_fmt) {
+			if (rs->punch_fmt == 2) {
+				ttystr("EBCDIC, RECFM=VB, LRECL=");
+				sprintf(reclen,"%d",rs->punch_recl + 4);
+				ttystr(reclen);
+			} else if (rs->punch_fmt) {
 				ttystr("EBCDIC, recl=");
-				sprintf(reclen,"%d",punch_recl);
+				sprintf(reclen,"%d",rs->punch_recl);
 				ttystr(reclen);
 			} else {
 				ttystr("ASCII");
@@ -920,7 +1584,7 @@ int execute()
 	if (strcmp(token, "SET") == 0) {
 		if (nexttoken() == 1) {
 			ttystr("\r\nRJE145I Host OS is: ");
-			switch (opt_os) {
+			switch (rs->opt_os) {
 			case 0: 
 				ttystr("Generic RJE");
 				break;
@@ -944,29 +1608,85 @@ int execute()
 				break;
 			}
 			ttystr("\r\nRJE146I Route to this user id: ");
-			if (strlen(opt_user) > 0) {
-				ttystr(opt_user);
+			if (strlen(rs->opt_user) > 0) {
+				ttystr(rs->opt_user);
 			} else {
 				ttystr("(none)");
 			}
 			ttystr("\r\nRJE147I Display printer output: ");
-			if (opt_copy == 1) {
+			if (rs->opt_copy == 1) {
 				ttystr("ON");
 			} else {
 				ttystr("OFF");
 			}
 			ttystr("\r\nRJE148I Poll when idle: ");
-			if (opt_poll == 1) {
+			if (rs->opt_poll == 1) {
 				ttystr("ON");
 			} else {
 				ttystr("OFF");
 			}
 			ttystr("\r\nRJE301I openrent send: ");
-			if (opt_trn == 1) {
+			if (rs->opt_trn == 1) {
+				ttystr("ON");
+			} else {
+				ttystr("OFF");
+			}
+			ttystr("\r\nRJE302I Send checkpoints: ");
+			switch (rs->opt_ckpt) {
+			case 0:
+				ttystr("OFF");
+				break;
+			case 1:
+				if (rje_can_resume(rs)) {
+					ttystr("ON, resume interrupted sends");
+				} else {
+					ttystr("ON, restart interrupted sends");
+				}
+				break;
+			case 2:
+				ttystr("ON, always resume interrupted sends");
+				break;
+			case 3:
+				ttystr("ON, always restart interrupted sends");
+				break;
+			}
+			ttystr("\r\nRJE303I Batch queued decks: ");
+			if (rs->opt_batch < 2) {
+				ttystr("OFF");
+			} else {
+				sprintf(reclen, "%d", rs->opt_batch);
+				ttystr("up to ");
+				ttystr(reclen);
+				ttystr(" decks per transmission");
+				if (!rje_can_batch(rs))
+					ttystr(", but not to this host OS");
+			}
+			ttystr("\r\nRJE304I Interrupt host output (RVI): ");
+			if (rs->opt_rvi == 0) {
+				ttystr("OFF");
+			} else {
+				sprintf(reclen, "%d", rs->opt_rvi);
+				ttystr("for queued work of priority ");
+				ttystr(reclen);
+				ttystr(" or more");
+			}
+			ttystr("\r\nRJE306I Sign on as: ");
+			if (rs->opt_ml) {
+				sprintf(reclen, "%d", rs->opt_mlrdrs);
+				ttystr("a multileaving workstation, ");
+				ttystr(reclen);
+				ttystr(rs->opt_mlrdrs == 1 ? " reader" : " readers");
+			} else {
+				ttystr("a 3780");
+			}
+			ttystr("\r\nRJE305I Hold off host output (WACK) when we fall behind: ");
+			if (rs->opt_wack == 1) {
 				ttystr("ON");
 			} else {
 				ttystr("OFF");
 			}
+			ttystr("\r\nRJE307I Page index (.pages) beside print files: ");
+			ttystr(rs->opt_pages ? "ON" : "OFF");
 //			ttystr("\r\nRJE148I Pause printer display: ");
 //			switch (opt_pause) {
 //			case -1:
@@ -976,63 +1696,148 @@ int execute()
 //				ttystr("never.");
 //				break;
 //			default:
-//				sprintf(wstr, "every %d lines.", opt_pause);
+//				sprintf(wstr, "every %d lines.", rs->opt_pause);
 //				ttystr(wstr);
 //				break;
 //			}
 		} else {
 			gettoken(1);
 			if (strcmp(token, "NOCOPY") == 0) {
-				opt_copy = 0;
+				rs->opt_copy = 0;
 				return (0);
 			} 
 			if (strcmp(token, "COPY") == 0) {
-				opt_copy = 1;
+				rs->opt_copy = 1;
 				return (0);
 			} 
 			if (strcmp(token, "NOPOLL") == 0) {
-				opt_poll = 0;
+				rs->opt_poll = 0;
 				return (0);
 			} 
 			if (strcmp(token, "POLL") == 0) {
-				opt_poll = 1;
+				rs->opt_poll = 1;
 				return (0);
 			} 
 			if (strcmp(token, "NOTRN") == 0) {
-				opt_trn = 0;
+				rs->opt_trn = 0;
 				return (0);
 			} 
 			if (strcmp(token, "TRN") == 0) {
-				opt_trn = 1;
+				rs->opt_trn = 1;
+				return (0);
+			}
+			if (strcmp(token, "NOCKPT") == 0) {
+				rs->opt_ckpt = 0;
+				return (0);
+			}
+			if (strcmp(token, "CKPT") == 0) {
+				rs->opt_ckpt = 1;
+				if (nexttoken() == 0) {
+					gettoken(1);
+					if (strcmp(token, "RESUME") == 0) {
+						rs->opt_ckpt = 2;
+					} else if (strcmp(token, "RESTART") == 0) {
+						rs->opt_ckpt = 3;
+					} else {
+						ttystr("\r\nRJE194A Use SET CKPT [RESUME | RESTART]");
+					}
+				}
+				return (0);
+			}
+			if (strcmp(token, "NOML") == 0 ||
+				strcmp(token, "NOMULTILEAVE") == 0) {
+				rs->opt_ml = 0;
+				return (0);
+			}
+			if (strcmp(token, "ML") == 0 ||
+				strcmp(token, "MULTILEAVE") == 0) {
+				rs->opt_ml = 1;
+				if (nexttoken() == 0) {
+					gettoken(0);
+					rs->opt_mlrdrs = atoi(token);
+					if (rs->opt_mlrdrs < 1 ||
+						rs->opt_mlrdrs > RJE_ML_STREAMS) {
+						ttystr("\r\nRJE223A Use SET ML [readers], 1 to 4");
+						rs->opt_mlrdrs = 1;
+					}
+				}
+				return (0);
+			}
+			if (strcmp(token, "NOWACK") == 0) {
+				rs->opt_wack = 0;
+				return (0);
+			}
+			if (strcmp(token, "WACK") == 0) {
+				rs->opt_wack = 1;
+				return (0);
+			}
+			if (strcmp(token, "NOPAGES") == 0) {
+				rs->opt_pages = 0;
+				return (0);
+			}
+			if (strcmp(token, "PAGES") == 0) {
+				rs->opt_pages = 1;
+				return (0);
+			}
+			if (strcmp(token, "NORVI") == 0) {
+				rs->opt_rvi = 0;
+				return (0);
+			}
+			if (strcmp(token, "RVI") == 0) {
+				rs->opt_rvi = RJE_PRIO_CMD;
+				if (nexttoken() == 0) {
+					gettoken(0);
+					rs->opt_rvi = atoi(token);
+					if (rs->opt_rvi < 1 || rs->opt_rvi > 9) {
+						ttystr("\r\nRJE211A Use SET RVI [priority], 1 to 9");
+						rs->opt_rvi = RJE_PRIO_CMD;
+					}
+				}
+				return (0);
+			}
+			if (strcmp(token, "NOBATCH") == 0) {
+				rs->opt_batch = 0;
+				return (0);
+			}
+			if (strcmp(token, "BATCH") == 0) {
+				rs->opt_batch = 8;
+				if (nexttoken() == 0) {
+					gettoken(0);
+					rs->opt_batch = atoi(token);
+					if (rs->opt_batch < 1 || rs->opt_batch > RJE_MAXQ) {
+						ttystr("\r\nRJE209A Use SET BATCH [decks], 1 to 64");
+						rs->opt_batch = 8;
+					}
+				}
 				return (0);
 			}
 			if (strcmp(token, "NOOS") == 0) {
-				opt_os = 0;
+				rs->opt_os = 0;
 				return (0);
 			} 
 			if (strcmp(token, "OS") == 0) {
-				opt_trn = 1;
-				opt_os = 6;
+				rs->opt_trn = 1;
+				rs->opt_os = 6;
 				return (0);
 			} 
 			if (strcmp(token, "VM") == 0) {
-				opt_os = 1;
+				rs->opt_os = 1;
 				return (0);
 			} 
 			if (strcmp(token, "JES2") == 0) {
-				opt_os = 2;
+				rs->opt_os = 2;
 				return (0);
 			} 
 			if (strcmp(token, "JES3") == 0) {
-				opt_os = 3;
+				rs->opt_os = 3;
 				return (0);
 			} 
 			if (strcmp(token, "DOS") == 0) {
-				opt_os = 4;
+				rs->opt_os = 4;
 				return (0);
 			} 
 			if (strcmp(token, "RES") == 0) {
-				opt_os = 5;
+				rs->opt_os = 5;
 				return (0);
 			} 
 			if (strcmp(token, "USER") == 0) {
@@ -1040,8 +1845,8 @@ int execute()
 					ttystr("\r\nRJE160A Missing userid");
 				} else {
 					gettoken(1);
-					strcpy(opt_user, token);
-					opt_os = 1;
+					strcpy(rs->opt_user, token);
+					rs->opt_os = 1;
 				}
 				return (0);
 			}
@@ -1052,15 +1857,15 @@ int execute()
 					gettoken(1);
 					if (strcmp(token, "FF") == 0 ||
 						strcmp(token, "ff") ==0) {
-							opt_pause = -1;
+							rs->opt_pause = -1;
 							return (0);
 					}
 					if (strcmp(token, "NO") == 0 ||
 						strcmp(token, "no") ==0) {
-							opt_pause = 0;
+							rs->opt_pause = 0;
 							return (0);
 					}
-					opt_pause = atoi(token);
+					rs->opt_pause = atoi(token);
 				}
 				return (0);
 			}
@@ -1082,78 +1887,359 @@ int execute()
 			i++;
 			comctr++;
 		}
-		switch (opt_os) {
-		case 4:
-			strcpy(cmdline, "* .. ");
-			strcat(cmdline, cmd);
-			break;
-		case 6:
-			strcpy(cmdline, ".. ");
-			strcat(cmdline, cmd);
-			break;
-		default:
-			strcpy(cmdline, cmd);
-			break;
-		}
-		rc = send_file(cmdline);
-		if (rc != -1) {
-			status = IDLE;
-			pollflag = 2;
-			pollctr = 0;
-		}
+		rc = rje_command(rs, cmd);
+		if (rc > 0)
+			cli_queued(rs, rc);
 		return (0);
 	}	
 
 	if (strcmp(token, "SEND") == 0 ||
 		strcmp(token, "SEN") == 0 ||
 		strcmp(token, "S") == 0) {
-		if (status < IDLE) {
-			ttystr("\r\nRJE064A You are not signed on, use SIGNON.\r\n");
-			return (0);
-		}
-		if (nexttoken() == 0) {
+		nfiles = 0;
+		prio = RJE_PRIO_FILE;
+		strcpy(host, "");
+		strcpy(tag, "");
+		while (nexttoken() == 0) {
 			gettoken(0);
-			strcpy(reader, token);
-			if (nexttoken() != 1) {
-				gettoken(1);
-				savep = reader_fmt;
-				reader_fmt = -1;
-				if (strcmp(token, "ASCII") == 0) {
-					reader_fmt = 0;
+			strcpy(file, token);
+			for (i = 0; token[i] != 0; i++)
+				token[i] = toupper(token[i]);
+			if (strcmp(token, "HOST") == 0 ||
+				strcmp(token, "TAG") == 0) {
+				strcpy(file, token);
+				if (nexttoken() == 1) {
+					ttystr("\r\nRJE254A Give the host or tag after ");
+					ttystr(file);
+					return (0);
 				}
-				if (strcmp(token, "EBCDIC") == 0) {
-					reader_fmt = 1;
+				gettoken(1);
+				if (strcmp(file, "HOST") == 0) {
+					strncpy(host, token, 8);
+					host[8] = 0;
+				} else {
+					strncpy(tag, token, sizeof(tag) - 1);
+					tag[sizeof(tag) - 1] = 0;
 				}
-				if (reader_fmt == -1) {
-					ttystr("\r\nRJE164A Invalid option following filename");
-					reader_fmt = savep;
+				continue;
+			}
+			if (strcmp(token, "PRIORITY") == 0 ||
+				strcmp(token, "PRIO") == 0 ||
+				strcmp(token, "PRI") == 0) {
+				if (nexttoken() == 0)
+					gettoken(0);
+				else
+					strcpy(token, "");
+				prio = atoi(token);
+				if (!isdigit((unsigned char) token[0]) || prio > 9) {
+					ttystr("\r\nRJE206A PRIORITY needs a number, 0 to 9");
 					return (0);
 				}
-				if (nexttoken() != 1) {
-					gettoken(0);
-					savep = reader_recl;
-					reader_recl=atoi(token);
-					if (reader_recl < 80 || reader_recl > 512) {
-						ttystr("\r\nRJE165A Invalid send record length");
-						reader_recl = savep;
-						return (0);
-					}
+				continue;
+			}
+			if (nfiles > 0 && isdigit((unsigned char) token[0])) {
+				savep = rs->reader_recl;
+				rs->reader_recl=atoi(token);
+				if (rs->reader_recl < 80 || rs->reader_recl > 512) {
+					ttystr("\r\nRJE165A Invalid send record length");
+					rs->reader_recl = savep;
+					return (0);
 				}
+				continue;
+			}
+			if (nfiles > 0 && rje_reader_fmt(token) >= 0) {
+				rs->reader_fmt = rje_reader_fmt(token);
+				continue;
+			}
+			if (strcmp(file, "*") == 0) {
+				strcpy(files[nfiles++], file);
+				continue;
 			}
+			i = nfiles;
+			nfiles = cli_files(file, files, nfiles, RJE_MAXQ);
+			if (nfiles == i) {
+				ttystr("\r\nRJE172S Can't open ");
+				ttystr(file);
+				ttystr(", it doesn't exist?");
+				return (0);
+			}
+		}
+		if (nfiles == 0 && strlen(rs->reader) > 0)
+			strcpy(files[nfiles++], rs->reader);	/* again */
+		if (nfiles == 0) {
+			ttystr("\r\nRJE207A Give the name of the file to send.");
+			return (0);
+		}
+		for (i = 0; i < nfiles && nfiles > 1; i++) {
+			if (strcmp(files[i], "*") == 0) {
+				ttystr("\r\nRJE278A SEND * on its own, not with files.");
+				return (0);
+			}
+		}
+
+		// Cards from the keyboard can't wait in the queue, and come
+		// from here for the current host
+
+		if (strcmp(files[0], "*") == 0) {
+			if (rs->status < IDLE) {
+				ttystr("\r\nRJE064A You are not signed on, use SIGNON.\r\n");
+				return (0);
+			}
+			rc = rje_queue(rs, XMIT_FILE, files[0], 9);
+			if (rc > 0)
+				cli_wait(rc);
+			return (0);
+		}
+		for (i = 0; i < nfiles; i++) {
+			s = cli_route(files[i], rs->reader_fmt, rs->reader_recl,
+				tag, host, cmd);
+			if (s == NULL) {
+				ttystr("\r\n");
+				ttystr(cmd);
+				continue;
+			}
+			rc = cli_send(s, files[i], rs->reader_fmt, rs->reader_recl,
+				prio);
+			if (rc > 0)
+				cli_queued(s, rc);
 		}
-		status = SENDING;
-		send_file("");
-		status = IDLE;
-		pollflag = 2;
-		pollctr = 0;
 		return (0);
 	}	
+	if (strcmp(token, "QUEUE") == 0 ||
+		strcmp(token, "QUEU") == 0 ||
+		strcmp(token, "QUE") == 0) {
+		if (nexttoken() == 0) {
+			gettoken(1);
+			if (strcmp(token, "CANCEL") != 0 &&
+				strcmp(token, "CAN") != 0) {
+				ttystr("\r\nRJE208A Use QUEUE, or QUEUE CANCEL <number>.");
+				return (0);
+			}
+			if (nexttoken() == 1) {
+				ttystr("\r\nRJE208A Use QUEUE, or QUEUE CANCEL <number>.");
+				return (0);
+			}
+			gettoken(0);
+			if (rje_cancel(rs, atoi(token)) == 0) {
+				cli_deckdone(rs, atoi(token));
+				ttystr("\r\nRJE204I Number ");
+				ttystr(token);
+				ttystr(" has been taken off the queue.");
+			} else {
+				ttystr("\r\nRJE205W Number ");
+				ttystr(token);
+				ttystr(" isn't waiting in the queue.");
+			}
+			return (0);
+		}
+		show_queue();
+		return (0);
+	}	
+	if (strcmp(token, "JOBS") == 0 ||
+		strcmp(token, "JOB") == 0 ||
+		strcmp(token, "JO") == 0) {
+		if (nexttoken() == 1)
+			return (show_jobs(0));
+		gettoken(1);
+		if (strcmp(token, "ALL") == 0)
+			return (show_jobs(1));
+		if (strcmp(token, "CLASS") == 0 ||
+			strcmp(token, "CLAS") == 0 ||
+			strcmp(token, "CLA") == 0 ||
+			strcmp(token, "CL") == 0)
+			return (show_classes());
+		ttystr("\r\nRJE229A Use JOBS, JOBS ALL or JOBS CLASS.");
+		return (0);
+	}
+	if (strcmp(token, "CONTROL") == 0 ||
+		strcmp(token, "CONTRO") == 0 ||
+		strcmp(token, "CONTR") == 0 ||
+		strcmp(token, "CONT") == 0 ||
+		strcmp(token, "CON") == 0) {
+		if (nexttoken() == 1) {
+			if (ctl.fd < 0) {
+				ttystr("\r\nRJE267I There's no control socket.  CONTROL <name> makes one.");
+				return (0);
+			}
+			for (i = n = 0; i < RJE_CTL_CONNS; i++)
+				n += (ctl.conn[i].fd >= 0);
+			sprintf(cmd, "\r\nRJE268I Control socket %.60s, %d connected.",
+				ctl.path, n);
+			ttystr(cmd);
+			return (0);
+		}
+		gettoken(0);
+		rje_ctl_close(&ctl);
+		if (strcmp(token, "OFF") == 0 || strcmp(token, "off") == 0) {
+			ttystr("\r\nRJE269I The control socket is closed.");
+			return (0);
+		}
+		if (rje_ctl_open(&ctl, token) != 0) {
+			ttystr("\r\nRJE260S Can't listen on ");
+			ttystr(token);
+			ttystr(", is another rje80 using it?");
+			return (0);
+		}
+		ttystr("\r\nRJE268I Control socket ");
+		ttystr(token);
+		ttystr(", programs can connect to it.");
+		return (0);
+	}
+	if (strcmp(token, "CACHE") == 0 ||
+		strcmp(token, "CACH") == 0 ||
+		strcmp(token, "CAC") == 0 ||
+		strcmp(token, "CA") == 0) {
+		if (nexttoken() == 1)
+			return (show_cache());
+		gettoken(0);
+		if (strcmp(token, "OFF") == 0 || strcmp(token, "off") == 0) {
+			cli_cache(-1, "");
+			ttystr("\r\nRJE272I Decks will no longer be cached.");
+			return (0);
+		}
+		n = 0;
+		if (isdigit((unsigned char) token[0])) {
+			n = atoi(token);
+			if (n < 1 || n > 1024 * 1024) {
+				ttystr("\r\nRJE273A Use CACHE [<KB>] [<directory>], 1 to 1048576 KB.");
+				return (0);
+			}
+			strcpy(token, "");
+			if (nexttoken() == 0)
+				gettoken(0);
+		}
+		if (cli_cache(n * 1024L, token) != 0) {
+			ttystr("\r\nRJE274S There's no memory for a deck cache.");
+			return (0);
+		}
+		sprintf(cmd, "\r\nRJE275I Decks will be cached, up to %ldK",
+			deckcache->size / 1024);
+		ttystr(cmd);
+		if (strlen(token) > 0) {
+			ttystr(", and kept in ");
+			ttystr(token);
+		}
+		ttystr(".");
+		return (0);
+	}
+	if (strcmp(token, "HOST") == 0 ||
+		strcmp(token, "HOS") == 0 ||
+		strcmp(token, "HO") == 0) {
+		if (nexttoken() == 1)
+			return (show_hosts());
+		gettoken(1);
+		if (strcmp(token, "DROP") == 0) {
+			if (nexttoken() == 1) {
+				ttystr("\r\nRJE255A Use HOST DROP <name>.");
+				return (0);
+			}
+			gettoken(1);
+			if ((n = cli_hostnum(token)) < 0) {
+				ttystr("\r\nRJE246W There's no host ");
+				ttystr(token);
+				ttystr(".");
+				return (0);
+			}
+			if (nhosts == 1) {
+				ttystr("\r\nRJE248A The only host can't be dropped.");
+				return (0);
+			}
+			if (hosts[n].s->status > NOLINK)
+				rje_close(hosts[n].s);
+			for (i = 0; i < CLI_DECKS; i++) {
+				if (decks[i].s == hosts[n].s)
+					cli_deckdone(decks[i].s, decks[i].id);
+			}
+			rje_free(hosts[n].s);
+			if (rs == hosts[n].s)
+				rs = hosts[n == 0 ? 1 : 0].s;
+			memmove(&hosts[n], &hosts[n + 1],
+				(nhosts - n - 1) * sizeof(struct cli_host));
+			nhosts--;
+			said = NULL;
+			ttystr("\r\nRJE247I Host ");
+			ttystr(token);
+			ttystr(" is gone; commands go to ");
+			ttystr(hosts[cli_hostof(rs)].name);
+			ttystr(".");
+			return (0);
+		}
+		for (i = 0; isalnum((unsigned char) token[i]); i++)
+			;
+		if (i == 0 || i > 8 || token[i] != 0) {
+			ttystr("\r\nRJE245A A host name is 1 to 8 letters and digits.");
+			return (0);
+		}
+		if ((n = cli_hostnum(token)) < 0) {
+			if ((n = cli_newhost(token)) < 0) {
+				ttystr("\r\nRJE244S There are as many hosts as there can be.");
+				return (0);
+			}
+			ttystr("\r\nRJE243I Host ");
+			ttystr(token);
+			ttystr(" added, OPEN it.");
+		}
+		rs = hosts[n].s;
+		ttystr("\r\nRJE242I Commands go to ");
+		ttystr(token);
+		ttystr(".");
+		return (0);
+	}
+	if (strcmp(token, "ROUTE") == 0 ||
+		strcmp(token, "ROUT") == 0 ||
+		strcmp(token, "ROU") == 0 ||
+		strcmp(token, "RO") == 0) {
+		if (nexttoken() == 1)
+			return (show_routes());
+		gettoken(1);
+		if (strcmp(token, "DROP") == 0) {
+			if (nexttoken() == 0)
+				gettoken(0);
+			else
+				strcpy(token, "");
+			if (rje_route_drop(&routes, atoi(token)) != 0) {
+				ttystr("\r\nRJE252W There's no route ");
+				ttystr(token);
+				ttystr(".");
+				return (0);
+			}
+			ttystr("\r\nRJE257I Route ");
+			ttystr(token);
+			ttystr(" has been dropped.");
+			return (0);
+		}
+		strncpy(host, token, 8);
+		host[8] = 0;
+		rc = -1;
+		if (nexttoken() == 0) {
+			gettoken(1);
+			rc = rje_route_kind(token);
+		}
+		if (rc < 0 || nexttoken() == 1) {
+			ttystr("\r\nRJE250A Use ROUTE <host> PATH|JOB|CLASS|TAG <pattern>,");
+			ttystr("\r\n        or ROUTE DROP <number>.");
+			return (0);
+		}
+		gettoken(rc == ROUTE_PATH ? 0 : 1);
+		if ((n = rje_route_add(&routes, host, rc, token)) < 0) {
+			ttystr("\r\nRJE251S There are as many routes as there can be.");
+			return (0);
+		}
+		sprintf(cmd, "\r\nRJE249I Route %d: %s %.64s goes to %.8s.", n,
+			rje_route_name(rc), token, host);
+		ttystr(cmd);
+		if (cli_hostnum(host) < 0) {
+			ttystr("\r\nRJE256W There's no host ");
+			ttystr(host);
+			ttystr(" yet.");
+		}
+		return (0);
+	}
 	if (strcmp(token, "CLOSE") == 0 ||
 		strcmp(token, "CL") == 0) {
-		if (status > NOLINK) {
-			close (sockfd);
+		if (rs->status > NOLINK) {
+			rje_close(rs);
 			ttystr("\r\nRJE166I Connection closed.\n\r");
-			status = NOLINK;
 		} else {
 			ttystr("\r\nRJE167W You are not presently connected.\n\r");
 		}	
@@ -1169,11 +2255,18 @@ int execute()
 		strcmp(token, "EX") == 0 ||
 		strcmp(token, "END") == 0) {
 		ttystr("\r\nRJE168I Shutting down RJE80...\n\r");
-		if (status > NOLINK) {
-			ttystr("RJE169I Connection closed\r\n");
-			close(sockfd);
-		}	
-		status = SHUTDOWN;
+		for (i = 0; i < nhosts; i++) {
+			if (hosts[i].s->status > NOLINK) {
+				ttystr("RJE169I Connection closed");
+				if (nhosts > 1) {
+					ttystr(" to ");
+					ttystr(hosts[i].name);
+				}
+				ttystr("\r\n");
+				rje_close(hosts[i].s);
+			}
+		}
+		rs->status = SHUTDOWN;
 		return (0);
 	}	
 	if (strcmp(token, "HELP") == 0 || strcmp(token, "?") == 0) {
@@ -1186,9 +2279,17 @@ int execute()
 			ttystr("   PUnch    Set the punch destination filename.\r\n");
 			ttystr("   Cmd      Send a command to the remote host OS.\r\n");
 			ttystr("   Send     Send a file to the host.\r\n");
+			ttystr("   QUeue    Show or cancel work waiting for the line.\r\n");
+			ttystr("   HOst     Add or pick a host, for lines to several.\r\n");
+			ttystr("   ROute    Say which host each deck is sent to.\r\n");
+			ttystr("   CONtrol  Let other programs use the lines, on a socket.\r\n");
+			ttystr("   CAche    Keep decks made into cards, for sending again.\r\n");
+			ttystr("   JObs     Show jobs sent and their turnaround.\r\n");
 			ttystr("   STatus   Show the status of the connection.\r\n");
 			ttystr("   SEt      Control various options and parameters.\r\n");
 			ttystr("   TRace    Record communcations data in a log file.\r\n");
+			ttystr("   INdex    Keep a full text index of print output.\r\n");
+			ttystr("   FInd     Find the jobs whose output has given words.\r\n");
 			ttystr("   CLose    Close the open TCP/IP connection.\r\n");
 			ttystr("   !        Spawn a shell underneath RJE80.\r\n");
 			ttystr("   Quit     Exit the program.\r\n");
@@ -1241,6 +2342,36 @@ int execute()
 			ttystr("   \r\n");
 			ttystr("   Example: CMD PDISPLAY LST sends a PDISPLAY LST command to DOS/VS.\r\n");
 			ttystr("            C SIGNOFF signs you off the DOS/VS RJE line.\r\n");
+			ttystr("   \r\n");
+			ttystr("   Commands are queued like SENDs, ahead of files, and go as soon\r\n");
+			ttystr("   as the line is ours.\r\n");
+			return(0);
+		}
+		if (strcmp(token, "QUEUE") == 0 ||
+			strcmp(token, "QU") == 0) {
+			ttystr("\r\n\r\n");
+			ttystr("   Syntax: QUEUE [CANCEL <number>]\r\n");
+			ttystr("   \r\n");
+			ttystr("   SEND and CMD don't wait for the line.  Their work is queued\r\n");
+			ttystr("   and sent, highest priority first, whenever the host gives the\r\n");
+			ttystr("   line back to us.  QUEUE lists what's being sent and what's\r\n");
+			ttystr("   waiting, with the number each was given when it was queued.\r\n");
+			ttystr("   QUEUE CANCEL takes one that hasn't started off the queue.\r\n");
+			return(0);
+		}
+		if (strcmp(token, "JOBS") == 0 ||
+			strcmp(token, "JO") == 0) {
+			ttystr("\r\n\r\n");
+			ttystr("   Syntax: JOBS [ALL | CLASS]\r\n");
+			ttystr("   \r\n");
+			ttystr("   Every JOB card sent (//name JOB, or * $$ JOB JNM=name for\r\n");
+			ttystr("   POWER) is followed until its output comes back.  The host's\r\n");
+			ttystr("   $HASP (or POWER 1Rxx) messages give its number, and the first\r\n");
+			ttystr("   lines of each print or punch file say which job it is for.\r\n");
+			ttystr("   JOBS lists the last 20 jobs (ALL for all that are kept) with\r\n");
+			ttystr("   when each was sent, how far it has got and, once its output\r\n");
+			ttystr("   is in, its turnaround.  JOBS CLASS gives turnaround figures\r\n");
+			ttystr("   for each job class.\r\n");
 			return(0);
 		}
 		if (strcmp(token, "SIGNON") == 0 ||
@@ -1292,6 +2423,34 @@ int execute()
 			ttystr("   TRACE without a filename to turn off tracing.\r\n");
 			return(0);
 		}
+		if (strcmp(token, "INDEX") == 0 ||
+			strcmp(token, "IN") == 0) {
+			ttystr("\r\n\r\n");
+			ttystr("   Syntax: INDEX <filename>\r\n");
+			ttystr("   \r\n");
+			ttystr("   Keeps an index of every word in the print output received,\r\n");
+			ttystr("   with the job, page and line it's on, in the file given (added\r\n");
+			ttystr("   to if it's there).  The words are indexed as the lines come\r\n");
+			ttystr("   in, and each job's go into the file when its output ends.\r\n");
+			ttystr("   INDEX without a filename stops it.  FIND, or the rjefind\r\n");
+			ttystr("   program, searches the index.\r\n");
+			return(0);
+		}
+		if (strcmp(token, "FIND") == 0 ||
+			strcmp(token, "FI") == 0) {
+			ttystr("\r\n\r\n");
+			ttystr("   Syntax: FIND <word> ...\r\n");
+			ttystr("   \r\n");
+			ttystr("   Lists the jobs whose print output has all of the words in it,\r\n");
+			ttystr("   from the INDEX file, with the page and line of the first word\r\n");
+			ttystr("   and how many lines it's on.  A word is letters, digits and\r\n");
+			ttystr("   $ # @; case doesn't matter, and a word ending in * finds any\r\n");
+			ttystr("   word starting with it.\r\n");
+			ttystr("   \r\n");
+			ttystr("   Example: FIND IEF142I\r\n");
+			ttystr("            FIND IEC* PAYROLL\r\n");
+			return(0);
+		}
 		if (strcmp(token, "INTRO") == 0 ||
 			strcmp(token, "I") == 0) {
 			ttystr("\r\n\r\n");
@@ -1333,7 +2492,8 @@ int execute()
 		if (strcmp(token, "PRINT") == 0 ||
 			strcmp(token, "PR") == 0) {
 			ttystr("\r\n\r\n");
-			ttystr("   Syntax: PRINT [filename]\r\n");
+			ttystr("   Syntax: PRINT [filename] [text | asa | machine | fb | vb] [width]\r\n");
+			ttystr("           PRINT [text | asa | machine | fb | vb] [width] |command\r\n");
 			ttystr("   \r\n");
 			ttystr("   When data is received from the host directed to the local\r\n");
 			ttystr("   printer, this option determines whether it will be saved in a\r\n");
@@ -1341,17 +2501,35 @@ int execute()
 			ttystr("   name.  To just display it on the console, use PRINT without a \r\n");
 			ttystr("   filename (which is the default when RJE80 starts).\r\n");
 			ttystr("   \r\n");
+			ttystr("   Normally the file is text, with the host's spacing and skips\r\n");
+			ttystr("   turned into line ends and form feeds.  ASA or MACHINE instead\r\n");
+			ttystr("   writes fixed length records, each a carriage control byte\r\n");
+			ttystr("   followed by the line padded to the printer width (default\r\n");
+			ttystr("   132), with no line ends, for print and archive tools that\r\n");
+			ttystr("   read carriage control themselves.  FB and VB are the same\r\n");
+			ttystr("   records left in EBCDIC (RECFM=FBA, or VBA with a 4 byte RDW\r\n");
+			ttystr("   on each record and no padding), ready to go back to a host.\r\n");
+			ttystr("   \r\n");
+			ttystr("   Everything from a | on is a command instead.  Each\r\n");
+			ttystr("   transmission starts it afresh, with the output on its\r\n");
+			ttystr("   standard input as it arrives and RJE_DEVICE and RJE_STREAM\r\n");
+			ttystr("   in its environment.  If it falls behind, the host is held\r\n");
+			ttystr("   off until it catches up.\r\n");
+			ttystr("   \r\n");
 			ttystr("   Example: PRINT myprintout.txt\r\n");
+			ttystr("            PRINT listing.asa asa 132\r\n");
+			ttystr("            PRINT asa |lpr -P lineprinter\r\n");
 			ttystr("   \r\n");
-			ttystr("   Note: Printer output is always translated to ascii.  It's also\r\n");
-			ttystr("   always displayed on your screen as it's received, unless you\r\n");
-			ttystr("   use a SET NOCOPY command to stop it.\r\n");
+			ttystr("   Note: Printer output is translated to ascii except for FB and\r\n");
+			ttystr("   VB.  It's also always displayed on your screen as it's received,\r\n");
+			ttystr("   unless you use a SET NOCOPY command to stop it.\r\n");
 			return(0);
 		}
 		if (strcmp(token, "PUNCH") == 0 ||
 			strcmp(token, "PU") == 0) {
 			ttystr("\r\n\r\n");
-			ttystr("   Syntax: PUNCH [filename] [ascii | ebcdic] [recl]\r\n");
+			ttystr("   Syntax: PUNCH [filename] [ascii | ebcdic | fb | vb] [recl]\r\n");
+			ttystr("           PUNCH [ascii | ebcdic | fb | vb] [recl] |command\r\n");
 			ttystr("   \r\n");
 			ttystr("   When data is received from the host directed to the local\r\n");
 			ttystr("   punch device, it will be stored in the filename you give\r\n");
@@ -1360,9 +2538,13 @@ int execute()
 			ttystr("   want the data translated to ascii or not, or saved in its\r\n");
 			ttystr("   original EBCDIC form, bit for bit.  If you choose EBCDIC, you \r\n");
 			ttystr("   have the option of giving a record length, which if not given\r\n");
-			ttystr("   defaults to 80 (of course).\r\n");
+			ttystr("   defaults to 80 (of course).  EBCDIC and FB are the same thing,\r\n");
+			ttystr("   cards padded to recl.  VB writes each card as it came, with a\r\n");
+			ttystr("   4 byte record descriptor word in front.  As with PRINT, a\r\n");
+			ttystr("   |command takes each transmission's cards on its standard input.\r\n");
 			ttystr("   \r\n");
 			ttystr("   Example:  PUNCH objectprog.cd ebcdic 80\r\n");
+			ttystr("             PUNCH |gzip > deck.gz\r\n");
 			ttystr("   \r\n");
 			ttystr("   Note: the default punch output file is 'punch.txt' and is\r\n");
 			ttystr("   translated to ascii.\r\n");
@@ -1371,38 +2553,172 @@ int execute()
 		if (strcmp(token, "SEND") == 0 ||
 			strcmp(token, "S") == 0) {
 			ttystr("\r\n\r\n");
-			ttystr("   Syntax: SEND <filename> [ascii | ebcdic] [recl]\r\n");
+			ttystr("   Syntax: SEND <filename> ... [ascii | ebcdic | fb | vb | aws] [recl]\r\n");
+			ttystr("                               [PRIORITY n] [HOST name] [TAG word]\r\n");
+			ttystr("   \r\n");
+			ttystr("   This is the command to send a file to the host.  In most cases\r\n");
+			ttystr("   this means you're submitting JCL to an input queue on the host.\r\n");
+			ttystr("   Unless you specify otherwise, the file is considered to be\r\n");
+			ttystr("   an Ascii text file, which will be translated to EBCDIC before\r\n");
+			ttystr("   being sent.  You can override this by specifying ebcdic as the\r\n");
+			ttystr("   second option.  Normally, records are 80 bytes long.  You can \r\n");
+			ttystr("   change this too, with the recl option.  If you specify * for the\r\n");
+			ttystr("   filename, input will come from the keyboard.  Press CTRL-D and\r\n");
+			ttystr("   ENTER to end input.  * goes on its own, not with files.\r\n");
+			ttystr("   \r\n");
+			ttystr("   EBCDIC files are sent as they are, with no translation:\r\n");
+			ttystr("      ebcdic or fb   fixed length cards, recl bytes each\r\n");
+			ttystr("      vb             each card behind a 4 byte RDW\r\n");
+			ttystr("      aws            an AWS tape image of card blocks, as\r\n");
+			ttystr("                     Hercules writes them\r\n");
+			ttystr("   The format and recl stay in effect for later SENDs.\r\n");
+			ttystr("   \r\n");
+			ttystr("   Example: SEND myfile.txt \r\n");
+			ttystr("            SEND objectdeck.cd ebcdic\r\n");
+			ttystr("            SEND cards.aws aws\r\n");
+			ttystr("            SEND job1.jcl job2.jcl jobs/*.jcl\r\n");
+			ttystr("            SEND *\r\n");
+			ttystr("   \r\n");
+			ttystr("   A FIFO (named pipe) is read as whatever writes it goes along,\r\n");
+			ttystr("   and the line is kept (TTD) while it waits for the next card.\r\n");
+			ttystr("   To send what's piped into rje80 itself, start\r\n");
+			ttystr("   it with --send - [format]; the keyboard is then /dev/tty.\r\n");
+			ttystr("   \r\n");
+			ttystr("   While a file is sent, the position after the last record the\r\n");
+			ttystr("   host acknowledged is kept in <filename>.ckp.  If the send fails,\r\n");
+			ttystr("   the next SEND of the same file resumes after that record when the\r\n");
+			ttystr("   host OS keeps partial decks, otherwise it starts over from card\r\n");
+			ttystr("   one.  See SET CKPT.\r\n");
+			ttystr("   \r\n");
+			ttystr("   You can give several files, and wildcards, to send them all.\r\n");
+			ttystr("   When the host OS splits a transmission into jobs itself (JES2,\r\n");
+			ttystr("   JES3, DOS, RES and OS/360), decks waiting in the queue are sent\r\n");
+			ttystr("   back to back in one transmission, saving a bid and turnaround\r\n");
+			ttystr("   for each.  See SET BATCH.\r\n");
+			ttystr("   \r\n");
+			ttystr("   Note:  You can SEND a file at any time.  If the line is busy, or\r\n");
+			ttystr("   not signed on yet, the file waits in the queue (see QUEUE) and\r\n");
+			ttystr("   goes as soon as the line is ours.  Higher PRIORITY (0 to 9, 4 if\r\n");
+			ttystr("   not given) goes first; CMDs are 8.  If you are sending a file to a VM/370\r\n");
+			ttystr("   user, use the SET USER command to specify the userid, or be sure \r\n");
+			ttystr("   that the cards are preceded by a valid ID card.\r\n");
+			ttystr("   \r\n");
+			ttystr("   With lines to more than one host (see HOST), each deck goes to\r\n");
+			ttystr("   the one HOST names, else the one its route says (see ROUTE),\r\n");
+			ttystr("   else the current one.  TAG gives the decks a tag for routes.\r\n");
+			return(0);
+		}
+		if (strcmp(token, "HOST") == 0 ||
+			strcmp(token, "HO") == 0) {
+			ttystr("\r\n\r\n");
+			ttystr("   Syntax: HOST [<name> | DROP <name>]\r\n");
+			ttystr("   \r\n");
+			ttystr("   RJE80 can have lines to several hosts at once, say an MVS, a\r\n");
+			ttystr("   VM/370 and a DOS/VS, each with its own SET options, print and\r\n");
+			ttystr("   punch files, queue and jobs.  HOST <name> makes that host the\r\n");
+			ttystr("   one commands go to, adding it if it's new; then OPEN, SET and\r\n");
+			ttystr("   SIGNON for it.  The first host is MAIN.  Every line keeps\r\n");
+			ttystr("   running whichever is current, and what a host says comes with\r\n");
+			ttystr("   its name in front.  HOST lists them, with * on the current one;\r\n");
+			ttystr("   HOST DROP closes one and forgets it.  A new host's punch\r\n");
+			ttystr("   file is punch-<name>.txt.\r\n");
+			ttystr("   \r\n");
+			ttystr("   Example: HOST MVS\r\n");
+			ttystr("            OPEN hercules 3780\r\n");
+			ttystr("            SET JES2\r\n");
+			ttystr("            SIGNON RMT1\r\n");
+			ttystr("            HOST VM\r\n");
+			ttystr("            OPEN hercules 3781\r\n");
+			ttystr("            SET VM\r\n");
+			ttystr("            SIGNON *\r\n");
+			return(0);
+		}
+		if (strcmp(token, "CONTROL") == 0 ||
+			strcmp(token, "CON") == 0) {
+			ttystr("\r\n\r\n");
+			ttystr("   Syntax: CONTROL [<socket> | OFF]\r\n");
+			ttystr("   \r\n");
+			ttystr("   Makes a UNIX domain socket that programs on this machine can\r\n");
+			ttystr("   connect to and use the lines through, sharing them with you\r\n");
+			ttystr("   (or start rje80 with --control <socket>).  A program writes\r\n");
+			ttystr("   requests, a line each, and gets back any data lines, then OK\r\n");
+			ttystr("   or ERR and a message:\r\n");
+			ttystr("   \r\n");
+			ttystr("      SUBMIT [options] [file]  a deck: OK host number\r\n");
+			ttystr("      CMD [HOST=name] text     a command: OK host number\r\n");
+			ttystr("      STATUS                   HOST name state os address port\r\n");
+			ttystr("                               queued sending [current]\r\n");
+			ttystr("      JOBS [HOST=name]         JOB host number name jobno state file\r\n");
+			ttystr("      EVENTS [OFF]             EVENT host STATUS state, DONE number\r\n");
+			ttystr("                               rc, OUTPUT PRINT|PUNCH, EOT, and\r\n");
+			ttystr("                               JOB number name jobno, as they happen\r\n");
+			ttystr("   \r\n");
+			ttystr("   SUBMIT takes HOST=, TAG=, PRIORITY=, FORMAT= and RECL=, and is\r\n");
+			ttystr("   routed like SEND.  With no file name, the deck is the oldest\r\n");
+			ttystr("   open file the program has passed (SCM_RIGHTS) and not used yet:\r\n");
+			ttystr("   a file, a memfd or a pipe, read from where it is with nothing\r\n");
+			ttystr("   copied down the socket.  It stays open until it has gone.\r\n");
+			ttystr("   CONTROL shows the socket, CONTROL OFF closes it.\r\n");
+			return(0);
+		}
+		if (strcmp(token, "CACHE") == 0 ||
+			strcmp(token, "CA") == 0) {
+			ttystr("\r\n\r\n");
+			ttystr("   Syntax: CACHE [<KB>] [<directory> | OFF]\r\n");
+			ttystr("   \r\n");
+			ttystr("   Keeps the cards each deck is made into, so a deck sent again\r\n");
+			ttystr("   (the same housekeeping jobs, day after day) goes from them\r\n");
+			ttystr("   instead of being read a line at a time, translated and padded\r\n");
+			ttystr("   all over again.  Decks are found by what's in them, not their\r\n");
+			ttystr("   names, so an edited deck is always made afresh.  Up to <KB>\r\n");
+			ttystr("   (16384) are kept, for every host, those wanted longest ago\r\n");
+			ttystr("   going first.  With a directory they're kept there too, and\r\n");
+			ttystr("   found again by later runs (or start rje80 with --cache <dir>;\r\n");
+			ttystr("   rjesubmit -C <dir> uses them as well).  Decks read from pipes\r\n");
+			ttystr("   aren't cached.  CACHE shows how it's doing, CACHE OFF stops it.\r\n");
+			return(0);
+		}
+		if (strcmp(token, "ROUTE") == 0 ||
+			strcmp(token, "RO") == 0) {
+			ttystr("\r\n\r\n");
+			ttystr("   Syntax: ROUTE [<host> PATH|JOB|CLASS|TAG <pattern> | DROP <n>]\r\n");
 			ttystr("   \r\n");
-			ttystr("   This is the command to send a file to the host.  In most cases\r\n");
-			ttystr("   this means you're submitting JCL to an input queue on the host.\r\n");
-			ttystr("   Unless you specify otherwise, the file is considered to be\r\n");
-			ttystr("   an Ascii text file, which will be translated to EBCDIC before\r\n");
-			ttystr("   being sent.  You can override this by specifying ebcdic as the\r\n");
-			ttystr("   second option.  Normally, records are 80 bytes long.  You can \r\n");
-			ttystr("   change this too, with the recl option.  If you want to specify \r\n");
-			ttystr("   a record length, you'll need to include the second option before\r\n");
-			ttystr("   it (ascii or ebcdic).  If you specify * for the filename, input\r\n");
-			ttystr("   will come from the keyboard.  Press CTRL-D and ENTER to end input.\r\n");
+			ttystr("   Routes send each deck to the right host (see HOST) without\r\n");
+			ttystr("   saying which on the SEND.  The first route a deck matches\r\n");
+			ttystr("   wins; with none, it goes to the current host.  A route can\r\n");
+			ttystr("   match on:\r\n");
 			ttystr("   \r\n");
-			ttystr("   Example: SEND myfile.txt \r\n");
-			ttystr("            SEND objectdeck.cd ebcdic\r\n");
-			ttystr("            SEND *\r\n");
+			ttystr("      PATH   the file name, as given to SEND\r\n");
+			ttystr("      JOB    the name on the deck's first JOB card (//name JOB,\r\n");
+			ttystr("             or * $$ JOB JNM=name for POWER)\r\n");
+			ttystr("      CLASS  that card's CLASS=\r\n");
+			ttystr("      TAG    SEND ... TAG word, or a //*RJE80 TAG word card in\r\n");
+			ttystr("             the deck (* RJE80 TAG word for POWER)\r\n");
 			ttystr("   \r\n");
-			ttystr("   Note:  You can SEND a file at any time.  If printer or punch data\r\n");
-			ttystr("   is being received when you SEND, it will be suspended until the\r\n");
-			ttystr("   transmission is complete.  If you are sending a file to a VM/370\r\n");
-			ttystr("   user, use the SET USER command to specify the userid, or be sure \r\n");
-			ttystr("   that the cards are preceded by a valid ID card.\r\n");
+			ttystr("   Patterns can have * and ?.  The JOB card or tag has to be in\r\n");
+			ttystr("   the first 20 cards.  ROUTE lists the routes, and ROUTE DROP\r\n");
+			ttystr("   takes one out.  Routes can name hosts not added yet.\r\n");
+			ttystr("   \r\n");
+			ttystr("   Example: ROUTE VM PATH vm/*\r\n");
+			ttystr("            ROUTE DOS TAG POWER\r\n");
+			ttystr("            ROUTE MVS JOB *\r\n");
 			return(0);
 		}
 		if (strcmp(token, "STATUS") == 0 ||
 			strcmp(token, "ST") == 0) {
 			ttystr("\r\n\r\n");
 			ttystr("   Syntax: STATUS\r\n");
+			ttystr("           STATUS TIMES [<filename> | RESET]\r\n");
 			ttystr("   \r\n");
 			ttystr("   This command prints out several lines giving you the status of\r\n");
 			ttystr("   your connection.\r\n");
 			ttystr("   \r\n");
+			ttystr("   STATUS TIMES shows how long the host takes to answer: our bids,\r\n");
+			ttystr("   our blocks, idle polls, and the line turning around (from our\r\n");
+			ttystr("   ACK0 to the host's first block, or from its EOT to our bid being\r\n");
+			ttystr("   taken), as percentiles in milliseconds.  With a filename, the\r\n");
+			ttystr("   whole histograms are written to it; RESET starts them again.\r\n");
+			ttystr("   \r\n");
 			return(0);
 		}
 		if (strcmp(token, "SET") == 0 ||
@@ -1415,6 +2731,21 @@ int execute()
 			ttystr("   SET [NO]COPY      Whether or not printer data is displayed\r\n");
 			ttystr("   SET [NO]POLL      Whether or not to poll the line when idle\r\n");
 			ttystr("   SET USER <userid> A VM userid to send the file to\r\n");
+			ttystr("   SET [NO]CKPT      Whether or not to checkpoint file sends\r\n");
+			ttystr("   SET CKPT RESUME   Resume an interrupted send where it stopped\r\n");
+			ttystr("   SET CKPT RESTART  Resend an interrupted deck from card one\r\n");
+			ttystr("   SET BATCH [n]     Send up to n (8) queued decks in one transmission\r\n");
+			ttystr("   SET NOBATCH       Send each deck in a transmission of its own\r\n");
+			ttystr("   SET RVI [n]       Interrupt host output when work of priority n (8)\r\n");
+			ttystr("                     or more is queued\r\n");
+			ttystr("   SET NORVI         Let host output finish first (default)\r\n");
+			ttystr("   SET ML [n]        Sign on as a HASP multileaving workstation with\r\n");
+			ttystr("                     n readers (1); jobs go up while output comes down\r\n");
+			ttystr("   SET NOML          Sign on as a 3780 (default)\r\n");
+			ttystr("   SET [NO]WACK      Whether or not to hold the host off (WACK) while\r\n");
+			ttystr("                     the screen catches up with its output (default on)\r\n");
+			ttystr("   SET [NO]PAGES     Whether or not to keep an index of where each page\r\n");
+			ttystr("                     starts beside print files, as file.pages (off)\r\n");
 			//ttystr("   SET PAUSE nnn     Pause display after every nnn lines\r\n");
 			//ttystr("   SET PAUSE NO      Do not pause display (default) \r\n");
 			//ttystr("   SET PAUSE FF      Pause display on every form feed\r\n");
@@ -1463,6 +2794,30 @@ int nexttoken()
 	return(1);
 }
 
+// A PRINT or PUNCH |command: the rest of the line from the |, taken off
+// it so the words before it can still give the format.  Empty if there
+// isn't one, nonzero if it's too long.
+
+int getpipe(char *cmd)
+{
+	int i, n;
+
+	cmd[0] = 0;
+	for (i = comctr; i < comlen && command[i] != '|'; i++)
+		;
+	if (i >= comlen)
+		return (0);
+	for (n = comlen; n > i + 1 && command[n - 1] == ' '; n--)
+		;
+	if (n - i > 79)
+		return (1);
+	memcpy(cmd, command + i, n - i);
+	cmd[n - i] = 0;
+	command[i] = ' ';
+	comlen = i;
+	return (0);
+}
+
 int gettoken(int upper)
 {
 	int i, j = 0;
@@ -1479,772 +2834,6 @@ int gettoken(int upper)
 	return (0);
 }
 
-// Function to connect to the host
-
-int connecthost() 
-{
-	struct hostent *he;
-	struct sockaddr_in sin;
-	struct in_addr intmp;
-	char thing[80];
-	int rc, wsaerrno;
-	long int non_block = 1;
-
-	he = gethostbyname(inethost);
-	strcpy(hname, inethost);
-	if (he == NULL) {
-		ttystr("\r\nRJE201A Can't locate hostname: ");
-		ttystr(inethost);
-		ttystr("\r\n");
-		return(-1);
-	}
-	memcpy(&host_ip, he->h_addr_list[0], 4);
-	sin.sin_family = AF_INET;
-	sin.sin_addr.s_addr = host_ip;
-	sin.sin_port = htons(inetport);
-	sockfd = socket(AF_INET, SOCK_STREAM, 0);
-#if defined (_WIN32)
-	ioctlsocket (sockfd, FIONBIO, &non_block);
-	rc = connect(sockfd, (struct sockaddr *)&sin, sizeof(sin));
-	if ((rc == SOCKET_ERROR) &&
-		(wsaerrno = WSAGetLastError() != WSAEWOULDBLOCK)) {
-		ttystr("\r\nRJE202S Failed to connect\r\n");
-		ttystr("\r\nRJE202I The winsock error number is ");
-		sprintf(thing, "%d", wsaerrno);
-		ttystr(thing);
-		close(sockfd);
-		status = NOLINK;
-		return (-1);
-	}
-#else
-	rc = fcntl(sockfd, F_GETFL);
-	rc |= O_NONBLOCK;
-	fcntl(sockfd, F_SETFL, rc);
-	rc = connect(sockfd, (struct sockaddr *)&sin, sizeof(sin));
-	if (rc < 0 && errno!= EINPROGRESS) {
-		ttystr("\r\nRJE202S Failed to connect\r\n");
-		perror("RJE202I The reason was: ");
-		close(sockfd);
-		status = NOLINK;
-		return (-1);
-	}
-#endif
-	ttystr("\r\nRJE203I Link established to ");	
-	ttystr(hname);
-	ttystr(" (");
-	intmp.s_addr = host_ip;
-	strcpy(thing, (char *)inet_ntoa(intmp));
-	ttystr(thing);
-	ttystr(") ");
-	ttystr(" port ");
-	sprintf(thing, "%d", inetport);
-	ttystr(thing);
-	ttystr(".");
-	status = INITIAL_WAIT;
-	return (1);
-}
-
-
-// This is the mighty SEND function
-// It's one parameter is a possible command to be sent in place of the file
-
-int send_file(char *command)
-{
-	int rc, i, count = 0, show = 0, retry = 0;
-	char wstr[32];
-	unsigned char cardbuf[512];
-	unsigned char savebuf[512];
-	unsigned char output_data[512];
-
-	strcpy(savebuf, "");
-	if (strlen(command) == 0) {
-		if (strcmp(reader, "*") != 0) {
-			readerfd = fopen(reader, "r");
-			if (readerfd == NULL) {
-				ttystr("\r\nRJE172S Can't open that file, it doesn't exist?\r\n");
-				return (-1);
-			}
-			ttystr("\r\nRJE173I Sending file '");
-			ttystr(reader);
-			ttystr("' to the host.\r\n");
-		} else {
-			ttystr("\r\nRJE174A Enter lines to send, CTRL-D for EOF\r\n");
-		}
-	} else {
-		strcpy(savebuf, command);
-	}
-
-	// Send the initial ENQ and see if the host gives us an ACK0
-	
-	while (retry < 10) {
-		line_out[0] = line_out[1] = SYN;
-		line_out[2] = ENQ;
-		line_out_size = 3;
-		write_buffer();
-		rc = read_data(10, 0, 0);
-		if (rc != 0)
-			break;
-		retry++;	
-	}	
-	if (rc == -1) {
-		ttystr("\r\nRJE175S The line has disconnected.\r\n");
-		ttystr("\r\nRJE176W The connection is now closed.\r\n");
-		status = NOLINK;
-		close(sockfd);
-		return (-1);
-	}
-	if (rc == 0) {
-		ttystr("\r\nRJE177S The host did not respond to our initial greeting.\r\n");
-		return (-1);
-	}
-	if (line_in[0] == NAK || (line_in[0] == DLE && line_in[1] == NAK)) {
-		ttystr("\r\nRJE178S The host says (with a NAK) it's not ready.\r\n");
-		return (-1);
-	}
-	if (line_in[0] != DLE || line_in[1] != ACK0) {
-		return (-1);
-	}
-
-	// HOST appears to want our file
-
-	while (1) {
-		if (show > 9) {
-			show = 0;
-			ttystr("RJE180I ");
-			sprintf(wstr, "%d Records sent.\r", count);
-			ttystr(wstr);
-		}
-		if (strlen(savebuf) == 0) {
-			for (i = 0; i < 512; i++) {cardbuf[i] = 0;}
-			if (strcmp(reader, "*") != 0) {
-				if (reader_fmt == 0) {
-					fgets(cardbuf, 512, readerfd);
-				} else {
-					fread(cardbuf, reader_recl, 1, readerfd);
-				}
-				if (feof(readerfd)) {
-					ttystr("\r\nRJE181I ");
-					sprintf(wstr, "%d Total records sent.", count);
-					ttystr(wstr);
-					fclose(readerfd);
-					line_out[0] = line_out[1] = SYN;
-					line_out[2] = EOT;
-					line_out_size = 3;
-					write_buffer();
-					return (0);
-				}
-			} else {
-				ttygets(cardbuf);
-				if (cardbuf[0] == '\004') {
-					line_out[0] = line_out[1] = SYN;
-					line_out[2] = EOT;
-					line_out_size = 3;
-					write_buffer();
-					return (0);
-				}
-			}
-		} else {
-			strcpy(cardbuf, savebuf);
-			strcpy(savebuf, "");
-		}
-
-		// Handle special VM ID card
-
-		if (opt_os == 1 && reader_fmt == 0 && strlen(command) == 0) {
-			if (count == 0) {
-				for (i = 0; i < 9; i++) {wstr[i] = cardbuf[i];}
-				wstr[10] = 0;
-				if (strcmp(wstr, "ID       ") != 0) {
-					if (strlen(opt_user) > 0) {
-						strcpy(wstr, "ID       ");
-						strcat(wstr, opt_user);
-						strcpy(savebuf, cardbuf);
-						strcpy(cardbuf, wstr);
-					}
-				}
-			}
-		}
-
-		// We have a line of data ... massage it, then send it
-
-		if (reader_fmt == 0 || strlen(command) > 0) {
-			for (i = 0; i < 512; i++) {output_data[i] = 0x20;}
-			for (i = 0; i < strlen(cardbuf); i++) {
-				if (cardbuf[i] != '\n' &&
-				    cardbuf[i] != '\r')
-					output_data[i] = cardbuf[i];
-			}
-			output_data[reader_recl + 1] = 0;
-			translate_to_ebcdic(output_data);
-		} else {
-			for (i = 0; i < reader_recl; i++) {
-				output_data[i] = cardbuf[i];
-			}
-		}
-		line_out[0] = STX;	/* Build the record to transmit */
-		line_out_size = 1;
-		for (i = 0; i < reader_recl; i++) {
-			line_out[line_out_size] = output_data[i];
-			line_out_size++;
-		}
-		line_out[line_out_size] = ETX;
-		line_out_size++;
-		retry = 0;
-		while (1) {
-			write_buffer();			/* Send the data */
-			rc = read_data(10, 0, 0);	/* Get the reply */
-			if (rc == -1) {
-				ttystr("\r\nRJE182S The line has disconnected during the send.\r\n");
-				ttystr("\r\nRJE183W The connection is now closed.\r\n");
-				status = NOLINK;
-				close(sockfd);
-				return (-1);
-			}
-			if (rc == 0) {
-				ttystr("\r\nRJE184S The send timed out, host probably down.\r\n");
-				return (-1);
-			}
-			if (line_in[0] == DLE && line_in[1] == ACK0)
-				break;
-			if (line_in[0] == DLE && line_in[1] == ACK1)
-				break;
-			if (line_in[0] == EOT)
-				break;
-			if (line_in[0] != NAK) {
-				return (-1);
-			}
-			// it was a NAK -- return to try transmit again
-			retry++;
-			if (retry > 10) {
-				ttystr("\r\nRJE186S 10 consecutive NAKs, giving up on send.\r\n");
-				return (-1);
-			}
-		}
-		if (strlen(command) > 0) {
-			line_out[0] = line_out[1] = SYN;
-			line_out[2] = EOT;
-			line_out_size = 3;
-			write_buffer();
-			return (0);
-		}
-		count++;
-		show++;
-	}
-}
-
-
-// ---------------------------------------------------------------------------------
-// This is code supporting the I/O to and from the line
-// ---------------------------------------------------------------------------------
-
-// Socket initialization (Windows only)
-
-int InitSockets()
-{
-#if defined (_WIN32)
-	int err;
-	WORD wVersionRequested;
-	WSADATA wsaData;
-
-	wVersionRequested = MAKEWORD (1, 1); 
-	err = WSAStartup(wVersionRequested, &wsaData);
-	if (err != 0) {
-		printf("\r\nRJE000T Winsock: Startup error number %d\n", err);
-		return (-1);
-	}
-#endif
-	return (0);
-}
-
-// Shutdown Sockets (Windows Only)
-
-int CloseSockets()
-{
-	return (0);
-}
-
-// This function returns the next byte in the bisync input buffer.  If 
-// there are no bytes there, it returns 0.  Once the byte is read,
-// it's cleared from the buffer
-
-unsigned char read_byte()
-{
-	unsigned char r;
-	int i;
-	
-	if (line_in_ctr < 1)		/* Nothing? */
-		return (0);		/* yep -- give up */
-	r = line_in[0];			/* return first byte */
-	line_in_ctr--;			/* and shift down the rest */
-	if (line_in_ctr > 0) {
-		for (i = 0; i < line_in_ctr; i++) {
-			line_in[i] = line_in[i+1];
-		}
-	}
-	return(r);	
-}
-
-// This function polls for data, and if there is some waiting,
-// it returns 1, otherwise it returns 0.
-// the parameters are the timeout values
-
-int read_poll(int sec, int usec)
-{
-	struct timeval tv;
-	fd_set readfdset;
-	tv.tv_sec = sec;			/* Set timeout value */
-	tv.tv_usec = usec;
-	FD_ZERO(&readfdset);
-	FD_SET(sockfd, &readfdset);
-	select(sockfd+1, &readfdset, NULL, NULL, &tv);
-	if (FD_ISSET(sockfd, &readfdset)) 	/* Data ready? */
-		return (1);
-	return (0);
-}
-
-
-// This is the read data function.  It listens on the line for data,
-// and returns when it's got a bisync unpend character.  Those are:  
-// ENQ, EOT, ETB, ETX.
-// If we are in eib mode, NAK, ACK0, and ACK1
-// are also unpend characters.
-//
-// The first two parameters are the timeout values, in seconds 
-// and microseconds.  The third parameter determines if we are
-// in eib (0), text (1), or transparent (2) mode.  The difference
-// is when to end the read:  ACK0, ACK1, and NAK unpend in eib
-// mode but not in the other two.  (eib mode is the mode when
-// text is not being sent but controls are).
-// Returns: -1 if the line is disconnected
-//           0 if the read timed out
-//           number of bytes read if otherwise
-
-int read_data(int sec, int usec, int mode)
-{
-	int rc, i, j, k, unpend;
-	char wstr[64];
-	char traceline[1024];
-	char transline[1024];
-	struct timeval tv;
-	fd_set readfdset;
-
-
-	strcpy(traceline, "");
-	clear_input_buffer();
-	while (1) {
-		tv.tv_sec = sec;			/* Set timeout value */
-		tv.tv_usec = usec;
-		FD_ZERO(&readfdset);
-		FD_SET(sockfd, &readfdset);
-		select(sockfd+1, &readfdset, NULL, NULL, &tv);
-		if (FD_ISSET(sockfd, &readfdset)) {	/* Data ready? */
-			rc = get_buffer();		/* We have data */
-			if (rc < 0)			/* No we dont - disconnect */
-				return (-1);
-		} else {
-			return (0);			/* We timed out */
-		}
-
-		// Copy from the physical buffer to the logical,
-		// stop when you hit an unpend character.  If the
-		// buffer empties without one, keep looking, other
-		// wise return to the caller.
-
-		unpend = 0;
-		for (i = 0; i < phy_ctr; i++) {
-			line_in[line_in_ctr] = phybuffer[i];
-			line_in_ctr++;
-			if (phybuffer[i] == ENQ ||
-			    phybuffer[i] == EOT ||
-			    phybuffer[i] == ETX ||
-			    phybuffer[i] == ETB) {
-				unpend = 1;
-				break;
-			}
-			if (mode == 0 && (phybuffer[i] == NAK ||
-				phybuffer[i] == ACK0 ||
-				phybuffer[i] == ACK1)) {
-				unpend = 1;
-				break;
-			}
-		}
-		if (i < phy_ctr) {
-			k = 0;	/* shift stuff still in buffer down */
-			for(j = i; j < phy_ctr; j++) {
-				phybuffer[k] = phybuffer[j];
-				phybuffer[j] = 0;
-			}
-			phy_ctr = k;
-		} else {
-			phy_ctr = 0;
-		}	
-		if (unpend == 1)
-			break;
-	}
-	if (strlen(tracefile) > 0) {
-		for (i = 0; i < 1024; i++) {transline[i] = 0;}
-		for (i = 0; i < 1024; i++) {traceline[i] = 0;}
-		for (i = 0; i < line_in_ctr; i++) {
-			transline[i] = line_in[i];
-		}
-		translate_to_ascii(transline);
-		strcpy(traceline, "RECV: ");
-		j = 6;
-		for (i = 0; i < line_in_ctr; i++) {
-			if (isprint(transline[i]) && transline[i] > 0x1f) {
-				traceline[j] = transline[i];
-				j++;
-			} else {
-				traceline[j] = ' ';
-				j++;
-			}
-		}
-		strcat(traceline, "\n");
-		fputs(traceline, tracefd);
-		strcpy(traceline, "      ");
-		j = 6;
-		for (i = 0; i < line_in_ctr; i++) {
-			sprintf(wstr, "%02x", line_in[i]);
-			traceline[j] = wstr[0];
-			j++;
-		}
-		//strcat(traceline, "\n");
-		fputs(traceline, tracefd);
-		strcpy(traceline, "      ");
-		j = 6;
-		for (i = 0; i < line_in_ctr; i++) {
-			sprintf(wstr, "%02x", line_in[i]);
-			traceline[j] = wstr[1];
-			j++;
-		}
-		strcat(traceline, "\n");
-		fputs(traceline, tracefd);
-	}
-	return (line_in_ctr);
-}
-
-// This function tries to read something from the line.  Whatever
-// it reads, it adds to the physical buffer (phybuffer).  It returns
-// the number of characters added to the buffer, or -1 if an error.
-
-
-int get_buffer()
-{
-	int i, rc, err, count;
-	char wstr[64];
-	unsigned char inbuffer[256];
-	
-	if (status == NOLINK || status == SHUTDOWN)
-		return (-1);
-
-	rc = recv(sockfd, inbuffer, 256, 0);
-	if (rc == 0) return (-1);	/* disconnect */
-
-#if defined (_WIN32)			// Windows
-
-	if (rc == SOCKET_ERROR) {
-		err = WSAGetLastError();
-		if (err == WSAEWOULDBLOCK)
-			return (0);			/* no data */
-		printf("\nWindows socket error: %d\n", err);
-		return (-1);
-	}
-
-#else					// Linux
-
-	if (rc < 0 && errno == EAGAIN)
-		rc = 0;			/* No data */
-#endif
-
-	count = 0;
-	if (rc > 0) {
-		if (debugit)
-			ttystr("\r\nData received: ");
-		for (i = 0; i < rc; i++) {	/* Consider each character */
-			if (inbuffer[i] == SYN || inbuffer[i] == EPAD || inbuffer[i] == SPAD)
-				continue;
-			if (debugit) {	
-				sprintf(wstr,"%2x",inbuffer[i]);
-				ttystr(wstr);
-			}		
-			phybuffer[phy_ctr] = inbuffer[i];
-			phy_ctr++;
-			count++;
-		}
-	}
-
-	if (rc < 0)
-		return (-1);
-	return (count);		
-}
-
-
-
-// Clear the input buffer
-
-int clear_input_buffer()
-{
-	int i;
-	
-	for (i = 0; i < 1024; i++) {
-		line_in[i] = 0;
-	}
-	line_in_ctr = 0;
-	return (0);	
-}
-
-// Clear the input record
-
-int clear_input_record()
-{
-	int i;
-	
-	for (i = 0; i < 1024; i++) {
-		record_in[i] = 0;
-	}
-	record_ctr = 0;
-	return (0);	
-}
-
-// Write the data record to the output file
-
-int write_record()
-{
-	char output_data[512];
-	char print_line[256];
-	unsigned char printer_action;
-	int i, j, h;
-	
-	for (i = 0; i < 512; i++) {output_data[i] = 0;}
-	if (device_select == 0) {
-		if (strlen(print) > 0 && print_open == 0) {
-			print_open = 1;
-			printfd = fopen(print, "a");
-		}
-
-		// Is this is horizontal tabs record?  If so store it.
-
-		if (record_in[0] == 0x27 && record_in[1] == 0x05) {
-			for (i = 0; i < 256; i++) {htabs[i] = 0;}
-			j = 2;
-			for (i = 0; i < 256; i++) {
-				if (record_in[j] != 0x40 &&
-				    record_in[j] != 0x05)
-					break;
-				htabs[i] = record_in[j];
-				j++;
-			}
-			i = 0;
-			while (j < record_ctr) {
-				record_in[i] = record_in[j];
-				i++;
-				j++;
-			}
-			record_ctr = i;
-			if (i < 1)
-				return (0);	/* DO NOT print it */
-		}
-
-
-		// check for vertical forms controls and store if found
-
-		j = 0;
-		for (i = 0; i < record_ctr; i++) {
-			switch (record_in[i]) {
-			case 0x27: 
-				i++;
-				printer_action = record_in[i];
-				break;
-			case 0x05:
-				while (1) {
-					output_data[j] = 0x40;
-					j++;
-					if (htabs[j] != 0x40)
-						break;
-				}
-				break;
-			default:
-				output_data[j] = record_in[i];
-				j++;
-				break;
-			}
-		}
-		translate_to_ascii(output_data);
-		j = strlen(output_data);
-		while (output_data[j] == ' ' && j > 1) {
-			output_data[j] = 0;
-			j--;
-		}
-		switch(printer_action) {
-			case 0x61:	/* single space */
-				strcpy(print_line, "\r\n");
-				break;
-			case 0xe2:	/* double space */
-				strcpy(print_line, "\r\n\r\n");
-				break;
-			case 0xe3:	/* triple space */
-				strcpy(print_line, "\r\n\r\n\r\n");
-				break;
-			case 0xc1:	/* Top of page */
-				strcpy(print_line, "\r\n\014");
-				break;
-			case 0xd4:	/* Suppress spacing */
-				strcpy(print_line, "\r");
-				break;
-			default:
-				strcpy(print_line, "\r\n");
-				break;
-		}
-		strcat(print_line, output_data);
-		if (strlen(print) == 0) {
-			ttystr(print_line);
-		} else {
-			fputs(print_line, printfd);
-		}
-	} else {
-		if (strlen(punch) > 0 && punch_open == 0) {
-			punch_open = 1;
-			punchfd = fopen(punch, "a");
-		}
-
-		for (i = 0; i < punch_recl; i++) {
-			if (i <= record_ctr)
-				output_data[i] = record_in[i];
-			else
-				output_data[i] = 0x40;
-		}
-		if (punch_fmt == 1) {
-			fwrite(output_data, punch_recl, 1, punchfd);
-		} else {
-			translate_to_ascii(output_data);
-			j = strlen(output_data);
-			while (output_data[j] == ' ' && j > 1) {
-				output_data[j] = 0;
-				j--;
-			}
-			strcat(output_data, "\n");
-			fputs(output_data, punchfd);
-		}
-	}
-	clear_input_record();	
-	return (0);
-}
-
-
-// Write the output buffer to the line 
-
-int write_buffer()
-{
-	int i, j, rc;
-	char diswrite[1024];
-	char hexch[32];
-	char wstr[32];
-	char traceline[1024];
-	char transline[1024];
-	unsigned char trndata[1024];
-	int xlate = 0;
-
-	strcpy(traceline, "");
-	if (opt_trn == 1) {	// transparent?
-		j = 0;		// yes -- insert DLEs
-		for (i = 0; i < line_out_size; i++) {
-			if (line_out[i] == STX)
-				xlate = 1;
-			if (line_out[i] < 0x40 &&
-				xlate == 1) {
-				trndata[j] = DLE;
-				j++;
-			}
-			if (line_out[i] == ETX)
-				xlate = 0;
-			trndata[j] = line_out[i];
-			j++;
-		}
-		for (i = 0; i < j; i++) {
-			line_out[i] = trndata[i];
-		}
-		line_out_size = j;
-	}
-	rc = send(sockfd, line_out, line_out_size, 0);
-	if (debugit) {
-		strcpy(diswrite, "");
-		for (i = 0; i < rc; i++) {
-			sprintf(hexch, "%02x", line_out[i]);
-			strcat(diswrite, hexch);
-		}
-		ttystr("\r\nWrote (");
-		sprintf(hexch, "%d bytes):", rc);
-		ttystr(hexch);
-		ttystr(diswrite);	
-		if (rc != line_out_size) {
-			ttystr(" INCOMPLETE WRITE, ");
-			sprintf(hexch, "%d%", (line_out_size - rc));
-			ttystr(hexch);
-			ttystr(" short!");
-		}
-	}	
-	if (strlen(tracefile) > 0) {
-		for (i = 0; i < 1024; i++) {transline[i] = 0;}
-		for (i = 0; i < 1024; i++) {traceline[i] = 0;}
-		for (i = 0; i < line_out_size; i++) {
-			transline[i] = line_out[i];
-		}
-		translate_to_ascii(transline);
-		strcpy(traceline, "SEND: ");
-		j = 6;
-		for (i = 0; i < line_out_size; i++) {
-			if (isprint(transline[i]) && transline[i] > 0x1f) {
-				traceline[j] = transline[i];
-				j++;
-			} else {
-				traceline[j] = ' ';
-				j++;
-			}
-		}
-		strcat(traceline, "\n");
-		fputs(traceline, tracefd);
-		strcpy(traceline, "      ");
-		j = 6;
-		for (i = 0; i < line_out_size; i++) {
-			sprintf(wstr, "%02x", line_out[i]);
-			traceline[j] = wstr[0];
-			j++;
-		}
-		//strcat(traceline, "\n");
-		fputs(traceline, tracefd);
-		strcpy(traceline, "      ");
-		j = 6;
-		for (i = 0; i < line_out_size; i++) {
-			sprintf(wstr, "%02x", line_out[i]);
-			traceline[j] = wstr[1];
-			j++;
-		}
-		strcat(traceline, "\n");
-		fputs(traceline, tracefd);
-	}
-	return (0);
-}
-
-// Send an ACK after a record is received
-
-int send_ack(char ack)
-{
-	line_out[0] = line_out[1] = SYN;	/* Tell remote we're OK */
-	line_out[2] = DLE;
-	if (ack == 0) {
-		if (lastack == ACK0)	/* Be sure and send correct ACK */
-			lastack = ACK1;
-			else
-			lastack = ACK0;
-	} else {
-		lastack = ack;
-	}			
-	line_out[3] = lastack;
-	line_out_size = 4;
-	write_buffer();
-	return (0);
-}
-
 // ---------------------------------------------------------------------------------
 // This is the TTY code -- mostly from SIMH -- that handles I/O to the local tty
 // -----------------------------------------------------------------------------
@@ -2327,9 +2916,9 @@ int rjesleep(int t)
 // 1. Init the local TTY
 
 int ttyinit() {
-	if (!isatty (fileno (stdin))) 
+	if (ttyfd < 0 || !isatty (ttyfd))
 		return (0);			/* skip if !tty */
-	if (tcgetattr (0, &cmdtty) < 0) {
+	if (tcgetattr (ttyfd, &cmdtty) < 0) {
 		ttychar('!');
 		return (1);			/* get old flags */
 	}	
@@ -2348,7 +2937,7 @@ int ttyinit() {
 	runtty.c_cc[VSTOP] = 0;
 	runtty.c_cc[VMIN] = 0;					/* no waiting */
 	runtty.c_cc[VTIME] = 0;
-	if (tcsetattr (0, TCSAFLUSH, &runtty) < 0) return (1);
+	if (tcsetattr (ttyfd, TCSAFLUSH, &runtty) < 0) return (1);
 	return (0);
 }	
 
@@ -2356,7 +2945,7 @@ int ttyinit() {
 
 int ttyclose()
 {
-	if (tcsetattr (0, TCSAFLUSH, &cmdtty) < 0) return (1);
+	if (ttyfd < 0 || tcsetattr (ttyfd, TCSAFLUSH, &cmdtty) < 0) return (1);
 	return (0);
 }
 
@@ -2392,7 +2981,9 @@ int ttyread(unsigned char buf[])
 {
 	int r;
 
-	r = read(0, buf, 1);
+	if (ttyfd < 0)
+		return (0);
+	r = read(ttyfd, buf, 1);
 	return (r);
 }
 
@@ -2424,41 +3015,3 @@ int rjesleep(int t)
 }
 
 #endif
-
-// ------------------------------------------------------------------------------
-// Code translation services
-// ------------------------------------------------------------------------------
-
-/*-------------------------------------------------------------------*/
-/* SUBROUTINE TO TRANSLATE A NULL-TERMINATED STRING TO EBCDIC        */
-/*-------------------------------------------------------------------*/
-char *translate_to_ebcdic (unsigned char *str)
-{
-int     i;                              /* Array subscript           */
-unsigned char c;                        /* Character work area       */
-
-    for (i = 0; str[i] != '\0'; i++)
-    {
-        c = str[i];
-        str[i] = ascii_to_ebcdic[c];
-    }
-
-    return str;
-}
-
-/*-------------------------------------------------------------------*/
-/* SUBROUTINE TO TRANSLATE A NULL-TERMINATED STRING TO ASCII         */
-/*-------------------------------------------------------------------*/
-char *translate_to_ascii (unsigned char *str)
-{
-int     i;                              /* Array subscript           */
-unsigned char c;                        /* Character work area       */
-
-    for (i = 0; str[i] != '\0'; i++)
-    {
-        c = str[i];
-        str[i] = ebcdic_to_ascii[c];
-    }
-
-    return str;
-}
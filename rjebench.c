@@ -0,0 +1,371 @@
+//  rjebench - time the paths every byte to and from the host goes through,
+//  so a change meant to make one of them faster comes with numbers.
+//
+//	translate	translate_to_ebcdic / translate_to_ascii of a card
+//	receive		recv_char over a host transmission of print lines
+//	receive_indexed	... with the lines going to the INDEX thread as well
+//	write_record	a print line out in each print file format
+//	write_buffer	a card block with transparency DLEs put in
+//	trace		trace_line of a block
+//	ml_pack		a card squeezed into multileaving SCBs, and back
+//	index_find	FIND of a word and a word* that matches many, in an
+//			output of 500 lines
+//	read_deck	a text deck opened and read through, as a send does
+//	read_deck_cached  ... with a deck cache (CACHE) that has it
+//
+//  Each runs for a fixed time and reports records (cards, lines, blocks)
+//  a second and MB a second of data through it.  Anything that would go
+//  to a file or the line goes to /dev/null, or to a closed socket that
+//  fails at once, so it's the formatting that's timed.
+//
+//  librje80.c is included here, rather than linked, to get at its
+//  static functions.  Build with make bench, or:
+//
+//      cc -O2 -o rjebench rjebench.c rjeforms.c rjereader.c rjehasp.c rjehist.c rjejobs.c rjesink.c rjeindex.c rjedeck.c -lpthread
+//
+//  Usage: rjebench [-t msec] [name ...]
+
+#include "librje80.c"
+
+#define BENCH_TIME 500		/* default msec for each */
+#define PRINT_LINES 64		/* lines in the receive transmission */
+#define DECK_CARDS 200		/* cards in the read_deck deck */
+#define FIND_LINES 500		/* lines in the index_find output */
+
+struct bench {
+	char *name;
+	long (*fn)(struct rje_session *s, long *bytes);	/* one round */
+};
+
+static long bench_xlate(struct rje_session *s, long *bytes);
+static long bench_receive(struct rje_session *s, long *bytes);
+static long bench_rindex(struct rje_session *s, long *bytes);
+static long bench_record(struct rje_session *s, long *bytes, int fmt);
+static long bench_text(struct rje_session *s, long *bytes);
+static long bench_asa(struct rje_session *s, long *bytes);
+static long bench_machine(struct rje_session *s, long *bytes);
+static long bench_fba(struct rje_session *s, long *bytes);
+static long bench_buffer(struct rje_session *s, long *bytes);
+static long bench_trace(struct rje_session *s, long *bytes);
+static long bench_mlpack(struct rje_session *s, long *bytes);
+static long bench_find(struct rje_session *s, long *bytes);
+static int bench_found(struct rje_idxhit *h, void *arg);
+static long bench_deck(struct rje_session *s, long *bytes);
+static long bench_cached(struct rje_session *s, long *bytes);
+static long bench_read(struct rje_decks *c, long *bytes);
+static struct rje_session *bench_session();
+static int bench_msg(struct rje_session *s, char *msg);
+
+static struct bench benches[] = {
+	{"translate", bench_xlate},
+	{"receive", bench_receive},
+	{"receive_indexed", bench_rindex},
+	{"write_record_text", bench_text},
+	{"write_record_asa", bench_asa},
+	{"write_record_machine", bench_machine},
+	{"write_record_fba", bench_fba},
+	{"write_buffer", bench_buffer},
+	{"trace", bench_trace},
+	{"ml_pack", bench_mlpack},
+	{"index_find", bench_find},
+	{"read_deck", bench_deck},
+	{"read_deck_cached", bench_cached},
+	{NULL, NULL}
+};
+
+// A print line: JCL listing, much as JES2 sends it
+
+static const char sample[] =
+	"        1 //BENCH    JOB  (ACCT),'PRINT TEST',CLASS=A,MSGCLASS=X     "
+	"                  JOB 123   00010000  IEF142I BENCH STEP1 - STEP WAS EX";
+
+static char deck[64];		/* read_deck's deck, made the first time */
+static char findidx[64];	/* ... and index_find's index */
+
+int main(int argc, char *argv[])
+{
+	struct rje_session *s;
+	struct bench *b;
+	long long start, now;
+	long n, bytes, round;
+	int i, msec = BENCH_TIME, any;
+
+	if (argc > 2 && strcmp(argv[1], "-t") == 0) {
+		msec = atoi(argv[2]);
+		argc -= 2;
+		argv += 2;
+	}
+	printf("%-22s %14s %10s\n", "benchmark", "records/s", "MB/s");
+	for (b = benches; b->name != NULL; b++) {
+		for (i = 1, any = (argc == 1); i < argc; i++) {
+			if (strcmp(argv[i], b->name) == 0 ||
+				strncmp(b->name, argv[i], strlen(argv[i])) == 0)
+				any = 1;
+		}
+		if (!any)
+			continue;
+		s = bench_session();
+		n = bytes = 0;
+		b->fn(s, &round);	/* warm up */
+		start = rje_uclock();
+		do {
+			for (i = 0; i < 100; i++) {
+				n += b->fn(s, &round);
+				bytes += round;
+			}
+			now = rje_uclock();
+		} while (now - start < msec * 1000LL);
+		printf("%-22s %14.0f %10.1f\n", b->name,
+			n * 1000000.0 / (now - start),
+			bytes / 1.048576 / (now - start));
+		rje_free(s);
+	}
+	if (strlen(deck) > 0)
+		remove(deck);
+	if (strlen(findidx) > 0)
+		remove(findidx);
+	return (0);
+}
+
+// A session with nowhere to send and print going to /dev/null
+
+static struct rje_session *bench_session()
+{
+	struct rje_session *s;
+
+	s = rje_new();
+	s->msgfn = bench_msg;
+	s->status = RECEIVING;
+	s->sockfd = -1;
+	strcpy(s->print, "/dev/null");
+	strcpy(s->punch, "/dev/null");
+	return (s);
+}
+
+static int bench_msg(struct rje_session *s, char *msg)
+{
+	return (0);
+}
+
+// An 80 column card there and back (static, so the compiler can't see
+// that nothing looks at it afterwards)
+
+static long bench_xlate(struct rje_session *s, long *bytes)
+{
+	static unsigned char card[81];
+
+	memcpy(card, sample, 80);
+	card[80] = 0;
+	translate_to_ebcdic(card);
+	translate_to_ascii(card);
+	*bytes = 160;
+	return (2);
+}
+
+// One host transmission: STX, then ESC action, line, IRS for each print
+// line, ETB at the end, taken a character at a time as rje_poll does
+
+static long bench_receive(struct rje_session *s, long *bytes)
+{
+	static unsigned char blk[PRINT_LINES * (sizeof(sample) + 3) + 2];
+	static int len = 0;
+	int i;
+
+	if (len == 0) {
+		blk[len++] = STX;
+		for (i = 0; i < PRINT_LINES; i++) {
+			blk[len++] = ESC;
+			blk[len++] = 0x61;
+			memcpy(blk + len, sample, sizeof(sample) - 1);
+			blk[len + sizeof(sample) - 1] = 0;
+			translate_to_ebcdic(blk + len);
+			len += sizeof(sample) - 1;
+			blk[len++] = IRS;
+		}
+		blk[len++] = ETB;
+	}
+	for (i = 0; i < len; i++)
+		recv_char(s, blk[i]);
+	*bytes = len;
+	return (PRINT_LINES);
+}
+
+// The same with an index kept (of nothing: its segments go to /dev/null)
+
+static long bench_rindex(struct rje_session *s, long *bytes)
+{
+	if (s->index == NULL)
+		rje_set_index(s, "/dev/null");
+	return (bench_receive(s, bytes));
+}
+
+// One print line into the print file, in a given format
+
+static long bench_record(struct rje_session *s, long *bytes, int fmt)
+{
+	s->print_fmt = fmt;
+	s->device_select = 0;
+	s->record_in[0] = ESC;
+	s->record_in[1] = 0x61;
+	memcpy(s->record_in + 2, sample, sizeof(sample) - 1);
+	s->record_in[sizeof(sample) + 1] = 0;
+	translate_to_ebcdic(s->record_in + 2);
+	s->record_ctr = sizeof(sample) + 1;
+	write_record(s);
+	*bytes = sizeof(sample) + 1;
+	return (1);
+}
+
+static long bench_text(struct rje_session *s, long *bytes)
+{
+	return (bench_record(s, bytes, 0));
+}
+
+static long bench_asa(struct rje_session *s, long *bytes)
+{
+	return (bench_record(s, bytes, 1));
+}
+
+static long bench_machine(struct rje_session *s, long *bytes)
+{
+	return (bench_record(s, bytes, 2));
+}
+
+static long bench_fba(struct rje_session *s, long *bytes)
+{
+	return (bench_record(s, bytes, 3));
+}
+
+// A card block, binary so a good many bytes need a DLE in front
+
+static long bench_buffer(struct rje_session *s, long *bytes)
+{
+	int i;
+
+	s->opt_trn = 1;
+	s->line_out[0] = STX;
+	for (i = 0; i < 80; i++)
+		s->line_out[1 + i] = (unsigned char) (i * 7);
+	s->line_out[81] = ETX;
+	s->line_out_size = 82;
+	write_buffer(s);
+	*bytes = 82;
+	return (1);
+}
+
+// The same block into the trace
+
+static long bench_trace(struct rje_session *s, long *bytes)
+{
+	unsigned char blk[82];
+	int i;
+
+	if (strlen(s->tracefile) == 0)
+		rje_trace(s, "/dev/null");
+	blk[0] = STX;
+	memcpy(blk + 1, sample, 80);
+	blk[81] = ETX;
+	for (i = 1; i < 81; i++)
+		blk[i] = ascii_to_ebcdic[blk[i]];
+	trace_line(s, "SEND: ", blk, sizeof(blk));
+	*bytes = sizeof(blk);
+	return (1);
+}
+
+// A card squeezed into SCBs and out again
+
+static long bench_mlpack(struct rje_session *s, long *bytes)
+{
+	unsigned char card[80], blk[200], back[80];
+	int used;
+
+	memcpy(card, sample, 80);
+	rje_ml_pack(blk, sizeof(blk), card, 80);
+	rje_ml_unpack(blk, sizeof(blk), back, sizeof(back), &used);
+	*bytes = 160;
+	return (2);
+}
+
+// FIND AA B* in an output with AA BX0 on its first line, then BXn BYn on
+// each of the rest: B* matches a word a line, so its lines are merged
+// in the search's scratch lists, growing them, while the lines AA is on
+// are being kept there too.  Only the first line has both.
+
+static long bench_find(struct rje_session *s, long *bytes)
+{
+	struct rje_index *x;
+	char line[64];
+	long hits = 0;
+	int i;
+
+	if (strlen(findidx) == 0) {
+		sprintf(findidx, "/tmp/rjebench%d.idx", (int) getpid());
+		remove(findidx);
+		if ((x = rje_index_open(findidx, ebcdic_to_ascii)) == NULL)
+			return (0);
+		for (i = 0; i < FIND_LINES; i++) {
+			if (i == 0)
+				strcpy(line, "AA BX0");
+			else
+				sprintf(line, "BX%d BY%d", i, i);
+			rje_index_line(x, 0, (unsigned char *) line, strlen(line),
+				i == 0, 0);
+		}
+		rje_index_end(x, 0, "BENCH", 1, "/dev/null");
+		rje_index_close(x);
+	}
+	if (rje_index_find(findidx, "AA B*", bench_found, &hits) != 1 ||
+		hits != 1) {
+		fprintf(stderr, "index_find: AA B* found the wrong lines\n");
+		exit(1);
+	}
+	*bytes = FIND_LINES * 10;
+	return (FIND_LINES);
+}
+
+static int bench_found(struct rje_idxhit *h, void *arg)
+{
+	*(long *) arg = h->count;
+	return (0);
+}
+
+// A text deck of JCL opened and read through to the end, card by card
+
+static long bench_deck(struct rje_session *s, long *bytes)
+{
+	return (bench_read(NULL, bytes));
+}
+
+static long bench_cached(struct rje_session *s, long *bytes)
+{
+	static struct rje_decks *c = NULL;
+
+	if (c == NULL)
+		c = rje_decks_open(0, NULL);
+	return (bench_read(c, bytes));
+}
+
+static long bench_read(struct rje_decks *c, long *bytes)
+{
+	struct rje_reader r;
+	unsigned char card[80];
+	FILE *fd;
+	int i, n = 0;
+
+	if (strlen(deck) == 0) {
+		sprintf(deck, "/tmp/rjebench%d.jcl", (int) getpid());
+		if ((fd = fopen(deck, "w")) == NULL)
+			return (0);
+		for (i = 0; i < DECK_CARDS; i++)
+			fprintf(fd, "//STEP%-4d EXEC PGM=IEFBR14,PARM='HOUSEKEEPING %d'\n",
+				i, i);
+		fclose(fd);
+	}
+	if (rje_decks_reader(c, &r, deck, RDR_ASCII, 80, ascii_to_ebcdic) != 0)
+		return (0);
+	while (rje_reader_get(&r, card) > 0)
+		n++;
+	rje_reader_close(&r);
+	*bytes = n * 80L;
+	return (n);
+}
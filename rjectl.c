@@ -0,0 +1,378 @@
+//  rjectl - the control socket: connections, requests a line at a time,
+//  files passed with them, and replies and events going back (see
+//  rjectl.h).
+//
+//  Nothing here waits.  The listening socket and the connections are
+//  non-blocking, what a program is sent is buffered until it reads it,
+//  and a program that lets RJE_CTL_OUT of it pile up is cut off rather
+//  than holding up the lines.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "rjectl.h"
+
+#if defined (_WIN32)
+
+int rje_ctl_open(struct rje_ctl *c, char *path)
+{
+	c->fd = -1;
+	return (-1);
+}
+
+int rje_ctl_fds(struct rje_ctl *c, void *fds, int max)
+{
+	return (max);
+}
+
+int rje_ctl_poll(struct rje_ctl *c)
+{
+	return (0);
+}
+
+int rje_ctl_reply(struct rje_ctl *c, int n, char *line)
+{
+	return (-1);
+}
+
+int rje_ctl_takefd(struct rje_ctl *c, int n)
+{
+	return (-1);
+}
+
+int rje_ctl_watch(struct rje_ctl *c, int n, int on)
+{
+	return (0);
+}
+
+int rje_ctl_event(struct rje_ctl *c, char *line)
+{
+	return (0);
+}
+
+int rje_ctl_close(struct rje_ctl *c)
+{
+	return (0);
+}
+
+#else
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <sys/un.h>
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0		/* SIGPIPE it is, then */
+#endif
+
+static int conn_read(struct rje_ctl *c, int n);
+static int conn_flush(struct rje_ctlconn *k);
+static int conn_drop(struct rje_ctlconn *k);
+
+// Listen on path, taking it over if an rje80 that's gone left it
+// behind.  Returns 0, or -1 if it can't, or path is a file or anything
+// else that isn't a socket.
+
+int rje_ctl_open(struct rje_ctl *c, char *path)
+{
+	struct sockaddr_un sun;
+	struct stat st;
+	int i, fd;
+
+	c->fd = -1;
+	for (i = 0; i < RJE_CTL_CONNS; i++)
+		c->conn[i].fd = -1;
+	if (strlen(path) >= sizeof(sun.sun_path) ||
+		strlen(path) >= sizeof(c->path))
+		return (-1);
+	memset(&sun, 0, sizeof(sun));
+	sun.sun_family = AF_UNIX;
+	strcpy(sun.sun_path, path);
+
+	// Someone listening there already?  Then it isn't ours to take.
+	// Nor is anything there that isn't a socket.
+
+	if (lstat(path, &st) == 0) {
+		if (!S_ISSOCK(st.st_mode))
+			return (-1);
+		if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0)
+			return (-1);
+		if (connect(fd, (struct sockaddr *) &sun, sizeof(sun)) == 0) {
+			close(fd);
+			return (-1);
+		}
+		close(fd);
+		unlink(path);
+	}
+
+	if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0)
+		return (-1);
+	if (bind(fd, (struct sockaddr *) &sun, sizeof(sun)) != 0 ||
+		listen(fd, 8) != 0) {
+		close(fd);
+		return (-1);
+	}
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+	fcntl(fd, F_SETFD, FD_CLOEXEC);
+	c->fd = fd;
+	strcpy(c->path, path);
+	return (0);
+}
+
+// Add the socket and connections to fds (an fd_set) for select.  Returns
+// the highest fd, or max if that's higher.
+
+int rje_ctl_fds(struct rje_ctl *c, void *fds, int max)
+{
+	int i;
+
+	if (c->fd < 0)
+		return (max);
+	FD_SET(c->fd, (fd_set *) fds);
+	if (c->fd > max)
+		max = c->fd;
+	for (i = 0; i < RJE_CTL_CONNS; i++) {
+		if (c->conn[i].fd < 0)
+			continue;
+		FD_SET(c->conn[i].fd, (fd_set *) fds);
+		if (c->conn[i].fd > max)
+			max = c->conn[i].fd;
+	}
+	return (max);
+}
+
+// Take new connections, hand each request that's all in to reqfn, and
+// send what's waiting to go.  Returns the number of requests.
+
+int rje_ctl_poll(struct rje_ctl *c)
+{
+	struct rje_ctlconn *k;
+	int i, fd, reqs = 0;
+
+	if (c->fd < 0)
+		return (0);
+	while ((fd = accept(c->fd, NULL, NULL)) >= 0) {
+		for (i = 0; i < RJE_CTL_CONNS && c->conn[i].fd >= 0; i++)
+			;
+		if (i == RJE_CTL_CONNS) {
+			close(fd);	/* full up */
+			continue;
+		}
+		k = &c->conn[i];
+		memset(k, 0, sizeof(struct rje_ctlconn));
+		if ((k->out = (char *) malloc(RJE_CTL_OUT)) == NULL) {
+			close(fd);
+			continue;
+		}
+		fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+		fcntl(fd, F_SETFD, FD_CLOEXEC);
+		k->fd = fd;
+	}
+	for (i = 0; i < RJE_CTL_CONNS; i++) {
+		if (c->conn[i].fd < 0)
+			continue;
+		reqs += conn_read(c, i);
+		if (c->conn[i].fd >= 0)
+			conn_flush(&c->conn[i]);
+	}
+	return (reqs);
+}
+
+// Send connection n a line (the \n is added).  -1 if it had to be cut
+// off, for not reading what it's sent.
+
+int rje_ctl_reply(struct rje_ctl *c, int n, char *line)
+{
+	struct rje_ctlconn *k = &c->conn[n];
+	int len = strlen(line);
+
+	if (k->fd < 0)
+		return (-1);
+	if (k->outlen + len + 1 > RJE_CTL_OUT) {
+		if (conn_flush(k) < 0 || k->fd < 0)
+			return (-1);	/* gone, out freed */
+		if (k->outlen + len + 1 > RJE_CTL_OUT) {
+			conn_drop(k);
+			return (-1);
+		}
+	}
+	memcpy(k->out + k->outlen, line, len);
+	k->out[k->outlen + len] = '\n';
+	k->outlen += len + 1;
+	return (0);
+}
+
+// The oldest file connection n has passed and not had taken: now the
+// caller's to close.  -1 if there isn't one.
+
+int rje_ctl_takefd(struct rje_ctl *c, int n)
+{
+	struct rje_ctlconn *k = &c->conn[n];
+	int fd;
+
+	if (k->npassed == 0)
+		return (-1);
+	fd = k->passed[0];
+	memmove(k->passed, k->passed + 1, --k->npassed * sizeof(int));
+	return (fd);
+}
+
+// Connection n does (on = 1) or doesn't want rje_ctl_event lines
+
+int rje_ctl_watch(struct rje_ctl *c, int n, int on)
+{
+	c->conn[n].watch = on;
+	return (0);
+}
+
+// A line for every connection watching.  Returns how many it went to.
+
+int rje_ctl_event(struct rje_ctl *c, char *line)
+{
+	int i, sent = 0;
+
+	for (i = 0; i < RJE_CTL_CONNS; i++) {
+		if (c->conn[i].fd >= 0 && c->conn[i].watch &&
+			rje_ctl_reply(c, i, line) == 0)
+			sent++;
+	}
+	return (sent);
+}
+
+// Stop listening, and cut everyone off
+
+int rje_ctl_close(struct rje_ctl *c)
+{
+	int i;
+
+	if (c->fd < 0)
+		return (0);
+	for (i = 0; i < RJE_CTL_CONNS; i++) {
+		if (c->conn[i].fd >= 0 && conn_flush(&c->conn[i]) == 0)
+			conn_drop(&c->conn[i]);	/* else flush dropped it */
+	}
+	close(c->fd);
+	unlink(c->path);
+	c->fd = -1;
+	return (0);
+}
+
+// Read what connection n has sent, and any files with it, and hand each
+// request that's all in to reqfn.  Returns the number of requests.
+
+static int conn_read(struct rje_ctl *c, int n)
+{
+	struct rje_ctlconn *k = &c->conn[n];
+	struct msghdr msg;
+	struct cmsghdr *cm;
+	struct iovec iov;
+	char buf[4096];
+	char cbuf[CMSG_SPACE(RJE_CTL_FDS * sizeof(int))];
+	int i, j, len, nfd, *fds, reqs = 0;
+
+	for (;;) {
+		memset(&msg, 0, sizeof(msg));
+		iov.iov_base = buf;
+		iov.iov_len = sizeof(buf);
+		msg.msg_iov = &iov;
+		msg.msg_iovlen = 1;
+		msg.msg_control = cbuf;
+		msg.msg_controllen = sizeof(cbuf);
+		len = recvmsg(k->fd, &msg, 0);
+		if (len < 0 && (errno == EAGAIN || errno == EWOULDBLOCK ||
+			errno == EINTR))
+			return (reqs);
+
+		// Files passed: kept in order, any over RJE_CTL_FDS closed
+
+		for (cm = CMSG_FIRSTHDR(&msg); len >= 0 && cm != NULL;
+			cm = CMSG_NXTHDR(&msg, cm)) {
+			if (cm->cmsg_level != SOL_SOCKET ||
+				cm->cmsg_type != SCM_RIGHTS)
+				continue;
+			fds = (int *) CMSG_DATA(cm);
+			nfd = (cm->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+			for (i = 0; i < nfd; i++) {
+				fcntl(fds[i], F_SETFD, FD_CLOEXEC);
+				if (k->npassed < RJE_CTL_FDS)
+					k->passed[k->npassed++] = fds[i];
+				else
+					close(fds[i]);
+			}
+		}
+		if (len <= 0) {
+			conn_drop(k);	/* gone */
+			return (reqs);
+		}
+
+		// Requests, a line at a time
+
+		for (i = 0; i < len && k->fd >= 0; i++) {
+			if (buf[i] == '\n') {
+				k->in[k->inlen] = 0;
+				j = k->inlen;
+				if (j > 0 && k->in[j - 1] == '\r')
+					k->in[j - 1] = 0;
+				if (!k->skip && c->reqfn != NULL) {
+					c->reqfn(c, n, k->in);
+					reqs++;
+				} else if (k->skip) {
+					rje_ctl_reply(c, n, "ERR RJE262A The request is too long.");
+				}
+				k->inlen = 0;
+				k->skip = 0;
+			} else if (k->inlen < RJE_CTL_LINE - 1) {
+				k->in[k->inlen++] = buf[i];
+			} else {
+				k->skip = 1;
+			}
+		}
+		if (k->fd < 0)
+			return (reqs);
+	}
+}
+
+// Send what's waiting, as much as it will take
+
+static int conn_flush(struct rje_ctlconn *k)
+{
+	int len;
+
+	while (k->outlen > 0) {
+		len = send(k->fd, k->out, k->outlen, MSG_NOSIGNAL);
+		if (len < 0 && (errno == EAGAIN || errno == EWOULDBLOCK ||
+			errno == EINTR))
+			return (0);
+		if (len <= 0) {
+			conn_drop(k);
+			return (-1);
+		}
+		memmove(k->out, k->out + len, k->outlen - len);
+		k->outlen -= len;
+	}
+	return (0);
+}
+
+static int conn_drop(struct rje_ctlconn *k)
+{
+	int i;
+
+	for (i = 0; i < k->npassed; i++)
+		close(k->passed[i]);
+	k->npassed = 0;
+	close(k->fd);
+	k->fd = -1;
+	free(k->out);
+	k->out = NULL;
+	k->outlen = 0;
+	k->watch = 0;
+	return (0);
+}
+
+#endif
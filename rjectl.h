@@ -0,0 +1,59 @@
+//  rjectl - a control socket, so programs on the same machine can use a
+//  running rje80's lines without going through its terminal.
+//
+//  It's a UNIX domain stream socket.  A program connects and writes
+//  requests, a line each, and gets back for each any number of lines of
+//  data and then one line saying how it went: OK, with what it has to say,
+//  or ERR and a message.  What the requests are is up to the program
+//  running the socket (reqfn); see rje80's HELP CONTROL for its.
+//
+//  A deck doesn't have to be copied down the socket.  Open files (a file,
+//  a memfd, the read end of a pipe) can be passed with a request, as
+//  SCM_RIGHTS, and the request can then use the oldest one passed with it
+//  or before it and not used yet (rje_ctl_takefd): it becomes the
+//  deck's, read straight from where it is.  Any not taken are closed when
+//  the program goes.
+//
+//  Lines sent with rje_ctl_event go to every connection that's asked for
+//  them (rje_ctl_watch), as they happen, between the replies.
+//
+//  UNIX only; on Windows rje_ctl_open says -1.
+
+#ifndef RJECTL_H
+#define RJECTL_H
+
+#define RJE_CTL_CONNS 16	/* programs connected at once */
+#define RJE_CTL_FDS 8		/* files passed and not taken, each */
+#define RJE_CTL_LINE 512	/* longest request */
+#define RJE_CTL_OUT 65536	/* replies and events not yet read, each */
+
+struct rje_ctlconn {
+	int fd;			/* -1 = not connected */
+	char in[RJE_CTL_LINE];	/* request coming in */
+	int inlen;
+	int skip;		/* ... too long, the rest of it goes */
+	int passed[RJE_CTL_FDS];	/* files passed, oldest first */
+	int npassed;
+	char *out;		/* waiting to go to it */
+	int outlen;
+	int watch;		/* it wants rje_ctl_event lines */
+};
+
+struct rje_ctl {
+	int fd;			/* listening, -1 = not */
+	char path[108];
+	struct rje_ctlconn conn[RJE_CTL_CONNS];
+	int (*reqfn)(struct rje_ctl *c, int n, char *req);
+	void *user;		/* for the caller's own use */
+};
+
+int rje_ctl_open(struct rje_ctl *c, char *path);
+int rje_ctl_fds(struct rje_ctl *c, void *fds, int max);
+int rje_ctl_poll(struct rje_ctl *c);
+int rje_ctl_reply(struct rje_ctl *c, int n, char *line);
+int rje_ctl_takefd(struct rje_ctl *c, int n);
+int rje_ctl_watch(struct rje_ctl *c, int n, int on);
+int rje_ctl_event(struct rje_ctl *c, char *line);
+int rje_ctl_close(struct rje_ctl *c);
+
+#endif
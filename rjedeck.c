@@ -0,0 +1,366 @@
+//  rjedeck - the deck cache (see rjedeck.h).
+//
+//  A deck is looked up by an FNV-1a hash, which is quick to take over the
+//  whole file and good enough to find the one image worth comparing it
+//  with.  The file is read once to look it up; on a miss the reader that
+//  read it goes on to make the image, so what's kept is made from the
+//  bytes that were hashed.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "rjedeck.h"
+
+#define FNV_BASIS 14695981039346656037ULL
+#define FNV_PRIME 1099511628211ULL
+
+// On disk: this, the file, the cards, then pos and next as long longs
+
+struct rje_deckhdr {
+	char magic[4];		/* "RJD1" */
+	int fmt;
+	int recl;
+	int ncards;
+	long long size;
+	unsigned long long hash;
+};
+
+static unsigned long long deck_hash(unsigned char *raw, long size, int fmt,
+	int recl, const unsigned char *xlate);
+static struct rje_deckimg *deck_find(struct rje_decks *c,
+	unsigned long long hash, int fmt, int recl, unsigned char *raw,
+	long size);
+static struct rje_deckimg *deck_make(struct rje_decks *c,
+	struct rje_reader *r, unsigned long long hash, unsigned char *raw,
+	long size);
+static struct rje_deckimg *deck_load(struct rje_decks *c,
+	unsigned long long hash, int fmt, int recl, unsigned char *raw,
+	long size);
+static int deck_save(struct rje_decks *c, struct rje_deckimg *img);
+static int deck_keep(struct rje_decks *c, struct rje_deckimg *img);
+static long deck_bytes(struct rje_deckimg *img);
+static int deck_path(struct rje_decks *c, char *path, unsigned long long hash,
+	int fmt, int recl);
+
+// A cache of up to size bytes (0 for RJE_DECKS_SIZE), kept in dir as
+// well unless it's NULL or "".  NULL if there's no memory for it.
+
+struct rje_decks *rje_decks_open(long size, const char *dir)
+{
+	struct rje_decks *c;
+
+	c = (struct rje_decks *) malloc(sizeof(struct rje_decks));
+	if (c == NULL)
+		return (NULL);
+	memset(c, 0, sizeof(struct rje_decks));
+	c->size = (size > 0) ? size : RJE_DECKS_SIZE;
+	if (dir != NULL)
+		strncpy(c->dir, dir, sizeof(c->dir) - 1);
+	return (c);
+}
+
+// Open a deck, from its image if it's been made before (see rjedeck.h).
+// Returns 0, or -1 if it can't be read, as rje_reader_open does.
+
+int rje_decks_reader(struct rje_decks *c, struct rje_reader *r, char *file,
+	int fmt, int recl, const unsigned char *xlate)
+{
+	struct rje_deckimg *img;
+	unsigned long long hash;
+	unsigned char *raw;
+	long size;
+
+	if (rje_reader_open(r, file, fmt, recl, xlate) != 0)
+		return (-1);
+	if (c == NULL || r->stream)
+		return (0);
+	if (fseek(r->fd, 0, SEEK_END) != 0 || (size = ftell(r->fd)) < 0 ||
+		size > c->size) {
+		rewind(r->fd);
+		return (0);
+	}
+	rewind(r->fd);
+	if ((raw = (unsigned char *) malloc(size + 1)) == NULL)
+		return (0);
+	size = fread(raw, 1, size, r->fd);
+	rewind(r->fd);
+	hash = deck_hash(raw, size, fmt, recl, xlate);
+
+	if ((img = deck_find(c, hash, fmt, recl, raw, size)) != NULL) {
+		free(raw);
+		c->hits++;
+	} else if ((img = deck_load(c, hash, fmt, recl, raw, size)) != NULL) {
+		c->loads++;
+		deck_keep(c, img);
+	} else if ((img = deck_make(c, r, hash, raw, size)) != NULL) {
+		c->made++;
+		deck_keep(c, img);
+		deck_save(c, img);
+	} else {
+
+		// Not a good deck, or too big: read it as it is, and let the
+		// send find out which
+
+		free(raw);
+		rje_reader_close(r);
+		return (rje_reader_open(r, file, fmt, recl, xlate));
+	}
+	img->used = ++c->clock;
+	rje_reader_close(r);
+	rje_reader_cards(r, img);
+	return (0);
+}
+
+// Let go of every image (those being sent go when their sends are done)
+
+int rje_decks_close(struct rje_decks *c)
+{
+	int i;
+
+	if (c == NULL)
+		return (0);
+	for (i = 0; i < c->n; i++)
+		rje_deckimg_drop(c->img[i]);
+	free(c);
+	return (0);
+}
+
+static unsigned long long deck_hash(unsigned char *raw, long size, int fmt,
+	int recl, const unsigned char *xlate)
+{
+	unsigned long long h = FNV_BASIS;
+	long i;
+
+	for (i = 0; i < size; i++)
+		h = (h ^ raw[i]) * FNV_PRIME;
+	h = (h ^ fmt) * FNV_PRIME;
+	h = (h ^ (recl & 0xff)) * FNV_PRIME;
+	h = (h ^ (recl >> 8)) * FNV_PRIME;
+	if (fmt == RDR_ASCII) {
+		for (i = 0; i < 256; i++)
+			h = (h ^ xlate[i]) * FNV_PRIME;
+	}
+	return (h);
+}
+
+static struct rje_deckimg *deck_find(struct rje_decks *c,
+	unsigned long long hash, int fmt, int recl, unsigned char *raw,
+	long size)
+{
+	struct rje_deckimg *img;
+	int i;
+
+	for (i = 0; i < c->n; i++) {
+		img = c->img[i];
+		if (img->hash == hash && img->fmt == fmt && img->recl == recl &&
+			img->size == size && memcmp(img->raw, raw, size) == 0)
+			return (img);
+	}
+	return (NULL);
+}
+
+// Read the rest of the deck from r into a new image, which has raw.  NULL
+// if the deck isn't in its format, or its image is bigger than the cache.
+
+static struct rje_deckimg *deck_make(struct rje_decks *c,
+	struct rje_reader *r, unsigned long long hash, unsigned char *raw,
+	long size)
+{
+	struct rje_deckimg *img;
+	unsigned char *cards;
+	long *pos, *next;
+	int n, max = 0;
+
+	if ((img = (struct rje_deckimg *) malloc(sizeof(*img))) == NULL)
+		return (NULL);
+	memset(img, 0, sizeof(struct rje_deckimg));
+	img->hash = hash;
+	img->fmt = r->fmt;
+	img->recl = r->recl;
+	img->size = size;
+	for (;;) {
+		if (size + (long) img->ncards * (r->recl + 2 * sizeof(long)) >
+			c->size)
+			break;
+		if (img->ncards == max) {
+			max = (max == 0) ? 256 : max * 2;
+			if ((cards = (unsigned char *) realloc(img->cards,
+				(long) max * r->recl)) != NULL)
+				img->cards = cards;
+			if ((pos = (long *) realloc(img->pos,
+				max * sizeof(long))) != NULL)
+				img->pos = pos;
+			if ((next = (long *) realloc(img->next,
+				max * sizeof(long))) != NULL)
+				img->next = next;
+			if (cards == NULL || pos == NULL || next == NULL)
+				break;
+		}
+		n = rje_reader_get(r, img->cards + (long) img->ncards * r->recl);
+		if (n == 0) {
+			img->raw = raw;
+			return (img);
+		}
+		if (n < 0)
+			break;
+		img->pos[img->ncards] = r->pos;
+		img->next[img->ncards++] = r->next;
+	}
+	img->raw = NULL;	/* the caller's, still */
+	img->refs = 1;
+	rje_deckimg_drop(img);
+	return (NULL);
+}
+
+// The image kept on disk for this deck, if there is one and it's this
+// deck's.  It has raw if so.
+
+static struct rje_deckimg *deck_load(struct rje_decks *c,
+	unsigned long long hash, int fmt, int recl, unsigned char *raw,
+	long size)
+{
+	struct rje_deckhdr hdr;
+	struct rje_deckimg *img;
+	char path[128];
+	unsigned char *had;
+	long long *at = NULL;
+	FILE *fd;
+	int i, ok = 0;
+
+	if (deck_path(c, path, hash, fmt, recl) != 0 ||
+		(fd = fopen(path, "rb")) == NULL)
+		return (NULL);
+	if (fread(&hdr, sizeof(hdr), 1, fd) != 1 ||
+		memcmp(hdr.magic, "RJD1", 4) != 0 || hdr.fmt != fmt ||
+		hdr.recl != recl || hdr.size != size || hdr.hash != hash ||
+		hdr.ncards < 0 ||
+		size + (long) hdr.ncards * (recl + 2 * sizeof(long)) > c->size) {
+		fclose(fd);
+		return (NULL);
+	}
+	if ((img = (struct rje_deckimg *) malloc(sizeof(*img))) == NULL) {
+		fclose(fd);
+		return (NULL);
+	}
+	memset(img, 0, sizeof(struct rje_deckimg));
+	img->hash = hash;
+	img->fmt = fmt;
+	img->recl = recl;
+	img->size = size;
+	img->ncards = hdr.ncards;
+	had = (unsigned char *) malloc(size + 1);
+	img->cards = (unsigned char *) malloc((long) hdr.ncards * recl + 1);
+	img->pos = (long *) malloc((hdr.ncards + 1) * sizeof(long));
+	img->next = (long *) malloc((hdr.ncards + 1) * sizeof(long));
+	at = (long long *) malloc((hdr.ncards + 1) * sizeof(long long));
+	if (had != NULL && img->cards != NULL && img->pos != NULL &&
+		img->next != NULL && at != NULL &&
+		fread(had, 1, size, fd) == size && memcmp(had, raw, size) == 0 &&
+		fread(img->cards, recl, hdr.ncards, fd) == hdr.ncards &&
+		fread(at, sizeof(long long), hdr.ncards, fd) == hdr.ncards) {
+		for (i = 0; i < hdr.ncards; i++)
+			img->pos[i] = at[i];
+		if (fread(at, sizeof(long long), hdr.ncards, fd) == hdr.ncards) {
+			for (i = 0; i < hdr.ncards; i++)
+				img->next[i] = at[i];
+			ok = 1;
+		}
+	}
+	fclose(fd);
+	free(had);
+	free(at);
+	if (!ok) {
+		img->refs = 1;
+		rje_deckimg_drop(img);
+		return (NULL);
+	}
+	img->raw = raw;
+	return (img);
+}
+
+// Write an image to the cache's directory, under another name until it's
+// all there so a run reading it never sees half of one
+
+static int deck_save(struct rje_decks *c, struct rje_deckimg *img)
+{
+	struct rje_deckhdr hdr;
+	char path[128], tmp[136];
+	long long at;
+	FILE *fd;
+	int i, ok;
+
+	if (deck_path(c, path, img->hash, img->fmt, img->recl) != 0)
+		return (-1);
+	sprintf(tmp, "%s.tmp", path);
+	if ((fd = fopen(tmp, "wb")) == NULL)
+		return (-1);
+	memset(&hdr, 0, sizeof(hdr));
+	memcpy(hdr.magic, "RJD1", 4);
+	hdr.fmt = img->fmt;
+	hdr.recl = img->recl;
+	hdr.ncards = img->ncards;
+	hdr.size = img->size;
+	hdr.hash = img->hash;
+	ok = fwrite(&hdr, sizeof(hdr), 1, fd) == 1 &&
+		fwrite(img->raw, 1, img->size, fd) == img->size &&
+		fwrite(img->cards, img->recl, img->ncards, fd) == img->ncards;
+	for (i = 0; ok && i < img->ncards; i++) {
+		at = img->pos[i];
+		ok = fwrite(&at, sizeof(at), 1, fd) == 1;
+	}
+	for (i = 0; ok && i < img->ncards; i++) {
+		at = img->next[i];
+		ok = fwrite(&at, sizeof(at), 1, fd) == 1;
+	}
+	if (fclose(fd) != 0)
+		ok = 0;
+#if defined (_WIN32)
+	if (ok)
+		remove(path);	/* rename won't replace it */
+#endif
+	if (!ok || rename(tmp, path) != 0) {
+		remove(tmp);
+		return (-1);
+	}
+	return (0);
+}
+
+// Keep an image, letting go of those wanted longest ago to make room.  An
+// image bigger than the whole cache isn't kept.
+
+static int deck_keep(struct rje_decks *c, struct rje_deckimg *img)
+{
+	long bytes = deck_bytes(img);
+	int i, old;
+
+	if (bytes > c->size)
+		return (-1);
+	while (c->n > 0 && (c->n == RJE_DECKS || c->used + bytes > c->size)) {
+		for (old = 0, i = 1; i < c->n; i++) {
+			if (c->img[i]->used < c->img[old]->used)
+				old = i;
+		}
+		c->used -= deck_bytes(c->img[old]);
+		rje_deckimg_drop(c->img[old]);
+		c->img[old] = c->img[--c->n];
+	}
+	c->img[c->n++] = img;
+	c->used += bytes;
+	img->refs++;
+	return (0);
+}
+
+static long deck_bytes(struct rje_deckimg *img)
+{
+	return (img->size + (long) img->ncards * (img->recl + 2 * sizeof(long)));
+}
+
+static int deck_path(struct rje_decks *c, char *path, unsigned long long hash,
+	int fmt, int recl)
+{
+	if (strlen(c->dir) == 0)
+		return (-1);
+	sprintf(path, "%s/%016llx-%d-%d.rjd", c->dir, hash, fmt, recl);
+	return (0);
+}
@@ -0,0 +1,50 @@
+//  rjedeck - a cache of decks already made into cards, for the ones sent
+//  over and over (the same housekeeping JCL every hour, say).
+//
+//  rje_decks_reader opens a deck the way rje_reader_open does, but first
+//  reads the whole file and looks it up by what's in it: a hash of its
+//  bytes, its format and card length (and for text, the translate table),
+//  and then the bytes themselves compared, so an edited deck is never
+//  mistaken for the one it was.  If it's there, the reader is put on the
+//  cards made last time and nothing is read a line at a time, translated
+//  or padded again.  If not, it's read through once into a new image,
+//  which is kept, and the reader put on that.
+//
+//  What a deck was made into doesn't depend on the session, so one cache
+//  can be shared by every session in a program (set s->decks in each).
+//  It keeps up to RJE_DECKS images in size bytes, letting go of the one
+//  wanted longest ago to make room; one that's still being sent is only
+//  freed when its send is done.  Decks bigger than size, streams and *
+//  are read as they always were.
+//
+//  Given a directory, images are kept there too, a file each named by
+//  the hash, format and card length, so a deck made by one run is found
+//  by the next.  They're in this machine's byte order, and only a cache:
+//  any can be removed, and one that doesn't match is made again.
+
+#ifndef RJEDECK_H
+#define RJEDECK_H
+
+#include "rjereader.h"
+
+#define RJE_DECKS 64		/* images kept in memory */
+#define RJE_DECKS_SIZE (16L * 1024 * 1024)	/* default size, bytes */
+
+struct rje_decks {
+	long size;		/* bytes of images kept at most */
+	long used;		/* ... kept now */
+	char dir[80];		/* where they're kept on disk, "" = not */
+	struct rje_deckimg *img[RJE_DECKS];
+	int n;
+	long clock;		/* counts lookups, for which to let go of */
+	long hits;		/* found in memory */
+	long loads;		/* ... on disk */
+	long made;		/* read through and kept */
+};
+
+struct rje_decks *rje_decks_open(long size, const char *dir);
+int rje_decks_reader(struct rje_decks *c, struct rje_reader *r, char *file,
+	int fmt, int recl, const unsigned char *xlate);
+int rje_decks_close(struct rje_decks *c);
+
+#endif
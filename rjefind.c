@@ -0,0 +1,104 @@
+//  rjefind - which jobs' print output has these words in it, from an
+//  index kept by rje80's INDEX command (see rjeindex).
+//
+//  Each job found is one line: its name and number, when its output
+//  ended, the page and line the (first) word is first on, how many lines
+//  it's on, and the file the output went to.  The index can be searched
+//  while rje80 is adding to it.
+//
+//      cc -o rjefind rjefind.c rjeindex.c -lpthread
+//
+//  Usage: rjefind [-c] [-t] index word ...
+//
+//	-c	just say how many jobs
+//	-t	and how long the search took
+//
+//  A word is letters, digits and $ # @, in any case; word* finds any word
+//  starting with it.  A job has to have all of them.  Exits 0 if any job
+//  was found, 1 if none, 2 if the index can't be read.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#if !defined (_WIN32)
+#include <sys/time.h>
+#endif
+
+#include "rjeindex.h"
+
+int found(struct rje_idxhit *h, void *arg);
+int usage();
+double msec();
+
+int main(int argc, char *argv[])
+{
+	char words[1024] = "";
+	int i, n, count = 0, timed = 0;
+	double start;
+
+	while (argc > 1 && argv[1][0] == '-' && argv[1][1] != 0) {
+		if (strcmp(argv[1], "-c") == 0)
+			count = 1;
+		else if (strcmp(argv[1], "-t") == 0)
+			timed = 1;
+		else
+			return (usage());
+		argc--;
+		argv++;
+	}
+	if (argc < 3)
+		return (usage());
+	for (i = 2; i < argc; i++) {
+		if (strlen(words) + strlen(argv[i]) + 2 > sizeof(words))
+			break;
+		strcat(words, argv[i]);
+		strcat(words, " ");
+	}
+	start = msec();
+	n = rje_index_find(argv[1], words, count ? NULL : found, NULL);
+	if (n < 0) {
+		fprintf(stderr, "rjefind: can't read %s\n", argv[1]);
+		return (2);
+	}
+	if (count)
+		printf("%d\n", n);
+	if (timed)
+		fprintf(stderr, "%d found in %.2f ms\n", n, msec() - start);
+	return (n > 0 ? 0 : 1);
+}
+
+int found(struct rje_idxhit *h, void *arg)
+{
+	char number[16], when[32];
+	time_t t = (time_t) h->when;
+
+	strcpy(number, "-");
+	if (h->number > 0)
+		sprintf(number, "JOB%05d", h->number);
+	strftime(when, sizeof(when), "%Y-%m-%d %H:%M:%S", localtime(&t));
+	printf("%-8s %-8s %s page %u line %u (%ld) %s\n",
+		h->job[0] ? h->job : "-", number, when, h->page, h->line,
+		h->count, h->file[0] ? h->file : "-");
+	return (0);
+}
+
+int usage()
+{
+	fprintf(stderr, "Usage: rjefind [-c] [-t] index word ...\n"
+		"  -c      just the number of jobs found\n"
+		"  -t      and how long it took\n");
+	return (2);
+}
+
+double msec()
+{
+#if defined (_WIN32)
+	return (clock() * 1000.0 / CLOCKS_PER_SEC);
+#else
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return (tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0);
+#endif
+}
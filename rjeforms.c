@@ -0,0 +1,132 @@
+//  rjeforms - forms control for received 2780/3780 printer data.
+//
+//  A printer record from the host is EBCDIC text with forms control mixed
+//  in: ESC x picks the carriage movement for the line, HT (0x05) moves to
+//  the next tab stop.  Tab stops come from an ESC HT record, where each
+//  HT in the record sets a stop at its column (the column after ESC HT
+//  being column 0).  Data following an HT is printed at the stop column.
+
+#include <string.h>
+
+#include "rjeforms.h"
+
+static const unsigned char ESC = 0x27;
+static const unsigned char HT  = 0x05;
+static const unsigned char BLANK = 0x40;
+
+// ESC action byte to carriage movement.  All of these happen before the
+// line prints, as ASA control does.  Machine codes move after the line
+// is written, so they belong on the line before; rje_forms_action gives
+// the write-then-move code and the caller shifts it.  Channels 2-12 have
+// no carriage tape behind them in a text file, so there they just start
+// a new line.
+
+#define FC(sp, ch, t, asa, mach) {sp, ch, t, sizeof(t) - 1, asa, mach}
+
+static const struct rje_fcact fcact[256] = {
+	[0x61] = FC(1, 0, "\r\n", ' ', 0x09),		/* ESC / single space */
+	[0xe2] = FC(2, 0, "\r\n\r\n", '0', 0x11),	/* ESC S double space */
+	[0xe3] = FC(3, 0, "\r\n\r\n\r\n", '-', 0x19),	/* ESC T triple space */
+	[0xd4] = FC(0, 0, "\r", '+', 0x01),		/* ESC M suppress space */
+	[0xc1] = FC(0, 1, "\r\n\014", '1', 0x89),	/* ESC A top of form */
+	[0xc2] = FC(0, 2, "\r\n", '2', 0x91),		/* ESC B .. ESC L channels 2-12 */
+	[0xc3] = FC(0, 3, "\r\n", '3', 0x99),
+	[0xc4] = FC(0, 4, "\r\n", '4', 0xa1),
+	[0xc5] = FC(0, 5, "\r\n", '5', 0xa9),
+	[0xc6] = FC(0, 6, "\r\n", '6', 0xb1),
+	[0xc7] = FC(0, 7, "\r\n", '7', 0xb9),
+	[0xc8] = FC(0, 8, "\r\n", '8', 0xc1),
+	[0xc9] = FC(0, 9, "\r\n", '9', 0xc9),
+	[0xd1] = FC(0, 10, "\r\n", 'A', 0xd1),
+	[0xd2] = FC(0, 11, "\r\n", 'B', 0xd9),
+	[0xd3] = FC(0, 12, "\r\n", 'C', 0xe1),
+};
+
+// No ESC in the record, or one we don't know: single space
+
+const struct rje_fcact *rje_forms_action(int action)
+{
+	if (action < 0 || action > 255 || fcact[action].text == NULL)
+		return (&fcact[0x61]);
+	return (&fcact[action]);
+}
+
+// Start with no tab stops
+
+int rje_forms_init(struct rje_forms *f)
+{
+	memset(f, 0, sizeof(struct rje_forms));
+	return (0);
+}
+
+// If rec is an ESC HT record, set the tab stops from it and return how
+// many bytes of it were the format (anything after that is a line to
+// print).  Anything else is left alone and 0 returned.
+
+int rje_forms_tabs(struct rje_forms *f, unsigned char *rec, int len)
+{
+	unsigned char stop[RJE_FORMS_MAX];
+	int i, n, next;
+
+	if (len < 2 || rec[0] != ESC || rec[1] != HT)
+		return (0);
+	n = 0;
+	while (n < len - 2 && n < RJE_FORMS_MAX &&
+	    (rec[n + 2] == BLANK || rec[n + 2] == HT)) {
+		stop[n] = (rec[n + 2] == HT);
+		n++;
+	}
+
+	// Walk back from the right margin so each column picks up the
+	// nearest stop to its right.
+
+	f->ntabs = 0;
+	next = 0;
+	for (i = RJE_FORMS_MAX - 1; i >= 0; i--) {
+		f->nexttab[i] = next;
+		if (i < n && stop[i]) {
+			next = i;
+			f->ntabs++;
+		}
+	}
+	return (n + 2);
+}
+
+// Lay out one record: tabs expanded, ESC actions taken out (the last one
+// is returned in action, 0 if none), and the text translated through
+// xlate if it isn't NULL.  Returns the length of the line in out.
+
+int rje_forms_expand(struct rje_forms *f, unsigned char *rec, int len,
+	unsigned char *out, int max, const unsigned char *xlate, int *action)
+{
+	unsigned char fill;
+	int i, j, stop;
+
+	if (max > RJE_FORMS_MAX)
+		max = RJE_FORMS_MAX;
+	fill = xlate ? xlate[BLANK] : BLANK;
+	*action = 0;
+	j = 0;
+	for (i = 0; i < len; i++) {
+		if (rec[i] == ESC) {
+			if (++i < len)
+				*action = rec[i];
+			continue;
+		}
+		if (rec[i] == HT) {
+			stop = (j < max) ? f->nexttab[j] : 0;
+			if (stop == 0)
+				stop = j + 1;	/* past the last stop: one blank */
+			if (stop > max)
+				stop = max;
+			if (stop > j) {
+				memset(out + j, fill, stop - j);
+				j = stop;
+			}
+			continue;
+		}
+		if (j < max)
+			out[j++] = xlate ? xlate[rec[i]] : rec[i];
+	}
+	return (j);
+}
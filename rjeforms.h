@@ -0,0 +1,42 @@
+//  rjeforms - forms control for received 2780/3780 printer data.
+//
+//  The host sets horizontal tabs with an ESC HT record, in which each HT
+//  marks a tab stop.  rje_forms_tabs compiles that record once into a
+//  table giving, for every column, the column of the next stop, so a tab
+//  in the data is expanded with one lookup and one blank fill.
+//
+//  Vertical control comes as ESC x ahead of the line.  rje_forms_action
+//  looks x up in a table that says how the printer moves before the line
+//  is printed, as CR/LF text, as an ASA control character, and as the
+//  machine (channel command) code that does the same move.
+
+#ifndef RJEFORMS_H
+#define RJEFORMS_H
+
+#define RJE_FORMS_MAX 256	/* widest line we lay out */
+
+struct rje_forms {
+	int ntabs;			/* tab stops set, 0 = none */
+	unsigned char nexttab[RJE_FORMS_MAX];	/* next stop after column, 0 = none */
+};
+
+// What an ESC action byte does to the paper before the line is printed
+
+struct rje_fcact {
+	unsigned char space;	/* lines to advance, 0 = overprint */
+	unsigned char channel;	/* skip to this carriage channel, 0 = none */
+	char *text;		/* what that is in a text file */
+	int textlen;
+	char asa;		/* ASA control character */
+	unsigned char mach;	/* machine code: write, then move */
+};
+
+#define RJE_MACH_IMMED 0x02	/* or'ed into mach: move without writing */
+
+int rje_forms_init(struct rje_forms *f);
+int rje_forms_tabs(struct rje_forms *f, unsigned char *rec, int len);
+int rje_forms_expand(struct rje_forms *f, unsigned char *rec, int len,
+	unsigned char *out, int max, const unsigned char *xlate, int *action);
+const struct rje_fcact *rje_forms_action(int action);
+
+#endif
@@ -0,0 +1,437 @@
+//  rjegroup - decks spread over a group of RJE lines.
+//
+//  The group only ever hands a line as much as RJE_GROUP_DEPTH decks, so
+//  the rest wait here, and go to whichever line gets through its own
+//  first.  How busy a line is is how many of our decks it has not yet
+//  finished, and then whether it's doing anything (sending, or taking in
+//  output) right now.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined (_WIN32)
+#include <winsock2.h>
+#else
+#include <signal.h>
+#include <sys/select.h>
+#include <sys/time.h>
+#endif
+
+#include "rjegroup.h"
+
+static int line_start(struct rje_group *g, int n);
+static int line_signon(struct rje_group *g, int n);
+static int line_down(struct rje_group *g, int n, char *why);
+static int line_events(struct rje_group *g, int n);
+static int line_load(struct rje_group *g, int n);
+static int group_dispatch(struct rje_group *g);
+static int group_event(struct rje_group *g, int type, int id, int rc,
+	int device);
+static struct rje_groupsub *sub_on(struct rje_group *g, int n, int sid);
+
+int rje_group_init(struct rje_group *g, char *name)
+{
+	memset(g, 0, sizeof(struct rje_group));
+	strncpy(g->name, name, sizeof(g->name) - 1);
+	g->reader_fmt = RDR_ASCII;
+	g->reader_recl = 80;
+	return (0);
+}
+
+// Add the lines of group name from a file of them.  Returns how many,
+// or -1 if the file can't be read.
+
+int rje_group_load(struct rje_group *g, char *file, char *name)
+{
+	FILE *fd;
+	char buf[256], group[32], host[128], user[32], password[32];
+	int port, n = 0;
+
+	if ((fd = fopen(file, "r")) == NULL)
+		return (-1);
+	while (fgets(buf, sizeof(buf), fd) != NULL) {
+		strcpy(user, "*");
+		strcpy(password, "");
+		if (sscanf(buf, "%31s %127s %d %31s %31s", group, host, &port,
+			user, password) < 3 || group[0] == '#')
+			continue;
+		if (strcmp(group, name) == 0 &&
+			rje_group_add(g, host, port, user, password) >= 0)
+			n++;
+	}
+	fclose(fd);
+	return (n);
+}
+
+// Add a line.  Its session is line[n].s, to be set up (msgfn, PRINT
+// files and so on) before rje_group_start.  Returns n, or -1.
+
+int rje_group_add(struct rje_group *g, char *host, int port, char *user,
+	char *password)
+{
+	struct rje_groupline *l;
+
+	if (g->n >= RJE_GROUP_LINES)
+		return (-1);
+	l = &g->line[g->n];
+	memset(l, 0, sizeof(struct rje_groupline));
+	if ((l->s = rje_new()) == NULL)
+		return (-1);
+	strncpy(l->host, host, sizeof(l->host) - 1);
+	l->port = port;
+	strncpy(l->user, user, sizeof(l->user) - 1);
+	strncpy(l->password, password, sizeof(l->password) - 1);
+	l->state = GL_DOWN;
+	return (g->n++);
+}
+
+// Bring all the lines up
+
+int rje_group_start(struct rje_group *g)
+{
+	int i;
+
+#if !defined (_WIN32)
+	signal(SIGPIPE, SIG_IGN);	/* a refused connect is a dropped line */
+#endif
+	for (i = 0; i < g->n; i++)
+		line_start(g, i);
+	return (0);
+}
+
+// Give the group a deck.  It goes to a line as soon as one has room.
+// Returns the group's id for it, or -1.
+
+int rje_group_submit(struct rje_group *g, char *file, int prio)
+{
+	struct rje_groupsub *u;
+	FILE *fd;
+
+	if (!rje_reader_stream(file)) {
+		if ((fd = fopen(file, "r")) == NULL)
+			return (-1);
+		fclose(fd);
+	}
+	u = &g->sub[(g->next_id + 1) % RJE_GROUP_SUBS];
+	if (u->id != 0 && !u->done)
+		return (-1);		/* that many still going */
+	memset(u, 0, sizeof(struct rje_groupsub));
+	u->id = ++g->next_id;
+	u->line = -1;
+	u->prio = prio;
+	u->fmt = g->reader_fmt;
+	u->recl = g->reader_recl;
+	strncpy(u->file, file, sizeof(u->file) - 1);
+	group_dispatch(g);
+	return (u->id);
+}
+
+// Service every line for up to msec.  Returns the number of events
+// waiting for rje_group_event.
+
+int rje_group_poll(struct rje_group *g, int msec)
+{
+	struct timeval tv;
+	fd_set fds;
+	long now;
+	int i, max = -1;
+
+	if (g->n == 1) {
+		rje_poll(g->line[0].s, msec);
+	} else {
+		FD_ZERO(&fds);
+		for (i = 0; i < g->n; i++) {
+			if (g->line[i].s->sockfd < 0)
+				continue;
+			FD_SET(g->line[i].s->sockfd, &fds);
+			if (g->line[i].s->sockfd > max)
+				max = g->line[i].s->sockfd;
+		}
+		tv.tv_sec = msec / 1000;
+		tv.tv_usec = (msec % 1000) * 1000;
+		select(max + 1, &fds, NULL, NULL, &tv);
+		for (i = 0; i < g->n; i++)
+			rje_poll(g->line[i].s, 0);
+	}
+	now = rje_clock();
+	for (i = 0; i < g->n; i++) {
+		line_events(g, i);
+		if (g->line[i].state == GL_DOWN && now - g->line[i].retry >= 0)
+			line_start(g, i);
+		else if (g->line[i].state == GL_START && g->line[i].signon < 0)
+			line_signon(g, i);
+	}
+	group_dispatch(g);
+	return ((g->ev_head - g->ev_tail + RJE_MAXEV) % RJE_MAXEV);
+}
+
+// The next event, 1 if there was one
+
+int rje_group_event(struct rje_group *g, struct rje_event *ev)
+{
+	if (g->ev_tail == g->ev_head)
+		return (0);
+	*ev = g->ev[g->ev_tail];
+	g->ev_tail = (g->ev_tail + 1) % RJE_MAXEV;
+	return (1);
+}
+
+// How many jobs a submission had, and (*done) how many have their output
+// in.  Only the line it went on last counts.
+
+int rje_group_jobs(struct rje_group *g, int id, int *done)
+{
+	struct rje_groupsub *u = &g->sub[id % RJE_GROUP_SUBS];
+	struct rje_jobrec *j;
+	struct rje_session *s;
+	int i, n = 0;
+
+	*done = 0;
+	if (u->id != id || u->line < 0)
+		return (0);
+	s = g->line[u->line].s;
+	for (i = 0; (j = rje_jobs_get(&s->jobs, i)) != NULL; i++) {
+		if (j->id != u->sid)
+			continue;
+		n++;
+		*done += (j->state == JOB_DONE);
+	}
+	return (n);
+}
+
+// How many lines are GL_xxx
+
+int rje_group_count(struct rje_group *g, int state)
+{
+	int i, n = 0;
+
+	for (i = 0; i < g->n; i++)
+		n += (g->line[i].state == state);
+	return (n);
+}
+
+int rje_group_close(struct rje_group *g)
+{
+	int i;
+
+	for (i = 0; i < g->n; i++) {
+		rje_close(g->line[i].s);
+		rje_free(g->line[i].s);
+		g->line[i].s = NULL;
+	}
+	g->n = 0;
+	return (0);
+}
+
+// Connect a line.  It's signed on once it's connected, and joins the
+// rotation when the signon has gone.
+
+static int line_start(struct rje_group *g, int n)
+{
+	struct rje_groupline *l = &g->line[n];
+
+	l->state = GL_START;
+	l->signon = -1;
+	if (rje_open(l->s, l->host, l->port) < 0)
+		return (line_down(g, n, "can't be connected"));
+	return (line_signon(g, n));
+}
+
+// Sign a line on, if its connect has gone through
+
+static int line_signon(struct rje_group *g, int n)
+{
+	struct rje_groupline *l = &g->line[n];
+	struct timeval tv;
+	fd_set fds;
+
+	if (l->s->sockfd < 0 || l->s->status != INITIAL_WAIT)
+		return (0);
+	tv.tv_sec = 0;
+	tv.tv_usec = 0;
+	FD_ZERO(&fds);
+	FD_SET(l->s->sockfd, &fds);
+	if (select(l->s->sockfd + 1, NULL, &fds, NULL, &tv) <= 0)
+		return (0);		/* still connecting */
+	if ((l->signon = rje_signon(l->s, l->user, l->password)) < 0)
+		return (line_down(g, n, "can't sign on"));
+	if (l->signon == 0)
+		l->state = GL_UP;	/* no signon needed */
+	return (0);
+}
+
+// Take a line out of the rotation.  Its decks go back to the group, to
+// go on another line.
+
+static int line_down(struct rje_group *g, int n, char *why)
+{
+	struct rje_groupline *l = &g->line[n];
+	struct rje_groupsub *u;
+	char wstr[256];		/* host can be 127 */
+	int i, moved = 0;
+
+	l->state = GL_DOWN;
+	l->retry = rje_clock() + RJE_GROUP_RETRY;
+	rje_close(l->s);
+	for (i = 0; i < RJE_GROUP_SUBS; i++) {
+		u = &g->sub[i];
+		if (u->id == 0 || u->done || u->line != n)
+			continue;
+		rje_cancel(l->s, u->sid);
+		u->line = -1;
+		if (rje_reader_stream(u->file)) {
+			u->done = 1;	/* it can't be read again */
+			group_event(g, RJE_EV_DONE, u->id, -1, 0);
+			continue;
+		}
+		moved++;
+	}
+	sprintf(wstr, "\r\nRJE420W Line %d of %s (%s port %d) ",
+		n + 1, g->name, l->host, l->port);
+	rje_msg(l->s, wstr);
+	rje_msg(l->s, why);
+	rje_msg(l->s, ", out of the rotation");
+	if (moved > 0) {
+		sprintf(wstr, "; %d deck%s go%s to other lines", moved,
+			moved == 1 ? "" : "s", moved == 1 ? "es" : "");
+		rje_msg(l->s, wstr);
+	}
+	rje_msg(l->s, ".\r\n");
+	return (-1);
+}
+
+// What's happened on a line
+
+static int line_events(struct rje_group *g, int n)
+{
+	struct rje_groupline *l = &g->line[n];
+	struct rje_groupsub *u;
+	struct rje_event ev;
+	char wstr[256];		/* host can be 127 */
+
+	while (rje_event(l->s, &ev)) {
+		if (ev.type == RJE_EV_STATUS && ev.status <= NOLINK) {
+			if (l->state != GL_DOWN)
+				line_down(g, n, "dropped");
+			continue;
+		}
+		if (ev.type == RJE_EV_DONE && ev.kind == XMIT_SIGNON &&
+			ev.id == l->signon && l->state == GL_START) {
+			if (ev.rc != 0) {
+				line_down(g, n, "wasn't signed on");
+				continue;
+			}
+			l->state = GL_UP;
+			sprintf(wstr, "\r\nRJE421I Line %d of %s (%s port %d) is in the rotation.\r\n",
+				n + 1, g->name, l->host, l->port);
+			rje_msg(l->s, wstr);
+			continue;
+		}
+		if ((ev.type != RJE_EV_DONE && ev.type != RJE_EV_JOB) ||
+			ev.kind != XMIT_FILE || (u = sub_on(g, n, ev.id)) == NULL)
+			continue;
+		if (ev.type == RJE_EV_JOB) {
+			group_event(g, RJE_EV_JOB, u->id, 0, ev.device);
+			continue;
+		}
+		if (u->done || (ev.rc != 0 && l->s->status <= NOLINK))
+			continue;	/* the line's gone, it goes again */
+		u->done = 1;
+		l->decks += (ev.rc == 0);
+		group_event(g, RJE_EV_DONE, u->id, ev.rc, 0);
+	}
+	return (0);
+}
+
+// How busy a line is: twice the decks it has of ours, plus one if it's
+// sending or receiving now.  -1 if it isn't taking any.
+
+static int line_load(struct rje_group *g, int n)
+{
+	struct rje_session *s = g->line[n].s;
+	int i, decks = 0;
+
+	if (g->line[n].state != GL_UP || s->status < IDLE)
+		return (-1);
+	for (i = 0; i < RJE_GROUP_SUBS; i++) {
+		if (g->sub[i].id != 0 && !g->sub[i].done && g->sub[i].line == n)
+			decks++;
+	}
+	if (decks >= RJE_GROUP_DEPTH)
+		return (-1);
+	return (decks * 2 + (s->status != IDLE));
+}
+
+// Hand waiting decks, best first, to the least busy lines with room
+
+static int group_dispatch(struct rje_group *g)
+{
+	struct rje_groupsub *u, *best;
+	struct rje_session *s;
+	int i, k, load, low;
+
+	for (;;) {
+		best = NULL;
+		for (i = 0; i < RJE_GROUP_SUBS; i++) {
+			u = &g->sub[i];
+			if (u->id == 0 || u->done || u->line >= 0)
+				continue;
+			if (best == NULL || u->prio > best->prio ||
+				(u->prio == best->prio && u->id < best->id))
+				best = u;
+		}
+		if (best == NULL)
+			return (0);
+		low = -1;
+		for (i = 0; i < g->n; i++) {
+			k = (g->turn + i) % g->n;
+			load = line_load(g, k);
+			if (load >= 0 && (low < 0 || load < line_load(g, low)))
+				low = k;
+		}
+		if (low < 0)
+			return (0);	/* no line has room */
+		g->turn = (low + 1) % g->n;
+		s = g->line[low].s;
+		s->reader_fmt = best->fmt;
+		s->reader_recl = best->recl;
+		best->line = low;
+		if ((best->sid = rje_queue(s, XMIT_FILE, best->file,
+			best->prio)) < 0) {
+			best->done = 1;
+			group_event(g, RJE_EV_DONE, best->id, -1, 0);
+		}
+	}
+}
+
+static int group_event(struct rje_group *g, int type, int id, int rc,
+	int device)
+{
+	struct rje_event *ev = &g->ev[g->ev_head];
+
+	memset(ev, 0, sizeof(struct rje_event));
+	ev->type = type;
+	ev->kind = XMIT_FILE;
+	ev->id = id;
+	ev->rc = rc;
+	ev->device = device;
+	g->ev_head = (g->ev_head + 1) % RJE_MAXEV;
+	if (g->ev_head == g->ev_tail)
+		g->ev_tail = (g->ev_tail + 1) % RJE_MAXEV;
+	return (0);
+}
+
+// Our submission with id sid in line n's session
+
+static struct rje_groupsub *sub_on(struct rje_group *g, int n, int sid)
+{
+	int i;
+
+	for (i = 0; i < RJE_GROUP_SUBS; i++) {
+		if (g->sub[i].id != 0 && g->sub[i].line == n &&
+			g->sub[i].sid == sid)
+			return (&g->sub[i]);
+	}
+	return (NULL);
+}
@@ -0,0 +1,92 @@
+//  rjegroup - several RJE lines to the same host run as one: decks given
+//  to the group go to whichever of its signed on lines is least busy.
+//
+//  A host can define several 2703 lines for a remote, and one line sends
+//  one deck at a time, so spreading the decks over all of them gets that
+//  many through at once.  Each line is a session of its own; the group
+//  keeps its submissions until one has room for them (RJE_GROUP_DEPTH
+//  queued or going), then hands them to the one with the least queued,
+//  preferring a line with nothing going, and taking turns when they're
+//  level.  So a deck is never stuck behind a long one on a busy line
+//  while another line is free.
+//
+//  A line that drops, or whose signon the host refuses, is taken out of
+//  the rotation; what it had queued or was sending goes back to the group
+//  to go on another line (except a deck read from a pipe, which can't be
+//  read again), and the line is tried again every RJE_GROUP_RETRY ms
+//  until it comes back.
+//
+//  Groups are named in a file of lines, one line per line:
+//
+//	# group   host        port   [signon id [password]]
+//	prod      hercules    3780   RMT1
+//	prod      hercules    3781   RMT2
+//
+//  Events come from rje_group_event, with ev.id the group's submission
+//  id: RJE_EV_DONE when a deck has gone (or couldn't be sent anywhere),
+//  RJE_EV_JOB when output for a job in one is in.
+
+#ifndef RJEGROUP_H
+#define RJEGROUP_H
+
+#include "librje80.h"
+
+#define RJE_GROUP_LINES 16	/* lines in a group */
+#define RJE_GROUP_SUBS 256	/* submissions not yet reported done */
+#define RJE_GROUP_DEPTH 2	/* queued or going on a line at once */
+#define RJE_GROUP_RETRY 30000	/* ms before a failed line is tried again */
+
+#define GL_DOWN -1		/* out of the rotation */
+#define GL_START 0		/* connecting and signing on */
+#define GL_UP 1			/* signed on, taking decks */
+
+struct rje_groupline {
+	struct rje_session *s;
+	char host[128];
+	int port;
+	char user[32];		/* signon id, * = none */
+	char password[32];
+	int state;		/* GL_xxx */
+	int signon;		/* signon submission id */
+	long retry;		/* GL_DOWN: when to try again, rje_clock */
+	long decks;		/* sent on it */
+};
+
+struct rje_groupsub {
+	int id;			/* the group's, 0 = slot free */
+	int line;		/* the line it's on, -1 = waiting */
+	int sid;		/* ... and its id in that line's session */
+	int prio;
+	int fmt;		/* RDR_xxx */
+	int recl;
+	int done;		/* RJE_EV_DONE reported */
+	char file[80];
+};
+
+struct rje_group {
+	char name[32];
+	int reader_fmt;		/* RDR_xxx for new submissions */
+	int reader_recl;
+	int n;			/* lines */
+	struct rje_groupline line[RJE_GROUP_LINES];
+	struct rje_groupsub sub[RJE_GROUP_SUBS];
+	int next_id;
+	int turn;		/* the line to look at first */
+	struct rje_event ev[RJE_MAXEV];
+	int ev_head;
+	int ev_tail;
+};
+
+int rje_group_init(struct rje_group *g, char *name);
+int rje_group_load(struct rje_group *g, char *file, char *name);
+int rje_group_add(struct rje_group *g, char *host, int port, char *user,
+	char *password);
+int rje_group_start(struct rje_group *g);
+int rje_group_submit(struct rje_group *g, char *file, int prio);
+int rje_group_poll(struct rje_group *g, int msec);
+int rje_group_event(struct rje_group *g, struct rje_event *ev);
+int rje_group_jobs(struct rje_group *g, int id, int *done);
+int rje_group_count(struct rje_group *g, int state);
+int rje_group_close(struct rje_group *g);
+
+#endif
@@ -0,0 +1,141 @@
+//  rjehasp - HASP multileaving records.
+//
+//  String control bytes (SCBs) squeeze a record:
+//
+//	00		end of record
+//	100nnnnn	nnnnn blanks
+//	101nnnnn	nnnnn copies of the byte that follows
+//	11nnnnnn	the nnnnnn bytes that follow, as they are
+//
+//  Trailing blanks are dropped; whoever takes the record pads it out.
+
+#include <string.h>
+
+#include "rjehasp.h"
+
+static const unsigned char BLANK = 0x40;
+
+#define SCB_EOR 0x00
+#define SCB_BLANKS 0x80
+#define SCB_DUP 0xa0
+#define SCB_STRING 0xc0
+#define SCB_MAXDUP 31
+#define SCB_MAXSTR 63
+
+// Squeeze len bytes of rec into out, 00 SCB and all.  Returns the bytes
+// used, or -1 if it won't fit in max.
+
+int rje_ml_pack(unsigned char *out, int max, const unsigned char *rec,
+	int len)
+{
+	int i, j, n = 0, run, lit;
+
+	while (len > 0 && rec[len - 1] == BLANK)
+		len--;
+	i = 0;
+	while (i < len) {
+		for (run = 1; i + run < len && rec[i + run] == rec[i] &&
+			run < SCB_MAXDUP; run++)
+			;
+		if (run >= 3 || (run == 2 && rec[i] == BLANK)) {
+			if (n + 2 > max)
+				return (-1);
+			if (rec[i] == BLANK) {
+				out[n++] = SCB_BLANKS | run;
+			} else {
+				out[n++] = SCB_DUP | run;
+				out[n++] = rec[i];
+			}
+			i += run;
+			continue;
+		}
+
+		// A string up to the next run worth squeezing
+
+		for (lit = 1; i + lit < len && lit < SCB_MAXSTR; lit++) {
+			j = i + lit;
+			if (j + 2 < len && rec[j] == rec[j + 1] &&
+				rec[j] == rec[j + 2])
+				break;
+			if (j + 1 < len && rec[j] == BLANK &&
+				rec[j + 1] == BLANK)
+				break;
+		}
+		if (n + 1 + lit > max)
+			return (-1);
+		out[n++] = SCB_STRING | lit;
+		memcpy(out + n, rec + i, lit);
+		n += lit;
+		i += lit;
+	}
+	if (n + 1 > max)
+		return (-1);
+	out[n++] = SCB_EOR;
+	return (n);
+}
+
+// Expand one record from in (len bytes left in the block) into rec.
+// Returns its length, with the bytes of block used in *used, or -1 if
+// the SCBs don't make sense or run off the end of the block.
+
+int rje_ml_unpack(const unsigned char *in, int len, unsigned char *rec,
+	int max, int *used)
+{
+	int i = 0, n = 0, cnt;
+	unsigned char scb;
+
+	for (;;) {
+		if (i >= len)
+			return (-1);
+		scb = in[i++];
+		if (scb == SCB_EOR)
+			break;
+		if ((scb & 0xc0) == SCB_STRING) {
+			cnt = scb & 0x3f;
+			if (i + cnt > len)
+				return (-1);
+			if (n + cnt > max)
+				cnt = max - n;
+			memcpy(rec + n, in + i, cnt);
+			i += scb & 0x3f;
+			n += cnt;
+			continue;
+		}
+		if ((scb & 0xe0) == SCB_BLANKS || (scb & 0xe0) == SCB_DUP) {
+			cnt = scb & 0x1f;
+			if (n + cnt > max)
+				cnt = max - n;
+			if ((scb & 0xe0) == SCB_DUP) {
+				if (i >= len)
+					return (-1);
+				memset(rec + n, in[i++], cnt);
+			} else {
+				memset(rec + n, BLANK, cnt);
+			}
+			n += cnt;
+			continue;
+		}
+		return (-1);
+	}
+	*used = i;
+	return (n);
+}
+
+// Printer SRCB to the ESC action (see rjeforms) for the line after it.
+// The SRCB moves the paper after its line is printed: 1000 00nn spaces
+// nn lines, 1001 cccc skips to channel cccc.
+
+int rje_ml_action(int srcb)
+{
+	static const unsigned char space[4] = {0xd4, 0x61, 0xe2, 0xe3};
+	static const unsigned char channel[13] = {
+		0x61, 0xc1, 0xc2, 0xc3, 0xc4, 0xc5, 0xc6,
+		0xc7, 0xc8, 0xc9, 0xd1, 0xd2, 0xd3
+	};
+
+	if ((srcb & 0xf0) == 0x90 && (srcb & 0x0f) <= 12)
+		return (channel[srcb & 0x0f]);
+	if ((srcb & 0xfc) == 0x80)
+		return (space[srcb & 0x03]);
+	return (0x61);
+}
@@ -0,0 +1,62 @@
+//  rjehasp - HASP multileaving records, for running the line as a
+//  multileaving (MRJE) workstation instead of a 3780.
+//
+//  A multileaving block carries records for several devices at once:
+//
+//	BCB FCS FCS  RCB SRCB data ... 00  RCB SRCB data ... 00  ...  00
+//
+//  BCB is a sequence count, FCS says which of the sender's partner's
+//  streams may send, RCB names the device (stream and type) a record is
+//  for and SRCB adds device detail (carriage control for a printer).
+//  Data is squeezed with SCBs: runs of blanks or of one character become
+//  one or two bytes, the rest goes as counted strings, and a 00 SCB ends
+//  the record.  A record that is just the 00 is the end of the file.
+
+#ifndef RJEHASP_H
+#define RJEHASP_H
+
+#define ML_BLKSIZE 400		/* most data in a block, before framing */
+
+// Block control byte: 1000 nnnn, nnnn counting blocks modulo 16
+
+#define ML_BCB 0x80		/* normal, count nnnn */
+#define ML_BCB_IGNORE 0x90	/* don't check the count */
+#define ML_BCB_RESET 0xa0	/* count starts again from nnnn */
+
+// Function control sequence.  In each byte the low four bits are
+// streams 1 to 4 (0x08 is stream 1): in the first byte printers (from
+// the workstation) or readers (from the host), in the second punches.
+
+#define ML_FCS 0x80		/* always on in both bytes */
+#define ML_FCS_WAIT 0x40	/* first byte: suspend everything */
+#define ML_FCS_CONSOLE 0x40	/* second byte: console may send */
+#define ML_FCS_STREAM(n) (0x10 >> (n))
+
+// Record control byte: 1 sss tttt, stream sss of device type tttt, or
+// one of the control records, which have an SRCB and no data
+
+#define ML_RCB(type, n) (0x80 | (n) << 4 | (type))
+#define ML_RCB_TYPE(rcb) ((rcb) & 0x0f)
+#define ML_RCB_STREAM(rcb) (((rcb) >> 4) & 0x07)
+
+#define ML_MSG 1		/* console message, host to workstation */
+#define ML_CMD 2		/* operator command, workstation to host */
+#define ML_READER 3
+#define ML_PRINTER 4
+#define ML_PUNCH 5
+
+#define ML_RCB_EOB 0x00		/* no more records in the block */
+#define ML_RCB_REQUEST 0x90	/* may I start, SRCB = the device's RCB */
+#define ML_RCB_GRANT 0xa0	/* ... yes you may */
+#define ML_RCB_BADBCB 0xb0	/* your BCB was wrong, SRCB = the count expected */
+#define ML_RCB_SIGNON 0xf0	/* signon card follows, 80 bytes as is */
+#define ML_SRCB_SIGNON 0xc1
+#define ML_SRCB 0x80		/* SRCB for cards, commands and messages */
+
+int rje_ml_pack(unsigned char *out, int max, const unsigned char *rec,
+	int len);
+int rje_ml_unpack(const unsigned char *in, int len, unsigned char *rec,
+	int max, int *used);
+int rje_ml_action(int srcb);
+
+#endif
@@ -0,0 +1,154 @@
+//  rjehist - latency histograms.
+//
+//  Bucket n for a value v:
+//
+//	v < 64		n = v
+//	otherwise	e = (top bit of v) - 5, so v >> e is 32 to 63,
+//			n = 64 + (e - 1) * 32 + (v >> e) - 32
+//
+//  which makes each bucket 1/32 of its power of two wide.
+
+#include <stdio.h>
+#include <string.h>
+
+#include "rjehist.h"
+
+#define HIST_SUB (1 << HIST_BITS)	/* exact values, below this */
+#define HIST_HALF (HIST_SUB / 2)	/* buckets per power of two after */
+#define HIST_TOP 0x7fffffffL		/* anything longer counts as this */
+
+static int hist_index(long v);
+static long hist_low(int n);
+static long hist_high(int n);
+
+// Empty a histogram
+
+void rje_hist_clear(struct rje_hist *h)
+{
+	memset(h, 0, sizeof(*h));
+}
+
+// Count one time, in microseconds
+
+void rje_hist_add(struct rje_hist *h, long usec)
+{
+	if (usec < 0)
+		usec = 0;
+	if (usec > HIST_TOP)
+		usec = HIST_TOP;
+	if (h->count == 0 || usec < h->min)
+		h->min = usec;
+	if (usec > h->max)
+		h->max = usec;
+	h->count++;
+	h->sum += usec;
+	h->bucket[hist_index(usec)]++;
+}
+
+// Add another histogram's counts to this one, as if they'd been counted
+// here too
+
+void rje_hist_merge(struct rje_hist *h, const struct rje_hist *from)
+{
+	int n;
+
+	if (from->count == 0)
+		return;
+	if (h->count == 0 || from->min < h->min)
+		h->min = from->min;
+	if (from->max > h->max)
+		h->max = from->max;
+	h->count += from->count;
+	h->sum += from->sum;
+	for (n = 0; n < HIST_BUCKETS; n++)
+		h->bucket[n] += from->bucket[n];
+}
+
+// The time pct percent of the values were within (the top of the bucket
+// that value falls in, no more than the largest seen), 0 if none
+
+long rje_hist_pct(const struct rje_hist *h, double pct)
+{
+	unsigned long want, seen = 0;
+	long v;
+	int n;
+
+	if (h->count == 0)
+		return (0);
+	want = (unsigned long) (pct / 100.0 * h->count + 0.999999);
+	if (want < 1)
+		want = 1;
+	if (want >= h->count)
+		return (h->max);
+	for (n = 0; n < HIST_BUCKETS; n++) {
+		seen += h->bucket[n];
+		if (seen >= want)
+			break;
+	}
+	v = hist_high(n);
+	if (v > h->max)
+		v = h->max;
+	if (v < h->min)
+		v = h->min;
+	return (v);
+}
+
+// Write a histogram out: a summary line, then every bucket with something
+// in it, with how much of the whole is at or below it
+
+int rje_hist_dump(const struct rje_hist *h, char *name, FILE *fd)
+{
+	static const double pcts[] = {50.0, 90.0, 99.0, 99.9};
+	unsigned long seen = 0;
+	int i, n;
+
+	fprintf(fd, "# %s: %lu, min %ld mean %.0f max %ld us\n", name,
+		h->count, h->min, h->count ? h->sum / h->count : 0.0, h->max);
+	if (h->count == 0)
+		return (0);
+	fprintf(fd, "#");
+	for (i = 0; i < sizeof(pcts) / sizeof(pcts[0]); i++)
+		fprintf(fd, " p%g %ld", pcts[i], rje_hist_pct(h, pcts[i]));
+	fprintf(fd, "\n#     from_us       to_us      count   percentile\n");
+	for (n = 0; n < HIST_BUCKETS; n++) {
+		if (h->bucket[n] == 0)
+			continue;
+		seen += h->bucket[n];
+		fprintf(fd, "%12ld %12ld %10u %11.6f\n", hist_low(n),
+			hist_high(n), h->bucket[n], 100.0 * seen / h->count);
+	}
+	return (0);
+}
+
+static int hist_index(long v)
+{
+	int e;
+
+	if (v < HIST_SUB)
+		return ((int) v);
+	for (e = 1; (v >> e) >= HIST_SUB; e++)
+		;
+	return (HIST_SUB + (e - 1) * HIST_HALF + (int) (v >> e) - HIST_HALF);
+}
+
+// The values bucket n counts, from and to
+
+static long hist_low(int n)
+{
+	int e;
+
+	if (n < HIST_SUB)
+		return (n);
+	e = (n - HIST_SUB) / HIST_HALF + 1;
+	return ((long) ((n - HIST_SUB) % HIST_HALF + HIST_HALF) << e);
+}
+
+static long hist_high(int n)
+{
+	int e;
+
+	if (n < HIST_SUB)
+		return (n);
+	e = (n - HIST_SUB) / HIST_HALF + 1;
+	return (((long) ((n - HIST_SUB) % HIST_HALF + HIST_HALF + 1) << e) - 1);
+}
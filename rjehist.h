@@ -0,0 +1,32 @@
+//  rjehist - latency histograms, for seeing where the time on a line goes.
+//
+//  Times are kept in microseconds in log-linear buckets, the way HDR
+//  histograms do it: below 64us every value has a bucket of its own, and
+//  above that each power of two is split into 32 buckets, so whatever
+//  the size of a value it is counted to within about 3%, in a fixed
+//  table, with no allocation.  Finding the bucket is a short loop of
+//  shifts, one for each power of two the value is over 64us.
+
+#ifndef RJEHIST_H
+#define RJEHIST_H
+
+#include <stdio.h>
+
+#define HIST_BITS 6		/* 2^HIST_BITS exact, then half that per power */
+#define HIST_BUCKETS 864	/* enough for 2^31us, about 35 minutes */
+
+struct rje_hist {
+	unsigned long count;	/* values counted */
+	long min;		/* smallest, us */
+	long max;		/* ... and largest */
+	double sum;		/* for the mean */
+	unsigned int bucket[HIST_BUCKETS];
+};
+
+void rje_hist_clear(struct rje_hist *h);
+void rje_hist_add(struct rje_hist *h, long usec);
+void rje_hist_merge(struct rje_hist *h, const struct rje_hist *from);
+long rje_hist_pct(const struct rje_hist *h, double pct);
+int rje_hist_dump(const struct rje_hist *h, char *name, FILE *fd);
+
+#endif
@@ -0,0 +1,745 @@
+//  rjeindex - the full text index of received print output.
+//
+//  The queue between write_record and the indexer is a ring of fixed
+//  size entries, so handing a line over is a copy under the lock and
+//  nothing more.  If the indexer falls IDX_QUEUE lines behind, the line
+//  waits for room.  The indexer keeps a hash table of words for each
+//  output in progress; at its end the words are sorted and written out
+//  in one go.
+
+#include <stdio.h>
+#include <ctype.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "rjeindex.h"
+
+#if !defined (_WIN32)
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#define IDX_MAGIC "RJX1"
+#define IDX_BAD -2		/* idx_lines: a segment that doesn't add up */
+
+// A word in an output being indexed, with where it has been seen
+
+struct idx_entry {
+	char word[IDX_WORD];	/* zero padded */
+	unsigned int hash;
+	struct rje_idxpost *post;
+	unsigned int n;
+	unsigned int max;
+};
+
+// The words of one output so far
+
+struct idx_table {
+	int active;
+	struct idx_entry *e;	/* open addressed, size a power of 2 */
+	unsigned int size;
+	unsigned int used;
+	unsigned long npost;
+	unsigned int page;
+	unsigned int line;
+};
+
+// A line for the indexer, or the end of an output
+
+struct idx_qent {
+	char kind;		/* 'L' line, 'E' end */
+	char stream;
+	char newpage;		/* skip to channel 1 before the line */
+	char ebcdic;		/* text still to be translated */
+	short len;
+	int number;
+	char job[9];
+	char file[80];
+	unsigned char text[IDX_LINE];
+};
+
+// Scratch lists of postings for a search
+
+struct idx_buf {
+	struct rje_idxpost *p[3];
+	unsigned long max;
+};
+
+struct rje_index {
+	FILE *fd;
+	const unsigned char *xlate;	/* EBCDIC to ASCII */
+	struct idx_table t[IDX_STREAMS];
+#if !defined (_WIN32)
+	struct idx_qent *q;
+	int head;		/* next to fill */
+	int tail;		/* next for the indexer */
+	int count;
+	int stop;
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t more;	/* something in the queue */
+	pthread_cond_t room;	/* room in it */
+#endif
+};
+
+static int idx_put(struct rje_index *x, struct idx_qent *q);
+static int idx_do(struct rje_index *x, struct idx_qent *q);
+static int idx_words(struct rje_index *x, struct idx_table *t,
+	const unsigned char *text, int len, int ebcdic);
+static int idx_add(struct idx_table *t, const char *word);
+static int idx_write(struct rje_index *x, struct idx_table *t,
+	struct idx_qent *q);
+static int idx_free(struct idx_table *t);
+static int idx_wordcmp(const void *a, const void *b);
+static int idx_key(const char *in, char *word);
+#if !defined (_WIN32)
+static void *idx_thread(void *arg);
+#endif
+
+// Which characters make up a word, upper cased; 0 = a break
+
+static unsigned char wordch[256];
+
+static int idx_chars()
+{
+	int c;
+
+	if (wordch['A'])
+		return (0);
+	for (c = 'A'; c <= 'Z'; c++) {
+		wordch[c] = c;
+		wordch[c - 'A' + 'a'] = c;
+	}
+	for (c = '0'; c <= '9'; c++)
+		wordch[c] = c;
+	wordch['$'] = '$';
+	wordch['#'] = '#';
+	wordch['@'] = '@';
+	return (0);
+}
+
+// ---------------------------------------------------------------------------------
+// Building the index
+// ---------------------------------------------------------------------------------
+
+// Start indexing into file, added to if it's there already.  xlate is
+// for lines given still in EBCDIC.
+
+struct rje_index *rje_index_open(const char *file, const unsigned char *xlate)
+{
+	struct rje_index *x;
+
+	idx_chars();
+	if ((x = (struct rje_index *) calloc(1, sizeof(*x))) == NULL)
+		return (NULL);
+	x->xlate = xlate;
+	if ((x->fd = fopen(file, "ab")) == NULL) {
+		free(x);
+		return (NULL);
+	}
+#if !defined (_WIN32)
+	x->q = (struct idx_qent *) malloc(IDX_QUEUE * sizeof(struct idx_qent));
+	if (x->q == NULL) {
+		fclose(x->fd);
+		free(x);
+		return (NULL);
+	}
+	pthread_mutex_init(&x->lock, NULL);
+	pthread_cond_init(&x->more, NULL);
+	pthread_cond_init(&x->room, NULL);
+	if (pthread_create(&x->thread, NULL, idx_thread, x) != 0) {
+		pthread_mutex_destroy(&x->lock);
+		pthread_cond_destroy(&x->more);
+		pthread_cond_destroy(&x->room);
+		free(x->q);
+		fclose(x->fd);
+		free(x);
+		return (NULL);
+	}
+#endif
+	return (x);
+}
+
+// A print line of output stream, as laid out for the print file
+
+int rje_index_line(struct rje_index *x, int stream, const unsigned char *text,
+	int len, int newpage, int ebcdic)
+{
+	struct idx_qent q;
+
+	if (stream < 0 || stream >= IDX_STREAMS)
+		return (-1);
+	if (len > IDX_LINE)
+		len = IDX_LINE;
+	q.kind = 'L';
+	q.stream = stream;
+	q.newpage = newpage;
+	q.ebcdic = ebcdic;
+	q.len = len;
+	memcpy(q.text, text, len);
+	return (idx_put(x, &q));
+}
+
+// The stream's output has ended: write its segment, for job (NULL or
+// empty if it isn't known) and file
+
+int rje_index_end(struct rje_index *x, int stream, const char *job,
+	int number, const char *file)
+{
+	struct idx_qent q;
+
+	if (stream < 0 || stream >= IDX_STREAMS)
+		return (-1);
+	memset(&q, 0, sizeof(q));
+	q.kind = 'E';
+	q.stream = stream;
+	q.number = number;
+	if (job != NULL)
+		strncpy(q.job, job, sizeof(q.job) - 1);
+	if (file != NULL)
+		strncpy(q.file, file, sizeof(q.file) - 1);
+	return (idx_put(x, &q));
+}
+
+// Finish what's queued and stop.  Output that hasn't ended isn't written.
+
+int rje_index_close(struct rje_index *x)
+{
+	int i;
+
+	if (x == NULL)
+		return (0);
+#if !defined (_WIN32)
+	pthread_mutex_lock(&x->lock);
+	x->stop = 1;
+	pthread_cond_signal(&x->more);
+	pthread_mutex_unlock(&x->lock);
+	pthread_join(x->thread, NULL);
+	pthread_mutex_destroy(&x->lock);
+	pthread_cond_destroy(&x->more);
+	pthread_cond_destroy(&x->room);
+	free(x->q);
+#endif
+	for (i = 0; i < IDX_STREAMS; i++)
+		idx_free(&x->t[i]);
+	fclose(x->fd);
+	free(x);
+	return (0);
+}
+
+#if defined (_WIN32)
+
+static int idx_put(struct rje_index *x, struct idx_qent *q)
+{
+	return (idx_do(x, q));
+}
+
+#else
+
+// Onto the queue for the indexer, waiting for room if it's full
+
+static int idx_put(struct rje_index *x, struct idx_qent *q)
+{
+	pthread_mutex_lock(&x->lock);
+	while (x->count == IDX_QUEUE)
+		pthread_cond_wait(&x->room, &x->lock);
+	if (q->kind == 'L')
+		memcpy(&x->q[x->head], q, offsetof(struct idx_qent, text) + q->len);
+	else
+		memcpy(&x->q[x->head], q, sizeof(*q));
+	x->head = (x->head + 1) % IDX_QUEUE;
+	x->count++;
+	pthread_cond_signal(&x->more);
+	pthread_mutex_unlock(&x->lock);
+	return (0);
+}
+
+// The indexer.  The entry it's working on stays in the queue (counted)
+// until it's done, so it isn't written over.
+
+static void *idx_thread(void *arg)
+{
+	struct rje_index *x = (struct rje_index *) arg;
+	struct idx_qent *q;
+
+	pthread_mutex_lock(&x->lock);
+	for (;;) {
+		while (x->count == 0 && !x->stop)
+			pthread_cond_wait(&x->more, &x->lock);
+		if (x->count == 0)
+			break;
+		q = &x->q[x->tail];
+		pthread_mutex_unlock(&x->lock);
+		idx_do(x, q);
+		pthread_mutex_lock(&x->lock);
+		x->tail = (x->tail + 1) % IDX_QUEUE;
+		x->count--;
+		pthread_cond_signal(&x->room);
+	}
+	pthread_mutex_unlock(&x->lock);
+	return (NULL);
+}
+
+#endif
+
+// A line into its output's table, or the table out to the file
+
+static int idx_do(struct rje_index *x, struct idx_qent *q)
+{
+	struct idx_table *t = &x->t[(int) q->stream];
+
+	if (q->kind == 'E') {
+		if (t->active)
+			idx_write(x, t, q);
+		idx_free(t);
+		return (0);
+	}
+	if (!t->active) {
+		t->active = 1;
+		t->page = 1;
+		t->line = 0;
+	}
+	if (q->newpage && t->line > 0) {
+		t->page++;
+		t->line = 0;
+	}
+	t->line++;
+	return (idx_words(x, t, q->text, q->len, q->ebcdic));
+}
+
+// Split a line into words and add each
+
+static int idx_words(struct rje_index *x, struct idx_table *t,
+	const unsigned char *text, int len, int ebcdic)
+{
+	char word[IDX_WORD];
+	int i, n = 0;
+	unsigned char c;
+
+	for (i = 0; i <= len; i++) {
+		if (i == len)
+			c = 0;
+		else if (ebcdic)
+			c = wordch[x->xlate[text[i]]];
+		else
+			c = wordch[text[i]];
+		if (c != 0) {
+			if (n < IDX_WORD)
+				word[n] = c;
+			n++;
+			continue;
+		}
+		if (n > 1) {		/* single letters aren't worth it */
+			if (n < IDX_WORD)
+				memset(word + n, 0, IDX_WORD - n);
+			if (idx_add(t, word) < 0)
+				return (-1);
+		}
+		if (n > 2 && !isalnum((unsigned char) word[0])) {
+			memmove(word, word + 1, IDX_WORD - 1);	/* $HASP395 is */
+			word[IDX_WORD - 1] = 0;			/* HASP395 too */
+			if (n - 1 < IDX_WORD)
+				memset(word + n - 1, 0, IDX_WORD - n + 1);
+			if (idx_add(t, word) < 0)
+				return (-1);
+		}
+		n = 0;
+	}
+	return (0);
+}
+
+// A word seen on the table's current line
+
+static int idx_add(struct idx_table *t, const char *word)
+{
+	struct idx_entry *e, *old;
+	struct rje_idxpost *p;
+	unsigned int h = 2166136261u, i, size;
+	int k;
+
+	for (k = 0; k < IDX_WORD && word[k]; k++)
+		h = (h ^ (unsigned char) word[k]) * 16777619u;
+	if (t->used * 2 >= t->size) {	/* grow it */
+		old = t->e;
+		size = t->size;
+		t->size = size ? size * 2 : 1024;
+		t->e = (struct idx_entry *) calloc(t->size, sizeof(*e));
+		if (t->e == NULL) {
+			t->e = old;
+			t->size = size;
+			return (-1);
+		}
+		for (i = 0; i < size; i++) {
+			if (old[i].post == NULL)
+				continue;
+			e = &t->e[old[i].hash & (t->size - 1)];
+			while (e->post != NULL)
+				e = (e == &t->e[t->size - 1]) ? t->e : e + 1;
+			*e = old[i];
+		}
+		free(old);
+	}
+	e = &t->e[h & (t->size - 1)];
+	while (e->post != NULL &&
+		(e->hash != h || memcmp(e->word, word, IDX_WORD) != 0))
+		e = (e == &t->e[t->size - 1]) ? t->e : e + 1;
+	if (e->post == NULL) {
+		if ((e->post = (struct rje_idxpost *) malloc(4 * sizeof(*p))) == NULL)
+			return (-1);
+		memcpy(e->word, word, IDX_WORD);
+		e->hash = h;
+		e->n = 0;
+		e->max = 4;
+		t->used++;
+	} else if (e->post[e->n - 1].page == t->page &&
+		e->post[e->n - 1].line == t->line) {
+		return (0);		/* on this line already */
+	} else if (e->n == e->max) {
+		p = (struct rje_idxpost *) realloc(e->post, e->max * 2 * sizeof(*p));
+		if (p == NULL)
+			return (-1);
+		e->post = p;
+		e->max *= 2;
+	}
+	e->post[e->n].page = t->page;
+	e->post[e->n].line = t->line;
+	e->n++;
+	t->npost++;
+	return (0);
+}
+
+// The table as a segment: header, words in order, postings
+
+static int idx_write(struct rje_index *x, struct idx_table *t,
+	struct idx_qent *q)
+{
+	struct rje_idxseg *h;
+	struct rje_idxword *w;
+	struct rje_idxpost *p;
+	struct idx_entry **e;
+	unsigned int i, n = 0, first = 0;
+	size_t size;
+
+	if (t->used == 0)
+		return (0);
+	size = sizeof(*h) + t->used * sizeof(*w) + t->npost * sizeof(*p);
+	e = (struct idx_entry **) malloc(t->used * sizeof(*e));
+	if (e == NULL || (h = (struct rje_idxseg *) calloc(1, size)) == NULL) {
+		free(e);
+		return (-1);
+	}
+	for (i = 0; i < t->size; i++) {
+		if (t->e[i].post != NULL)
+			e[n++] = &t->e[i];
+	}
+	qsort(e, n, sizeof(*e), idx_wordcmp);
+	memcpy(h->magic, IDX_MAGIC, 4);
+	h->size = size;
+	h->nword = n;
+	h->npost = t->npost;
+	strcpy(h->job, q->job);
+	h->number = q->number;
+	h->when = time(NULL);
+	h->pages = t->page;
+	h->lines = t->line;
+	strcpy(h->file, q->file);
+	w = (struct rje_idxword *) (h + 1);
+	p = (struct rje_idxpost *) (w + n);
+	for (i = 0; i < n; i++) {
+		memcpy(w[i].word, e[i]->word, IDX_WORD);
+		w[i].first = first;
+		w[i].count = e[i]->n;
+		memcpy(p + first, e[i]->post, e[i]->n * sizeof(*p));
+		first += e[i]->n;
+	}
+	fwrite(h, size, 1, x->fd);
+	fflush(x->fd);		/* whole, for anyone searching */
+	free(h);
+	free(e);
+	return (0);
+}
+
+static int idx_free(struct idx_table *t)
+{
+	unsigned int i;
+
+	for (i = 0; i < t->size; i++)
+		free(t->e[i].post);
+	free(t->e);
+	memset(t, 0, sizeof(*t));
+	return (0);
+}
+
+static int idx_wordcmp(const void *a, const void *b)
+{
+	return (memcmp((*(struct idx_entry **) a)->word,
+		(*(struct idx_entry **) b)->word, IDX_WORD));
+}
+
+// ---------------------------------------------------------------------------------
+// Searching it
+// ---------------------------------------------------------------------------------
+
+// A search word as it's kept, zero padded.  Returns how many characters
+// of it to compare: IDX_WORD, or fewer for word*.  0 if it isn't a word.
+
+static int idx_key(const char *in, char *word)
+{
+	int n;
+
+	memset(word, 0, IDX_WORD);
+	for (n = 0; in[n] && wordch[(unsigned char) in[n]]; n++) {
+		if (n < IDX_WORD)
+			word[n] = wordch[(unsigned char) in[n]];
+	}
+	if (n == 0)
+		return (0);
+	if (in[n] == '*')
+		return (n < IDX_WORD ? n : IDX_WORD);
+	return (IDX_WORD);
+}
+
+// Look word up in a segment's words: the first that matches, and how
+// many (more than one for word*)
+
+static int idx_lookup(struct rje_idxword *w, unsigned int n, const char *word,
+	int cmp, unsigned int *at)
+{
+	unsigned int lo = 0, hi = n, mid, k;
+
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (memcmp(w[mid].word, word, cmp) < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	for (k = lo; k < n && memcmp(w[k].word, word, cmp) == 0; k++)
+		;
+	*at = lo;
+	return (k - lo);
+}
+
+static int idx_before(struct rje_idxpost *a, struct rje_idxpost *b)
+{
+	return (a->page < b->page || (a->page == b->page && a->line < b->line));
+}
+
+// Room for n postings in each of a search's scratch lists.  They may
+// move, so pointers into them have to be taken again after.
+
+static int idx_room(struct idx_buf *b, unsigned long n)
+{
+	struct rje_idxpost *p;
+	int i;
+
+	if (n <= b->max)
+		return (0);
+	for (i = 0; i < 3; i++) {
+		p = (struct rje_idxpost *) realloc(b->p[i], n * sizeof(*p));
+		if (p == NULL)
+			return (-1);
+		b->p[i] = p;
+	}
+	b->max = n;
+	return (0);
+}
+
+// The lines a search word is on in a segment, in order: straight from
+// the segment for a word, merged into scratch list 1 for a word* that
+// matches several.  Returns how many, 0 if none, -1 if out of memory,
+// IDX_BAD if a word's postings aren't all in the segment.
+
+static long idx_lines(struct rje_idxseg *h, const char *key, int cmp,
+	struct idx_buf *b, struct rje_idxpost **out)
+{
+	struct rje_idxword *w = (struct rje_idxword *) (h + 1);
+	struct rje_idxpost *p = (struct rje_idxpost *) (w + h->nword);
+	struct rje_idxpost *a, *c, *t;
+	unsigned int at, j, n;
+	unsigned long total = 0, na, nc, x, y;
+
+	if ((n = idx_lookup(w, h->nword, key, cmp, &at)) == 0)
+		return (0);
+	for (j = at; j < at + n; j++) {
+		if (w[j].first > h->npost || w[j].count > h->npost - w[j].first)
+			return (IDX_BAD);
+	}
+	if (n == 1) {
+		*out = p + w[at].first;
+		return (w[at].count);
+	}
+	for (j = at; j < at + n; j++)
+		total += w[j].count;
+	if (idx_room(b, total) < 0)
+		return (-1);
+	a = b->p[1];
+	c = b->p[2];
+	memcpy(a, p + w[at].first, w[at].count * sizeof(*a));
+	na = w[at].count;
+	for (j = at + 1; j < at + n; j++) {
+		t = p + w[j].first;
+		for (x = y = nc = 0; x < na || y < w[j].count; ) {
+			if (y == w[j].count || (x < na && idx_before(&a[x], &t[y])))
+				c[nc++] = a[x++];
+			else if (x == na || idx_before(&t[y], &a[x]))
+				c[nc++] = t[y++];
+			else {
+				c[nc++] = a[x++];	/* both on the line */
+				y++;
+			}
+		}
+		t = a;
+		a = c;
+		c = t;
+		na = nc;
+	}
+	b->p[1] = a;
+	b->p[2] = c;
+	*out = a;
+	return (na);
+}
+
+// Every output in the index with a line that has all of words (separated
+// by blanks) on it.  fn is called for each, oldest first, with the first
+// such line and how many there are; a nonzero return stops the search.
+// Returns how many were found, or -1 if the index can't be read.
+
+int rje_index_find(const char *file, const char *words,
+	int (*fn)(struct rje_idxhit *h, void *arg), void *arg)
+{
+	char key[IDX_FIND][IDX_WORD];
+	int cmp[IDX_FIND], nkey = 0, i, found = 0;
+	unsigned char *base;
+	size_t len, off;
+	struct rje_idxseg *h;
+	struct rje_idxpost *l, *acc;
+	struct rje_idxhit hit;
+	struct idx_buf b;
+	long n, na, x, y, k;
+#if defined (_WIN32)
+	FILE *fd;
+#else
+	struct stat st;
+	int fd;
+#endif
+
+	idx_chars();
+	while (*words && nkey < IDX_FIND) {
+		while (*words == ' ' || *words == ',')
+			words++;
+		if (*words == 0)
+			break;
+		if ((cmp[nkey] = idx_key(words, key[nkey])) > 0)
+			nkey++;
+		while (*words && *words != ' ' && *words != ',')
+			words++;
+	}
+	if (nkey == 0)
+		return (0);
+
+#if defined (_WIN32)
+	if ((fd = fopen(file, "rb")) == NULL)
+		return (-1);
+	fseek(fd, 0, SEEK_END);
+	len = ftell(fd);
+	fseek(fd, 0, SEEK_SET);
+	if ((base = (unsigned char *) malloc(len + 1)) == NULL) {
+		fclose(fd);
+		return (-1);
+	}
+	len = fread(base, 1, len, fd);
+	fclose(fd);
+#else
+	if ((fd = open(file, O_RDONLY)) < 0)
+		return (-1);
+	if (fstat(fd, &st) != 0) {
+		close(fd);
+		return (-1);
+	}
+	len = st.st_size;
+	base = NULL;
+	if (len > 0) {
+		base = (unsigned char *) mmap(NULL, len, PROT_READ, MAP_SHARED, fd, 0);
+		if (base == (unsigned char *) MAP_FAILED) {
+			close(fd);
+			return (-1);
+		}
+	}
+	close(fd);
+#endif
+
+	memset(&b, 0, sizeof(b));
+	for (off = 0; off + sizeof(*h) <= len; off += h->size) {
+		h = (struct rje_idxseg *) (base + off);
+		if (memcmp(h->magic, IDX_MAGIC, 4) != 0 || h->size < sizeof(*h) ||
+			h->size > len - off || sizeof(*h) +
+			(unsigned long long) h->nword * sizeof(struct rje_idxword) +
+			(unsigned long long) h->npost * sizeof(struct rje_idxpost) >
+			h->size)
+			break;		/* not a segment, or cut short */
+
+		// The lines the first word is on, then those of them each of
+		// the others is on too, in scratch list 0
+
+		if ((na = idx_lines(h, key[0], cmp[0], &b, &acc)) == IDX_BAD)
+			break;
+		if (na <= 0)
+			continue;
+		if (nkey > 1) {
+			if (idx_room(&b, na) < 0)
+				break;
+			memcpy(b.p[0], acc, na * sizeof(*acc));
+			acc = b.p[0];
+		}
+		for (i = 1; i < nkey && na > 0; i++) {
+			if ((n = idx_lines(h, key[i], cmp[i], &b, &l)) <= 0) {
+				na = n;
+				break;
+			}
+			acc = b.p[0];	/* idx_lines may have moved it */
+			for (x = y = k = 0; x < na && y < n; ) {
+				if (idx_before(&acc[x], &l[y]))
+					x++;
+				else if (idx_before(&l[y], &acc[x]))
+					y++;
+				else {
+					acc[k++] = acc[x++];
+					y++;
+				}
+			}
+			na = k;
+		}
+		if (na == IDX_BAD)
+			break;
+		if (na <= 0)
+			continue;
+		found++;
+		memset(&hit, 0, sizeof(hit));
+		memcpy(hit.job, h->job, sizeof(hit.job));
+		hit.number = h->number;
+		hit.when = h->when;
+		memcpy(hit.file, h->file, sizeof(hit.file));
+		hit.pages = h->pages;
+		hit.count = na;
+		hit.page = acc[0].page;
+		hit.line = acc[0].line;
+		if (fn != NULL && fn(&hit, arg) != 0)
+			break;
+	}
+	for (i = 0; i < 3; i++)
+		free(b.p[i]);
+
+#if defined (_WIN32)
+	free(base);
+#else
+	if (base != NULL)
+		munmap(base, len);
+#endif
+	return (found);
+}
@@ -0,0 +1,81 @@
+//  rjeindex - a full text index of received print output, so finding the
+//  job that put out an IEF or 1R message is a lookup rather than a grep
+//  through every listing.
+//
+//  Each print line is handed to rje_index_line as write_record lays it
+//  out, which only copies it into a queue: a thread of its own splits it
+//  into words and adds them to a table for the output it belongs to.
+//  When that output ends, rje_index_end appends the table to the index
+//  file as one segment - the job's name and number and where its output
+//  went, then its words in order, each with the pages and lines it's on.
+//  A segment is only ever added whole, so the file can be searched while
+//  output is still coming in.
+//
+//  A word is a run of letters, digits and $ # @, in upper case, kept to
+//  its first IDX_WORD characters.  rje_index_find looks words up in every
+//  segment by binary search; a word ending in * matches any word it
+//  starts.
+//
+//  Without threads (Windows), the words are indexed as the line comes.
+
+#ifndef RJEINDEX_H
+#define RJEINDEX_H
+
+#define IDX_WORD 16		/* characters of a word kept */
+#define IDX_STREAMS 8		/* outputs being indexed at once */
+#define IDX_QUEUE 1024		/* lines waiting for the indexer */
+#define IDX_LINE 256		/* longest line indexed */
+#define IDX_FIND 8		/* words in one search */
+
+// On disk: a segment header, its words in order, then their postings
+
+struct rje_idxseg {
+	char magic[4];		/* "RJX1" */
+	unsigned int size;	/* the whole segment, bytes */
+	unsigned int nword;
+	unsigned int npost;
+	char job[9];		/* blank if not known */
+	char pad[3];
+	int number;		/* host's job number, 0 = not known */
+	long long when;		/* output ended, time() */
+	unsigned int pages;
+	unsigned int lines;
+	char file[80];		/* where the output went */
+};
+
+struct rje_idxword {
+	char word[IDX_WORD];	/* not terminated if it's IDX_WORD long */
+	unsigned int first;	/* its first posting */
+	unsigned int count;
+};
+
+struct rje_idxpost {
+	unsigned int page;	/* from 1 */
+	unsigned int line;	/* on the page, from 1 */
+};
+
+// A job (output) found by rje_index_find
+
+struct rje_idxhit {
+	char job[9];
+	int number;
+	long long when;
+	char file[80];
+	unsigned int pages;
+	long count;		/* lines with the (first) word on them */
+	unsigned int page;	/* the first of them */
+	unsigned int line;
+};
+
+struct rje_index;
+
+struct rje_index *rje_index_open(const char *file, const unsigned char *xlate);
+int rje_index_line(struct rje_index *x, int stream, const unsigned char *text,
+	int len, int newpage, int ebcdic);
+int rje_index_end(struct rje_index *x, int stream, const char *job,
+	int number, const char *file);
+int rje_index_close(struct rje_index *x);
+int rje_index_find(const char *file, const char *words,
+	int (*fn)(struct rje_idxhit *h, void *arg), void *arg);
+
+#endif
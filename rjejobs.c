@@ -0,0 +1,292 @@
+//  rjejobs - following jobs from the deck we send to the output that
+//  comes back.
+//
+//  JOB cards understood:
+//
+//	//name JOB ...,CLASS=c,...		OS, MVS, JES2, JES3
+//	* $$ JOB JNM=name,...,CLASS=c,...	DOS/VS POWER
+//
+//  Messages understood, anywhere in a printer line or console message:
+//
+//	JOB  123  $HASP100 name ON READER1	the number may be JOB00123,
+//	JOB  123  $HASP395 name ENDED		or missing altogether
+//	1Q34I JOB name 00123 ...		POWER, any 1xnnx id
+//
+//  Output is matched on the job name as a word in the line, a line that
+//  also has the job's number in it winning over one that hasn't.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "rjejobs.h"
+
+#define JOB_COLS 72		/* JCL stops at column 71 */
+
+static int job_word(const char *p, char *word, int max);
+static int has_word(const char *line, const char *word);
+static int has_number(const char *line, int number);
+static int by_value(const void *a, const void *b);
+
+// Is this card a JOB card?  If so, the job name and class (blank if it
+// doesn't say) and 1.  xlate, if not NULL, translates the card to ASCII.
+
+int rje_job_card(const unsigned char *card, int len,
+	const unsigned char *xlate, char *name, char *cls)
+{
+	char text[JOB_COLS + 1];
+	char *p;
+	int i;
+
+	if (len > JOB_COLS)
+		len = JOB_COLS;
+	for (i = 0; i < len; i++)
+		text[i] = xlate ? xlate[card[i]] : card[i];
+	text[len] = 0;
+
+	if (strncmp(text, "* $$ JOB ", 9) == 0) {
+		if ((p = strstr(text, "JNM=")) == NULL)
+			return (0);
+		job_word(p + 4, name, 8);
+	} else if (text[0] == '/' && text[1] == '/' && text[2] != ' ' &&
+		text[2] != '*') {
+		p = text + 2 + job_word(text + 2, name, 8);
+		if (*p != ' ')
+			return (0);	/* name too long, or nothing after */
+		while (*p == ' ')
+			p++;
+		if (strncmp(p, "JOB", 3) != 0 || (p[3] != ' ' && p[3] != 0))
+			return (0);
+	} else {
+		return (0);
+	}
+	if (strlen(name) == 0)
+		return (0);
+	*cls = ' ';
+	if ((p = strstr(text, "CLASS=")) != NULL && isalnum((unsigned char) p[6]))
+		*cls = p[6];
+	return (1);
+}
+
+// Is this line a host message about a job?  If so, the job name and
+// number (0 if it doesn't give one) and JOBMSG_xxx.
+
+int rje_job_msg(const char *line, char *name, int *number)
+{
+	const char *p, *q;
+
+	*number = 0;
+	if ((p = strstr(line, "$HASP")) != NULL && isdigit((unsigned char) p[5]) &&
+		isdigit((unsigned char) p[6]) && isdigit((unsigned char) p[7])) {
+		for (q = line; q < p && *number == 0; q++) {
+			if (strncmp(q, "JOB", 3) == 0 && (q == line || q[-1] == ' ')) {
+				q += 3;
+				while (*q == ' ')
+					q++;
+				*number = atoi(q);
+			}
+		}
+		q = p + 8;
+		while (*q == ' ')
+			q++;
+		if (job_word(q, name, 8) == 0)
+			return (JOBMSG_NONE);
+		if (strncmp(p + 5, "100", 3) == 0)
+			return (JOBMSG_READ);
+		if (strncmp(p + 5, "395", 3) == 0 || strncmp(p + 5, "165", 3) == 0)
+			return (JOBMSG_ENDED);
+		return (JOBMSG_OTHER);
+	}
+
+	// POWER: 1xnnx message id, then JOB name number
+
+	for (p = line; *p == ' '; p++)
+		;
+	if (p[0] != '1' || !isalnum((unsigned char) p[1]) ||
+		!isalnum((unsigned char) p[2]) || !isalnum((unsigned char) p[3]) ||
+		!isalpha((unsigned char) p[4]) || p[5] != ' ')
+		return (JOBMSG_NONE);
+	if ((p = strstr(p, " JOB ")) == NULL)
+		return (JOBMSG_NONE);
+	p += 5;
+	while (*p == ' ')
+		p++;
+	p += job_word(p, name, 8);
+	if (strlen(name) == 0)
+		return (JOBMSG_NONE);
+	while (*p == ' ')
+		p++;
+	if (isdigit((unsigned char) *p))
+		*number = atoi(p);
+	return (JOBMSG_OTHER);
+}
+
+// The i'th job in the table, oldest first
+
+struct rje_jobrec *rje_jobs_get(struct rje_jobs *t, int i)
+{
+	if (i < 0 || i >= t->n)
+		return (NULL);
+	return (&t->job[(t->first + i) % RJE_MAXJOBS]);
+}
+
+// A JOB card has gone to the host.  If the table is full, the oldest
+// job makes room.
+
+struct rje_jobrec *rje_jobs_add(struct rje_jobs *t, int id, char *file,
+	char *name, int cls, long now)
+{
+	struct rje_jobrec *j;
+
+	if (t->n == RJE_MAXJOBS) {
+		t->first = (t->first + 1) % RJE_MAXJOBS;
+		t->n--;
+	}
+	j = &t->job[(t->first + t->n) % RJE_MAXJOBS];
+	t->n++;
+	memset(j, 0, sizeof(*j));
+	j->id = id;
+	strncpy(j->name, name, sizeof(j->name) - 1);
+	j->cls = cls;
+	strncpy(j->file, file, sizeof(j->file) - 1);
+	j->state = JOB_SENT;
+	j->when = time(NULL);
+	j->submit = now;
+	return (j);
+}
+
+// The job a host message is about: the one with its number, or else the
+// oldest of that name that has no number yet
+
+struct rje_jobrec *rje_jobs_named(struct rje_jobs *t, char *name, int number)
+{
+	struct rje_jobrec *j;
+	int i;
+
+	if (number > 0) {
+		for (i = t->n - 1; i >= 0; i--) {
+			j = rje_jobs_get(t, i);
+			if (j->number == number && strcmp(j->name, name) == 0)
+				return (j);
+		}
+	}
+	for (i = 0; i < t->n; i++) {
+		j = rje_jobs_get(t, i);
+		if (j->number == 0 && strcmp(j->name, name) == 0)
+			return (j);
+	}
+	return (NULL);
+}
+
+// The job a line of output belongs to, or NULL if it doesn't name one.
+// A job whose number is in the line too is best, then the oldest whose
+// output isn't in, then the newest.
+
+struct rje_jobrec *rje_jobs_match(struct rje_jobs *t, const char *line)
+{
+	struct rje_jobrec *j, *waiting = NULL, *any = NULL;
+	int i;
+
+	for (i = t->n - 1; i >= 0; i--) {
+		j = rje_jobs_get(t, i);
+		if (!has_word(line, j->name))
+			continue;
+		if (j->number > 0 && has_number(line, j->number))
+			return (j);
+		if (j->state < JOB_DONE)
+			waiting = j;
+		if (any == NULL)
+			any = j;
+	}
+	return (waiting != NULL ? waiting : any);
+}
+
+// Turnaround figures for the jobs of class cls (0 = all) in the table
+// whose output is back.  Returns the number of them.
+
+int rje_jobs_class(struct rje_jobs *t, int cls, struct rje_jobstat *st)
+{
+	long v[RJE_MAXJOBS];
+	double sum = 0;
+	struct rje_jobrec *j;
+	int i, n = 0;
+
+	memset(st, 0, sizeof(*st));
+	for (i = 0; i < t->n; i++) {
+		j = rje_jobs_get(t, i);
+		if (j->state != JOB_DONE || (cls != 0 && j->cls != cls))
+			continue;
+		v[n] = j->end - j->submit;
+		sum += v[n++];
+	}
+	if (n == 0)
+		return (0);
+	qsort(v, n, sizeof(v[0]), by_value);
+	st->count = n;
+	st->mean = (long) (sum / n);
+	st->p50 = v[(n - 1) / 2];
+	st->p90 = v[(n * 9 + 9) / 10 - 1];
+	st->max = v[n - 1];
+	return (n);
+}
+
+// Copy a job name (letters, digits, @ # $) of up to max characters.
+// Returns its length; word is empty if there isn't one, or it's longer.
+
+static int job_word(const char *p, char *word, int max)
+{
+	int n = 0;
+
+	while (isalnum((unsigned char) p[n]) || p[n] == '@' || p[n] == '#' ||
+		p[n] == '$')
+		n++;
+	if (n > max)
+		n = 0;
+	memcpy(word, p, n);
+	word[n] = 0;
+	return (n);
+}
+
+// Does word appear in line, with no name character either side of it?
+
+static int has_word(const char *line, const char *word)
+{
+	const char *p = line;
+	int n = strlen(word);
+
+	if (n == 0)
+		return (0);
+	while ((p = strstr(p, word)) != NULL) {
+		if ((p == line || !(isalnum((unsigned char) p[-1]) ||
+			p[-1] == '@' || p[-1] == '#' || p[-1] == '$')) &&
+			!(isalnum((unsigned char) p[n]) || p[n] == '@' ||
+			p[n] == '#' || p[n] == '$'))
+			return (1);
+		p++;
+	}
+	return (0);
+}
+
+// Is number in line as a string of digits of its own (JOB00123 counts)?
+
+static int has_number(const char *line, int number)
+{
+	const char *p;
+
+	for (p = line; *p; p++) {
+		if (!isdigit((unsigned char) *p) ||
+			(p > line && isdigit((unsigned char) p[-1])))
+			continue;
+		if (atoi(p) == number)
+			return (1);
+	}
+	return (0);
+}
+
+static int by_value(const void *a, const void *b)
+{
+	long x = *(const long *) a, y = *(const long *) b;
+
+	return (x < y ? -1 : x > y);
+}
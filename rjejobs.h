@@ -0,0 +1,70 @@
+//  rjejobs - following jobs from the deck we send to the output that
+//  comes back.
+//
+//  Each JOB card that goes to the host (an OS //name JOB card, or a
+//  POWER * $$ JOB JNM= card) starts a job in the table, with its name and
+//  class.  The host's messages ($HASP for JES2, 1Rxx/1Qxx for POWER) give
+//  its job number, and the first lines of each print or punch
+//  transmission (separator page, job log) say which job the output
+//  belongs to.  The table keeps the last RJE_MAXJOBS jobs.
+
+#ifndef RJEJOBS_H
+#define RJEJOBS_H
+
+#include <time.h>
+
+#define RJE_MAXJOBS 256		/* jobs remembered, the oldest go first */
+#define JOB_SCAN 60		/* output lines looked at for the job */
+
+#define JOB_SENT 0		/* JOB card sent */
+#define JOB_READ 1		/* the host says it has it */
+#define JOB_ENDED 2		/* ... and that it has run */
+#define JOB_OUTPUT 3		/* output coming in */
+#define JOB_DONE 4		/* output received */
+
+#define JOBMSG_NONE 0		/* not a job message */
+#define JOBMSG_READ 1		/* job read in ($HASP100) */
+#define JOBMSG_ENDED 2		/* job ended ($HASP395, $HASP165) */
+#define JOBMSG_OTHER 3		/* some other message about a job */
+
+struct rje_jobrec {
+	int id;			/* submission it was in */
+	char name[9];		/* job name */
+	char cls;		/* CLASS=, blank if not given */
+	int number;		/* host's job number, 0 = not known yet */
+	int state;		/* JOB_xxx */
+	char file[80];		/* deck it came from */
+	time_t when;		/* submitted, wall clock */
+	long submit;		/* ... and by rje_clock, ms */
+	long start;		/* first output, ms */
+	long end;		/* last output received, ms */
+	long records;		/* print and punch records */
+};
+
+struct rje_jobs {
+	struct rje_jobrec job[RJE_MAXJOBS];
+	int first;		/* the oldest */
+	int n;			/* how many */
+};
+
+// Turnaround (submit to end of output) for the jobs of one class
+
+struct rje_jobstat {
+	int count;		/* jobs with their output back */
+	long mean;		/* ms */
+	long p50;
+	long p90;
+	long max;
+};
+
+int rje_job_card(const unsigned char *card, int len,
+	const unsigned char *xlate, char *name, char *cls);
+int rje_job_msg(const char *line, char *name, int *number);
+struct rje_jobrec *rje_jobs_get(struct rje_jobs *t, int i);
+struct rje_jobrec *rje_jobs_add(struct rje_jobs *t, int id, char *file,
+	char *name, int cls, long now);
+struct rje_jobrec *rje_jobs_named(struct rje_jobs *t, char *name, int number);
+struct rje_jobrec *rje_jobs_match(struct rje_jobs *t, const char *line);
+int rje_jobs_class(struct rje_jobs *t, int cls, struct rje_jobstat *st);
+
+#endif
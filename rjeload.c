@@ -0,0 +1,611 @@
+//  rjeload - push made-up jobs through one or more RJE lines at a given
+//  rate, and say how fast they went.
+//
+//  Each line is a librje80 session of its own, to port, port+1, ... (or
+//  all to the one port with -S), the way Hercules gives each 2703 line
+//  its own port.  Decks are made up as they're needed: a JOB card, then
+//  cards with as much or as little in them as asked for, so they can be
+//  made easy or hard to compress.  Each is written to a scratch
+//  directory and queued with rje_submit exactly as SEND queues a file,
+//  then removed once it has gone.  Whatever the host sends back is
+//  thrown away.
+//
+//  At the end (and every -i seconds if asked) it reports jobs and cards
+//  a second, blocks and bids sent again, WACKs, how long jobs took from
+//  being queued to the host ACKing their last card, and how long the
+//  host took to ACK a block, as percentiles.
+//
+//  With -V there's no host: each line gets a simulated one (see rjesim),
+//  and everything runs in simulated time, so a run of hours, or one with
+//  the line dropping every tenth frame, is over in seconds.  -T changes
+//  the sessions' timeouts and retry limits, to see what they do to it.
+//  With -m too, the simulated hosts are multileaving ones.
+//
+//      cc -o rjeload rjeload.c librje80.c rjeforms.c rjereader.c rjehasp.c rjehist.c rjejobs.c rjesink.c rjeindex.c rjedeck.c rjesim.c -lpthread
+//
+//  It's for Linux and the like only (getopt, mkdtemp).
+//
+//  Usage: rjeload [options] host port
+//         rjeload -V [options]
+//
+//	-l n	lines (1)
+//	-S	every line to the same port
+//	-u id	signon id, %d for the line number (* = no signon, the default)
+//	-p pw	signon password
+//	-o n	host OS, as SET OS numbers it (2 = JES2)
+//	-m	sign on as multileaving workstations (as RMT%d unless -u)
+//	-R n	... with n readers each (1)
+//	-n n	jobs to send (100)
+//	-t sec	or send for this long instead
+//	-r n	jobs a second over all the lines (0 = as fast as they'll go)
+//	-q n	most decks waiting on a line at once (4)
+//	-c n	cards in a deck, the JOB card included (50)
+//	-f pct	how much of each card isn't blank (40)
+//	-d pct	how much of that is runs of one character (0)
+//	-s n	seed for the card contents (1)
+//	-i sec	report every sec seconds as well as at the end
+//	-v	show what the lines have to say
+//	-T name=n  one of struct rje_timing's timings (ms) or retry limits
+//
+//  and with -V, for the simulated hosts:
+//
+//	-D ms	time to answer anything (2)
+//	-B bps	line speed (no limit)
+//	-N pct	blocks NAKed (0)
+//	-W pct	blocks WACKed (0)
+//	-L pct	frames from the station lost (0)
+//	-P n	lines of output sent back for each job (0)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/select.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+
+#include "librje80.h"
+#include "rjesim.h"
+
+#define MAXLINES 64
+#define MAXPEND 128		/* decks a line can have on the go */
+#define RUN_LEN 8		/* characters in a run, with -d */
+#define MAXTIMING 16		/* -T options */
+
+struct line {
+	struct rje_session *s;
+	int n;			/* line number, from 1 */
+	int port;
+	int up;			/* signed on */
+	int signon;		/* signon submission id */
+	int pending;		/* decks queued, not yet done */
+	long long queued[MAXPEND];	/* when each was, by id */
+	char deck[MAXPEND][96];		/* ... and its file, "" once removed */
+	struct rje_sim sim;		/* its host, with -V */
+};
+
+// Prototypes
+
+int usage();
+int make_deck(char *file, int job);
+int make_card(char *card);
+int send_job(struct line *l);
+int line_events(struct line *l);
+int wait_lines(int msec);
+struct line *least_busy();
+int report(long long now, int final);
+int report_sim();
+int set_timing(struct rje_session *s);
+double real_time();
+int load_msg(struct rje_session *s, char *msg);
+int load_rec(struct rje_session *s, int device, unsigned char *rec, int len);
+
+// Options
+
+char host[128];
+int port = 0;
+int nlines = 1;
+int sameport = 0;
+char user[32] = "*";
+char password[32] = "";
+int hostos = 2;
+int multileave = 0;
+int readers = 1;
+int njobs = 100;
+int seconds = 0;
+double rate = 0;
+int depth = 4;
+int ncards = 50;
+int fill = 40;
+int runs = 0;
+int seed = 1;
+int every = 0;
+int verbose = 0;
+char *timing[MAXTIMING];
+int ntiming = 0;
+int simulate = 0;
+double delay = 2;
+long bps = 0;
+int naks = 0;
+int wacks = 0;
+int lose = 0;
+int print = 0;
+
+// How it's going
+
+struct line lines[MAXLINES];
+char scratch[32];		/* where the decks are written */
+int sent = 0;			/* decks queued */
+int done = 0;			/* ... and ACKed all through */
+int failed = 0;			/* ... or not */
+long cards = 0;			/* cards in the ones done */
+long long started;		/* when the first was queued, us */
+struct rje_hist jobtime;	/* queued to done, us */
+double real_start;		/* real time, seconds, with -V */
+
+int main(int argc, char *argv[])
+{
+	struct line *l;
+	long long now, due, last;
+	int i, c, wait, up;
+	char id[32];
+
+	while ((c = getopt(argc, argv,
+		"l:Su:p:o:mR:n:t:r:q:c:f:d:s:i:vT:VD:B:N:W:L:P:")) != -1) {
+		switch (c) {
+		case 'l': nlines = atoi(optarg); break;
+		case 'S': sameport = 1; break;
+		case 'u': strncpy(user, optarg, sizeof(user) - 1); break;
+		case 'p': strncpy(password, optarg, sizeof(password) - 1); break;
+		case 'o': hostos = atoi(optarg); break;
+		case 'm': multileave = 1; break;
+		case 'R': readers = atoi(optarg); break;
+		case 'n': njobs = atoi(optarg); break;
+		case 't': seconds = atoi(optarg); break;
+		case 'r': rate = atof(optarg); break;
+		case 'q': depth = atoi(optarg); break;
+		case 'c': ncards = atoi(optarg); break;
+		case 'f': fill = atoi(optarg); break;
+		case 'd': runs = atoi(optarg); break;
+		case 's': seed = atoi(optarg); break;
+		case 'i': every = atoi(optarg); break;
+		case 'v': verbose = 1; break;
+		case 'T':
+			if (ntiming == MAXTIMING)
+				return (usage());
+			timing[ntiming++] = optarg;
+			break;
+		case 'V': simulate = 1; break;
+		case 'D': delay = atof(optarg); break;
+		case 'B': bps = atol(optarg); break;
+		case 'N': naks = atoi(optarg); break;
+		case 'W': wacks = atoi(optarg); break;
+		case 'L': lose = atoi(optarg); break;
+		case 'P': print = atoi(optarg); break;
+		default: return (usage());
+		}
+	}
+	if (argc - optind != (simulate ? 0 : 2) || nlines < 1 ||
+		nlines > MAXLINES || depth < 1 || depth >= MAXPEND ||
+		depth > RJE_MAXQ || ncards < 1 || fill < 0 || fill > 100 ||
+		runs < 0 || runs > 100 || readers < 1 || readers > RJE_ML_STREAMS)
+		return (usage());
+	if (multileave && strcmp(user, "*") == 0)
+		strcpy(user, "RMT%d");	/* it has to sign on */
+	if (!simulate) {
+		strncpy(host, argv[optind], sizeof(host) - 1);
+		port = atoi(argv[optind + 1]);
+	}
+	if (seconds > 0)
+		njobs = 0;
+	srand(seed);
+	rje_hist_clear(&jobtime);
+	real_start = real_time();
+
+	strcpy(scratch, "/tmp/rjeloadXXXXXX");
+	if (mkdtemp(scratch) == NULL) {
+		perror("RJE400S Can't make a scratch directory");
+		return (2);
+	}
+
+	// Bring the lines up
+
+	rje_init();
+	for (i = 0; i < nlines; i++) {
+		l = &lines[i];
+		l->n = i + 1;
+		l->port = sameport ? port : port + i;
+		l->s = rje_new();
+		l->s->msgfn = load_msg;
+		l->s->recfn = load_rec;
+		l->s->opt_os = hostos;
+		l->s->opt_ml = multileave;
+		l->s->opt_mlrdrs = readers;
+		l->s->opt_ckpt = 0;	/* scratch decks, nothing to resume */
+		l->s->user = l;
+		if (set_timing(l->s) < 0)
+			return (usage());
+		if (simulate) {
+			rje_sim_init(&l->sim);
+			l->sim.delay = (long) (delay * 1000);
+			l->sim.bps = bps;
+			l->sim.nak = naks;
+			l->sim.wack = wacks;
+			l->sim.lose = lose;
+			l->sim.print = print;
+			l->sim.seed = seed + l->n;
+			sprintf(id, "simulated host %d", l->n);
+			rje_sim_attach(&l->sim, l->s, id);
+			continue;
+		}
+		if (rje_open(l->s, host, l->port) < 0) {
+			fprintf(stderr, "RJE401S Line %d: can't connect to %s port %d.\n",
+				l->n, host, l->port);
+			rmdir(scratch);
+			return (2);
+		}
+	}
+	for (i = 0; i < nlines; i++)
+		rje_poll(lines[i].s, 50);
+	for (i = 0; i < nlines; i++) {
+		l = &lines[i];
+		if (strstr(user, "%d") != NULL)
+			snprintf(id, sizeof(id), user, l->n);
+		else
+			strcpy(id, user);
+		l->signon = rje_signon(l->s, id, password);
+		if (l->signon == 0)
+			l->up = 1;
+	}
+	last = rje_uclock();
+	while (last - rje_uclock() > -10000000LL) {
+		for (i = up = 0; i < nlines; i++) {
+			rje_poll(lines[i].s, 0);
+			line_events(&lines[i]);
+			up += (lines[i].up != 0);
+		}
+		if (up == nlines)
+			break;
+		wait_lines(10);
+	}
+	for (i = up = 0; i < nlines; i++) {
+		if (lines[i].up == 1)
+			up++;
+		else
+			fprintf(stderr, "RJE402W Line %d didn't sign on.\n", lines[i].n);
+	}
+	if (up == 0) {
+		rmdir(scratch);
+		return (2);
+	}
+	printf("RJE403I %d of %d lines signed on, sending %d card decks", up,
+		nlines, ncards);
+	if (rate > 0)
+		printf(" at %g a second", rate);
+	printf(".\n");
+
+	// Queue jobs as they come due, keep the lines going, until they're
+	// all sent (or the time's up) and done
+
+	started = due = last = rje_uclock();
+	for (;;) {
+		now = rje_uclock();
+		while ((njobs == 0 || sent < njobs) &&
+			(seconds == 0 || now - started < seconds * 1000000LL) &&
+			(rate == 0 || due <= now) && (l = least_busy()) != NULL) {
+			if (send_job(l) < 0)
+				break;
+			due += (long long) (1000000 / (rate > 0 ? rate : 1));
+		}
+		for (i = up = 0; i < nlines; i++) {
+			rje_poll(lines[i].s, 0);
+			line_events(&lines[i]);
+			up += (lines[i].up == 1);
+		}
+		if (every > 0 && now - last >= every * 1000000LL) {
+			report(now, 0);
+			last = now;
+		}
+		if (done + failed == sent && ((njobs > 0 && sent >= njobs) ||
+			(seconds > 0 && now - started >= seconds * 1000000LL)))
+			break;
+		if (up == 0) {
+			fprintf(stderr, "RJE404S All the lines are down.\n");
+			break;
+		}
+		wait = 10;
+		if (rate > 0 && due > now && (due - now) / 1000 < wait)
+			wait = (int) ((due - now + 999) / 1000);
+		wait_lines(wait);
+	}
+	report(rje_uclock(), 1);
+
+	for (i = 0; i < nlines; i++)
+		rje_free(lines[i].s);
+	rje_term();
+	rmdir(scratch);
+	return (failed > 0);
+}
+
+int usage()
+{
+	fprintf(stderr, "Usage: rjeload [options] host port\n"
+		"  -l n    lines (1)                 -S      all on the same port\n"
+		"  -u id   signon id, %%d = line (*)  -p pw   signon password\n"
+		"  -o n    host OS as SET OS (2)     -m      multileaving\n"
+		"  -R n    multileaving readers (1)\n"
+		"  -n n    jobs to send (100)        -t sec  or send for this long\n"
+		"  -r n    jobs a second (as fast as they go)\n"
+		"  -q n    most decks waiting on a line (4)\n"
+		"  -c n    cards in a deck (50)      -f pct  of a card not blank (40)\n"
+		"  -d pct  of that in runs (0)       -s n    seed (1)\n"
+		"  -i sec  report every sec seconds  -v      show line messages\n"
+		"  -T name=n  a timeout (ms) or retry limit, as in struct rje_timing\n"
+		"Usage: rjeload -V [options], against simulated hosts, and also\n"
+		"  -D ms   host answers in (2)       -B bps  line speed (no limit)\n"
+		"  -N pct  blocks NAKed (0)          -W pct  blocks WACKed (0)\n"
+		"  -L pct  frames lost (0)           -P n    output lines a job (0)\n");
+	return (2);
+}
+
+// Write a deck: a JOB card named for the job, then made up cards
+
+int make_deck(char *file, int job)
+{
+	FILE *fd;
+	char card[81];
+	int i;
+
+	if ((fd = fopen(file, "w")) == NULL)
+		return (-1);
+	fprintf(fd, "//L%07d JOB CLASS=A,MSGCLASS=X\n", job % 10000000);
+	for (i = 1; i < ncards; i++) {
+		make_card(card);
+		fprintf(fd, "%s\n", card);
+	}
+	fclose(fd);
+	return (0);
+}
+
+// One card: fill percent of it letters and digits (runs percent of those
+// in runs of one character), the rest blanks
+
+int make_card(char *card)
+{
+	static const char chars[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
+	int i = 0, n, k, want = 80 * fill / 100;
+	char c;
+
+	memset(card, ' ', 80);
+	while (i < want) {
+		c = chars[rand() % (sizeof(chars) - 1)];
+		n = 1;
+		if (runs > 0 && rand() % 100 < runs)
+			n = RUN_LEN;
+		for (k = 0; k < n && i < want; k++)
+			card[i++] = c;
+	}
+	card[0] = 'X';			/* never a // card */
+	while (i > 0 && card[i - 1] == ' ')
+		i--;
+	card[i] = 0;
+	return (i);
+}
+
+// Queue the next deck on a line
+
+int send_job(struct line *l)
+{
+	char file[96];
+	int id;
+
+	sprintf(file, "%s/job%d.jcl", scratch, sent + 1);
+	if (make_deck(file, sent + 1) < 0) {
+		perror("RJE405S Can't write a deck");
+		return (-1);
+	}
+	if ((id = rje_submit(l->s, file)) < 0) {
+		remove(file);
+		return (-1);
+	}
+	l->queued[id % MAXPEND] = rje_uclock();
+	strcpy(l->deck[id % MAXPEND], file);
+	l->pending++;
+	sent++;
+	return (0);
+}
+
+// See what's happened on a line
+
+int line_events(struct line *l)
+{
+	struct rje_event ev;
+	int slot;
+
+	while (rje_event(l->s, &ev)) {
+		if (ev.type == RJE_EV_STATUS && ev.status <= NOLINK && l->up >= 0) {
+			fprintf(stderr, "RJE406W Line %d has gone down, %d decks lost.\n",
+				l->n, l->pending);
+			failed += l->pending;
+			l->pending = 0;
+			l->up = -1;
+			for (slot = 0; slot < MAXPEND; slot++) {
+				if (strlen(l->deck[slot]) > 0)
+					remove(l->deck[slot]);
+				strcpy(l->deck[slot], "");
+			}
+		}
+		if (ev.type != RJE_EV_DONE)
+			continue;
+		if (ev.id == l->signon && ev.kind == XMIT_SIGNON) {
+			l->up = (ev.rc == 0) ? 1 : -1;
+			continue;
+		}
+		if (ev.kind != XMIT_FILE || l->pending == 0)
+			continue;
+		slot = ev.id % MAXPEND;
+		if (ev.rc == 0) {
+			done++;
+			cards += ncards;
+			rje_hist_add(&jobtime, (long) (rje_uclock() - l->queued[slot]));
+		} else {
+			failed++;
+		}
+		remove(l->deck[slot]);
+		strcpy(l->deck[slot], "");
+		l->pending--;
+	}
+	return (0);
+}
+
+// Wait up to msec for any line to have something for us
+
+int wait_lines(int msec)
+{
+	struct timeval tv;
+	fd_set fds;
+	int i, max = -1;
+
+	if (simulate)
+		return (rje_sim_advance(msec));
+	FD_ZERO(&fds);
+	for (i = 0; i < nlines; i++) {
+		if (lines[i].s->sockfd < 0)
+			continue;
+		FD_SET(lines[i].s->sockfd, &fds);
+		if (lines[i].s->sockfd > max)
+			max = lines[i].s->sockfd;
+	}
+	tv.tv_sec = msec / 1000;
+	tv.tv_usec = (msec % 1000) * 1000;
+	select(max + 1, &fds, NULL, NULL, &tv);
+	return (0);
+}
+
+// The signed on line with the fewest decks waiting, if it has room
+
+struct line *least_busy()
+{
+	struct line *best = NULL;
+	int i;
+
+	for (i = 0; i < nlines; i++) {
+		if (lines[i].up != 1 || lines[i].pending >= depth)
+			continue;
+		if (best == NULL || lines[i].pending < best->pending)
+			best = &lines[i];
+	}
+	return (best);
+}
+
+// How it's going, or how it went
+
+int report(long long now, int final)
+{
+	struct rje_hist acks;
+	double secs = (now - started) / 1000000.0;
+	long retries = 0, wacks = 0;
+	int i;
+
+	rje_hist_clear(&acks);
+	for (i = 0; i < nlines; i++) {
+		rje_hist_merge(&acks, &lines[i].s->lat[RJE_LAT_BLOCK]);
+		retries += lines[i].s->stat_retries;
+		wacks += lines[i].s->stat_wacks;
+	}
+	if (secs <= 0)
+		secs = 0.001;
+	printf("RJE407I %s %.1fs: %d sent, %d done, %d failed, %.2f jobs/s, %.0f cards/s, %ld retries, %ld WACKs\n",
+		final ? "Total" : "After", secs, sent, done, failed, done / secs,
+		cards / secs, retries, wacks);
+	if (!final)
+		return (0);
+	printf("RJE408I Job time (ms)  p50 %.1f  p90 %.1f  p99 %.1f  max %.1f\n",
+		rje_hist_pct(&jobtime, 50.0) / 1000.0,
+		rje_hist_pct(&jobtime, 90.0) / 1000.0,
+		rje_hist_pct(&jobtime, 99.0) / 1000.0, jobtime.max / 1000.0);
+	printf("RJE409I Block ACK (ms) p50 %.2f  p90 %.2f  p99 %.2f  max %.2f\n",
+		rje_hist_pct(&acks, 50.0) / 1000.0, rje_hist_pct(&acks, 90.0) / 1000.0,
+		rje_hist_pct(&acks, 99.0) / 1000.0, acks.max / 1000.0);
+	if (simulate)
+		report_sim();
+	return (0);
+}
+
+// What the simulated hosts saw, and how long it really took
+
+int report_sim()
+{
+	struct rje_sim t;
+	int i;
+
+	memset(&t, 0, sizeof(t));
+	for (i = 0; i < nlines; i++) {
+		t.frames += lines[i].sim.frames;
+		t.bids += lines[i].sim.bids;
+		t.naks += lines[i].sim.naks;
+		t.wacks += lines[i].sim.wacks;
+		t.lost += lines[i].sim.lost;
+		t.polls += lines[i].sim.polls;
+		t.jobs += lines[i].sim.jobs;
+		t.lines += lines[i].sim.lines;
+	}
+	printf("RJE410I Hosts: %ld frames, %ld bids, %ld NAKs, %ld WACKs, %ld lost, %ld polls, %ld jobs, %ld lines back\n",
+		t.frames, t.bids, t.naks, t.wacks, t.lost, t.polls, t.jobs,
+		t.lines);
+	printf("RJE411I That took %.2fs of real time.\n",
+		real_time() - real_start);
+	return (0);
+}
+
+// Apply the -T options to a session
+
+int set_timing(struct rje_session *s)
+{
+	char name[32], *p;
+	int i;
+
+	for (i = 0; i < ntiming; i++) {
+		if ((p = strchr(timing[i], '=')) == NULL ||
+			p - timing[i] >= sizeof(name)) {
+			fprintf(stderr, "RJE412A Use -T name=value, not %s\n", timing[i]);
+			return (-1);
+		}
+		memcpy(name, timing[i], p - timing[i]);
+		name[p - timing[i]] = 0;
+		if (rje_set_timing(s, name, atol(p + 1)) < 0) {
+			fprintf(stderr, "RJE413A No timing %s, or not %s.\n", name,
+				p + 1);
+			return (-1);
+		}
+	}
+	return (0);
+}
+
+// Seconds, really
+
+double real_time()
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return (tv.tv_sec + tv.tv_usec / 1000000.0);
+}
+
+// The lines' messages, shown only with -v
+
+int load_msg(struct rje_session *s, char *msg)
+{
+	if (verbose) {
+		printf("[%d] %s", ((struct line *) s->user)->n, msg);
+		fflush(stdout);
+	}
+	return (0);
+}
+
+// Host output isn't kept
+
+int load_rec(struct rje_session *s, int device, unsigned char *rec, int len)
+{
+	return (1);
+}
@@ -0,0 +1,475 @@
+//  rjereader - the card reader: decks to be sent to the host.
+//
+//  Formats understood:
+//
+//	ASCII	text lines, translated and padded with blanks to recl
+//	FB	EBCDIC cards recl bytes long (a short last card is padded)
+//	VB	EBCDIC cards each behind a 4 byte RDW: length including the
+//		RDW, big endian, then two zero bytes.  Cards are padded or
+//		cut to recl.
+//	AWS	an AWS tape image (as Hercules writes them) of card blocks.
+//		Each block has a 6 byte header: its length and the previous
+//		block's, little endian, then two flag bytes.  A block holds
+//		one or more cards of recl bytes; a tape mark ends the deck.
+//
+//  pos and next are file offsets for the checkpoint code, which can put
+//  the reader back on any card with rje_reader_seek.  For a stream they
+//  count the bytes read from it, and it can't be put back.
+//
+//  A stream is read with read() on its descriptor, after a poll() to see
+//  that read() won't wait; its descriptor's flags (stdin's, say) are left
+//  as they are.  Cards are taken from blk, which is topped up only when
+//  the next card isn't all in it.
+//
+//  A reader on a deck image has no file open at all: its cards are
+//  copied from the image, and seeking is a binary search of its offsets.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#if defined (_WIN32)
+#include <io.h>
+#else
+#include <unistd.h>
+#include <poll.h>
+#endif
+
+#include "rjereader.h"
+
+#define AWS_TAPEMARK 0x40	/* flags1: this header is a tape mark */
+
+static int aws_block(struct rje_reader *r, long at);
+static int stream_get(struct rje_reader *r, unsigned char *card);
+static int stream_fill(struct rje_reader *r);
+static int cards_seek(struct rje_reader *r, long pos);
+
+// Format name (as typed on SEND) to RDR_xxx, or -1
+
+int rje_reader_fmt(char *name)
+{
+	if (strcmp(name, "ASCII") == 0)
+		return (RDR_ASCII);
+	if (strcmp(name, "EBCDIC") == 0 || strcmp(name, "FB") == 0)
+		return (RDR_FB);
+	if (strcmp(name, "VB") == 0 || strcmp(name, "RDW") == 0)
+		return (RDR_VB);
+	if (strcmp(name, "AWS") == 0)
+		return (RDR_AWS);
+	return (-1);
+}
+
+// Is this deck a stream: stdin, or anything that isn't a plain file?
+
+int rje_reader_stream(char *file)
+{
+	struct stat st;
+
+	if (strcmp(file, "-") == 0)
+		return (1);
+	if (stat(file, &st) != 0)
+		return (0);
+	return (!S_ISREG(st.st_mode) && !S_ISDIR(st.st_mode));
+}
+
+// Open a deck.  Returns 0, or -1 if it can't be read.
+
+int rje_reader_open(struct rje_reader *r, char *file, int fmt, int recl,
+	const unsigned char *xlate)
+{
+	memset(r, 0, sizeof(struct rje_reader));
+	r->fmt = fmt;
+	r->recl = recl;
+	r->xlate = xlate;
+	r->sfd = -1;
+	if (rje_reader_stream(file)) {
+		if (fmt == RDR_AWS)
+			return (-1);	/* blocks are found by seeking */
+		r->stream = 1;
+		r->blk = (unsigned char *) malloc(RDR_STREAMBUF);
+		if (r->blk == NULL)
+			return (-1);
+		if (strcmp(file, "-") == 0) {
+			r->sfd = 0;
+#if defined (_WIN32)
+			if (fmt != RDR_ASCII)
+				_setmode(0, _O_BINARY);
+#endif
+		} else {
+#if defined (_WIN32)
+			r->sfd = open(file, O_RDONLY | (fmt == RDR_ASCII ?
+				0 : O_BINARY));
+#else
+			// O_NONBLOCK, or opening a FIFO waits for a writer
+
+			r->sfd = open(file, O_RDONLY | O_NONBLOCK);
+#endif
+		}
+		if (r->sfd < 0) {
+			rje_reader_close(r);
+			return (-1);
+		}
+		return (0);
+	}
+	r->fd = fopen(file, fmt == RDR_ASCII ? "r" : "rb");
+	if (r->fd == NULL)
+		return (-1);
+	if (fmt == RDR_AWS) {
+		r->blk = (unsigned char *) malloc(65536);
+		if (r->blk == NULL) {
+			rje_reader_close(r);
+			return (-1);
+		}
+		r->blkpos = -1;
+	}
+	return (0);
+}
+
+// Put a reader on a deck image, from its first card.  The reader holds
+// on to it until it's closed.
+
+int rje_reader_cards(struct rje_reader *r, struct rje_deckimg *img)
+{
+	memset(r, 0, sizeof(struct rje_reader));
+	r->fmt = img->fmt;
+	r->recl = img->recl;
+	r->sfd = -1;
+	r->img = img;
+	img->refs++;
+	return (0);
+}
+
+// Read the next card, recl bytes of EBCDIC.  Returns recl, 0 at the end
+// of the deck, or -1 if the file isn't in the format it's supposed to be.
+
+int rje_reader_get(struct rje_reader *r, unsigned char *card)
+{
+	unsigned char rdw[4];
+	char line[RDR_MAXRECL + 2];
+	int n, len;
+
+	if (r->img != NULL) {
+		if (r->card >= r->img->ncards)
+			return (0);
+		memcpy(card, r->img->cards + (long) r->card * r->recl, r->recl);
+		r->pos = r->img->pos[r->card];
+		r->next = r->img->next[r->card++];
+		return (r->recl);
+	}
+	if (r->stream)
+		return (stream_get(r, card));
+	switch (r->fmt) {
+	case RDR_ASCII:
+		r->pos = ftell(r->fd);
+		if (fgets(line, sizeof(line), r->fd) == NULL)
+			return (0);
+		n = strlen(line);
+		if (n > 0 && line[n - 1] != '\n' && !feof(r->fd)) {
+			while ((len = fgetc(r->fd)) != EOF && len != '\n')
+				;	/* rest of a long line is lost */
+		}
+		r->next = ftell(r->fd);
+		return (rje_card_text(card, line, r->recl, r->xlate));
+
+	case RDR_FB:
+		r->pos = ftell(r->fd);
+		n = fread(card, 1, r->recl, r->fd);
+		if (n <= 0)
+			return (0);
+		memset(card + n, 0x40, r->recl - n);
+		r->next = r->pos + n;
+		return (r->recl);
+
+	case RDR_VB:
+		r->pos = ftell(r->fd);
+		n = fread(rdw, 1, 4, r->fd);
+		if (n == 0)
+			return (0);
+		len = (rdw[0] << 8 | rdw[1]) - 4;
+		if (n < 4 || len < 0)
+			return (-1);
+		n = (len > r->recl) ? r->recl : len;
+		if (fread(card, 1, n, r->fd) != n)
+			return (-1);
+		if (len > n)
+			fseek(r->fd, len - n, SEEK_CUR);
+		memset(card + n, 0x40, r->recl - n);
+		r->next = r->pos + 4 + len;
+		return (r->recl);
+
+	case RDR_AWS:
+		if (r->blkpos < 0 || r->blkoff >= r->blklen) {
+			n = aws_block(r, r->blkpos < 0 ? 0 : r->blkpos + r->blklen);
+			if (n <= 0)
+				return (n);
+		}
+		r->pos = r->blkpos + r->blkoff;
+		n = r->blklen - r->blkoff;
+		if (n > r->recl)
+			n = r->recl;
+		memcpy(card, r->blk + r->blkoff, n);
+		memset(card + n, 0x40, r->recl - n);
+		r->blkoff += n;
+		r->next = r->blkpos + r->blkoff;
+		if (r->blkoff >= r->blklen)
+			r->next = r->blkpos + r->blklen;
+		return (r->recl);
+	}
+	return (-1);
+}
+
+// Read the AWS block whose header is at file offset at.  Returns 1, 0 at
+// a tape mark or the end of the file, -1 for a bad header.
+
+static int aws_block(struct rje_reader *r, long at)
+{
+	unsigned char hdr[6];
+
+	for (;;) {
+		if (fseek(r->fd, at, SEEK_SET) != 0 ||
+			fread(hdr, 1, 6, r->fd) != 6)
+			return (0);
+		if (hdr[4] & AWS_TAPEMARK)
+			return (0);
+		r->blklen = hdr[0] | hdr[1] << 8;
+		r->blkpos = at + 6;
+		r->blkoff = 0;
+		if (r->blklen == 0) {
+			at += 6;	/* empty block, skip it */
+			continue;
+		}
+		if (fread(r->blk, 1, r->blklen, r->fd) != r->blklen)
+			return (-1);
+		return (1);
+	}
+}
+
+// The next card from a stream: recl, 0 at the end, -1 for a VB stream
+// cut off inside a card, or RDR_WAIT if it hasn't all come yet.
+
+static int stream_get(struct rje_reader *r, unsigned char *card)
+{
+	char line[RDR_MAXRECL + 2];
+	unsigned char *p, *nl;
+	int n, len, have, rc;
+
+	for (;;) {
+		p = r->blk + r->blkoff;
+		have = r->blklen - r->blkoff;
+		switch (r->fmt) {
+		case RDR_ASCII:
+			nl = (unsigned char *) memchr(p, '\n', have);
+			if (r->skip && nl != NULL) {
+				r->blkoff += nl - p + 1;
+				r->skip = 0;	/* rest of a long line is lost */
+				continue;
+			}
+			if (r->skip) {
+				r->blkoff += have;
+				if (r->seof)
+					return (0);
+				break;
+			}
+			if (nl == NULL && !r->seof && have < RDR_STREAMBUF)
+				break;		/* not all here */
+			if (have == 0)
+				return (0);
+			len = (nl == NULL) ? have : nl - p + 1;
+			r->skip = (nl == NULL && !r->seof);
+			r->pos = r->blkpos + r->blkoff;
+			r->blkoff += len;
+			r->next = r->blkpos + r->blkoff;
+			n = (len > r->recl) ? r->recl : len;
+			memcpy(line, p, n);
+			line[n] = 0;
+			return (rje_card_text(card, line, r->recl, r->xlate));
+
+		case RDR_FB:
+			if (have < r->recl && !r->seof)
+				break;
+			if (have == 0)
+				return (0);
+			n = (have > r->recl) ? r->recl : have;
+			memcpy(card, p, n);
+			memset(card + n, 0x40, r->recl - n);
+			r->pos = r->blkpos + r->blkoff;
+			r->blkoff += n;
+			r->next = r->pos + n;
+			return (r->recl);
+
+		case RDR_VB:
+			if (have == 0 && r->seof)
+				return (0);
+			if (have < 4 || have < (p[0] << 8 | p[1])) {
+				if (r->seof)
+					return (-1);
+				break;
+			}
+			len = (p[0] << 8 | p[1]) - 4;
+			if (len < 0)
+				return (-1);
+			n = (len > r->recl) ? r->recl : len;
+			memcpy(card, p + 4, n);
+			memset(card + n, 0x40, r->recl - n);
+			r->pos = r->blkpos + r->blkoff;
+			r->blkoff += 4 + len;
+			r->next = r->blkpos + r->blkoff;
+			return (r->recl);
+
+		default:
+			return (-1);
+		}
+		if ((rc = stream_fill(r)) <= 0)
+			return (rc);
+	}
+}
+
+// Move what's left in the buffer to the front and read more behind it,
+// if there's any there.  Returns 1, RDR_WAIT if there's nothing to read
+// yet, or -1 if the stream has failed.
+
+static int stream_fill(struct rje_reader *r)
+{
+	int n;
+#if !defined (_WIN32)
+	struct pollfd pfd;
+#endif
+
+	if (r->seof || r->blklen - r->blkoff == RDR_STREAMBUF)
+		return (1);
+	if (r->blkoff > 0) {
+		memmove(r->blk, r->blk + r->blkoff, r->blklen - r->blkoff);
+		r->blklen -= r->blkoff;
+		r->blkpos += r->blkoff;
+		r->blkoff = 0;
+	}
+#if !defined (_WIN32)
+	pfd.fd = r->sfd;
+	pfd.events = POLLIN;
+	if (poll(&pfd, 1, 0) == 0)
+		return (RDR_WAIT);
+#endif
+	n = read(r->sfd, r->blk + r->blklen, RDR_STREAMBUF - r->blklen);
+	if (n < 0 && (errno == EINTR || errno == EAGAIN))
+		return (RDR_WAIT);
+	if (n < 0)
+		return (-1);
+	if (n == 0)
+		r->seof = 1;
+	r->blklen += n;
+	return (1);
+}
+
+// Put the reader on the card at file offset pos (a pos or next value
+// from earlier).  AWS blocks are walked from the start to find it; the
+// next after a block's last card is the header of the block after it.
+
+int rje_reader_seek(struct rje_reader *r, long pos)
+{
+	long at = 0;
+	int rc;
+
+	if (r->img != NULL)
+		return (cards_seek(r, pos));
+	if (r->stream)
+		return (-1);
+	if (r->fmt != RDR_AWS) {
+		r->next = pos;
+		return (fseek(r->fd, pos, SEEK_SET));
+	}
+	while ((rc = aws_block(r, at)) > 0) {
+		if (pos >= at && pos <= r->blkpos) {
+			r->next = pos;	/* its header: its first card */
+			return (0);
+		}
+		if (pos < r->blkpos + r->blklen) {
+			if (pos < r->blkpos)
+				return (-1);
+			r->blkoff = pos - r->blkpos;
+			r->next = pos;
+			return (0);
+		}
+		at = r->blkpos + r->blklen;
+	}
+	if (rc == 0 && pos == at) {	/* after the last card */
+		r->blkoff = r->blklen;
+		r->next = pos;
+		return (0);
+	}
+	return (-1);
+}
+
+// A deck image's card whose pos is pos, or that follows the one whose
+// next is (the end, if that's the last).  Cards are in file order.
+
+static int cards_seek(struct rje_reader *r, long pos)
+{
+	struct rje_deckimg *img = r->img;
+	int lo = 0, hi = img->ncards;
+	int mid;
+
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		if (img->pos[mid] < pos)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	if ((lo < img->ncards && img->pos[lo] == pos) ||
+		(lo > 0 && img->next[lo - 1] == pos) ||
+		(lo == 0 && pos == 0)) {
+		r->card = lo;
+		r->next = pos;
+		return (0);
+	}
+	return (-1);
+}
+
+int rje_reader_close(struct rje_reader *r)
+{
+	if (r->img != NULL)
+		rje_deckimg_drop(r->img);
+	r->img = NULL;
+	if (r->fd != NULL)
+		fclose(r->fd);
+	if (r->sfd > 0)
+		close(r->sfd);		/* but not stdin */
+	if (r->blk != NULL)
+		free(r->blk);
+	r->fd = NULL;
+	r->sfd = -1;
+	r->blk = NULL;
+	return (0);
+}
+
+// Let go of a deck image, and free it if nothing else has hold of it
+
+int rje_deckimg_drop(struct rje_deckimg *img)
+{
+	if (--img->refs > 0)
+		return (0);
+	free(img->raw);
+	free(img->cards);
+	free(img->pos);
+	free(img->next);
+	free(img);
+	return (0);
+}
+
+// Make a card from a line of text: line ends dropped, translated with
+// xlate, padded with blanks to recl.  Returns recl.
+
+int rje_card_text(unsigned char *card, char *text, int recl,
+	const unsigned char *xlate)
+{
+	int i;
+
+	for (i = 0; i < recl && text[i] != 0 &&
+		text[i] != '\n' && text[i] != '\r'; i++)
+		card[i] = xlate[(unsigned char) text[i]];
+	memset(card + i, 0x40, recl - i);
+	return (recl);
+}
@@ -0,0 +1,83 @@
+//  rjereader - the card reader: decks to be sent to the host.
+//
+//  A deck is a file of card images in one of several formats.  Text files
+//  are translated to EBCDIC a line at a time; the others are EBCDIC
+//  already and go out exactly as they are, each card read straight into
+//  the block being built for the line.
+//
+//  A deck can also be a stream: - for stdin, or a FIFO, pipe or device.
+//  It's read as it comes, a buffer full at a time, and never waited on:
+//  when the next card isn't all there yet, rje_reader_get says RDR_WAIT
+//  and the line holds (TTD) until it is.  Streams can't be AWS, and
+//  can't be put back on a card, so sends of them aren't checkpointed.
+//
+//  Or a deck can come from one already made into cards (struct
+//  rje_deckimg, see rjedeck.h): rje_reader_cards puts a reader on it, and
+//  the cards are copied out as they are, with the file offsets they were
+//  read from, so checkpoints work the same.
+
+#ifndef RJEREADER_H
+#define RJEREADER_H
+
+#include <stdio.h>
+
+#define RDR_ASCII 0		/* text, one card per line */
+#define RDR_FB 1		/* EBCDIC, fixed length cards */
+#define RDR_VB 2		/* EBCDIC, RDW in front of each card */
+#define RDR_AWS 3		/* AWS tape image, blocks of cards */
+
+#define RDR_MAXRECL 512
+#define RDR_WAIT -2		/* rje_reader_get: stream, card not in yet */
+#define RDR_STREAMBUF 65536	/* read from a stream at once */
+#define RDR_FD "/dev/fd/"	/* a deck already open: /dev/fd/n */
+
+// A deck made into cards: the file as it was read, then its cards and
+// where in the file each came from (pos and next, as rje_reader_get set
+// them).  The last reader to let go of one that's been dropped frees it.
+
+struct rje_deckimg {
+	unsigned long long hash;	/* of raw, fmt, recl and the table */
+	int fmt;
+	int recl;
+	long size;		/* raw's length */
+	unsigned char *raw;	/* the file */
+	int ncards;
+	unsigned char *cards;	/* ncards * recl bytes of EBCDIC */
+	long *pos;		/* ncards of each */
+	long *next;
+	int refs;		/* readers on it, and 1 for the cache */
+	long used;		/* when it was last wanted, by the cache's count */
+};
+
+struct rje_reader {
+	FILE *fd;
+	int fmt;		/* RDR_xxx */
+	int recl;		/* card length sent to the host */
+	const unsigned char *xlate;	/* ASCII to EBCDIC, for RDR_ASCII */
+	long pos;		/* file offset of the last card read */
+	long next;		/* ... and of the card after it */
+	unsigned char *blk;	/* AWS: the block being taken apart */
+	int blklen;		/* ... its length */
+	int blkoff;		/* ... how far into it we are */
+	long blkpos;		/* ... and where its data starts in the file */
+	int stream;		/* a stream, its fd; blk is what's been read */
+	int sfd;
+	int seof;		/* stream: no more to come */
+	int skip;		/* stream: the rest of a long line goes */
+	struct rje_deckimg *img;	/* cards from here, not the file */
+	int card;		/* ... the next one */
+};
+
+int rje_reader_fmt(char *name);
+int rje_reader_stream(char *file);
+int rje_reader_open(struct rje_reader *r, char *file, int fmt, int recl,
+	const unsigned char *xlate);
+int rje_reader_cards(struct rje_reader *r, struct rje_deckimg *img);
+int rje_reader_get(struct rje_reader *r, unsigned char *card);
+int rje_reader_seek(struct rje_reader *r, long pos);
+int rje_reader_close(struct rje_reader *r);
+int rje_deckimg_drop(struct rje_deckimg *img);
+int rje_card_text(unsigned char *card, char *text, int recl,
+	const unsigned char *xlate);
+
+#endif
@@ -0,0 +1,179 @@
+//  rjeroute - which host a deck goes to, by its file name, its JOB card
+//  or a tag (see rjeroute.h).
+//
+//  The deck is only read when a route needs what's in it, and then just
+//  its first RJE_ROUTE_SCAN cards, once for all the routes.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "librje80.h"
+#include "rjeroute.h"
+
+static int match(const char *pat, const char *s, int fold);
+static int card_tag(const char *text, char *tag);
+
+static char *kinds[] = {"PATH", "JOB", "CLASS", "TAG"};
+
+// A route kind as typed (upper case) to ROUTE_xxx, or -1
+
+int rje_route_kind(char *name)
+{
+	int i;
+
+	for (i = 0; i < 4; i++) {
+		if (strcmp(name, kinds[i]) == 0)
+			return (i);
+	}
+	return (-1);
+}
+
+char *rje_route_name(int kind)
+{
+	return (kinds[kind]);
+}
+
+// Add a route after the others.  Returns its number, from 1, or -1 if
+// there are too many.
+
+int rje_route_add(struct rje_routes *t, char *host, int kind, char *pattern)
+{
+	struct rje_route *r;
+	int i;
+
+	if (t->n >= RJE_ROUTES)
+		return (-1);
+	r = &t->route[t->n];
+	memset(r, 0, sizeof(struct rje_route));
+	r->kind = kind;
+	strncpy(r->pattern, pattern, sizeof(r->pattern) - 1);
+	for (i = 0; host[i] != 0 && i < sizeof(r->host) - 1; i++)
+		r->host[i] = toupper((unsigned char) host[i]);
+	if (kind != ROUTE_PATH) {
+		for (i = 0; r->pattern[i] != 0; i++)
+			r->pattern[i] = toupper((unsigned char) r->pattern[i]);
+	}
+	return (++t->n);
+}
+
+// Take route n (from 1) out; those after it move up.  -1 if there's no
+// such route.
+
+int rje_route_drop(struct rje_routes *t, int n)
+{
+	if (n < 1 || n > t->n)
+		return (-1);
+	memmove(&t->route[n - 1], &t->route[n],
+		(t->n - n) * sizeof(struct rje_route));
+	t->n--;
+	return (0);
+}
+
+// The first route the deck matches, from 0, or -1 if none does.  tag is
+// the one given with SEND, empty if none; it beats one in the deck.
+
+int rje_route_find(struct rje_routes *t, char *file, int fmt, int recl,
+	char *tag)
+{
+	char text[RJE_ROUTE_SCAN][81];
+	char name[9], cls[2], jname[9], jcls, dtag[64];
+	int i, n, peeked = 0;
+
+	strcpy(name, "");
+	strcpy(cls, "");
+	strncpy(dtag, tag, sizeof(dtag) - 1);
+	dtag[sizeof(dtag) - 1] = 0;
+	for (i = 0; i < t->n; i++) {
+		if (t->route[i].kind != ROUTE_PATH && !peeked) {
+			peeked = 1;
+			n = rje_deck_peek(file, fmt, recl, text, RJE_ROUTE_SCAN);
+			for (n--; n >= 0; n--) {	/* the first of each wins */
+				if (rje_job_card((unsigned char *) text[n],
+					strlen(text[n]), NULL, jname, &jcls)) {
+					strcpy(name, jname);
+					cls[0] = jcls;
+					cls[1] = 0;
+				}
+				if (strlen(tag) == 0)
+					card_tag(text[n], dtag);
+			}
+			for (n = 0; dtag[n] != 0; n++)
+				dtag[n] = toupper((unsigned char) dtag[n]);
+		}
+		switch (t->route[i].kind) {
+		case ROUTE_PATH:
+			if (match(t->route[i].pattern, file, 0))
+				return (i);
+			break;
+		case ROUTE_JOB:
+			if (strlen(name) > 0 && match(t->route[i].pattern, name, 1))
+				return (i);
+			break;
+		case ROUTE_CLASS:
+			if (cls[0] != 0 && cls[0] != ' ' &&
+				match(t->route[i].pattern, cls, 1))
+				return (i);
+			break;
+		case ROUTE_TAG:
+			if (strlen(dtag) > 0 && match(t->route[i].pattern, dtag, 1))
+				return (i);
+			break;
+		}
+	}
+	return (-1);
+}
+
+// Does s match pat, with its * and ?
+
+static int match(const char *pat, const char *s, int fold)
+{
+	for (; *pat != 0; pat++, s++) {
+		if (*pat == '*') {
+			for (; *s != 0; s++) {
+				if (match(pat + 1, s, fold))
+					return (1);
+			}
+			return (match(pat + 1, s, fold));
+		}
+		if (*s == 0)
+			return (0);
+		if (*pat == '?')
+			continue;
+		if (fold ? toupper((unsigned char) *pat) != toupper((unsigned char) *s) :
+			*pat != *s)
+			return (0);
+	}
+	return (*s == 0);
+}
+
+// Is this card a tag, //*RJE80 TAG word (* RJE80 TAG word for POWER)?
+// Then the word, and 1.
+
+static int card_tag(const char *text, char *tag)
+{
+	const char *p;
+	int i;
+
+	if (strncmp(text, "//*", 3) == 0)
+		p = text + 3;
+	else if (text[0] == '*' && text[1] == ' ')
+		p = text + 1;
+	else
+		return (0);
+	while (*p == ' ')
+		p++;
+	if (strncmp(p, "RJE80 ", 6) != 0)
+		return (0);
+	for (p += 6; *p == ' '; p++)
+		;
+	if (strncmp(p, "TAG", 3) != 0 || (p[3] != ' ' && p[3] != '='))
+		return (0);
+	for (p += 4; *p == ' ' || *p == '='; p++)
+		;
+	for (i = 0; p[i] != 0 && p[i] != ' ' && i < 63; i++)
+		tag[i] = p[i];
+	tag[i] = 0;
+	return (i > 0);
+}
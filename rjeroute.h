@@ -0,0 +1,49 @@
+//  rjeroute - which host a deck goes to, when rje80 has lines to more
+//  than one.
+//
+//  Routes are looked at in the order they were given, and the first one
+//  that matches the deck says where it goes:
+//
+//	PATH pattern	the deck's file name, as given to SEND
+//	JOB pattern	the name on its first JOB card
+//	CLASS c		... that card's CLASS=
+//	TAG word	its tag: given with SEND ... TAG word, or on a
+//			comment card in the deck, //*RJE80 TAG word
+//			(or * RJE80 TAG word for POWER)
+//
+//  Patterns can have * and ?, and case doesn't matter but in file names.
+//  The JOB card and tag have to be in the first RJE_ROUTE_SCAN cards; a
+//  deck read from a pipe can't be looked at first, so only PATH and a TAG
+//  given with SEND can route it.  Hosts are named in routes, not
+//  numbered, so routes can be given before the hosts they name.
+
+#ifndef RJEROUTE_H
+#define RJEROUTE_H
+
+#define RJE_ROUTES 32		/* routes kept */
+#define RJE_ROUTE_SCAN 20	/* cards looked at for a JOB card or tag */
+
+#define ROUTE_PATH 0
+#define ROUTE_JOB 1
+#define ROUTE_CLASS 2
+#define ROUTE_TAG 3
+
+struct rje_route {
+	int kind;		/* ROUTE_xxx */
+	char pattern[80];
+	char host[9];		/* where the decks it matches go */
+};
+
+struct rje_routes {
+	struct rje_route route[RJE_ROUTES];
+	int n;
+};
+
+int rje_route_kind(char *name);
+char *rje_route_name(int kind);
+int rje_route_add(struct rje_routes *t, char *host, int kind, char *pattern);
+int rje_route_drop(struct rje_routes *t, int n);
+int rje_route_find(struct rje_routes *t, char *file, int fmt, int recl,
+	char *tag);
+
+#endif
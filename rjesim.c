@@ -0,0 +1,722 @@
+//  rjesim - a simulated host, in simulated time.
+//
+//  The station's frames arrive through its writefn, all of a frame at
+//  once, since write_buffer sends one frame a write.  Whatever we answer
+//  is put on the line to the station, due there once the host has taken
+//  its delay and the line has carried the bytes, and its waitfn says
+//  there's something to read once the clock gets to that.
+//
+//  On our own we bid when there's output to go and the line has been
+//  idle a little while, ENQ when an answer is late or a WACK has been
+//  waited out, and give up on the station when it goes quiet on us.
+//  Each job's output goes as a transmission of its own: the $HASP395
+//  line JES2 would send, then print lines with the job name in them.
+//
+//  A multileaving station's signon block puts the line in SIM_ML.  From
+//  then on every frame from the station is answered with a block of ours
+//  or DLE ACK0, as HASP does, and a job's output goes on printer 1 once
+//  the deck it came in is all in and the station has granted the printer.
+
+#include <stdio.h>
+#include <string.h>
+
+#include "rjesim.h"
+
+#define SIM_DELAY 2000		/* default us to answer */
+#define SIM_WAIT 3000		/* ms for the station to answer us */
+#define SIM_TRIES 7		/* ENQs before we give up */
+#define SIM_GAP 20		/* ms the line is idle before we bid */
+#define SIM_WACK_WAIT 250	/* ms after the station WACKs */
+#define SIM_LINES 8		/* print lines in a block */
+#define SIM_QUIET 120000	/* ms a multileaving station can say nothing */
+
+static const unsigned char STX = 0x02;
+static const unsigned char ETX = 0x03;
+static const unsigned char DLE = 0x10;
+static const unsigned char IRS = 0x1e;
+static const unsigned char ETB = 0x26;
+static const unsigned char ESC = 0x27;
+static const unsigned char ENQ = 0x2d;
+static const unsigned char SYN = 0x32;
+static const unsigned char EOT = 0x37;
+static const unsigned char NAK = 0x3d;
+static const unsigned char ACK1 = 0x61;
+static const unsigned char WACK = 0x6b;
+static const unsigned char ACK0 = 0x70;
+static const unsigned char RVI = 0x7c;
+static const unsigned char SPAD = 0xaa;
+static const unsigned char EPAD = 0xff;
+
+static int sim_wait(struct rje_session *s, long msec);
+static int sim_read(struct rje_session *s, unsigned char *buf, int len);
+static int sim_write(struct rje_session *s, unsigned char *buf, int len);
+static int sim_frame(struct rje_sim *h, unsigned char *f, int n);
+static int sim_enq(struct rje_sim *h);
+static int sim_block(struct rje_sim *h, unsigned char *f, int n);
+static int sim_job(struct rje_sim *h, unsigned char *card, int len,
+	int stream);
+static int sim_answer(struct rje_sim *h, unsigned char c);
+static int sim_tick(struct rje_sim *h);
+static int sim_idle(struct rje_sim *h);
+static int sim_output(struct rje_sim *h);
+static int sim_ctl(struct rje_sim *h, unsigned char c1, unsigned char c2);
+static int sim_ml_signon(struct rje_sim *h);
+static int sim_ml_frame(struct rje_sim *h, unsigned char *f, int n);
+static int sim_ml_block(struct rje_sim *h, unsigned char *f, int n);
+static int sim_ml_card(struct rje_sim *h, int n, unsigned char *card,
+	int len);
+static int sim_ml_send(struct rje_sim *h, int poll);
+static int sim_ml_print(struct rje_sim *h, unsigned char *b, int len);
+static int sim_ml_ctl(struct rje_sim *h, int rcb, int srcb);
+static int sim_send(struct rje_sim *h, const unsigned char *buf, int len,
+	long long when);
+static int sim_roll(struct rje_sim *h, int pct);
+static long long sim_bytes(struct rje_sim *h, int len);
+
+static long long now = 1000000;	/* us; 0 means "not yet" to the library */
+static struct rje_sim *sims[SIM_MAX];
+static int nsims = 0;
+
+// A host with the defaults: answers in 2ms, never fails, sends no output
+
+void rje_sim_init(struct rje_sim *h)
+{
+	memset(h, 0, sizeof(*h));
+	h->delay = SIM_DELAY;
+	h->seed = 1;
+}
+
+// Bring a session up on a line to the host, as rje_open would to a real
+// one.  From here on the library runs on the simulated clock.
+
+int rje_sim_attach(struct rje_sim *h, struct rje_session *s, char *name)
+{
+	if (nsims == SIM_MAX)
+		return (-1);
+	h->s = s;
+	h->state = SIM_IDLE;
+	h->outlen = h->lastlen = 0;
+	h->timer = 0;
+	sims[nsims++] = h;
+	s->waitfn = sim_wait;
+	s->readfn = sim_read;
+	s->writefn = sim_write;
+	s->lineio = h;
+	rje_set_clock(rje_sim_clock);
+	return (rje_attach(s, name));
+}
+
+// Take the host away, closing the session.  The last one gone, the
+// library goes back to real time.
+
+int rje_sim_detach(struct rje_sim *h)
+{
+	int i;
+
+	for (i = 0; i < nsims && sims[i] != h; i++)
+		;
+	if (i == nsims)
+		return (-1);
+	rje_close(h->s);
+	h->s->waitfn = NULL;
+	h->s->readfn = NULL;
+	h->s->writefn = NULL;
+	h->s->lineio = NULL;
+	sims[i] = sims[--nsims];
+	if (nsims == 0)
+		rje_set_clock(NULL);
+	return (0);
+}
+
+// The simulated time, us
+
+long long rje_sim_clock()
+{
+	return (now);
+}
+
+// Let up to msec go by: to the next time something arrives at a station
+// or a host means to act, if that's sooner.  Nothing goes by while
+// something is waiting to be read.
+
+int rje_sim_advance(long msec)
+{
+	long long to = now + msec * 1000LL;
+	struct rje_sim *h;
+	int i;
+
+	for (i = 0; i < nsims; i++) {
+		h = sims[i];
+		if (h->outlen > 0 && h->due < to)
+			to = h->due;
+		if (h->timer > 0 && h->timer < to)
+			to = h->timer;
+	}
+	if (to > now)
+		now = to;
+	for (i = 0; i < nsims; i++)
+		sim_tick(sims[i]);
+	return (0);
+}
+
+// The session's waitfn
+
+static int sim_wait(struct rje_session *s, long msec)
+{
+	struct rje_sim *h = (struct rje_sim *) s->lineio;
+
+	sim_tick(h);
+	if (h->outlen == 0 || h->due > now)
+		rje_sim_advance(msec);
+	return (h->outlen > 0 && h->due <= now);
+}
+
+// ... its readfn.  It's only asked once waitfn says there's something.
+
+static int sim_read(struct rje_session *s, unsigned char *buf, int len)
+{
+	struct rje_sim *h = (struct rje_sim *) s->lineio;
+
+	if (h->outlen == 0 || h->due > now)
+		return (-1);
+	if (len > h->outlen)
+		len = h->outlen;
+	memcpy(buf, h->out, len);
+	memmove(h->out, h->out + len, h->outlen - len);
+	h->outlen -= len;
+	return (len);
+}
+
+// ... and its writefn: a frame from the station, unless the line loses it
+
+static int sim_write(struct rje_session *s, unsigned char *buf, int len)
+{
+	struct rje_sim *h = (struct rje_sim *) s->lineio;
+
+	h->frames++;
+	h->heard = now + sim_bytes(h, len);
+	if (h->lose > 0 && sim_roll(h, h->lose)) {
+		h->lost++;
+		return (len);
+	}
+	sim_frame(h, buf, len);
+	return (len);
+}
+
+// What has the station sent?
+
+static int sim_frame(struct rje_sim *h, unsigned char *f, int n)
+{
+	while (n > 0 && (*f == SYN || *f == EPAD || *f == SPAD)) {
+		f++;
+		n--;
+	}
+	if (n == 0)
+		return (0);
+	if (h->state == SIM_ML)
+		return (sim_ml_frame(h, f, n));
+	if (f[0] == ENQ)
+		return (sim_enq(h));
+	if (f[0] == STX && n > 1 && f[1] == ENQ) {	/* TTD */
+		if (h->state == SIM_RECV) {
+			sim_ctl(h, NAK, 0);
+			h->timer = h->heard + SIM_WAIT * 1000LL;
+		}
+		return (0);
+	}
+	if (h->state == SIM_RECV && f[0] == DLE && n > 6 && f[1] == STX &&
+		f[2] == ML_BCB && f[5] == ML_RCB_SIGNON &&
+		f[6] == ML_SRCB_SIGNON)	/* no card starts with x'80' */
+		return (sim_ml_signon(h));
+	if (f[0] == STX || (f[0] == DLE && n > 1 && f[1] == STX))
+		return (sim_block(h, f, n));
+	if (f[0] == EOT) {
+		if (h->state == SIM_RECV) {
+			h->ready = h->njobs;	/* decks in, output may go */
+			sim_idle(h);
+		}
+		return (0);
+	}
+	if (f[0] == DLE && n > 1)
+		return (sim_answer(h, f[n - 1]));
+	return (0);			/* NAK, or something odd */
+}
+
+// A bid, or the station asking for our last answer again.  If we've bid
+// too, we win: the station gives way.
+
+static int sim_enq(struct rje_sim *h)
+{
+	if (h->state == SIM_IDLE) {
+		h->bids++;
+		h->state = SIM_RECV;
+		h->ack = ACK1;
+		sim_ctl(h, DLE, ACK0);
+	} else if (h->state == SIM_RECV && h->lastlen > 0) {
+		sim_send(h, h->last, h->lastlen, h->heard + h->delay);
+	} else {
+		return (0);
+	}
+	h->timer = h->heard + SIM_WAIT * 1000LL;
+	return (0);
+}
+
+// A block of cards.  Any JOB card in it starts a job.
+
+static int sim_block(struct rje_sim *h, unsigned char *f, int n)
+{
+	unsigned char card[RDR_MAXRECL + 1];
+	int i, len = 0, trn = (f[0] == DLE);
+
+	if (h->state != SIM_RECV)
+		return (0);
+	h->timer = h->heard + SIM_WAIT * 1000LL;
+	if (h->nak > 0 && sim_roll(h, h->nak)) {
+		h->naks++;
+		return (sim_ctl(h, NAK, 0));
+	}
+	h->blocks++;
+	h->cards++;
+	for (i = trn ? 2 : 1; i < n - (trn ? 2 : 1); i++) {
+		if (trn && f[i] == DLE && i + 1 < n - 2)
+			i++;
+		else if (!trn && f[i] == IRS && i + 1 < n - 1)
+			h->cards++;
+		if (len < RDR_MAXRECL)
+			card[len++] = f[i];
+	}
+	sim_job(h, card, len, 0);
+	if (h->wack > 0 && sim_roll(h, h->wack)) {
+		h->wacks++;
+		sim_ctl(h, DLE, WACK);
+		h->last[0] = DLE;	/* the ENQ after it gets the ACK */
+		h->last[1] = h->ack;
+	} else {
+		sim_ctl(h, DLE, h->ack);
+	}
+	h->ack = (h->ack == ACK0) ? ACK1 : ACK0;
+	return (0);
+}
+
+// A card (EBCDIC, with room for a 0 after it).  If it's a JOB card, the
+// job's output is to go back once the deck it's in has all come.
+
+static int sim_job(struct rje_sim *h, unsigned char *card, int len,
+	int stream)
+{
+	struct rje_simjob *j;
+	char name[9], cls;
+
+	card[len] = 0;
+	translate_to_ascii(card);
+	if (!rje_job_card(card, len, NULL, name, &cls))
+		return (0);
+	h->jobs++;
+	h->jobno++;
+	if (h->print > 0 && h->njobs < SIM_JOBS) {
+		j = &h->job[(h->first + h->njobs++) % SIM_JOBS];
+		strcpy(j->name, name);
+		j->number = h->jobno;
+		j->line = -1;
+		j->stream = stream;
+	}
+	return (1);
+}
+
+// The station answered our bid, or a block of output (or polled)
+
+static int sim_answer(struct rje_sim *h, unsigned char c)
+{
+	struct rje_simjob *j = &h->job[h->first];
+
+	switch (h->state) {
+	case SIM_IDLE:
+		if (c == ACK0) {	/* DLE DLE DLE ACK0, a poll */
+			h->polls++;
+			sim_ctl(h, DLE, ACK0);
+		}
+		return (0);
+	case SIM_BID:
+		if (c != ACK0)
+			return (0);
+		h->state = SIM_SEND;
+		h->tries = 0;
+		return (sim_output(h));
+	case SIM_SEND:
+		h->tries = 0;
+		if (c == WACK) {	/* it has the block, wait for it */
+			h->held = 1;
+			h->timer = h->heard + SIM_WACK_WAIT * 1000LL;
+			return (0);
+		}
+		if (c != ACK0 && c != ACK1 && c != RVI)
+			return (0);
+		h->held = 0;
+		h->lines += h->inblock;
+		if (j->line >= h->print) {
+			h->first = (h->first + 1) % SIM_JOBS;
+			h->njobs--;
+			h->ready--;
+		}
+		if (j->line >= h->print || c == RVI) {
+			sim_ctl(h, EOT, 0);
+			return (sim_idle(h));
+		}
+		return (sim_output(h));
+	default:
+		return (0);
+	}
+}
+
+// Our own timer has gone off
+
+static int sim_tick(struct rje_sim *h)
+{
+	unsigned char enq[3] = {SYN, SYN, ENQ};
+
+	if (h->timer == 0 || h->timer > now)
+		return (0);
+	h->timer = 0;
+	switch (h->state) {
+	case SIM_IDLE:			/* bid for the line */
+		if (h->ready == 0 || h->print == 0)
+			return (0);
+		h->state = SIM_BID;
+		h->tries = 0;
+		sim_send(h, enq, sizeof(enq), now);
+		break;
+	case SIM_BID:
+	case SIM_SEND:			/* no answer, or WACK waited out */
+		if (!h->held && ++h->tries > SIM_TRIES) {
+			if (h->state == SIM_SEND)
+				sim_ctl(h, EOT, 0);
+			return (sim_idle(h));
+		}
+		h->held = 0;
+		sim_send(h, enq, sizeof(enq), now);
+		break;
+	case SIM_RECV:			/* the station has gone quiet */
+		h->njobs = h->ready;	/* decks not all in are no jobs */
+		return (sim_idle(h));
+	case SIM_ML:			/* ... for good */
+		h->njobs = h->ready = 0;
+		return (sim_idle(h));
+	}
+	h->timer = h->due + SIM_WAIT * 1000LL;
+	return (0);
+}
+
+// The line's free.  Bid for it before long if there's output to go.
+
+static int sim_idle(struct rje_sim *h)
+{
+	h->state = SIM_IDLE;
+	h->lastlen = 0;
+	h->held = 0;
+	h->timer = 0;
+	if (h->ready > 0 && h->print > 0)
+		h->timer = now + SIM_GAP * 1000LL;
+	return (0);
+}
+
+// The next block of the oldest job's output
+
+static int sim_output(struct rje_sim *h)
+{
+	struct rje_simjob *j = &h->job[h->first];
+	unsigned char blk[SIM_OUT];
+	char text[96];
+	int k, n = 0;
+
+	blk[n++] = SYN;
+	blk[n++] = SYN;
+	blk[n++] = STX;
+	for (k = 0; k < SIM_LINES && j->line < h->print; k++, j->line++) {
+		if (j->line < 0)
+			sprintf(text, "JOB%5d  $HASP395 %-8s ENDED", j->number,
+				j->name);
+		else
+			sprintf(text, " %-8s JOB%05d  LINE %6d OF %6d", j->name,
+				j->number, j->line + 1, h->print);
+		translate_to_ebcdic((unsigned char *) text);
+		blk[n++] = ESC;
+		blk[n++] = ACK1;	/* '/', space one line */
+		memcpy(blk + n, text, strlen(text));
+		n += strlen(text);
+		blk[n++] = IRS;
+	}
+	h->inblock = k;
+	blk[n++] = (j->line >= h->print) ? ETX : ETB;
+	sim_send(h, blk, n, h->heard + h->delay);
+	h->timer = h->due + SIM_WAIT * 1000LL;
+	return (0);
+}
+
+// A short answer, DLE ACK0 say, or a single NAK or EOT with c2 0.  It's
+// kept, for when the station ENQs for it again.
+
+static int sim_ctl(struct rje_sim *h, unsigned char c1, unsigned char c2)
+{
+	unsigned char ctl[4];
+	int n = 0;
+
+	ctl[n++] = SYN;
+	ctl[n++] = SYN;
+	ctl[n++] = c1;
+	if (c2 != 0)
+		ctl[n++] = c2;
+	memcpy(h->last, ctl + 2, n - 2);
+	h->lastlen = n - 2;
+	return (sim_send(h, ctl, n, h->heard + h->delay));
+}
+
+// ---------------------------------------------------------------------------------
+// Multileaving
+// ---------------------------------------------------------------------------------
+
+// The station has sent its signon in a multileaving block.  Say ACK0 to
+// it, and from here on the line goes back and forth.
+
+static int sim_ml_signon(struct rje_sim *h)
+{
+	h->state = SIM_ML;
+	h->bcbin = 1;			/* the signon block was 0 */
+	h->bcbout = 0;
+	h->fcs = ML_FCS | 0x0f;
+	h->fcsout = ML_FCS | 0x0f;	/* as the station takes it to be */
+	h->nctl = 0;
+	h->prt = ML_IDLE;
+	h->inblock = 0;
+	h->njobs = h->ready = 0;
+	return (sim_ml_send(h, 0));
+}
+
+// Anything from a multileaving station is our turn to answer
+
+static int sim_ml_frame(struct rje_sim *h, unsigned char *f, int n)
+{
+	h->timer = h->heard + SIM_QUIET * 1000LL;
+	if (f[0] == DLE && n > 1 && f[1] == STX)
+		return (sim_ml_block(h, f, n));
+	if (f[0] == DLE && n > 1 && f[1] == ACK0) {	/* it has nothing */
+		h->lines += h->inblock;
+		h->inblock = 0;
+		return (sim_ml_send(h, 1));
+	}
+	if (f[0] == NAK || f[0] == ENQ)	/* it didn't get our last */
+		return (sim_send(h, h->blk, h->blklen, h->heard + h->delay));
+	if (f[0] == EOT) {		/* signed off */
+		h->njobs = h->ready = 0;
+		return (sim_idle(h));
+	}
+	return (0);
+}
+
+// A block from the station, DLE STX ... DLE ETB
+
+static int sim_ml_block(struct rje_sim *h, unsigned char *f, int n)
+{
+	unsigned char b[SIM_OUT];
+	unsigned char card[RDR_MAXRECL + 1];
+	int i, k, len = 0, rcb, srcb, seq, used;
+
+	for (i = 2; i < n - 2; i++) {
+		if (f[i] == DLE && i + 1 < n - 2)
+			i++;
+		b[len++] = f[i];
+	}
+	if (len < 3 || (h->nak > 0 && sim_roll(h, h->nak))) {
+		h->naks++;
+		return (sim_ctl(h, NAK, 0));
+	}
+	seq = b[0] & 0x0f;
+	if ((b[0] & 0xf0) == ML_BCB && seq == ((h->bcbin + 15) & 0x0f))
+		return (sim_send(h, h->blk, h->blklen, h->heard + h->delay));
+	h->bcbin = (seq + 1) & 0x0f;
+	h->fcs = b[1];
+	h->blocks++;
+	h->lines += h->inblock;		/* it has our last block */
+	h->inblock = 0;
+
+	for (i = 3; i + 1 < len; ) {
+		rcb = b[i++];
+		if (rcb == ML_RCB_EOB)
+			break;
+		srcb = b[i++];
+		if (rcb == ML_RCB_REQUEST) {
+			if (ML_RCB_TYPE(srcb) == ML_READER)
+				sim_ml_ctl(h, ML_RCB_GRANT, srcb);
+			continue;
+		}
+		if (rcb == ML_RCB_GRANT) {
+			if (srcb == ML_RCB(ML_PRINTER, 1) && h->prt == ML_ASKED)
+				h->prt = ML_ACTIVE;
+			continue;
+		}
+		if (ML_RCB_TYPE(rcb) == 0 || rcb == ML_RCB_SIGNON)
+			continue;	/* no data with these */
+		k = rje_ml_unpack(b + i, len - i, card, RDR_MAXRECL, &used);
+		if (k < 0)
+			break;
+		i += used;
+		if (ML_RCB_TYPE(rcb) == ML_READER)
+			sim_ml_card(h, ML_RCB_STREAM(rcb), card, k);
+	}				/* commands are taken and forgotten */
+	return (sim_ml_send(h, 0));
+}
+
+// A card on reader n, or with len 0 the end of its deck, which lets the
+// jobs in it have their output
+
+static int sim_ml_card(struct rje_sim *h, int n, unsigned char *card,
+	int len)
+{
+	int i;
+
+	if (len > 0) {
+		h->cards++;
+		return (sim_job(h, card, len, n));
+	}
+	for (i = 0; i < h->njobs; i++) {
+		if (h->job[(h->first + i) % SIM_JOBS].stream == n)
+			h->job[(h->first + i) % SIM_JOBS].stream = 0;
+	}
+	return (0);
+}
+
+// Our turn: a block of whatever we have, or DLE ACK0.  A WACK is a block
+// whose FCS stops the station sending anything until the next.
+
+static int sim_ml_send(struct rje_sim *h, int poll)
+{
+	unsigned char b[ML_BLKSIZE];
+	unsigned char *o = h->blk;
+	struct rje_simjob *j = &h->job[h->first];
+	int i, n = 0, len = 3;
+
+	b[0] = ML_BCB | h->bcbout;
+	b[1] = ML_FCS | 0x0f;
+	b[2] = ML_FCS | ML_FCS_CONSOLE | 0x0f;
+	if (h->wack > 0 && sim_roll(h, h->wack)) {
+		h->wacks++;
+		b[1] = ML_FCS | ML_FCS_WAIT;
+	}
+	if (h->prt == ML_IDLE && h->njobs > 0 && j->stream == 0) {
+		sim_ml_ctl(h, ML_RCB_REQUEST, ML_RCB(ML_PRINTER, 1));
+		h->prt = ML_ASKED;
+	}
+	for (i = 0; i < h->nctl; i++) {
+		b[len++] = h->ctl[i][0];
+		b[len++] = h->ctl[i][1];
+	}
+	h->nctl = 0;
+	if (h->prt == ML_ACTIVE && !(h->fcs & ML_FCS_WAIT) &&
+		(h->fcs & ML_FCS_STREAM(1)))
+		len = sim_ml_print(h, b, len);
+
+	o[n++] = SYN;
+	o[n++] = SYN;
+	o[n++] = DLE;
+	if (len == 3 && b[1] == h->fcsout) {
+		if (poll)
+			h->polls++;
+		o[n++] = ACK0;
+	} else {
+		o[n++] = STX;
+		b[len++] = ML_RCB_EOB;
+		for (i = 0; i < len; i++) {
+			if (b[i] == DLE)
+				o[n++] = DLE;
+			o[n++] = b[i];
+		}
+		o[n++] = DLE;
+		o[n++] = ETB;
+		h->fcsout = b[1];
+		h->bcbout = (h->bcbout + 1) & 0x0f;
+	}
+	h->blklen = n;
+	return (sim_send(h, o, n, h->heard + h->delay));
+}
+
+// As much of the oldest job's output as fits, and the end of it if that
+// does too, when the printer is free again for the next job's
+
+static int sim_ml_print(struct rje_sim *h, unsigned char *b, int len)
+{
+	struct rje_simjob *j = &h->job[h->first];
+	char text[96];
+	int k, used;
+
+	for (k = 0; k < SIM_LINES && j->line < h->print; k++, j->line++) {
+		if (j->line < 0)
+			sprintf(text, "JOB%5d  $HASP395 %-8s ENDED", j->number,
+				j->name);
+		else
+			sprintf(text, " %-8s JOB%05d  LINE %6d OF %6d", j->name,
+				j->number, j->line + 1, h->print);
+		translate_to_ebcdic((unsigned char *) text);
+		used = rje_ml_pack(b + len + 2, ML_BLKSIZE - 1 - len - 2,
+			(unsigned char *) text, strlen(text));
+		if (used < 0)
+			break;
+		b[len++] = ML_RCB(ML_PRINTER, 1);
+		b[len++] = ML_SRCB | 1;	/* space a line after it */
+		len += used;
+	}
+	h->inblock = k;
+	if (j->line >= h->print && len + 3 < ML_BLKSIZE) {
+		b[len++] = ML_RCB(ML_PRINTER, 1);
+		b[len++] = ML_SRCB | 1;
+		b[len++] = 0;		/* end of file */
+		h->first = (h->first + 1) % SIM_JOBS;
+		h->njobs--;
+		h->prt = ML_IDLE;
+	}
+	return (len);
+}
+
+static int sim_ml_ctl(struct rje_sim *h, int rcb, int srcb)
+{
+	if (h->nctl >= SIM_CTL)
+		return (-1);
+	h->ctl[h->nctl][0] = rcb;
+	h->ctl[h->nctl][1] = srcb;
+	h->nctl++;
+	return (0);
+}
+
+// Put something on the line to the station, starting at when.  It gets
+// there once all of it has gone down the line, after anything already on
+// its way.
+
+static int sim_send(struct rje_sim *h, const unsigned char *buf, int len,
+	long long when)
+{
+	if (when < now)
+		when = now;
+	if (h->outlen > 0 && h->due > when)
+		when = h->due;
+	if (len > SIM_OUT - h->outlen)
+		len = SIM_OUT - h->outlen;
+	memcpy(h->out + h->outlen, buf, len);
+	h->outlen += len;
+	h->due = when + sim_bytes(h, len);
+	return (0);
+}
+
+// Does something that happens pct percent of the time happen this time?
+
+static int sim_roll(struct rje_sim *h, int pct)
+{
+	h->seed = h->seed * 1103515245UL + 12345UL;
+	return ((int) ((h->seed >> 16) % 100) < pct);
+}
+
+// How long len bytes take down the line, us
+
+static long long sim_bytes(struct rje_sim *h, int len)
+{
+	if (h->bps <= 0)
+		return (0);
+	return (len * 8 * 1000000LL / h->bps);
+}
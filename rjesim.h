@@ -0,0 +1,114 @@
+//  rjesim - a simulated host on the other end of a librje80 session, in
+//  simulated time.
+//
+//  A session brought up with rje_sim_attach, instead of rje_open, talks
+//  to a host kept here that plays its part of 2780/3780 bisync: it
+//  answers bids and polls, ACKs blocks, takes JOB cards as jobs, and
+//  sends each job back a listing, NAKing, WACKing and losing frames as
+//  often as it's told to.
+//
+//  Time is a clock kept here too, which moves only when a session waits
+//  (or rje_sim_advance is called), and then straight to the next thing
+//  due to happen, so an hour of polling or a run of ten second timeouts
+//  goes by in milliseconds.  Every session and host shares the one clock.
+//
+//  A station that signs on as a multileaving workstation (opt_ml) gets a
+//  HASP host instead: it takes turns with the station a block at a time,
+//  grants its readers, and sends each job's listing on printer 1 once the
+//  station grants that.  WACKs become a block whose FCS holds everything.
+
+#ifndef RJESIM_H
+#define RJESIM_H
+
+#include "librje80.h"
+
+#define SIM_MAX 64		/* hosts at once */
+#define SIM_JOBS 64		/* jobs waiting for their output */
+#define SIM_OUT 2048		/* on the line to the station */
+
+// Where the host is with the line
+
+#define SIM_IDLE 0		/* nobody has it */
+#define SIM_RECV 1		/* the station has it, sending us cards */
+#define SIM_BID 2		/* we've bid for it */
+#define SIM_SEND 3		/* we're sending output */
+#define SIM_ML 4		/* multileaving: we and it take turns */
+
+#define SIM_CTL 8		/* multileaving control records to send */
+
+struct rje_simjob {
+	char name[9];
+	int number;		/* JOB number given it */
+	int line;		/* output lines sent, -1 = none yet */
+	int stream;		/* multileaving: reader it's coming in on, 0 = in */
+};
+
+struct rje_sim {
+
+	// How the host behaves: set after rje_sim_init
+
+	long delay;		/* us it takes to answer */
+	long bps;		/* line speed, 0 = as fast as it goes */
+	int nak;		/* percent of blocks NAKed */
+	int wack;		/* ... and WACKed */
+	int lose;		/* percent of the station's frames lost */
+	int print;		/* lines of output for each job, 0 = none */
+	unsigned long seed;	/* for all of those */
+
+	// The line
+
+	struct rje_session *s;
+	int state;		/* SIM_xxx */
+	unsigned char ack;	/* ACK0 or ACK1 for the next block */
+	unsigned char last[4];	/* last reply, again for an ENQ */
+	int lastlen;
+	unsigned char out[SIM_OUT];	/* on its way to the station */
+	int outlen;
+	long long due;		/* ... and when it gets there */
+	long long heard;	/* when the last frame from it was all in */
+	long long timer;	/* when we next act on our own, 0 = never */
+	int tries;		/* ENQs with no answer */
+	int held;		/* the station WACKed us */
+	int inblock;		/* print lines in the block out */
+
+	// Multileaving
+
+	int bcbin;		/* count due in the station's next block */
+	int bcbout;		/* ... and in ours */
+	unsigned char fcs;	/* the station's FCS, first byte */
+	unsigned char fcsout;	/* ... and ours, in our last block */
+	unsigned char ctl[SIM_CTL][2];	/* control records for our next block */
+	int nctl;
+	int prt;		/* printer 1: ML_IDLE, ML_ASKED or ML_ACTIVE */
+	unsigned char blk[SIM_OUT];	/* our last answer, for a NAK */
+	int blklen;
+
+	// Jobs whose output is to go back, oldest first
+
+	struct rje_simjob job[SIM_JOBS];
+	int first;
+	int njobs;
+	int ready;		/* ... of which the deck is all in */
+	int jobno;		/* last JOB number given */
+
+	// What's happened
+
+	long frames;		/* from the station */
+	long bids;
+	long blocks;
+	long cards;
+	long jobs;
+	long naks;		/* we sent */
+	long wacks;
+	long lost;
+	long polls;
+	long lines;		/* of output, ACKed */
+};
+
+void rje_sim_init(struct rje_sim *h);
+int rje_sim_attach(struct rje_sim *h, struct rje_session *s, char *name);
+int rje_sim_detach(struct rje_sim *h);
+int rje_sim_advance(long msec);
+long long rje_sim_clock();
+
+#endif
@@ -0,0 +1,234 @@
+//  rjesink - host output piped into a command.
+//
+//  Our end of the pipe is non-blocking and close-on-exec (so the next
+//  command started doesn't hold this one's stdin open).  SIGPIPE is
+//  ignored: a command that exits early shows up as a write failing, and
+//  what it didn't take is thrown away.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "rjesink.h"
+
+#if defined (_WIN32)
+
+// No fork or non-blocking pipes: output only goes to files
+
+int rje_sink_open(struct rje_sink *k, const char *cmd, const char *dev,
+	int stream)
+{
+	return (-1);
+}
+
+int rje_sink_write(struct rje_sink *k, const void *data, int len)
+{
+	return (-1);
+}
+
+int rje_sink_flush(struct rje_sink *k, int wait)
+{
+	return (0);
+}
+
+int rje_sink_close(struct rje_sink *k)
+{
+	k->state = SINK_FREE;
+	return (1);
+}
+
+int rje_sink_service(struct rje_sink *k)
+{
+	return (0);
+}
+
+int rje_sink_finish(struct rje_sink *k)
+{
+	k->state = SINK_FREE;
+	return (0);
+}
+
+#else
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/select.h>
+#include <sys/wait.h>
+
+static int sink_reap(struct rje_sink *k, int wait);
+
+// Start cmd with a pipe to its stdin.  It gets nothing else of ours:
+// a line socket it held would keep the line up after we'd closed it.
+// Everything rje80 waits on is under FD_SETSIZE, for select.
+
+int rje_sink_open(struct rje_sink *k, const char *cmd, const char *dev,
+	int stream)
+{
+	int p[2], fd;
+	char num[16];
+
+	memset(k, 0, sizeof(*k));
+	k->fd = -1;
+	strncpy(k->cmd, cmd, sizeof(k->cmd) - 1);
+	if ((k->buf = (unsigned char *) malloc(SINK_SIZE)) == NULL)
+		return (-1);
+	if (pipe(p) != 0) {
+		free(k->buf);
+		k->buf = NULL;
+		return (-1);
+	}
+	signal(SIGPIPE, SIG_IGN);
+	fflush(stdout);
+	if ((k->pid = fork()) < 0) {
+		close(p[0]);
+		close(p[1]);
+		free(k->buf);
+		k->buf = NULL;
+		k->pid = 0;
+		return (-1);
+	}
+	if (k->pid == 0) {
+		dup2(p[0], 0);
+		for (fd = 3; fd < FD_SETSIZE; fd++)
+			close(fd);
+		signal(SIGPIPE, SIG_DFL);
+		sprintf(num, "%d", stream);
+		setenv("RJE_DEVICE", dev, 1);
+		setenv("RJE_STREAM", num, 1);
+		execl("/bin/sh", "sh", "-c", cmd, (char *) NULL);
+		_exit(127);
+	}
+	close(p[0]);
+	fcntl(p[1], F_SETFL, fcntl(p[1], F_GETFL) | O_NONBLOCK);
+	fcntl(p[1], F_SETFD, FD_CLOEXEC);
+	k->fd = p[1];
+	k->state = SINK_OPEN;
+	return (0);
+}
+
+// Some output for it.  It goes into the buffer and as much of the buffer
+// as the pipe will take goes down it; only when the buffer's full do we
+// wait for the command.  -1 if the command has gone away.
+
+int rje_sink_write(struct rje_sink *k, const void *data, int len)
+{
+	const unsigned char *p = (const unsigned char *) data;
+	int n;
+
+	if (k->broken || k->fd < 0)
+		return (-1);
+	while (len > 0) {
+		if (k->len == SINK_SIZE && rje_sink_flush(k, 1) < 0)
+			return (-1);
+		n = SINK_SIZE - k->len;
+		if (n > len)
+			n = len;
+		memcpy(k->buf + k->len, p, n);
+		k->len += n;
+		p += n;
+		len -= n;
+	}
+	return (rje_sink_flush(k, 0));
+}
+
+// Send what's buffered down the pipe: what it'll take now, or (wait) all
+// of it.  -1 if the command has gone away.
+
+int rje_sink_flush(struct rje_sink *k, int wait)
+{
+	struct pollfd pfd;
+	int n;
+
+	while (k->len > 0 && k->fd >= 0) {
+		n = write(k->fd, k->buf, k->len);
+		if (n > 0) {
+			memmove(k->buf, k->buf + n, k->len - n);
+			k->len -= n;
+			k->sent += n;
+			continue;
+		}
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+			if (!wait)
+				return (0);
+			pfd.fd = k->fd;
+			pfd.events = POLLOUT;
+			poll(&pfd, 1, -1);
+			continue;
+		}
+		k->broken = 1;		/* EPIPE: it's not reading any more */
+		k->len = 0;
+		return (-1);
+	}
+	return (k->broken ? -1 : 0);
+}
+
+// The output's all in.  The command gets end of file once the buffer has
+// gone, which may not be yet.
+
+int rje_sink_close(struct rje_sink *k)
+{
+	if (k->state == SINK_OPEN)
+		k->state = SINK_CLOSING;
+	return (rje_sink_service(k));
+}
+
+// Keep things moving: more down the pipe, end of file once a closing
+// one's buffer is empty, and the command reaped once it's exited.
+// Returns 1 when it has just finished, its exit status in k->status.
+
+int rje_sink_service(struct rje_sink *k)
+{
+	if (k->state == SINK_FREE)
+		return (0);
+	if (k->len > 0)
+		rje_sink_flush(k, 0);
+	if (k->state == SINK_CLOSING && k->len == 0 && k->fd >= 0) {
+		close(k->fd);
+		k->fd = -1;
+	}
+	return (sink_reap(k, 0));
+}
+
+// Finish it now, waiting for all of it to go and the command to exit.
+// Returns its exit status.
+
+int rje_sink_finish(struct rje_sink *k)
+{
+	if (k->state == SINK_FREE)
+		return (k->status);
+	rje_sink_flush(k, 1);
+	if (k->fd >= 0)
+		close(k->fd);
+	k->fd = -1;
+	k->state = SINK_CLOSING;
+	sink_reap(k, 1);
+	return (k->status);
+}
+
+// Once the pipe's closed: has the command exited?  If so, free the sink
+// and return 1.
+
+static int sink_reap(struct rje_sink *k, int wait)
+{
+	int st;
+
+	if (k->fd >= 0)
+		return (0);
+	if (k->pid > 0) {
+		if (waitpid(k->pid, &st, wait ? 0 : WNOHANG) != k->pid)
+			return (0);
+		k->status = WIFEXITED(st) ? WEXITSTATUS(st) : 128 + WTERMSIG(st);
+		k->pid = 0;
+	}
+	free(k->buf);
+	k->buf = NULL;
+	k->state = SINK_FREE;
+	return (1);
+}
+
+#endif
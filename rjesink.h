@@ -0,0 +1,44 @@
+//  rjesink - host output piped into a command as it arrives, rather than
+//  written to a file, so whatever works on it can start on the first
+//  lines instead of waiting for the last.
+//
+//  A PRINT or PUNCH name starting with | is a command for sh.  Each
+//  transmission (or multileaving file) starts it afresh, with RJE_DEVICE
+//  set to print or punch and RJE_STREAM to the stream number, and its
+//  stdin is closed at the end of the output.  The pipe is never waited
+//  on: records go into a buffer and on down the pipe as fast as the
+//  command takes them, and while more than SINK_HIGH is waiting the host
+//  is held off with WACK.  Only if the buffer fills anyway do we wait.
+
+#ifndef RJESINK_H
+#define RJESINK_H
+
+#define RJE_SINKS 8		/* commands running at once, per session */
+#define SINK_SIZE 65536		/* buffered for one */
+#define SINK_HIGH 32768		/* more than this waiting: busy */
+
+#define SINK_FREE 0
+#define SINK_OPEN 1		/* taking output */
+#define SINK_CLOSING 2		/* output all in, the rest still to go */
+
+struct rje_sink {
+	int state;		/* SINK_xxx */
+	int fd;			/* our end of the pipe, -1 = closed */
+	int pid;		/* the command, 0 = gone */
+	unsigned char *buf;	/* waiting to go down the pipe */
+	int len;
+	long sent;		/* bytes it has taken */
+	int broken;		/* it went away before taking it all */
+	int status;		/* exit status, once it's gone */
+	char cmd[80];
+};
+
+int rje_sink_open(struct rje_sink *k, const char *cmd, const char *dev,
+	int stream);
+int rje_sink_write(struct rje_sink *k, const void *data, int len);
+int rje_sink_flush(struct rje_sink *k, int wait);
+int rje_sink_close(struct rje_sink *k);
+int rje_sink_service(struct rje_sink *k);
+int rje_sink_finish(struct rje_sink *k);
+
+#endif
@@ -0,0 +1,339 @@
+//  rjesubmit - send decks to the host and wait for their jobs' output,
+//  with no terminal and no rje80.rc: for scripts, make and cron.
+//
+//  It connects, signs on, queues the decks in the order given (- is
+//  stdin) and, with -w, waits until the output of every job in them has
+//  come back - a job being a JOB card sent, followed to its output as
+//  JOBS in rje80 does - or the time is up.  Print and punch output goes
+//  to the -P and -K files, written as PRINT and PUNCH would write them;
+//  that's everything the host sends while we're on the line, ours or
+//  not.  Without them it's thrown away.
+//
+//  With -g the decks go over a group of lines instead (see rjegroup),
+//  named in the -G file, each deck on whichever line is least busy.  The
+//  second line's output goes to the -P and -K files with .2 on the end,
+//  and so on.
+//
+//      cc -o rjesubmit rjesubmit.c librje80.c rjeforms.c rjereader.c rjehasp.c rjehist.c rjejobs.c rjesink.c rjeindex.c rjegroup.c rjedeck.c -lpthread
+//
+//  It's for Linux and the like only (getopt).
+//
+//  Usage: rjesubmit [options] host port deck ...
+//         rjesubmit [options] -g group deck ...
+//
+//	-u id	signon id (* = no signon, the default)
+//	-p pw	signon password
+//	-g name	send on the lines of this group
+//	-G file	... from this file of them (rje80.lines)
+//	-o n	host OS, as SET OS numbers it (2 = JES2)
+//	-m	sign on as a multileaving workstation
+//	-f fmt	deck format: ascii, ebcdic (fb), vb or aws (ascii)
+//	-r n	card length (80)
+//	-w sec	wait this long for the jobs' output (0 = don't wait)
+//	-P file	print output, |command to pipe it
+//	-F fmt	... written as text, asa, machine, fba or vba (text)
+//	-K file	punch output
+//	-C dir	keep decks made into cards here, and send them from there
+//		when they're sent again (see rjedeck)
+//	-v	show what the line has to say, on stderr
+//
+//  Exits
+//
+//	0	every deck went, and with -w every job's output is in
+//	1	a deck didn't all go
+//	2	a bad option, or a deck that can't be read
+//	3	the host can't be reached, won't take the signon, or the
+//		line dropped (with -g: every line has)
+//	4	-w ran out before all the output was in
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <unistd.h>
+
+#include "librje80.h"
+#include "rjegroup.h"
+
+#define EXIT_FAILED 1
+#define EXIT_USAGE 2
+#define EXIT_LINE 3
+#define EXIT_TIMEOUT 4
+
+int sub_msg(struct rje_session *s, char *msg);
+int sub_rec(struct rje_session *s, int device, unsigned char *rec, int len);
+int sub_events();
+int lines_gone();
+int jobs_out(int *jobs);
+int prt_fmt(char *name);
+int usage();
+
+struct rje_group g;		/* the line, or lines */
+int verbose = 0;
+int ids[RJE_MAXQ];		/* the decks' submission ids */
+int rcs[RJE_MAXQ];		/* ... and how they went, 1 = not yet */
+int ndecks = 0;
+
+int main(int argc, char *argv[])
+{
+	struct rje_session *s;
+	char *host = NULL, *user = "*", *password = "";
+	char *group = NULL, *groups = "rje80.lines";
+	char *print = NULL, *punch = NULL, *cache = NULL;
+	struct rje_decks *decks = NULL;
+	char fmt[16];
+	int c, i, n, port = 0, first, jobs, rc = 0;
+	int hostos = 2, multileave = 0, rdrfmt = RDR_ASCII, recl = 80;
+	int prtfmt = 0, wait = 0;
+	long deadline;
+
+	while ((c = getopt(argc, argv, "u:p:g:G:o:mf:r:w:P:F:K:C:v")) != -1) {
+		switch (c) {
+		case 'u': user = optarg; break;
+		case 'p': password = optarg; break;
+		case 'g': group = optarg; break;
+		case 'G': groups = optarg; break;
+		case 'o': hostos = atoi(optarg); break;
+		case 'm': multileave = 1; break;
+		case 'f':
+			for (i = 0; optarg[i] != 0 && i < sizeof(fmt) - 1; i++)
+				fmt[i] = toupper((unsigned char) optarg[i]);
+			fmt[i] = 0;
+			if ((rdrfmt = rje_reader_fmt(fmt)) < 0)
+				return (usage());
+			break;
+		case 'r': recl = atoi(optarg); break;
+		case 'w': wait = atoi(optarg); break;
+		case 'P': print = optarg; break;
+		case 'F':
+			if ((prtfmt = prt_fmt(optarg)) < 0)
+				return (usage());
+			break;
+		case 'K': punch = optarg; break;
+		case 'C': cache = optarg; break;
+		case 'v': verbose = 1; break;
+		default: return (usage());
+		}
+	}
+	first = optind + (group == NULL ? 2 : 0);
+	if (argc - first < 1 || argc - first > RJE_MAXQ ||
+		recl < 80 || recl > RDR_MAXRECL || hostos < 0 || hostos > 6)
+		return (usage());
+
+	rje_init();
+	if (cache != NULL)
+		decks = rje_decks_open(0, cache);
+	if (group == NULL) {
+		host = argv[optind];
+		port = atoi(argv[optind + 1]);
+		rje_group_init(&g, host);
+		rje_group_add(&g, host, port, user, password);
+	} else {
+		rje_group_init(&g, group);
+		if ((n = rje_group_load(&g, groups, group)) <= 0) {
+			fprintf(stderr, n < 0 ? "RJE509S Can't read %s.\n" :
+				"RJE510S %s has no lines for %s.\n", groups, group);
+			return (EXIT_USAGE);
+		}
+	}
+	for (i = 0; i < g.n; i++) {
+		s = g.line[i].s;
+		s->msgfn = sub_msg;
+		s->recfn = sub_rec;
+		s->opt_os = hostos;
+		s->opt_ml = multileave;
+		s->opt_copy = 0;
+		s->decks = decks;
+		s->print_fmt = prtfmt;
+		strcpy(s->print, "");
+		strcpy(s->punch, "");
+		if (print != NULL)
+			snprintf(s->print, sizeof(s->print), i ? "%s.%d" : "%s",
+				print, i + 1);
+		if (punch != NULL)
+			snprintf(s->punch, sizeof(s->punch), i ? "%s.%d" : "%s",
+				punch, i + 1);
+		if (strcmp(g.line[i].user, "*") == 0) {
+			strncpy(g.line[i].user, user, sizeof(g.line[i].user) - 1);
+			strncpy(g.line[i].password, password,
+				sizeof(g.line[i].password) - 1);
+		}
+	}
+	g.reader_fmt = rdrfmt;
+	g.reader_recl = recl;
+
+	// Queue the decks first: one that can't be read stops us before
+	// anything goes
+
+	for (i = first; i < argc; i++) {
+		if ((ids[ndecks] = rje_group_submit(&g, argv[i], RJE_PRIO_FILE)) < 0) {
+			fprintf(stderr, "RJE501S Can't read %s.\n", argv[i]);
+			return (EXIT_USAGE);
+		}
+		rcs[ndecks++] = 1;
+	}
+	rje_group_start(&g);
+
+	// Until the decks have gone
+
+	for (;;) {
+		rje_group_poll(&g, 100);
+		sub_events();
+		if (lines_gone()) {
+			rc = EXIT_LINE;
+			break;
+		}
+		for (i = n = 0; i < ndecks; i++)
+			n += (rcs[i] == 1);
+		if (n == 0)
+			break;
+	}
+	for (i = 0; i < ndecks && rc == 0; i++) {
+		if (rcs[i] != 0)
+			rc = EXIT_FAILED;
+	}
+	if (rc == 0 && verbose)
+		fprintf(stderr, "RJE504I %d deck%s sent.\n", ndecks,
+			ndecks == 1 ? "" : "s");
+
+	// ... and their jobs' output is in
+
+	deadline = rje_clock() + wait * 1000L;
+	while (rc == 0 && wait > 0) {
+		n = jobs_out(&jobs);
+		if (jobs == 0 && verbose)
+			fprintf(stderr, "RJE505I No JOB cards sent, no output to wait for.\n");
+		if (n == jobs)
+			break;
+		if (rje_clock() - deadline >= 0) {
+			fprintf(stderr, "RJE506W Output for %d of %d job%s in after %d seconds.\n",
+				n, jobs, jobs == 1 ? "" : "s", wait);
+			rc = EXIT_TIMEOUT;
+			break;
+		}
+		rje_group_poll(&g, 100);
+		sub_events();
+		if (lines_gone()) {
+			fprintf(stderr, "RJE507S The line dropped with output for %d of %d job%s in.\n",
+				n, jobs, jobs == 1 ? "" : "s");
+			rc = EXIT_LINE;
+		}
+	}
+	if (rc == 0 && wait > 0 && jobs > 0 && verbose)
+		fprintf(stderr, "RJE508I Output for %d job%s is in.\n", jobs,
+			jobs == 1 ? "" : "s");
+
+	rje_group_close(&g);
+	rje_decks_close(decks);
+	rje_term();
+	return (rc);
+}
+
+// What the line has to say, for -v
+
+int sub_msg(struct rje_session *s, char *msg)
+{
+	int i;
+
+	if (!verbose)
+		return (0);
+	for (i = 0; msg[i] != 0; i++) {
+		if (msg[i] != '\r')
+			fputc(msg[i], stderr);
+	}
+	return (0);
+}
+
+// Output for a device with no file is thrown away (1 = taken)
+
+int sub_rec(struct rje_session *s, int device, unsigned char *rec, int len)
+{
+	if (device == 0)
+		return (strlen(s->print) == 0);
+	return (strlen(s->punch) == 0);
+}
+
+// Take in how the decks went
+
+int sub_events()
+{
+	struct rje_event ev;
+	int i;
+
+	while (rje_group_event(&g, &ev)) {
+		if (ev.type != RJE_EV_DONE)
+			continue;
+		for (i = 0; i < ndecks; i++) {
+			if (ids[i] == ev.id)
+				rcs[i] = ev.rc;
+		}
+	}
+	return (0);
+}
+
+// Have all the lines failed?  Say so the first time.
+
+int lines_gone()
+{
+	if (rje_group_count(&g, GL_UP) + rje_group_count(&g, GL_START) > 0)
+		return (0);
+	if (g.n == 1)
+		fprintf(stderr, "RJE502S The line to %s port %d is down.\n",
+			g.line[0].host, g.line[0].port);
+	else
+		fprintf(stderr, "RJE503S Every line of %s is down.\n", g.name);
+	return (1);
+}
+
+// How many of the jobs in our decks have their output in; *jobs says how
+// many there are
+
+int jobs_out(int *jobs)
+{
+	int i, done, n = 0;
+
+	*jobs = 0;
+	for (i = 0; i < ndecks; i++) {
+		*jobs += rje_group_jobs(&g, ids[i], &done);
+		n += done;
+	}
+	return (n);
+}
+
+// Print file format, as PRINT takes them, to its print_fmt or -1
+
+int prt_fmt(char *name)
+{
+	static char *names[] = {"text", "asa", "machine", "fba", "vba"};
+	int i;
+
+	for (i = 0; i < 5; i++) {
+		if (strcasecmp(name, names[i]) == 0)
+			return (i);
+	}
+	return (-1);
+}
+
+int usage()
+{
+	fprintf(stderr, "Usage: rjesubmit [options] host port deck ...\n"
+		"       rjesubmit [options] -g group deck ...\n"
+		"  -u id    signon id (* = no signon, the default)\n"
+		"  -p pw    signon password\n"
+		"  -g name  send on the lines of this group\n"
+		"  -G file  ... from this file of them (rje80.lines)\n"
+		"  -o n     host OS, as SET OS numbers it (2 = JES2)\n"
+		"  -m       sign on as a multileaving workstation\n"
+		"  -f fmt   deck format: ascii, ebcdic, vb or aws (ascii)\n"
+		"  -r n     card length (80)\n"
+		"  -w sec   wait this long for the jobs' output (0 = don't)\n"
+		"  -P file  print output, |command to pipe it\n"
+		"  -F fmt   ... as text, asa, machine, fba or vba (text)\n"
+		"  -K file  punch output\n"
+		"  -C dir   keep decks made into cards here, to send again\n"
+		"  -v       show what the line has to say, on stderr\n"
+		"A deck of - is stdin.  Exits 0 if all went, 1 if a deck didn't,\n"
+		"2 for bad options or decks, 3 if the line failed, 4 if -w ran out.\n");
+	return (EXIT_USAGE);
+}